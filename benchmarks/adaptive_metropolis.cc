@@ -0,0 +1,114 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the time per sample of the AdaptiveMetropolis producer for
+// several dimensions d, compared to the pattern used in the adaptive_mh_01
+// test and the documentation of the MetropolisHastings class: a
+// MetropolisHastings producer whose perturb function queries a
+// CovarianceMatrix consumer and computes its Cholesky decomposition in
+// every step. The log likelihood is that of a standard normal
+// distribution, which is cheap to evaluate, so that the timings show the
+// cost of the adaptation: O(d^3) per sample for the latter, and O(d^2)
+// for the former.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <eigen3/Eigen/Dense>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/adaptive_metropolis.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+using SampleType = Eigen::VectorXd;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -x.squaredNorm()/2;
+}
+
+
+
+int main ()
+{
+  const SampleFlow::types::sample_index n_samples = 2000;
+  const SampleFlow::types::sample_index adaptation_start = 500;
+
+  std::cout << "    d   MH+llt (us/sample)   AdaptiveMetropolis (us/sample)" << std::endl;
+
+  for (const unsigned int dim : {10, 50, 100, 200})
+    {
+      const SampleType x0 = SampleType::Zero(dim);
+      const Eigen::MatrixXd initial_covariance = 0.01 * Eigen::MatrixXd::Identity(dim,dim);
+      const Eigen::MatrixXd initial_factor = initial_covariance.llt().matrixL();
+
+      double mh_time;
+      {
+        SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+
+        SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+        covariance_matrix.connect_to_producer(mh_sampler);
+
+        SampleFlow::Consumers::CountSamples<SampleType> counter;
+        counter.connect_to_producer(mh_sampler);
+
+        std::mt19937 rng;
+        std::normal_distribution<double> distribution(0,1);
+
+        const auto start = std::chrono::steady_clock::now();
+        mh_sampler.sample (x0,
+                           &log_likelihood,
+                           [&](const SampleType &x)
+        {
+          SampleType z (dim);
+          for (unsigned int k=0; k<dim; ++k)
+            z(k) = 2.4/std::sqrt(1.*dim) * distribution(rng);
+
+          if (counter.get() < adaptation_start)
+            return std::make_pair (SampleType(x + initial_factor * z), 1.0);
+          else
+            {
+              const auto LLt = covariance_matrix.get().llt();
+              return std::make_pair (SampleType(x + LLt.matrixL() * z), 1.0);
+            }
+        },
+        n_samples);
+        const auto end = std::chrono::steady_clock::now();
+        mh_time = std::chrono::duration<double,std::micro>(end-start).count() / n_samples;
+      }
+
+      double am_time;
+      {
+        SampleFlow::Producers::AdaptiveMetropolis<SampleType> am_sampler (initial_covariance,
+            adaptation_start);
+
+        const auto start = std::chrono::steady_clock::now();
+        am_sampler.sample (x0, &log_likelihood, n_samples);
+        const auto end = std::chrono::steady_clock::now();
+        am_time = std::chrono::duration<double,std::micro>(end-start).count() / n_samples;
+      }
+
+      std::cout << std::setw(5) << dim
+                << std::fixed << std::setprecision(1)
+                << std::setw(21) << mh_time
+                << std::setw(33) << am_time
+                << std::endl;
+    }
+}
@@ -0,0 +1,132 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure how many samples per second can be sent from a producer to a
+// cheap consumer that runs in ParallelMode::asynchronous, and compare
+// this to processing the samples synchronously as well as to launching
+// one std::async task per sample (which is what asynchronous consumers
+// used to do before they used a ThreadPool).
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/thread_pool.h>
+
+
+using SampleType = double;
+
+
+// Run the given function and report how many samples per second it
+// processed.
+template <typename Function>
+void time_it (const std::string &name,
+              const std::size_t n_samples,
+              const Function &f)
+{
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+
+  const double seconds = std::chrono::duration<double>(end-start).count();
+  std::cout << std::left << std::setw(40) << name
+            << std::right << std::setw(14) << std::fixed << std::setprecision(0)
+            << n_samples/seconds << " samples/s"
+            << std::endl;
+}
+
+
+
+int main ()
+{
+  const std::size_t n_samples = 1000000;
+  std::vector<SampleType> samples (n_samples);
+  for (std::size_t i=0; i<n_samples; ++i)
+    samples[i] = i;
+
+  std::cout << "Sending samples to a MeanValue consumer; the default thread pool has "
+            << SampleFlow::ThreadPool::default_pool().n_threads()
+            << " threads." << std::endl;
+
+  time_it ("synchronous", n_samples, [&]()
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.connect_to_producer (range_producer);
+    range_producer.sample (samples);
+  });
+
+  time_it ("asynchronous, default thread pool", n_samples, [&]()
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 1024);
+    mean_value.connect_to_producer (range_producer);
+    range_producer.sample (samples);
+  });
+
+  for (const unsigned int n_threads : {1U, 2U, 4U})
+    time_it ("asynchronous, pool with " + std::to_string(n_threads) + " thread(s)",
+             n_samples, [&]()
+    {
+      SampleFlow::ThreadPool thread_pool (n_threads);
+      SampleFlow::Producers::Range<SampleType> range_producer;
+      SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+      mean_value.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 1024);
+      mean_value.set_thread_pool (thread_pool);
+      mean_value.connect_to_producer (range_producer);
+      range_producer.sample (samples);
+    });
+
+  // Emulate what asynchronous consumers used to do: Launch a separate
+  // std::async task for every sample. This is so slow that we only use
+  // a fraction of the samples.
+  const std::size_t n_async_samples = n_samples / 20;
+  time_it ("one std::async per sample", n_async_samples, [&]()
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+
+    std::mutex futures_mutex;
+    std::list<std::future<void>> futures;
+    SampleFlow::Consumers::Action<SampleType>
+    launcher ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+    {
+      std::future<void> future = std::async (std::launch::async,
+                                             [&mean_value,sample,aux_data]()
+      {
+        mean_value.consume (sample, aux_data);
+      });
+
+      std::lock_guard<std::mutex> lock (futures_mutex);
+      futures.emplace_back (std::move(future));
+    });
+    launcher.connect_to_producer (range_producer);
+
+    range_producer.sample (std::vector<SampleType>(samples.begin(),
+                                                   samples.begin()+n_async_samples));
+    for (auto &future : futures)
+      future.wait();
+  });
+}
@@ -0,0 +1,154 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Count how many memory allocations it takes, per sample, to attach the
+// auxiliary data the Metropolis-Hastings producer attaches to each of its
+// samples and for a consumer to read the log likelihood back, and how
+// long this takes. This is done for the std::map<std::string,boost::any>
+// type that SampleFlow used to use for AuxiliaryData, for the current
+// AuxiliaryData class with the predefined keys, and for the current class
+// used through its string-based compatibility interface. Finally, also
+// count allocations per sample of a complete Metropolis-Hastings run with
+// a MaximumProbabilitySample consumer.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+
+#include <sampleflow/auxiliary_data.h>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/maximum_probability_sample.h>
+
+
+// Replace the global operator new so that we can count allocations.
+// The replacements are not inlined: otherwise, GCC pairs the malloc()
+// and free() calls they contain with the new and delete expressions they
+// were inlined into, and warns about mismatched allocation functions.
+static unsigned long n_allocations = 0;
+
+__attribute__((noinline))
+void *operator new (std::size_t size)
+{
+  ++n_allocations;
+  if (void *p = std::malloc (size))
+    return p;
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline))
+void operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+__attribute__((noinline))
+void operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+
+
+using LegacyAuxiliaryData = std::map<std::string, boost::any>;
+
+const unsigned int n_samples = 1000000;
+
+
+template <typename Function>
+void measure (const std::string &name,
+              const Function &function)
+{
+  double sum = 0;
+
+  const unsigned long n_allocations_before = n_allocations;
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int i=0; i<n_samples; ++i)
+    sum += function (i);
+  const auto end = std::chrono::steady_clock::now();
+
+  std::cout << std::setw(32) << std::left << name << std::right
+            << std::fixed << std::setprecision(1)
+            << std::setw(8) << 1.*(n_allocations-n_allocations_before)/n_samples
+            << std::setw(12)
+            << std::chrono::duration<double,std::nano>(end-start).count() / n_samples
+            << "   (" << sum << ")"
+            << std::endl;
+}
+
+
+
+int main ()
+{
+  std::cout << "                                allocs/sample   ns/sample" << std::endl;
+
+  measure ("std::map<std::string,boost::any>",
+           [](const unsigned int i)
+  {
+    LegacyAuxiliaryData aux_data
+    {
+      {"relative log likelihood", boost::any(1.*i)},
+      {"sample is repeated", boost::any(i%2 == 0)}
+    };
+    return boost::any_cast<double>(aux_data["relative log likelihood"]);
+  });
+
+  measure ("AuxiliaryData, predefined keys",
+           [](const unsigned int i)
+  {
+    SampleFlow::AuxiliaryData aux_data
+    {
+      {SampleFlow::AuxiliaryDataKeys::relative_log_likelihood, 1.*i},
+      {SampleFlow::AuxiliaryDataKeys::sample_is_repeated, i%2 == 0}
+    };
+    return aux_data.get<double>(SampleFlow::AuxiliaryDataKeys::relative_log_likelihood);
+  });
+
+  measure ("AuxiliaryData, string keys",
+           [](const unsigned int i)
+  {
+    SampleFlow::AuxiliaryData aux_data
+    {
+      {"relative log likelihood", boost::any(1.*i)},
+      {"sample is repeated", boost::any(i%2 == 0)}
+    };
+    return boost::any_cast<double>(aux_data.at("relative log likelihood"));
+  });
+
+
+  // Now run a complete Metropolis-Hastings chain:
+  SampleFlow::Producers::MetropolisHastings<double> mh_sampler;
+  SampleFlow::Consumers::MaximumProbabilitySample<double> map_point;
+  map_point.connect_to_producer (mh_sampler);
+
+  const unsigned long n_allocations_before = n_allocations;
+  mh_sampler.sample (0.,
+                     [](const double x)
+  {
+    return -x*x;
+  },
+  [](const double x)
+  {
+    return std::make_pair (x + 0.1, 1.);
+  },
+  n_samples);
+  std::cout << "Metropolis-Hastings with MAP consumer: "
+            << 1.*(n_allocations-n_allocations_before)/n_samples
+            << " allocs/sample" << std::endl;
+}
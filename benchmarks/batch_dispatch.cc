@@ -0,0 +1,67 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure how the time it takes to get samples from a producer to cheap
+// consumers depends on the size of the blocks in which the producer sends
+// them. With a block size of one, every sample is sent through the
+// producer's signal individually; with larger block sizes, the cost of
+// the signal and of the locks the consumers take is amortized over all
+// samples of a block.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/histogram.h>
+
+
+using SampleType = double;
+
+
+int main ()
+{
+  const std::size_t n_samples = 2000000;
+  std::vector<SampleType> samples (n_samples);
+  for (std::size_t i=0; i<n_samples; ++i)
+    samples[i] = 1.*i/n_samples;
+
+  for (const unsigned int batch_size : {1, 16, 256, 4096})
+    {
+      SampleFlow::Producers::Range<SampleType> range_producer (batch_size);
+
+      SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+      mean_value.connect_to_producer (range_producer);
+
+      SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+      covariance_matrix.connect_to_producer (range_producer);
+
+      SampleFlow::Consumers::Histogram<SampleType> histogram (0, 1, 100);
+      histogram.connect_to_producer (range_producer);
+
+      const auto start = std::chrono::steady_clock::now();
+      range_producer.sample (samples);
+      const auto end = std::chrono::steady_clock::now();
+
+      std::cout << "batch size " << std::setw(5) << batch_size << ": "
+                << std::fixed << std::setprecision(1) << std::setw(8)
+                << std::chrono::duration<double,std::nano>(end-start).count() / n_samples
+                << " ns/sample" << std::endl;
+    }
+}
@@ -0,0 +1,83 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the time per sample of the DelayedRejectionMetropolisHastings
+// producer as a function of the maximal number of delay stages, for
+// samples in 100 dimensions. The log likelihood is cheap to evaluate and
+// the proposal distribution is far too wide, so that most samples go
+// through all delay stages and the timings show the overhead of computing
+// acceptance ratios and of managing the rejected samples.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <eigen3/Eigen/Dense>
+
+#include <sampleflow/producers/delayed_rejection_mh.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+
+
+using SampleType = Eigen::VectorXd;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -x.squaredNorm()/2;
+}
+
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      const std::vector<SampleType> &rejected_samples)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0, 1./(1+rejected_samples.size()));
+
+  SampleType y = x;
+  for (unsigned int i=0; i<y.size(); ++i)
+    y(i) += distribution(rng);
+  return {y, 1.0};
+}
+
+
+
+int main ()
+{
+  const unsigned int dim = 100;
+  const SampleFlow::types::sample_index n_samples = 2000;
+
+  std::cout << "max_delays   time per sample (us)   acceptance ratio" << std::endl;
+
+  for (const unsigned int max_delays : {0, 1, 2, 4, 6, 8, 10})
+    {
+      SampleFlow::Producers::DelayedRejectionMetropolisHastings<SampleType> dr_sampler;
+      SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+      acceptance_ratio.connect_to_producer (dr_sampler);
+
+      const auto start = std::chrono::steady_clock::now();
+      dr_sampler.sample (SampleType::Zero(dim), &log_likelihood, &perturb,
+                         max_delays, n_samples, 1);
+      const auto end = std::chrono::steady_clock::now();
+
+      std::cout << std::setw(10) << max_delays
+                << std::fixed << std::setprecision(1)
+                << std::setw(23) << std::chrono::duration<double,std::micro>(end-start).count() / n_samples
+                << std::setprecision(3)
+                << std::setw(19) << acceptance_ratio.get()
+                << std::endl;
+    }
+}
@@ -0,0 +1,79 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the time it takes a producer to send samples to 1, 4, and 16
+// cheap consumers, using each of the mechanisms described by the
+// DispatchBackend enum. The consumers all run in
+// ParallelMode::synchronous, so that what is measured is in essence the
+// cost of walking over the list of connected consumers and calling each
+// of them.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+using SampleType = double;
+
+
+double time_per_sample (const SampleFlow::DispatchBackend backend,
+                        const unsigned int n_consumers,
+                        const std::vector<SampleType> &samples)
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  range_producer.set_dispatch_backend (backend);
+
+  std::vector<std::unique_ptr<SampleFlow::Consumers::CountSamples<SampleType>>> consumers;
+  for (unsigned int i=0; i<n_consumers; ++i)
+    {
+      consumers.emplace_back (new SampleFlow::Consumers::CountSamples<SampleType>());
+      consumers.back()->connect_to_producer (range_producer);
+    }
+
+  const auto start = std::chrono::steady_clock::now();
+  range_producer.sample (samples);
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::nano>(end-start).count() / samples.size();
+}
+
+
+
+int main ()
+{
+  const std::size_t n_samples = 1000000;
+  const std::vector<SampleType> samples (n_samples, 1.);
+
+  std::cout << "consumers   boost::signals2   flat list   (ns/sample)" << std::endl;
+  for (const unsigned int n_consumers : {1, 4, 16})
+    {
+      const double t_signals2
+        = time_per_sample (SampleFlow::DispatchBackend::signals2, n_consumers, samples);
+      const double t_flat_list
+        = time_per_sample (SampleFlow::DispatchBackend::flat_list, n_consumers, samples);
+
+      std::cout << std::setw(9) << n_consumers
+                << std::fixed << std::setprecision(1)
+                << std::setw(18) << t_signals2
+                << std::setw(12) << t_flat_list
+                << std::endl;
+    }
+}
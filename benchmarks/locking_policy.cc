@@ -0,0 +1,113 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the per-sample cost of the chain
+//   Range -> DiscardFirstN -> TakeEveryNth -> {MeanValue, CountSamples}
+// for each of the locking policies (see Consumer::set_locking_policy()),
+// both when the objects are connected via Consumer::connect_to_producer()
+// and when they are composed into a static pipeline. All objects run in
+// ParallelMode::synchronous and receive their samples from one thread, so
+// the locks are never contended; the differences are the costs of
+// obtaining and releasing uncontended locks.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <sampleflow/pipeline.h>
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+using SampleType = double;
+
+
+double time_per_sample (const SampleFlow::LockingPolicy locking_policy,
+                        const bool static_pipeline,
+                        const std::vector<SampleType> &samples)
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  range_producer.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+
+  SampleFlow::Filters::DiscardFirstN<SampleType> discard (1000);
+  SampleFlow::Filters::TakeEveryNth<SampleType> every_nth (2);
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+
+  discard.set_locking_policy (locking_policy);
+  every_nth.set_locking_policy (locking_policy);
+  mean_value.set_locking_policy (locking_policy);
+  count_samples.set_locking_policy (locking_policy);
+
+  const auto start = std::chrono::steady_clock::now();
+  if (static_pipeline == false)
+    {
+      discard.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+      every_nth.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+
+      discard.connect_to_producer (range_producer);
+      every_nth.connect_to_producer (discard);
+      mean_value.connect_to_producer (every_nth);
+      count_samples.connect_to_producer (every_nth);
+
+      range_producer.sample (samples);
+    }
+  else
+    {
+      const auto pipeline = SampleFlow::pipeline (range_producer)
+                            | discard
+                            | every_nth
+                            | SampleFlow::tee (mean_value, count_samples);
+
+      range_producer.sample (samples);
+    }
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::nano>(end-start).count() / samples.size();
+}
+
+
+
+int main ()
+{
+  const std::size_t n_samples = 4000000;
+  std::vector<SampleType> samples (n_samples);
+  for (std::size_t i=0; i<n_samples; ++i)
+    samples[i] = i;
+
+  std::cout << "policy       connected   static pipeline   (ns/sample)" << std::endl;
+  for (const auto &policy :
+       {
+         std::make_pair (std::string("mutex"), SampleFlow::LockingPolicy::mutex),
+         std::make_pair (std::string("spinlock"), SampleFlow::LockingPolicy::spinlock),
+         std::make_pair (std::string("none"), SampleFlow::LockingPolicy::none)
+       })
+    {
+      const double t_connected = time_per_sample (policy.second, false, samples);
+      const double t_static    = time_per_sample (policy.second, true, samples);
+
+      std::cout << std::setw(8) << std::left << policy.first << std::right
+                << std::fixed << std::setprecision(1)
+                << std::setw(14) << t_connected
+                << std::setw(18) << t_static
+                << std::endl;
+    }
+}
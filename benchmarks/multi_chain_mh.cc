@@ -0,0 +1,125 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the wall-clock time it takes to produce a fixed total number of
+// samples with a log likelihood function that is expensive to evaluate
+// (it keeps the processor busy for a fixed amount of time), once with a
+// single chain run by the MetropolisHastings producer and then with K
+// chains run by the MultiChainMetropolisHastings producer, for several
+// values of K. On a machine with at least K cores, the latter should be
+// close to K times faster.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/multi_chain_mh.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = double;
+
+
+// A log likelihood that busy-waits for the given number of microseconds
+// before returning the log of a Gaussian.
+double expensive_log_likelihood (const SampleType &x)
+{
+  const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+  while (std::chrono::steady_clock::now() < end)
+    ;
+
+  return -(x-1)*(x-1);
+}
+
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::uniform_real_distribution<double> distribution(-0.5,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+
+// Run the given function and return the wall-clock time in milliseconds.
+template <typename Function>
+double wall_time (const Function &f)
+{
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::milli>(end-start).count();
+}
+
+
+
+int main ()
+{
+  const SampleFlow::types::sample_index n_samples = 8000;
+
+  std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+  std::cout << "chains   wall time (ms)   speedup" << std::endl;
+
+  double t_single_chain;
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.connect_to_producer (mh_sampler);
+
+    std::mt19937 rng;
+    t_single_chain = wall_time ([&]()
+    {
+      mh_sampler.sample (0,
+                         &expensive_log_likelihood,
+                         [&](const SampleType &x)
+      {
+        return perturb (x, rng);
+      },
+      n_samples);
+    });
+  }
+  std::cout << std::setw(6) << 1
+            << std::fixed << std::setprecision(1)
+            << std::setw(17) << t_single_chain
+            << std::setw(10) << 1.0
+            << std::endl;
+
+  for (const unsigned int n_chains : {2, 4, 8})
+    {
+      SampleFlow::Producers::MultiChainMetropolisHastings<SampleType> mh_sampler;
+      SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+      mean_value.connect_to_producer (mh_sampler);
+
+      const double t = wall_time ([&]()
+      {
+        mh_sampler.sample (std::vector<SampleType>(n_chains, 0.),
+                           &expensive_log_likelihood,
+                           &perturb,
+                           n_samples / n_chains);
+      });
+
+      std::cout << std::setw(6) << n_chains
+                << std::setw(17) << t
+                << std::setw(10) << t_single_chain / t
+                << std::endl;
+    }
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the wall-clock time per step and the acceptance ratio of the
+// MultipleTryMetropolisHastings producer for several numbers of trials
+// per step, using a log likelihood function that is expensive to evaluate
+// (it keeps the processor busy for a fixed amount of time). With M trials,
+// each step requires 2M-1 evaluations of the log likelihood; on a machine
+// with at least 2M-1 cores, these all run concurrently and a step should
+// take about twice as long as a step with M=1 (which is equivalent to the
+// MetropolisHastings producer), while the acceptance ratio increases.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <valarray>
+
+#include <sampleflow/producers/multiple_try_mh.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+double expensive_log_likelihood (const SampleType &x)
+{
+  const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+  while (std::chrono::steady_clock::now() < end)
+    ;
+
+  return -((x-1.)*(x-1.)).sum();
+}
+
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0,1);
+  SampleType y = x;
+  for (auto &y_i : y)
+    y_i += distribution(rng);
+  return {y, 1.0};
+}
+
+
+
+int main ()
+{
+  const SampleFlow::types::sample_index n_samples = 2000;
+
+  std::cout << "Threads in pool: " << SampleFlow::ThreadPool::default_pool().n_threads() << std::endl;
+  std::cout << "trials   time per step (us)   acceptance ratio" << std::endl;
+  for (const unsigned int n_trials : {1, 2, 4, 8})
+    {
+      SampleFlow::Producers::MultipleTryMetropolisHastings<SampleType> mtm_sampler (n_trials);
+
+      SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+      acceptance_ratio.connect_to_producer (mtm_sampler);
+
+      const auto start = std::chrono::steady_clock::now();
+      mtm_sampler.sample ({0, 0, 0, 0}, &expensive_log_likelihood, &perturb, n_samples);
+      const auto end = std::chrono::steady_clock::now();
+
+      std::cout << std::setw(6) << n_trials
+                << std::fixed << std::setprecision(1)
+                << std::setw(23) << std::chrono::duration<double,std::micro>(end-start).count() / n_samples
+                << std::setprecision(3)
+                << std::setw(19) << acceptance_ratio.get()
+                << std::endl;
+    }
+}
@@ -0,0 +1,108 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the wall-clock time per sample of the PrefetchingMetropolisHastings
+// producer for several prefetch depths, compared to the MetropolisHastings
+// producer, using a log likelihood function that is expensive to evaluate
+// (it keeps the processor busy for a fixed amount of time). The proposal
+// distribution is chosen so that the acceptance ratio is around 0.25. All
+// variants produce the same chain; on a machine with at least as many
+// cores as the prefetch depth, the prefetching producer should be faster by
+// the factor (1-(1-a)^d)/a discussed in the documentation of the class.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/prefetching_mh.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+
+
+using SampleType = double;
+
+
+double expensive_log_likelihood (const SampleType &x)
+{
+  const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+  while (std::chrono::steady_clock::now() < end)
+    ;
+
+  return -x*x/2;
+}
+
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::normal_distribution<double> distribution(0,6);
+  return {x + distribution(rng), 1.0};
+}
+
+
+
+int main ()
+{
+  const SampleFlow::types::sample_index n_samples = 5000;
+
+  std::cout << "Threads in pool: " << SampleFlow::ThreadPool::default_pool().n_threads() << std::endl;
+  std::cout << "depth   time per sample (us)   acceptance ratio" << std::endl;
+
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+    acceptance_ratio.connect_to_producer (mh_sampler);
+
+    std::mt19937 proposal_rng
+      = SampleFlow::Producers::PrefetchingMetropolisHastings<SampleType>::proposal_generator (1);
+    const auto start = std::chrono::steady_clock::now();
+    mh_sampler.sample (0,
+                       &expensive_log_likelihood,
+                       [&](const SampleType &x)
+    {
+      return perturb (x, proposal_rng);
+    },
+    n_samples, 1);
+    const auto end = std::chrono::steady_clock::now();
+
+    std::cout << "   MH"
+              << std::fixed << std::setprecision(1)
+              << std::setw(25) << std::chrono::duration<double,std::micro>(end-start).count() / n_samples
+              << std::setprecision(3)
+              << std::setw(19) << acceptance_ratio.get()
+              << std::endl;
+  }
+
+  for (const unsigned int depth : {1, 2, 4, 8})
+    {
+      SampleFlow::Producers::PrefetchingMetropolisHastings<SampleType> prefetching_sampler (depth);
+      SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+      acceptance_ratio.connect_to_producer (prefetching_sampler);
+
+      const auto start = std::chrono::steady_clock::now();
+      prefetching_sampler.sample (0, &expensive_log_likelihood, &perturb, n_samples, 1);
+      const auto end = std::chrono::steady_clock::now();
+
+      std::cout << std::setw(5) << depth
+                << std::fixed << std::setprecision(1)
+                << std::setw(25) << std::chrono::duration<double,std::micro>(end-start).count() / n_samples
+                << std::setprecision(3)
+                << std::setw(19) << acceptance_ratio.get()
+                << std::endl;
+    }
+}
@@ -0,0 +1,91 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the throughput of a MeanValue and a CountSamples consumer to
+// which a varying number of threads send samples concurrently, with and
+// without sharding (see MeanValue::enable_sharding()). Without sharding,
+// all threads compete for the lock of each consumer; with sharding, each
+// thread updates its own shard. The time reported for the sharded
+// objects includes the time to merge the shards in a final call to get().
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+using SampleType = double;
+
+
+double time_per_sample (const unsigned int n_threads,
+                        const bool sharded,
+                        const unsigned int n_samples_per_thread)
+{
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  if (sharded)
+    {
+      mean_value.enable_sharding (n_threads);
+      count_samples.enable_sharding (n_threads);
+    }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int t=0; t<n_threads; ++t)
+    threads.emplace_back ([&]()
+  {
+    for (unsigned int i=0; i<n_samples_per_thread; ++i)
+      {
+        mean_value.consume (i, {});
+        count_samples.consume (i, {});
+      }
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  const volatile double mean = mean_value.get();
+  const volatile SampleFlow::types::sample_index count = count_samples.get();
+  (void)mean;
+  (void)count;
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::nano>(end-start).count()
+         / (1. * n_threads * n_samples_per_thread);
+}
+
+
+
+int main ()
+{
+  const unsigned int n_samples_per_thread = 1000000;
+
+  std::cout << "threads   unsharded   sharded   (ns/sample)" << std::endl;
+  for (const unsigned int n_threads : {1, 2, 4, 8})
+    {
+      const double t_unsharded = time_per_sample (n_threads, false, n_samples_per_thread);
+      const double t_sharded   = time_per_sample (n_threads, true, n_samples_per_thread);
+
+      std::cout << std::setw(7) << n_threads
+                << std::fixed << std::setprecision(1)
+                << std::setw(12) << t_unsharded
+                << std::setw(10) << t_sharded
+                << std::endl;
+    }
+}
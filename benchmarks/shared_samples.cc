@@ -0,0 +1,86 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the time it takes to get large, vector-valued samples from a
+// producer to several consumers that only read them, with and without
+// sharing samples between consumers (see Producer::set_sample_sharing()).
+// Without sharing, every consumer gets its own copy of every sample.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = Eigen::VectorXd;
+
+
+double time_per_sample (const bool share_samples,
+                        const unsigned int n_consumers,
+                        const std::vector<SampleType> &samples)
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  range_producer.set_sample_sharing (share_samples);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (range_producer);
+
+  SampleFlow::Filters::TakeEveryNth<SampleType> every_tenth (10);
+  every_tenth.connect_to_producer (range_producer);
+
+  std::vector<std::unique_ptr<SampleFlow::Consumers::CountSamples<SampleType>>> consumers;
+  for (unsigned int i=0; i<n_consumers; ++i)
+    {
+      consumers.emplace_back (new SampleFlow::Consumers::CountSamples<SampleType>());
+      consumers.back()->connect_to_producer (i % 2 == 0 ?
+                                             static_cast<SampleFlow::Producer<SampleType>&>(range_producer) :
+                                             static_cast<SampleFlow::Producer<SampleType>&>(every_tenth));
+    }
+
+  const auto start = std::chrono::steady_clock::now();
+  range_producer.sample (samples);
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::micro>(end-start).count() / samples.size();
+}
+
+
+
+int main ()
+{
+  const std::size_t n_samples = 2000;
+  const std::vector<SampleType> samples (n_samples, SampleType::Ones(10000));
+
+  std::cout << "consumers   by value   shared   (us/sample)" << std::endl;
+  for (const unsigned int n_consumers : {1, 4, 16})
+    {
+      const double t_by_value = time_per_sample (false, n_consumers, samples);
+      const double t_shared   = time_per_sample (true, n_consumers, samples);
+
+      std::cout << std::setw(9) << n_consumers
+                << std::fixed << std::setprecision(1)
+                << std::setw(11) << t_by_value
+                << std::setw(9) << t_shared
+                << std::endl;
+    }
+}
@@ -0,0 +1,159 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the per-sample cost of the chain
+//   producer -> DiscardFirstN -> TakeEveryNth -> {MeanValue, CovarianceMatrix}
+// when the objects are connected via Consumer::connect_to_producer() (with
+// both dispatch backends), and when they are composed into a static
+// pipeline (see pipeline.h). This is done once with a Range producer, so
+// that the timings show the cost of getting samples through the chain,
+// and once with a Metropolis-Hastings producer, for which the cost of
+// generating the samples is added.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <sampleflow/pipeline.h>
+#include <sampleflow/producers/range.h>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+
+using SampleType = double;
+
+
+// Run the given function and return the time per sample in nanoseconds.
+template <typename Function>
+double time_per_sample (const std::size_t n_samples,
+                        const Function &f)
+{
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::nano>(end-start).count() / n_samples;
+}
+
+
+
+// Connect the chain of filters and consumers to the given producer, either
+// as a graph of connected objects or as a static pipeline, using either
+// the signals2 (variants 0 and 2) or the flat_list (variants 1 and 3)
+// dispatch backend, and then call the given function that makes the
+// producer create its samples.
+template <typename ProducerType, typename Function>
+double time_per_sample (const std::size_t n_samples,
+                        const int variant,
+                        const Function &run_producer)
+{
+  return time_per_sample (n_samples, [&]()
+  {
+    ProducerType producer;
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+
+    if ((variant == 1) || (variant == 3))
+      producer.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+
+    if (variant < 2)
+      {
+        SampleFlow::Filters::DiscardFirstN<SampleType> discard (1000);
+        SampleFlow::Filters::TakeEveryNth<SampleType> every_nth (10);
+        if (variant == 1)
+          {
+            discard.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+            every_nth.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+          }
+
+        discard.connect_to_producer (producer);
+        every_nth.connect_to_producer (discard);
+        mean_value.connect_to_producer (every_nth);
+        covariance_matrix.connect_to_producer (every_nth);
+
+        run_producer (producer);
+      }
+    else
+      {
+        const auto pipeline = SampleFlow::pipeline (producer)
+                              | SampleFlow::discard_first_n (1000)
+                              | SampleFlow::take_every_nth (10)
+                              | SampleFlow::tee (mean_value, covariance_matrix);
+
+        run_producer (producer);
+      }
+  });
+}
+
+
+
+template <typename ProducerType, typename Function>
+void run_benchmarks (const std::string &name,
+                     const std::size_t n_samples,
+                     const Function &run_producer)
+{
+  std::cout << name << ":\n"
+            << std::fixed << std::setprecision(1)
+            << "  connected, signals2 backend:     " << std::setw(8)
+            << time_per_sample<ProducerType> (n_samples, 0, run_producer) << " ns/sample\n"
+            << "  connected, flat_list backend:    " << std::setw(8)
+            << time_per_sample<ProducerType> (n_samples, 1, run_producer) << " ns/sample\n"
+            << "  static pipeline, signals2:       " << std::setw(8)
+            << time_per_sample<ProducerType> (n_samples, 2, run_producer) << " ns/sample\n"
+            << "  static pipeline, flat_list:      " << std::setw(8)
+            << time_per_sample<ProducerType> (n_samples, 3, run_producer) << " ns/sample\n"
+            << std::endl;
+}
+
+
+
+int main ()
+{
+  const std::size_t n_samples = 2000000;
+  std::vector<SampleType> samples (n_samples);
+  for (std::size_t i=0; i<n_samples; ++i)
+    samples[i] = i;
+
+  run_benchmarks<SampleFlow::Producers::Range<SampleType>>
+  ("Range producer", n_samples,
+   [&](SampleFlow::Producers::Range<SampleType> &producer)
+  {
+    producer.sample (samples);
+  });
+
+  run_benchmarks<SampleFlow::Producers::MetropolisHastings<SampleType>>
+  ("Metropolis-Hastings producer", n_samples,
+   [&](SampleFlow::Producers::MetropolisHastings<SampleType> &producer)
+  {
+    std::mt19937 rng;
+    std::uniform_real_distribution<> distribution(-1,1);
+    producer.sample (0.,
+                     [](const SampleType &x)
+    {
+      return -x*x/2;
+    },
+    [&](const SampleType &x)
+    {
+      return std::make_pair (x + distribution(rng), 1.0);
+    },
+    n_samples);
+  });
+}
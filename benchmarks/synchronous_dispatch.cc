@@ -0,0 +1,161 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Measure the per-sample overhead of delivering samples to consumers that
+// run in ParallelMode::synchronous. We compare the following ways of
+// getting a sample from a producer to a cheap consumer:
+// - Calling the consumer's consume() function directly in a loop. This
+//   is the lower bound for what any dispatch mechanism can achieve.
+// - Sending the sample through the producer's signal to a slot that
+//   directly calls consume(). The difference to the first variant is
+//   the cost of the signal itself.
+// - Sending the sample through the signal to a slot that does the
+//   bookkeeping synchronous consumers used to do: wrap the call to
+//   consume() into a std::packaged_task, register its future in a list
+//   under a mutex, run it, and then lock again to remove completed
+//   futures from the list.
+// - Using Consumer::connect_to_producer(), i.e., what SampleFlow does
+//   today.
+// The difference between the last two variants and the second one is the
+// overhead of the bookkeeping necessary to safely disconnect consumers.
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = double;
+
+
+// Run the given function and return the time per sample in nanoseconds.
+template <typename Function>
+double time_per_sample (const std::size_t n_samples,
+                        const Function &f)
+{
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double,std::nano>(end-start).count() / n_samples;
+}
+
+
+
+template <template <typename> class ConsumerType>
+void run_benchmarks (const std::string &consumer_name,
+                     const std::vector<SampleType> &samples)
+{
+  const std::size_t n_samples = samples.size();
+
+  const double t_direct = time_per_sample (n_samples, [&]()
+  {
+    ConsumerType<SampleType> consumer;
+    for (const auto &sample : samples)
+      consumer.consume (sample, {});
+  });
+
+  const double t_signal = time_per_sample (n_samples, [&]()
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+    ConsumerType<SampleType> consumer;
+    auto connections
+      = range_producer.connect_to_signals ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+    {
+      consumer.consume (std::move(sample), std::move(aux_data));
+    },
+    []() {});
+    range_producer.sample (samples);
+    connections.first.disconnect();
+    connections.second.disconnect();
+  });
+
+  const double t_packaged_task = time_per_sample (n_samples, [&]()
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+    ConsumerType<SampleType> consumer;
+
+    std::mutex mutex;
+    std::list<std::shared_future<void>> background_tasks;
+    auto connections
+      = range_producer.connect_to_signals ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+    {
+      std::packaged_task<void ()> worker ([&]()
+      {
+        consumer.consume (std::move(sample), std::move(aux_data));
+      });
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        background_tasks.emplace_back (worker.get_future().share());
+      }
+      worker();
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto future = background_tasks.begin();
+        while (future != background_tasks.end())
+          if (future->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            future = background_tasks.erase (future);
+          else
+            ++future;
+      }
+    },
+    []() {});
+    range_producer.sample (samples);
+    connections.first.disconnect();
+    connections.second.disconnect();
+  });
+
+  const double t_sampleflow = time_per_sample (n_samples, [&]()
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+    ConsumerType<SampleType> consumer;
+    consumer.connect_to_producer (range_producer);
+    range_producer.sample (samples);
+  });
+
+  std::cout << consumer_name << ":\n"
+            << std::fixed << std::setprecision(1)
+            << "  direct call to consume():        " << std::setw(8) << t_direct << " ns/sample\n"
+            << "  signal + direct call:            " << std::setw(8) << t_signal << " ns/sample\n"
+            << "  signal + packaged_task per call: " << std::setw(8) << t_packaged_task << " ns/sample\n"
+            << "  Consumer::connect_to_producer(): " << std::setw(8) << t_sampleflow << " ns/sample\n"
+            << "  bookkeeping overhead beyond the signal itself:\n"
+            << "    packaged_task per call:        " << std::setw(8) << std::max (t_packaged_task - t_signal, 0.) << " ns/sample\n"
+            << "    Consumer::connect_to_producer: " << std::setw(8) << std::max (t_sampleflow - t_signal, 0.) << " ns/sample\n"
+            << std::endl;
+}
+
+
+
+int main ()
+{
+  const std::size_t n_samples = 2000000;
+  std::vector<SampleType> samples (n_samples);
+  for (std::size_t i=0; i<n_samples; ++i)
+    samples[i] = i;
+
+  run_benchmarks<SampleFlow::Consumers::CountSamples> ("CountSamples<double>", samples);
+  run_benchmarks<SampleFlow::Consumers::MeanValue> ("MeanValue<double>", samples);
+}
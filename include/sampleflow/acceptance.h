@@ -0,0 +1,131 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_ACCEPTANCE_H
+#define SAMPLEFLOW_ACCEPTANCE_H
+
+#include <cmath>
+#include <limits>
+
+
+namespace SampleFlow
+{
+  namespace internal
+  {
+    /**
+     * Return whether the given value of a log likelihood corresponds to a
+     * sample with zero probability, i.e., whether it equals either
+     * `-std::numeric_limits<double>::infinity()` or
+     * `-std::numeric_limits<double>::max()`.
+     */
+    inline
+    bool
+    is_zero_probability (const double log_likelihood)
+    {
+      return ((log_likelihood == -std::numeric_limits<double>::max())
+              ||
+              (log_likelihood == -std::numeric_limits<double>::infinity()));
+    }
+
+
+
+    /**
+     * Decide whether a Metropolis-Hastings-type sampler should accept a
+     * trial sample. This function implements the rule documented for the
+     * MetropolisHastings class, and all producers that accept or reject
+     * samples in this way use it:
+     * - A trial sample with zero probability (see is_zero_probability())
+     *   is rejected, unless the current sample also has zero probability.
+     * - If both the trial and the current sample have zero probability,
+     *   then the trial sample is accepted with probability
+     *   $\min\{1,1/r\}$, where $r$ is the ratio of proposal probabilities
+     *   `proposal_distribution_ratio`. This allows a chain that starts in
+     *   a region of zero probability to random-walk its way out of it.
+     * - Otherwise, the trial sample is accepted with probability
+     *   $\min\left\{1, \frac{1}{r}
+     *   \exp\left(\frac{\ell_\text{trial}-\ell_\text{current}}{T}\right)\right\}$,
+     *   where $\ell$ denotes log likelihoods and $T$ the temperature.
+     *
+     * The random numbers drawn from `uniform_distribution` are the same
+     * ones the MetropolisHastings class has always drawn, so that seeded
+     * chains are reproduced exactly:
+     * - No random number is drawn if the trial sample is rejected because
+     *   it has zero probability and the current sample does not.
+     * - If both samples have zero probability, a random number is drawn
+     *   and compared against $1/r$, even if $1/r\ge 1$. If this leads to
+     *   rejection, the trial sample is then treated as in the general case
+     *   below, which may draw a second random number.
+     * - Otherwise, a random number is drawn unless
+     *   $\frac{\ell_\text{trial}}{T}-\log r >
+     *   \frac{\ell_\text{current}}{T}$, i.e., unless the acceptance
+     *   probability is known to be greater than one. In particular, a
+     *   random number is drawn if the acceptance probability equals one,
+     *   as happens for example for a constant likelihood and a symmetric
+     *   proposal distribution.
+     *
+     * As a consequence, all producers that use this function consume the
+     * same random numbers when deciding about the same trial samples.
+     *
+     * @param[in] trial_log_likelihood The log likelihood of the trial
+     *   sample.
+     * @param[in] current_log_likelihood The log likelihood of the current
+     *   sample.
+     * @param[in] proposal_distribution_ratio The ratio of proposal
+     *   probabilities returned by the `perturb` function.
+     * @param[in,out] rng The random number generator to use.
+     * @param[in,out] uniform_distribution An object that, when called with
+     *   `rng` as argument, returns a random number uniformly distributed in
+     *   $[0,1]$ -- typically a `std::uniform_real_distribution` object.
+     * @param[in] temperature The temperature $T$ by which the difference of
+     *   log likelihoods is divided. The default value of one corresponds to
+     *   the standard Metropolis-Hastings algorithm.
+     */
+    template <typename RandomNumberGenerator, typename UniformDistribution>
+    bool
+    accept_trial_sample (const double trial_log_likelihood,
+                         const double current_log_likelihood,
+                         const double proposal_distribution_ratio,
+                         RandomNumberGenerator &rng,
+                         UniformDistribution &uniform_distribution,
+                         const double temperature = 1.)
+    {
+      // A trial sample with zero probability is rejected, unless the
+      // current sample also has zero probability. In the latter case,
+      // accept with probability min{1,1/r}. If that fails, fall through
+      // to the general rule below, as MetropolisHastings has always done:
+      if (is_zero_probability (trial_log_likelihood))
+        {
+          if (is_zero_probability (current_log_likelihood) == false)
+            return false;
+
+          if (1. / proposal_distribution_ratio >= uniform_distribution(rng))
+            return true;
+        }
+
+      // Otherwise, accept without drawing a random number if the
+      // acceptance probability is greater than one. This comparison is
+      // done on the logarithms, which also covers the case where the
+      // current sample has zero probability:
+      if (trial_log_likelihood / temperature - std::log(proposal_distribution_ratio)
+          > current_log_likelihood / temperature)
+        return true;
+      else
+        return (std::exp((trial_log_likelihood - current_log_likelihood) / temperature)
+                / proposal_distribution_ratio >= uniform_distribution(rng));
+    }
+  }
+}
+
+#endif
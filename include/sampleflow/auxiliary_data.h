@@ -16,11 +16,380 @@
 #ifndef SAMPLEFLOW_AUXILIARY_DATA_H
 #define SAMPLEFLOW_AUXILIARY_DATA_H
 
-#include <map>
 #include <boost/any.hpp>
+#include <boost/container/small_vector.hpp>
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace SampleFlow
 {
+  /**
+   * A class that identifies one kind of information stored in an
+   * AuxiliaryData object, for example the log likelihood of a sample.
+   * Conceptually, keys are strings (such as "relative log likelihood"), but
+   * every distinct string is only stored once in a global table, and a key
+   * is simply the index of its string in this table. As a consequence, keys
+   * are cheap to copy and compare.
+   *
+   * Keys can be created from strings; this requires looking up the string
+   * in the global table (and adding it if it is not there yet), and is
+   * consequently not cheap. Code that attaches or queries information for
+   * every sample should therefore create the keys it needs once and then
+   * store them, or use the keys predefined in namespace AuxiliaryDataKeys,
+   * which are compile-time constants.
+   */
+  class AuxiliaryDataKey
+  {
+    public:
+      /**
+       * Create a key with the given index in the global table of strings.
+       * This constructor is only intended for the keys predefined in
+       * namespace AuxiliaryDataKeys; user code should create keys from
+       * strings.
+       */
+      explicit
+      constexpr
+      AuxiliaryDataKey (const unsigned int index);
+
+      /**
+       * Create the key that corresponds to the given string.
+       */
+      AuxiliaryDataKey (const std::string &name);
+
+      /**
+       * Create the key that corresponds to the given string.
+       */
+      AuxiliaryDataKey (const char *name);
+
+      /**
+       * Return the string that corresponds to this key.
+       */
+      std::string
+      name () const;
+
+      /**
+       * Return whether two keys are the same.
+       */
+      constexpr
+      bool
+      operator== (const AuxiliaryDataKey &other) const;
+
+      /**
+       * Return whether two keys are different.
+       */
+      constexpr
+      bool
+      operator!= (const AuxiliaryDataKey &other) const;
+
+    private:
+      /**
+       * The index of the string that corresponds to this key in the global
+       * table of strings.
+       */
+      unsigned int index;
+  };
+
+
+
+  namespace internal
+  {
+    /**
+     * The global table of strings that correspond to AuxiliaryDataKey
+     * objects.
+     */
+    class AuxiliaryDataKeyTable
+    {
+      public:
+        /**
+         * Return the one object of this type.
+         */
+        static
+        AuxiliaryDataKeyTable &
+        get ();
+
+        /**
+         * Return the index of the given string, adding it to the table
+         * if necessary.
+         */
+        unsigned int
+        index (const std::string &name);
+
+        /**
+         * Return the string with the given index.
+         */
+        std::string
+        name (const unsigned int index);
+
+      private:
+        /**
+         * Constructor. Add the names of the keys in namespace
+         * AuxiliaryDataKeys, in the order of their indices.
+         */
+        AuxiliaryDataKeyTable ();
+
+        /**
+         * A mutex that guards the other member variables.
+         */
+        std::mutex mutex;
+
+        /**
+         * The strings, in the order of their indices.
+         */
+        std::vector<std::string> names;
+
+        /**
+         * A map from strings to their indices.
+         */
+        std::unordered_map<std::string,unsigned int> indices;
+    };
+
+
+
+    inline
+    AuxiliaryDataKeyTable &
+    AuxiliaryDataKeyTable::get ()
+    {
+      static AuxiliaryDataKeyTable table;
+      return table;
+    }
+
+
+
+    inline
+    AuxiliaryDataKeyTable::AuxiliaryDataKeyTable ()
+    {
+      for (const char *name :
+           {
+             "relative log likelihood",
+             "sample is repeated",
+             "chain index",
+             "rejected at stage",
+             "temperature"
+           })
+        index (name);
+    }
+
+
+
+    inline
+    unsigned int
+    AuxiliaryDataKeyTable::index (const std::string &name)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+
+      const auto p = indices.find (name);
+      if (p != indices.end())
+        return p->second;
+
+      names.push_back (name);
+      indices[name] = names.size()-1;
+      return names.size()-1;
+    }
+
+
+
+    inline
+    std::string
+    AuxiliaryDataKeyTable::name (const unsigned int index)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+
+      return names.at(index);
+    }
+  }
+
+
+
+  constexpr
+  AuxiliaryDataKey::AuxiliaryDataKey (const unsigned int index)
+    :
+    index (index)
+  {}
+
+
+
+  inline
+  AuxiliaryDataKey::AuxiliaryDataKey (const std::string &name)
+    :
+    index (internal::AuxiliaryDataKeyTable::get().index (name))
+  {}
+
+
+
+  inline
+  AuxiliaryDataKey::AuxiliaryDataKey (const char *name)
+    :
+    index (internal::AuxiliaryDataKeyTable::get().index (name))
+  {}
+
+
+
+  inline
+  std::string
+  AuxiliaryDataKey::name () const
+  {
+    return internal::AuxiliaryDataKeyTable::get().name (index);
+  }
+
+
+
+  constexpr
+  bool
+  AuxiliaryDataKey::operator== (const AuxiliaryDataKey &other) const
+  {
+    return index == other.index;
+  }
+
+
+
+  constexpr
+  bool
+  AuxiliaryDataKey::operator!= (const AuxiliaryDataKey &other) const
+  {
+    return index != other.index;
+  }
+
+
+
+  /**
+   * A namespace for keys that SampleFlow itself uses to attach information
+   * to samples. These keys are compile-time constants and so can be used
+   * without any cost. Their names are listed in the documentation of each
+   * key; creating an AuxiliaryDataKey object from these names results in
+   * the same key.
+   */
+  namespace AuxiliaryDataKeys
+  {
+    /**
+     * The key with name "relative log likelihood".
+     */
+    constexpr AuxiliaryDataKey relative_log_likelihood (0u);
+
+    /**
+     * The key with name "sample is repeated".
+     */
+    constexpr AuxiliaryDataKey sample_is_repeated (1u);
+
+    /**
+     * The key with name "chain index".
+     */
+    constexpr AuxiliaryDataKey chain_index (2u);
+
+    /**
+     * The key with name "rejected at stage".
+     */
+    constexpr AuxiliaryDataKey rejected_at_stage (3u);
+
+    /**
+     * The key with name "temperature".
+     */
+    constexpr AuxiliaryDataKey temperature (4u);
+  }
+
+
+
+  /**
+   * A class that stores one piece of information in an AuxiliaryData
+   * object. Values of type `double`, `bool`, and `unsigned int` -- by far
+   * the most common kinds of information producers attach to samples --
+   * are stored in the object itself. Values of all other types are stored in a
+   * `boost::any` object, which generally requires allocating memory.
+   */
+  class AuxiliaryDataValue
+  {
+    public:
+      /**
+       * Create an empty object.
+       */
+      AuxiliaryDataValue ();
+
+      /**
+       * Store the given `double` value.
+       */
+      AuxiliaryDataValue (const double value);
+
+      /**
+       * Store the given `bool` value.
+       */
+      AuxiliaryDataValue (const bool value);
+
+      /**
+       * Store the given `unsigned int` value.
+       */
+      AuxiliaryDataValue (const unsigned int value);
+
+      /**
+       * Store the value held by the given `boost::any` object. If that is
+       * a `double`, `bool`, or `unsigned int`, then it is stored in the same way as if it
+       * had been passed to one of the constructors above.
+       */
+      AuxiliaryDataValue (const boost::any &value);
+
+      /**
+       * Store the given value of any other type.
+       */
+      template <typename T>
+      AuxiliaryDataValue (const T &value);
+
+      /**
+       * Return a pointer to the stored value if it has type `T`, and a
+       * `nullptr` otherwise.
+       */
+      template <typename T>
+      const T *
+      get_if () const;
+
+      /**
+       * Return the stored value wrapped in a `boost::any` object.
+       */
+      boost::any
+      to_any () const;
+
+    private:
+      /**
+       * An enum that describes what kind of value is stored.
+       */
+      enum class Type : unsigned char
+      {
+        empty,
+        real,
+        boolean,
+        unsigned_integer,
+        other
+      };
+
+      /**
+       * What kind of value is stored.
+       */
+      Type type;
+
+      /**
+       * The storage for `double`, `bool`, and `unsigned int` values.
+       */
+      union
+      {
+        double       real_value;
+        bool         boolean_value;
+        unsigned int unsigned_value;
+      };
+
+      /**
+       * The storage for values of all other types.
+       */
+      boost::any other_value;
+  };
+
+
+
   /**
    * A data type used to convey additional information alongside samples that
    * are sent from Producer through Filter to Consumer objects. Oftentimes,
@@ -42,21 +411,586 @@ namespace SampleFlow
    *
    * Since different producer (or filter) classes may want to pass along
    * different kinds of information, the data type used is rather general:
-   * It is a map with string keys that identify what the additional
-   * information is, and an object of type boost::any that stores the
-   * information itself. boost::any is a data type that wraps around an
-   * object of any kind, in essence by storing something like a `void`
-   * pointer. One must know the type of the object so stored to retrieve
-   * it from a boost::any object, but this is not a restriction here
-   * because a consumer wishing to process additional data clearly
-   * needs to know something about what kind of information a producer
-   * may have attached in the first place.
-   *
-   * Producers passing along such additional data need to document the string
-   * under which the data is stored in the map and the type of the data
-   * so stored.
+   * It stores a list of pairs of an AuxiliaryDataKey that identifies what
+   * the additional information is, and an AuxiliaryDataValue object that
+   * stores the information itself. The latter can hold objects of any type,
+   * similar to `boost::any`. One must know the type of the object so stored
+   * to retrieve it, but this is not a restriction here because a consumer
+   * wishing to process additional data clearly needs to know something about
+   * what kind of information a producer may have attached in the first place.
+   *
+   * Producers passing along such additional data need to document the key
+   * under which the data is stored and the type of the data so stored.
+   *
+   *
+   * ### Performance ###
+   *
+   * An AuxiliaryData object is created for every sample, and so this class
+   * is designed to be cheap in the common case: The first few entries are
+   * stored in the object itself; entries with `double`, `bool`, and
+   * `unsigned int` values do not require allocating memory (see
+   * AuxiliaryDataValue); and keys are integers. Since samples rarely carry
+   * more than a handful of entries, looking up an entry by key in the flat
+   * list of entries takes constant time in practice.
+   *
+   *
+   * ### Compatibility with string-keyed code ###
+   *
+   * In previous versions of SampleFlow, this type was a
+   * `std::map<std::string, boost::any>`. The class provides the parts of
+   * the interface of that type that were commonly used: Objects can be
+   * initialized from lists of pairs of strings and `boost::any` objects;
+   * they can be searched via find(), count(), and at(); and iterating
+   * over an object yields `std::pair<std::string,boost::any>` objects. All
+   * of these functions accept strings where they expect an
+   * AuxiliaryDataKey, but are slower than using keys directly. Unlike for
+   * `std::map`, iteration visits entries in the order in which they were
+   * added. Code that used `operator[]` needs to use set() and get()
+   * instead.
    */
-  using AuxiliaryData = std::map<std::string, boost::any>;
+  class AuxiliaryData
+  {
+    public:
+      /**
+       * The type used to store one entry.
+       */
+      struct Entry
+      {
+        /**
+         * The key that identifies the entry.
+         */
+        AuxiliaryDataKey   key;
+
+        /**
+         * The value of the entry.
+         */
+        AuxiliaryDataValue value;
+      };
+
+      /**
+       * An iterator over the entries of an AuxiliaryData object that
+       * presents each entry as a `std::pair<std::string,boost::any>`, as
+       * if the object were a `std::map<std::string,boost::any>`. The
+       * pairs are created on the fly, so dereferencing an iterator returns
+       * them by value.
+       */
+      class const_iterator
+      {
+        public:
+          using value_type        = std::pair<std::string,boost::any>;
+          using reference         = value_type;
+          using difference_type   = std::ptrdiff_t;
+          using iterator_category = std::input_iterator_tag;
+
+          /**
+           * A helper class that allows writing `iterator->first`.
+           */
+          class pointer
+          {
+            public:
+              explicit pointer (value_type &&value);
+              const value_type *operator-> () const;
+
+            private:
+              const value_type value;
+          };
+
+          explicit const_iterator (const Entry *entry);
+
+          value_type operator* () const;
+          pointer operator-> () const;
+          const_iterator &operator++ ();
+          const_iterator operator++ (int);
+          bool operator== (const const_iterator &other) const;
+          bool operator!= (const const_iterator &other) const;
+
+          /**
+           * Return the entry the iterator points to, with key and value
+           * in their native representation.
+           */
+          const Entry &entry () const;
+
+        private:
+          const Entry *current;
+      };
+
+      /**
+       * Create an object without any entries.
+       */
+      AuxiliaryData () = default;
+
+      /**
+       * Create an object with the given entries. Examples are
+       * @code
+       *   AuxiliaryData aux_data { {AuxiliaryDataKeys::relative_log_likelihood, -3.4},
+       *                            {AuxiliaryDataKeys::sample_is_repeated, true} };
+       * @endcode
+       * or, slower but equivalently,
+       * @code
+       *   AuxiliaryData aux_data { {"relative log likelihood", boost::any(-3.4)},
+       *                            {"sample is repeated", boost::any(true)} };
+       * @endcode
+       */
+      AuxiliaryData (std::initializer_list<Entry> entries);
+
+      /**
+       * Set the entry with the given key to the given value. If there is
+       * already an entry with this key, it is replaced.
+       */
+      void
+      set (const AuxiliaryDataKey &key,
+           const AuxiliaryDataValue &value);
+
+      /**
+       * Return a pointer to the value of the entry with the given key, if
+       * there is one and it is of type `T`, and a `nullptr` otherwise.
+       */
+      template <typename T>
+      const T *
+      get_if (const AuxiliaryDataKey &key) const;
+
+      /**
+       * Return the value of the entry with the given key. This function
+       * throws an exception of type `std::out_of_range` if there is no such
+       * entry, and of type `boost::bad_any_cast` if the value is not of type
+       * `T`.
+       */
+      template <typename T>
+      const T &
+      get (const AuxiliaryDataKey &key) const;
+
+      /**
+       * Return whether there is an entry with the given key.
+       */
+      bool
+      contains (const AuxiliaryDataKey &key) const;
+
+      /**
+       * Return the number of entries.
+       */
+      std::size_t
+      size () const;
+
+      /**
+       * Return whether there are no entries.
+       */
+      bool
+      empty () const;
+
+      /**
+       * Return an iterator to the first entry.
+       */
+      const_iterator
+      begin () const;
+
+      /**
+       * Return an iterator past the last entry.
+       */
+      const_iterator
+      end () const;
+
+      /**
+       * Return an iterator to the entry with the given key, or end() if
+       * there is no such entry.
+       */
+      const_iterator
+      find (const AuxiliaryDataKey &key) const;
+
+      /**
+       * Return one if there is an entry with the given key, and zero
+       * otherwise.
+       */
+      std::size_t
+      count (const AuxiliaryDataKey &key) const;
+
+      /**
+       * Return the value of the entry with the given key, wrapped in a
+       * `boost::any` object. This function throws an exception of type
+       * `std::out_of_range` if there is no such entry.
+       */
+      boost::any
+      at (const AuxiliaryDataKey &key) const;
+
+    private:
+      /**
+       * The entries. The first few of them are stored in the object
+       * itself.
+       */
+      boost::container::small_vector<Entry,4> entries;
+
+      /**
+       * Return a pointer to the entry with the given key, or a `nullptr`
+       * if there is no such entry.
+       */
+      const Entry *
+      find_entry (const AuxiliaryDataKey &key) const;
+  };
+
+
+
+  inline
+  AuxiliaryDataValue::AuxiliaryDataValue ()
+    :
+    type (Type::empty),
+    real_value (0)
+  {}
+
+
+
+  inline
+  AuxiliaryDataValue::AuxiliaryDataValue (const double value)
+    :
+    type (Type::real),
+    real_value (value)
+  {}
+
+
+
+  inline
+  AuxiliaryDataValue::AuxiliaryDataValue (const bool value)
+    :
+    type (Type::boolean),
+    boolean_value (value)
+  {}
+
+
+
+  inline
+  AuxiliaryDataValue::AuxiliaryDataValue (const unsigned int value)
+    :
+    type (Type::unsigned_integer),
+    unsigned_value (value)
+  {}
+
+
+
+  inline
+  AuxiliaryDataValue::AuxiliaryDataValue (const boost::any &value)
+    :
+    AuxiliaryDataValue ()
+  {
+    if (const double *p = boost::any_cast<double>(&value))
+      {
+        type = Type::real;
+        real_value = *p;
+      }
+    else if (const bool *p = boost::any_cast<bool>(&value))
+      {
+        type = Type::boolean;
+        boolean_value = *p;
+      }
+    else if (const unsigned int *p = boost::any_cast<unsigned int>(&value))
+      {
+        type = Type::unsigned_integer;
+        unsigned_value = *p;
+      }
+    else if (value.empty() == false)
+      {
+        type = Type::other;
+        other_value = value;
+      }
+  }
+
+
+
+  template <typename T>
+  AuxiliaryDataValue::AuxiliaryDataValue (const T &value)
+    :
+    type (Type::other),
+    real_value (0),
+    other_value (value)
+  {}
+
+
+
+  template <typename T>
+  const T *
+  AuxiliaryDataValue::get_if () const
+  {
+    return boost::any_cast<T>(&other_value);
+  }
+
+
+
+  template <>
+  inline
+  const double *
+  AuxiliaryDataValue::get_if<double> () const
+  {
+    return (type == Type::real ? &real_value : nullptr);
+  }
+
+
+
+  template <>
+  inline
+  const bool *
+  AuxiliaryDataValue::get_if<bool> () const
+  {
+    return (type == Type::boolean ? &boolean_value : nullptr);
+  }
+
+
+
+  template <>
+  inline
+  const unsigned int *
+  AuxiliaryDataValue::get_if<unsigned int> () const
+  {
+    return (type == Type::unsigned_integer ? &unsigned_value : nullptr);
+  }
+
+
+
+  inline
+  boost::any
+  AuxiliaryDataValue::to_any () const
+  {
+    switch (type)
+      {
+        case Type::real:
+          return real_value;
+        case Type::boolean:
+          return boolean_value;
+        case Type::unsigned_integer:
+          return unsigned_value;
+        default:
+          return other_value;
+      }
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator::pointer::pointer (value_type &&value)
+    :
+    value (std::move(value))
+  {}
+
+
+
+  inline
+  const AuxiliaryData::const_iterator::value_type *
+  AuxiliaryData::const_iterator::pointer::operator-> () const
+  {
+    return &value;
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator::const_iterator (const Entry *entry)
+    :
+    current (entry)
+  {}
+
+
+
+  inline
+  AuxiliaryData::const_iterator::value_type
+  AuxiliaryData::const_iterator::operator* () const
+  {
+    return { current->key.name(), current->value.to_any() };
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator::pointer
+  AuxiliaryData::const_iterator::operator-> () const
+  {
+    return pointer (**this);
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator &
+  AuxiliaryData::const_iterator::operator++ ()
+  {
+    ++current;
+    return *this;
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator
+  AuxiliaryData::const_iterator::operator++ (int)
+  {
+    const const_iterator old = *this;
+    ++current;
+    return old;
+  }
+
+
+
+  inline
+  bool
+  AuxiliaryData::const_iterator::operator== (const const_iterator &other) const
+  {
+    return current == other.current;
+  }
+
+
+
+  inline
+  bool
+  AuxiliaryData::const_iterator::operator!= (const const_iterator &other) const
+  {
+    return current != other.current;
+  }
+
+
+
+  inline
+  const AuxiliaryData::Entry &
+  AuxiliaryData::const_iterator::entry () const
+  {
+    return *current;
+  }
+
+
+
+  inline
+  AuxiliaryData::AuxiliaryData (std::initializer_list<Entry> entries)
+  {
+    for (const Entry &entry : entries)
+      set (entry.key, entry.value);
+  }
+
+
+
+  inline
+  void
+  AuxiliaryData::set (const AuxiliaryDataKey &key,
+                      const AuxiliaryDataValue &value)
+  {
+    for (Entry &entry : entries)
+      if (entry.key == key)
+        {
+          entry.value = value;
+          return;
+        }
+
+    entries.push_back (Entry {key, value});
+  }
+
+
+
+  template <typename T>
+  const T *
+  AuxiliaryData::get_if (const AuxiliaryDataKey &key) const
+  {
+    const Entry *entry = find_entry (key);
+    return (entry != nullptr ? entry->value.get_if<T>() : nullptr);
+  }
+
+
+
+  template <typename T>
+  const T &
+  AuxiliaryData::get (const AuxiliaryDataKey &key) const
+  {
+    const Entry *entry = find_entry (key);
+    if (entry == nullptr)
+      throw std::out_of_range ("There is no entry with key <" + key.name() + ">.");
+
+    const T *value = entry->value.get_if<T>();
+    if (value == nullptr)
+      throw boost::bad_any_cast();
+
+    return *value;
+  }
+
+
+
+  inline
+  bool
+  AuxiliaryData::contains (const AuxiliaryDataKey &key) const
+  {
+    return (find_entry (key) != nullptr);
+  }
+
+
+
+  inline
+  std::size_t
+  AuxiliaryData::size () const
+  {
+    return entries.size();
+  }
+
+
+
+  inline
+  bool
+  AuxiliaryData::empty () const
+  {
+    return entries.empty();
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator
+  AuxiliaryData::begin () const
+  {
+    return const_iterator (entries.data());
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator
+  AuxiliaryData::end () const
+  {
+    return const_iterator (entries.data() + entries.size());
+  }
+
+
+
+  inline
+  AuxiliaryData::const_iterator
+  AuxiliaryData::find (const AuxiliaryDataKey &key) const
+  {
+    const Entry *entry = find_entry (key);
+    return (entry != nullptr ? const_iterator (entry) : end());
+  }
+
+
+
+  inline
+  std::size_t
+  AuxiliaryData::count (const AuxiliaryDataKey &key) const
+  {
+    return (contains (key) ? 1 : 0);
+  }
+
+
+
+  inline
+  boost::any
+  AuxiliaryData::at (const AuxiliaryDataKey &key) const
+  {
+    const Entry *entry = find_entry (key);
+    if (entry == nullptr)
+      throw std::out_of_range ("There is no entry with key <" + key.name() + ">.");
+
+    return entry->value.to_any();
+  }
+
+
+
+  inline
+  const AuxiliaryData::Entry *
+  AuxiliaryData::find_entry (const AuxiliaryDataKey &key) const
+  {
+    for (const Entry &entry : entries)
+      if (entry.key == key)
+        return &entry;
+    return nullptr;
+  }
 }
 
 
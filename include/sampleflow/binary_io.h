@@ -0,0 +1,166 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_BINARY_IO_H
+#define SAMPLEFLOW_BINARY_IO_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * Write the given object to a stream in binary form, by copying the
+     * bytes that represent it in memory. This is only possible for types
+     * that are "trivially copyable", such as `double`, `int`, or
+     * `std::array<double,N>`. The result is compact, but can only be read
+     * again on a machine with the same byte order and the same
+     * representation of the type in question.
+     *
+     * Objects written by this function can be read by read_binary().
+     */
+    template <typename T>
+    void
+    write_binary (std::ostream &output_stream,
+                  const T &value);
+
+    /**
+     * Read an object of type `T` that has previously been written by
+     * write_binary(). If the stream does not contain enough data, then this
+     * function throws an exception of type `std::runtime_error`.
+     */
+    template <typename T>
+    T
+    read_binary (std::istream &input_stream);
+
+    /**
+     * Write the state of a random number generator of type `std::mt19937`
+     * to a stream in binary form. The state written is the one the
+     * C++ standard defines for this class (and that `operator<<` writes in
+     * textual form), and so reading it again via read_binary() yields a
+     * generator that produces the same sequence of numbers as the one
+     * written.
+     */
+    void
+    write_binary (std::ostream &output_stream,
+                  const std::mt19937 &rng);
+
+    /**
+     * Read the state of a random number generator of type `std::mt19937`
+     * that has previously been written by write_binary().
+     */
+    template <>
+    std::mt19937
+    read_binary<std::mt19937> (std::istream &input_stream);
+
+
+
+    template <typename T>
+    void
+    write_binary (std::ostream &output_stream,
+                  const T &value)
+    {
+      static_assert (std::is_trivially_copyable<T>::value,
+                     "This function can only be used for trivially copyable types.");
+      output_stream.write (reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+
+
+    template <typename T>
+    T
+    read_binary (std::istream &input_stream)
+    {
+      static_assert (std::is_trivially_copyable<T>::value,
+                     "This function can only be used for trivially copyable types.");
+      T value;
+      input_stream.read (reinterpret_cast<char *>(&value), sizeof(T));
+      if (!input_stream)
+        throw std::runtime_error ("Could not read an object from the given stream.");
+      return value;
+    }
+
+
+
+    inline
+    void
+    write_binary (std::ostream &output_stream,
+                  const std::mt19937 &rng)
+    {
+      // The standard only gives us access to the state of the generator via
+      // its textual representation, a sequence of (32-bit) numbers. Convert
+      // these numbers into binary form, preceded by how many there are.
+      std::stringstream text;
+      text << rng;
+
+      std::vector<std::uint32_t> state;
+      unsigned long x;
+      while (text >> x)
+        state.push_back (static_cast<std::uint32_t>(x));
+
+      write_binary (output_stream, static_cast<std::uint32_t>(state.size()));
+      output_stream.write (reinterpret_cast<const char *>(state.data()),
+                           state.size() * sizeof(std::uint32_t));
+    }
+
+
+
+    template <>
+    inline
+    std::mt19937
+    read_binary<std::mt19937> (std::istream &input_stream)
+    {
+      // Check the number of values before allocating memory for them, so
+      // that a corrupt or truncated stream leads to an exception rather than
+      // an attempt to allocate an arbitrary amount of memory. The textual
+      // representation of the state consists of std::mt19937::state_size
+      // numbers, plus (in some implementations) the position within the
+      // state:
+      const std::uint32_t n_values = read_binary<std::uint32_t> (input_stream);
+      if (n_values > std::mt19937::state_size + 1)
+        throw std::runtime_error ("The state of the random number generator "
+                                  "read from the given stream is not valid.");
+
+      std::vector<std::uint32_t> state (n_values);
+      input_stream.read (reinterpret_cast<char *>(state.data()),
+                         state.size() * sizeof(std::uint32_t));
+      if (!input_stream)
+        throw std::runtime_error ("Could not read the state of a random number "
+                                  "generator from the given stream.");
+
+      std::stringstream text;
+      for (const std::uint32_t x : state)
+        text << x << ' ';
+
+      std::mt19937 rng;
+      text >> rng;
+      if (!text)
+        throw std::runtime_error ("The state of the random number generator "
+                                  "read from the given stream is not valid.");
+      return rng;
+    }
+  }
+}
+
+#endif
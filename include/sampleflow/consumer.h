@@ -19,12 +19,20 @@
 #include <sampleflow/auxiliary_data.h>
 #include <sampleflow/producer.h>
 #include <sampleflow/parallel_mode.h>
-#include <boost/signals2.hpp>
+#include <sampleflow/mutex.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/signal.h>
+#include <sampleflow/types.h>
 
 #include <list>
+#include <deque>
+#include <tuple>
 #include <utility>
-#include <future>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <thread>
 
 
 namespace SampleFlow
@@ -66,7 +74,12 @@ namespace SampleFlow
    * appropriate strategies for dealing with concurrency. Principally,
    * this implies that all functions that access the current state of
    * their object need to use `std::mutex` and `std::lock_guard` objects
-   * appropriately.
+   * appropriately. The consumers and filters in SampleFlow use the
+   * `mutex` member variable of the current class for this. Its type,
+   * Mutex, behaves like `std::mutex`, but the mechanism it uses for
+   * locking can be selected via set_locking_policy(). In particular, if it
+   * is known that a consumer only ever receives samples from one thread,
+   * then locking can be switched off altogether.
    *
    *
    * @tparam InputType The C++ type used to describe samples. For example,
@@ -146,6 +159,38 @@ namespace SampleFlow
       consume (InputType sample,
                AuxiliaryData aux_data) = 0;
 
+      /**
+       * Process a whole block of samples that an upstream producer has
+       * sent at once (see the discussion of batches in the documentation
+       * of the Producer class). The default implementation simply calls
+       * consume() for each sample of the block. Derived classes can
+       * override this function if they can process a block more
+       * efficiently than one sample at a time, for example by acquiring
+       * a lock only once for the whole block. Implementations have to
+       * process the samples in the order in which they are stored in
+       * the block.
+       *
+       * @param[in] samples The samples, along with their auxiliary data.
+       */
+      virtual
+      void
+      consume_batch (const SampleBatch<InputType> &samples);
+
+      /**
+       * Process a sample that an upstream producer has sent as a
+       * SharedSample object (see the discussion of shared samples in the
+       * documentation of the Producer class). The same object is sent to
+       * all consumers connected to that producer, and so the sample must
+       * not be modified. The default implementation calls consume() with
+       * a copy of the sample and its auxiliary data. Derived classes that
+       * only need to read the sample should override this function to
+       * avoid making this copy.
+       *
+       * @param[in] sample The sample, along with its auxiliary data.
+       */
+      virtual
+      void
+      consume_shared (const SharedSample<InputType> &sample);
 
       /**
        * Set how this consumer or filter should process newly incoming samples.
@@ -165,7 +210,16 @@ namespace SampleFlow
        *   finished yet. If, for example, `queue_size` is one and a previous
        *   sample has not completed processing, then a newly incoming sample
        *   will be held up (and the current process will block) until the
-       *   previous sample has completed processing.
+       *   previous sample has completed processing. This argument is only
+       *   used if `parallel_mode` is ParallelMode::asynchronous, and it
+       *   must be at least one.
+       * @param[in] overflow_policy What to do with a newly incoming sample
+       *   if `queue_size` samples are already queued or being processed.
+       *   By default, the thread on which the sample was sent blocks until
+       *   there is room in the queue again; the alternatives are discussed
+       *   in the documentation of the QueueOverflowPolicy `enum`. This
+       *   argument is only used if `parallel_mode` is
+       *   ParallelMode::asynchronous.
        *
        * @note This function needs to be be called *before* this consumer or
        *   filter is connected to any upstream producer (or other filter), and
@@ -174,7 +228,59 @@ namespace SampleFlow
        */
       void
       set_parallel_mode (const ParallelMode parallel_mode,
-                         const unsigned int queue_size = 1);
+                         const unsigned int queue_size = 1,
+                         const QueueOverflowPolicy overflow_policy = QueueOverflowPolicy::block);
+
+      /**
+       * Select the ThreadPool on which samples are processed if this
+       * consumer or filter uses ParallelMode::asynchronous. If this
+       * function is not called, then the pool returned by
+       * ThreadPool::default_pool() is used. Selecting a separate pool
+       * is useful to bound the number of threads that work on one part
+       * of a pipeline, or to share one pool (of a size different than
+       * the default one) between all consumers of a pipeline.
+       *
+       * @param[in] thread_pool The pool to submit tasks to. The pool needs
+       *   to live at least as long as the current object.
+       *
+       * @note Like set_parallel_mode(), this function needs to be
+       *   called *before* this consumer or filter is connected to any
+       *   upstream producer (or other filter).
+       */
+      void
+      set_thread_pool (ThreadPool &thread_pool);
+
+      /**
+       * Select the mechanism that is used to protect the state of this
+       * consumer or filter against concurrent access. By default, this is
+       * LockingPolicy::mutex. See the LockingPolicy `enum` for a
+       * description of the alternatives.
+       *
+       * This function sets the locking policy of the `mutex` member
+       * variable. It only has an effect for derived classes that use this
+       * variable to protect their state, as all consumers and filters in
+       * SampleFlow do.
+       *
+       * @param[in] locking_policy The mechanism to use for locking.
+       *   LockingPolicy::none may only be selected if this object uses
+       *   ParallelMode::synchronous, and if it only ever receives samples
+       *   from one thread at a time.
+       *
+       * @note Like set_parallel_mode(), this function needs to be
+       *   called *before* this consumer or filter is connected to any
+       *   upstream producer (or other filter).
+       */
+      void
+      set_locking_policy (const LockingPolicy locking_policy);
+
+      /**
+       * Return the number of samples that have been discarded because
+       * this object runs in ParallelMode::asynchronous with an overflow
+       * policy other than QueueOverflowPolicy::block, and samples came in
+       * faster than they could be processed.
+       */
+      types::sample_index
+      n_dropped_samples () const;
 
       /**
        * Ensure that all samples currently being worked on by this object
@@ -186,6 +292,14 @@ namespace SampleFlow
        *   This is what the disconnect_and_flush() function does.
        * - Ensure that flush() has been called before on all upstream
        *   producers and filters.
+       *
+       * If this object runs in ParallelMode::asynchronous and processing
+       * one of the queued samples has thrown an exception, then this
+       * function rethrows that exception once all samples have been
+       * processed. (If several samples threw, only the first exception is
+       * kept.) Since producers call flush() at the end of their `sample()`
+       * functions, such exceptions then propagate to the caller of
+       * `sample()`, just as they would in ParallelMode::synchronous.
        */
       virtual
       void
@@ -202,10 +316,23 @@ namespace SampleFlow
        *   function ensures exactly this, and as a consequence all Filter
        *   and Consumer implementations must call this function in their
        *   destructor before destroying any other data structures.
+       *
+       * @note Because this function is called from destructors, it does
+       *   not throw the exceptions flush() may rethrow; these are simply
+       *   discarded. Call flush() explicitly beforehand if you need to
+       *   know about them.
        */
       void
       disconnect_and_flush ();
 
+    protected:
+      /**
+       * A mutex that derived classes use to protect their state against
+       * concurrent access. The mechanism it uses for locking is
+       * selected via set_locking_policy().
+       */
+      mutable Mutex mutex;
+
     private:
 
       /**
@@ -216,7 +343,7 @@ namespace SampleFlow
        * producer decides to generate a sample after the current object
        * has been destroyed.
        */
-      std::list<std::pair<boost::signals2::connection,boost::signals2::connection>> connections_to_producers;
+      std::list<std::tuple<Connection,Connection,Connection,Connection>> connections_to_producers;
 
       /**
        * How newly incoming samples should be processed.
@@ -242,27 +369,144 @@ namespace SampleFlow
        */
       std::atomic<unsigned int> queue_size;
 
+      /**
+       * What to do with incoming samples if the queue is full.
+       *
+       * This variable can be read from/written to in an atomic
+       * fashion to ensure that different threads don't tread on
+       * each other.
+       */
+      std::atomic<int> overflow_policy;
+
+      /**
+       * The pool that tasks are submitted to if the parallel mode is
+       * ParallelMode::asynchronous. If this is a `nullptr` at the time
+       * connect_to_producer() is called, then it is set to
+       * ThreadPool::default_pool().
+       */
+      ThreadPool *thread_pool;
+
       /**
        * A mutex that controls access to all of the data structures involved
        * in parallel processing of samples. In particular, this includes
-       * the task queue, but also shutting down the process of accepting
-       * samples.
+       * the queue of samples waiting to be processed asynchronously, but
+       * also shutting down the process of accepting samples.
        */
       std::mutex parallel_mode_mutex;
 
       /**
-       * A queue of std::future objects that correspond to tasks that
-       * process samples.
+       * Whether samples that arrive via a connection to an upstream
+       * producer should be processed. This flag is set in
+       * connect_to_producer() and cleared in disconnect_and_flush(). It is
+       * used by the synchronous processing path that does not take a
+       * lock for every sample.
+       */
+      std::atomic<bool> accepting_samples;
+
+      /**
+       * The number of samples that have been received in
+       * ParallelMode::synchronous and that are currently being processed.
        */
-      std::list<std::shared_future<void>> background_tasks;
+      std::atomic<unsigned int> n_synchronous_samples_in_progress;
 
+      /**
+       * The number of threads currently waiting in flush(). Threads
+       * processing synchronous samples only need to notify
+       * `queue_state_changed` if this number is nonzero, which saves them
+       * from taking a lock for every sample.
+       */
+      std::atomic<unsigned int> n_flush_waiters;
 
       /**
-       * Ensure that the queue of background tasks does not grow beyond
-       * bounds by going through the queue and deleting all shared_future
-       * objects that have already completed.
+       * The samples (along with their auxiliary data) that have been
+       * received in ParallelMode::asynchronous, but whose processing has
+       * not started yet. For each of these samples, a task has been
+       * handed to the thread pool that will take the oldest element
+       * off this queue and process it.
        */
-      void trim_background_queue();
+      std::deque<std::pair<InputType,AuxiliaryData>> queued_samples;
+
+      /**
+       * The number of samples that have been taken off the
+       * `queued_samples` queue and that are currently being processed.
+       */
+      unsigned int n_samples_in_progress;
+
+      /**
+       * The number of tasks that have been handed to the thread pool and
+       * that have not finished yet. This is generally equal to the number
+       * of elements in `queued_samples` plus `n_samples_in_progress`, but
+       * it may be larger if queued samples have been discarded because of
+       * QueueOverflowPolicy::drop_oldest: The tasks corresponding to these
+       * samples will still run, but will not find anything to process.
+       * We may only let flush() return once all of these tasks have
+       * finished, since they access the current object.
+       */
+      unsigned int n_scheduled_tasks;
+
+      /**
+       * The number of samples discarded because of the overflow policy.
+       */
+      std::atomic<types::sample_index> n_discarded_samples;
+
+      /**
+       * The first exception thrown while processing a queued sample in
+       * ParallelMode::asynchronous that has not yet been rethrown by
+       * flush(). Access is protected by `parallel_mode_mutex`.
+       */
+      std::exception_ptr asynchronous_exception;
+
+      /**
+       * A condition variable that is notified whenever a task that processes
+       * a queued sample finishes, whenever the last synchronously processed
+       * sample finishes while someone is waiting in flush(), and whenever
+       * the connections to upstream producers are severed. It is used
+       * together with `parallel_mode_mutex` by threads that wait for room
+       * in the queue, or for all samples to finish processing.
+       */
+      std::condition_variable queue_state_changed;
+
+
+      /**
+       * Execute the given function object, which processes one sample or
+       * one block of samples in ParallelMode::synchronous, unless the
+       * current object has stopped accepting samples. This function
+       * implements the protocol by which disconnect_and_flush() can wait
+       * for all synchronously processed samples without the need to take
+       * a lock for every sample; see the comments in connect_to_producer().
+       */
+      template <typename Function>
+      void process_synchronously (const Function &process);
+
+      /**
+       * Decrement `n_synchronous_samples_in_progress` at the end of
+       * processing a sample in ParallelMode::synchronous, and notify threads
+       * waiting in flush() if this was the last sample in progress.
+       */
+      void finish_synchronous_sample();
+
+      /**
+       * The function executed by the tasks that are handed to the thread pool
+       * in ParallelMode::asynchronous. It takes the oldest element off the
+       * `queued_samples` queue (if there is one) and calls consume() with it.
+       */
+      void process_queued_sample();
+
+      /**
+       * Wait until the given predicate becomes true. The predicate is
+       * evaluated while holding the given lock on `parallel_mode_mutex`,
+       * and is re-evaluated whenever `queue_state_changed` is notified.
+       *
+       * If the calling thread is itself one of the threads of the thread
+       * pool the current object uses, then we cannot just block: If all
+       * threads of the pool did that, nobody would be left to execute
+       * the tasks we are waiting for. In that case, the calling thread
+       * instead executes other tasks of the pool until the predicate
+       * becomes true.
+       */
+      template <typename Predicate>
+      void wait_for_queue (std::unique_lock<std::mutex> &lock,
+                           const Predicate &predicate);
   };
 
 
@@ -272,7 +516,15 @@ namespace SampleFlow
     :
     parallel_mode (static_cast<int>(ParallelMode::synchronous)),
     supported_parallel_modes (supported_parallel_modes),
-    queue_size (1)
+    queue_size (1),
+    overflow_policy (static_cast<int>(QueueOverflowPolicy::block)),
+    thread_pool (nullptr),
+    accepting_samples (false),
+    n_synchronous_samples_in_progress (0),
+    n_flush_waiters (0),
+    n_samples_in_progress (0),
+    n_scheduled_tasks (0),
+    n_discarded_samples (0)
   {}
 
 
@@ -293,12 +545,16 @@ namespace SampleFlow
   connect_to_producer (Producer<InputType> &producer)
   {
     // Create a lambda function that receives a new sample and that in turn
-    // calls the consume() member function of the current object.
+    // calls the consume() member function of the current object, and
+    // others that do the same for blocks of samples and for shared samples
+    // and call consume_batch() and consume_shared(), respectively.
     //
-    // How exactly the lambda function that is called for each
-    // sample looks like depends on the parallel mode of the current
+    // How exactly the lambda functions that are called for each
+    // sample look like depends on the parallel mode of the current
     // object.
     std::function<void(InputType sample, AuxiliaryData aux_data)> sample_consumer;
+    std::function<void(const SampleBatch<InputType> &samples)> batch_consumer;
+    std::function<void(const SharedSample<InputType> &sample)> shared_consumer;
     switch (static_cast<ParallelMode>(parallel_mode.load()))
       {
         // If we want to process samples synchronously, then
@@ -314,73 +570,66 @@ namespace SampleFlow
         // (though implementations of the `consume()` function in
         // derived classes typically want to). So we need
         // to expose this fact to the `disconnect_and_flush()` function.
-        // This we do by wrapping up the task at hand into a std::task
-        // object that we place into the task queue, but instead of
-        // calling `std::async` on it, we immediately execute it. The
-        // point is that while we wait for it, it exists in a state so
-        // that `disconnect_and_flush()` can also wait for it.
-        //
-        // Because we may still get multiple samples in parallel from
-        // upstream (for example, because an upstream filter runs in
-        // asynchronous mode), we need to do the set-up of all of this
-        // under a mutex.
+        // This we do by counting how many calls of the lambda function
+        // below are currently executing `consume()`; flush() then waits
+        // for this counter to drop to zero.
         //
         // Finally, we need to be mindful that we could have received a sample
         // just at the same time as someone called `disconnect_and_flush()`.
         // In this case, we may have ended up in the lambda function below,
         // the OS has interrupted us and while we had to wait, the connection
         // to upstream was severed and `flush()` was called (or not yet, but
-        // will soon). In that case, we don't want to process more samples.
-        // If that is the case, once we get the parallel_mode_mutex,
-        // we need to decide that we don't want to process this sample
+        // will soon). In that case, we don't want to process more samples,
+        // and we need to decide that we don't want to process this sample
         // any more -- as if the connection had been severed just *before*,
         // not just *after* the sample had been sent. This ensures that once
         // `disconnect_and_flush()` has finished, we no longer process any
         // samples.
+        //
+        // All of this is done without taking a lock, because for cheap
+        // consumers the cost of locking (let alone the cost of setting up
+        // a std::packaged_task and std::future object for every sample)
+        // would dominate the cost of processing the sample. Instead, we rely on
+        // the following ordering argument: We first increment the counter,
+        // and then check whether we are still accepting samples.
+        // `disconnect_and_flush()` does the opposite: It first marks the
+        // object as no longer accepting samples, and then waits for the
+        // counter to become zero. Because all of these operations are
+        // sequentially consistent atomic operations, either the
+        // check in process_synchronously() sees that we are no longer
+        // accepting samples, or `disconnect_and_flush()` sees the
+        // incremented counter and waits for the sample to be processed.
+        //
+        // Blocks of samples and shared samples are treated in exactly the
+        // same way, except that they are handed to consume_batch() and
+        // consume_shared(), respectively.
         case ParallelMode::synchronous:
         {
           sample_consumer =
-            [&](InputType sample, AuxiliaryData aux_data)
+            [this](InputType sample, AuxiliaryData aux_data)
           {
-            // Create a task that calls `consume()`. We're eventually going to
-            // run this task synchronously, so we can take all arguments of the
-            // underlying lambda as references. The point of wrapping it all
-            // up in a std::packaged_task is so that we can extract a
-            // std::future from it.
-            std::packaged_task<void ()> worker
-            ([&]()
+            this->process_synchronously ([&]()
             {
               this->consume (std::move(sample), std::move(aux_data));
             });
+          };
+
+          batch_consumer =
+            [this](const SampleBatch<InputType> &samples)
+          {
+            this->process_synchronously ([&]()
+            {
+              this->consume_batch (samples);
+            });
+          };
 
-            // Now do the actual work of setting up the task and extracting
-            // the future object:
+          shared_consumer =
+            [this](const SharedSample<InputType> &sample)
+          {
+            this->process_synchronously ([&]()
             {
-              std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
-
-              // If all connections have been severed since we actually
-              // got here (via a connection, of course), we pretend that we
-              // never received the sample.
-              if (connections_to_producers.size() == 0)
-                return;
-
-              // Next emplace the shared future object into the queue, in order
-              // to allow other threads to wait for the termination of
-              // the current job
-              background_tasks.emplace_back (worker.get_future().share());
-            }
-
-            // At this point, we have created a task and put its corresponding
-            // future into the queue. Instead of putting the task into the
-            // background, just execute it right away. This can happen outside
-            // the mutex guard because we do not touch the parallel data
-            // structures at this point. The future will then immediately be
-            // ready once we task has finished executing.
-            worker();
-
-            // Finally, ensure that the queue does not grow beyond bound by
-            // removing shared_futures that have already been satisfied
-            trim_background_queue();
+              this->consume_shared (sample);
+            });
           };
 
           break;
@@ -388,54 +637,107 @@ namespace SampleFlow
 
 
         // On the other hand, if we use asynchronous processing,
-        // then the logic is substantially more complicated.
+        // then the logic is substantially more complicated. We put the
+        // sample into a queue of samples waiting to be processed, and hand
+        // a task to the thread pool that will take a sample from this queue
+        // and process it once one of the pool's threads becomes available.
+        //
+        // The queue is bounded by `queue_size`. If it is full (counting
+        // both the samples waiting in the queue and the ones currently being
+        // processed), then what we do depends on the overflow policy: We
+        // either wait for one of the samples to finish processing (and
+        // thereby throttle the producer), or we discard a sample.
         case ParallelMode::asynchronous:
         {
+          if (thread_pool == nullptr)
+            thread_pool = &ThreadPool::default_pool();
+
           sample_consumer =
-            [&](InputType sample, AuxiliaryData aux_data)
+            [this](InputType sample, AuxiliaryData aux_data)
           {
-            // Create a task that calls `consume()`. First, because we're going
-            // to run this task at some later time, we need to copy the sample
-            // and aux data at this point. (If we were using C++14, we could
-            // actually *move* these objects into the lambda function, but that
-            // is not possible with C++11.)
-            auto worker =
-              [this,sample,aux_data]()
+            // All of the data structures involved are shared with other
+            // threads sending samples, and with the tasks processing
+            // queued samples. So work under a lock.
+            std::unique_lock<std::mutex> parallel_lock (parallel_mode_mutex);
+
+            // If all connections have been severed since we actually
+            // got here (via a connection, of course), we pretend that we
+            // never received the sample. This is the same as what happened
+            // in the synchronous case above.
+            if (connections_to_producers.size() == 0)
+              return;
+
+            // Next make sure that there is room in the queue:
+            while (queued_samples.size() + n_samples_in_progress >= queue_size)
+              {
+                const QueueOverflowPolicy policy
+                  = static_cast<QueueOverflowPolicy>(overflow_policy.load());
+
+                if (policy == QueueOverflowPolicy::drop_newest)
+                  {
+                    ++n_discarded_samples;
+                    return;
+                  }
+                else if ((policy == QueueOverflowPolicy::drop_oldest)
+                         &&
+                         (queued_samples.size() > 0))
+                  {
+                    // Drop the oldest sample that has not been started on.
+                    // The task that was created for it is still in the
+                    // thread pool's queue, and will simply process the
+                    // next sample in line.
+                    queued_samples.pop_front();
+                    ++n_discarded_samples;
+                  }
+                else
+                  {
+                    // Wait for a task to finish. While we wait, the
+                    // connection could have been severed, in which case we
+                    // again pretend that we never received the sample.
+                    wait_for_queue (parallel_lock,
+                                    [this]()
+                    {
+                      return ((connections_to_producers.size() == 0)
+                              ||
+                              (queued_samples.size() + n_samples_in_progress < queue_size));
+                    });
+
+                    if (connections_to_producers.size() == 0)
+                      return;
+                  }
+              }
+
+            // There is room in the queue now. Put the sample there and
+            // hand a task to the thread pool that is going to process
+            // it. (Strictly speaking, the task is going to process whatever
+            // sample is first in the queue at the time it runs; because the
+            // queue is first-in-first-out, that does not make a difference.)
+            queued_samples.emplace_back (std::move(sample), std::move(aux_data));
+            ++n_scheduled_tasks;
+            parallel_lock.unlock();
+
+            thread_pool->enqueue ([this]()
             {
-              this->consume (std::move(sample), std::move(aux_data));
-            };
+              this->process_queued_sample();
+            });
+          };
 
-            // We then also need to put a future object into the queue that we
-            // can query for unfinished objects. Since the queue is a shared
-            // state, we need to access it under a lock. Once we are under the
-            // lock, we can also commit to actually launching the task
-            {
-              std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
-
-              // If all connections have been severed since we actually
-              // got here (via a connection, of course), we pretend that we
-              // never received the sample. This is the same as what happened
-              // in the synchronous case above.
-              if (connections_to_producers.size() == 0)
-                return;
-
-              // Then start the task in the background and let the OS decide when
-              // it wants to execute it. The result is a std::future object that
-              // we can query for completion of the task, and we will hold on
-              // to this future object because we need to wait for tasks to finish
-              // in flush().
-              std::future<void> future = std::async(std::launch::async, worker);
-
-              // Next emplace the shared future object into the queue, in order
-              // to allow other threads to wait for the termination of
-              // the current job
-              background_tasks.emplace_back (future.share());
-            }
-
-
-            // Finally, ensure that the queue does not grow beyond bound by
-            // removing shared_futures that have already been satisfied
-            trim_background_queue();
+          // Samples that arrive as a block are put into the queue one by
+          // one, so that the bound on the queue size and the overflow
+          // policy apply to each of them individually.
+          batch_consumer =
+            [sample_consumer](const SampleBatch<InputType> &samples)
+          {
+            for (const auto &sample : samples)
+              sample_consumer (sample.first, sample.second);
+          };
+
+          // The queue stores samples by value, so shared samples are
+          // copied into it like any other sample.
+          shared_consumer =
+            [sample_consumer](const SharedSample<InputType> &sample)
+          {
+            sample_consumer (sample->first, sample->second);
           };
 
           break;
@@ -458,8 +760,32 @@ namespace SampleFlow
     };
 
     // Finally hook it all up:
+    std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
     connections_to_producers.emplace_back (
-      producer.connect_to_signals (sample_consumer, flush_slot));
+      producer.connect_to_signals (sample_consumer, batch_consumer,
+                                   shared_consumer, flush_slot));
+    accepting_samples = true;
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  consume_batch (const SampleBatch<InputType> &samples)
+  {
+    for (const auto &sample : samples)
+      this->consume (sample.first, sample.second);
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  consume_shared (const SharedSample<InputType> &sample)
+  {
+    this->consume (sample->first, sample->second);
   }
 
 
@@ -468,15 +794,58 @@ namespace SampleFlow
   void
   Consumer<InputType>::
   set_parallel_mode (const ParallelMode parallel_mode,
-                     const unsigned int queue_size)
+                     const unsigned int queue_size,
+                     const QueueOverflowPolicy overflow_policy)
   {
     assert (connections_to_producers.size() == 0);
     assert ((static_cast<int>(parallel_mode)
              & static_cast<int>(supported_parallel_modes))
             != 0);
+    assert (queue_size >= 1);
+    assert ((parallel_mode == ParallelMode::synchronous)
+            ||
+            (mutex.get_locking_policy() != LockingPolicy::none));
 
     this->parallel_mode = static_cast<int>(parallel_mode);
     this->queue_size = queue_size;
+    this->overflow_policy = static_cast<int>(overflow_policy);
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  set_thread_pool (ThreadPool &thread_pool)
+  {
+    assert (connections_to_producers.size() == 0);
+
+    this->thread_pool = &thread_pool;
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  set_locking_policy (const LockingPolicy locking_policy)
+  {
+    assert (connections_to_producers.size() == 0);
+    assert ((locking_policy != LockingPolicy::none)
+            ||
+            (static_cast<ParallelMode>(parallel_mode.load()) == ParallelMode::synchronous));
+
+    mutex.set_locking_policy (locking_policy);
+  }
+
+
+
+  template <typename InputType>
+  types::sample_index
+  Consumer<InputType>::
+  n_dropped_samples () const
+  {
+    return n_discarded_samples.load();
   }
 
 
@@ -497,14 +866,28 @@ namespace SampleFlow
 
       for (auto &connection : connections_to_producers)
         {
-          connection.first.disconnect ();
-          connection.second.disconnect ();
+          std::get<0>(connection).disconnect ();
+          std::get<1>(connection).disconnect ();
+          std::get<2>(connection).disconnect ();
+          std::get<3>(connection).disconnect ();
         }
       connections_to_producers.clear();
+      accepting_samples = false;
     }
 
-    // Then flush() the current state.
-    flush ();
+    // Threads that are waiting for room in the queue of samples need to
+    // learn that they should give up:
+    queue_state_changed.notify_all();
+
+    // Then flush() the current state. We may be called from a
+    // destructor, so we must not let an exception escape.
+    try
+      {
+        flush ();
+      }
+    catch (...)
+      {
+      }
   }
 
 
@@ -514,19 +897,66 @@ namespace SampleFlow
   Consumer<InputType>::
   flush()
   {
-    std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
+    std::unique_lock<std::mutex> parallel_lock (parallel_mode_mutex);
+
+    // Wait for all samples that are currently being processed
+    // synchronously, and for all tasks that process queued samples
+    // in asynchronous mode, to finish. Threads that finish processing
+    // a synchronous sample only notify us if they know that someone
+    // is waiting, so we have to register ourselves first.
+    ++n_flush_waiters;
+    wait_for_queue (parallel_lock,
+                    [this]()
+    {
+      return ((n_synchronous_samples_in_progress.load() == 0)
+              &&
+              (n_scheduled_tasks == 0));
+    });
+    --n_flush_waiters;
+
+    // If processing one of the queued samples threw an exception, pass it
+    // on to our caller now that everything else has been finished up:
+    if (asynchronous_exception)
+      {
+        std::exception_ptr exception = asynchronous_exception;
+        asynchronous_exception = nullptr;
+        parallel_lock.unlock();
+        std::rethrow_exception (exception);
+      }
+  }
+
+
+
+  template <typename InputType>
+  template <typename Function>
+  void
+  Consumer<InputType>::
+  process_synchronously (const Function &process)
+  {
+    ++n_synchronous_samples_in_progress;
 
-    // For each std::shared_future object, first check whether it
-    // has already been waited on. If that is the case, then just
-    // ignore it. If it hasn't, wait for its completion.
-    for (auto &future : background_tasks)
-      if (future.valid())
-        future.wait();
-
-    // At this point, we have waited for all futures, and because
-    // we are under the lock, no new futures can have been added. So
-    // just clear the whole array
-    background_tasks.clear();
+    // If all connections have been severed since we actually
+    // got here (via a connection, of course), we pretend that we
+    // never received the sample.
+    if (accepting_samples.load() == false)
+      {
+        finish_synchronous_sample();
+        return;
+      }
+
+    // Otherwise process the sample. We need to make sure
+    // that the counter is decremented again even if consume()
+    // throws an exception.
+    try
+      {
+        process();
+      }
+    catch (...)
+      {
+        finish_synchronous_sample();
+        throw;
+      }
+    finish_synchronous_sample();
   }
 
 
@@ -534,34 +964,97 @@ namespace SampleFlow
   template <typename InputType>
   void
   Consumer<InputType>::
-  trim_background_queue()
+  finish_synchronous_sample()
   {
-    std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
+    // If we were the last sample in progress and someone is waiting for
+    // this to happen, wake them up. The notification has to happen
+    // under the lock: Otherwise, the waiting thread could have checked
+    // the counter just before we decremented it, but not yet started
+    // waiting, and would then miss the notification.
+    if ((--n_synchronous_samples_in_progress == 0)
+        &&
+        (n_flush_waiters.load() > 0))
+      {
+        std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
+        queue_state_changed.notify_all();
+      }
+  }
+
 
-    // For each std::shared_future object, first check whether it
-    // has completed (either because someone has waited for it,
-    // or because it has finished since someone last looked).
-    // If that is the case, then remove it from the list.
-    auto future = background_tasks.begin();
-    while (future != background_tasks.end())
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  process_queued_sample()
+  {
+    std::unique_lock<std::mutex> parallel_lock (parallel_mode_mutex);
+
+    // The sample this task was created for may have been discarded
+    // because of QueueOverflowPolicy::drop_oldest. In that case, there
+    // is nothing left to do for this task.
+    if (queued_samples.size() == 0)
       {
-        if (future->wait_for(std::chrono::seconds(0))
-            == std::future_status::ready)
-          {
-            // Move the iterator forward by one, but erase the element
-            // previously pointed to by the iterator:
-            auto old_iterator = future;
-            ++future;
+        --n_scheduled_tasks;
+        queue_state_changed.notify_all();
+        return;
+      }
 
-            background_tasks.erase (old_iterator);
-          }
-        else
-          ++future;
+    // Otherwise, take the oldest sample off the queue and process it
+    // outside the lock:
+    std::pair<InputType,AuxiliaryData> sample_and_data (std::move(queued_samples.front()));
+    queued_samples.pop_front();
+    ++n_samples_in_progress;
+    parallel_lock.unlock();
+
+    // We are running on a thread of the pool, so an exception must not
+    // escape from here. Rather, store it so that flush() can rethrow
+    // it on the thread that waits for us.
+    std::exception_ptr exception;
+    try
+      {
+        this->consume (std::move(sample_and_data.first),
+                       std::move(sample_and_data.second));
+      }
+    catch (...)
+      {
+        exception = std::current_exception();
       }
+
+    // Finally, let everyone know that there is room in the queue again.
+    // We notify while still holding the lock: As soon as we release it,
+    // flush() may return and the current object may be destroyed.
+    parallel_lock.lock();
+    if (exception && !asynchronous_exception)
+      asynchronous_exception = exception;
+    --n_samples_in_progress;
+    --n_scheduled_tasks;
+    queue_state_changed.notify_all();
   }
 
 
 
+  template <typename InputType>
+  template <typename Predicate>
+  void
+  Consumer<InputType>::
+  wait_for_queue (std::unique_lock<std::mutex> &lock,
+                  const Predicate &predicate)
+  {
+    if ((thread_pool != nullptr) && thread_pool->is_worker_thread())
+      {
+        while (predicate() == false)
+          {
+            lock.unlock();
+            if (thread_pool->run_pending_task() == false)
+              std::this_thread::yield();
+            lock.lock();
+          }
+      }
+    else
+      queue_state_changed.wait (lock, predicate);
+  }
+
+
 
   /**
    * A namespace for the implementation of consumers, i.e., classes
@@ -102,12 +102,6 @@ namespace SampleFlow
         double get () const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * The current value of accepted values as described in the introduction
          * of this class.
@@ -200,7 +194,7 @@ namespace SampleFlow
     AcceptanceRatio<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       // If this is the first sample we see, naturally, this sample is accepted.
       if (n_samples == 0)
@@ -238,7 +232,7 @@ namespace SampleFlow
     AcceptanceRatio<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       if (n_samples > 0)
         return (static_cast<double>(n_accepted_samples)
@@ -139,12 +139,6 @@ namespace SampleFlow
         consume (InputType sample, AuxiliaryData aux_data) override;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         const std::function<void (InputType, AuxiliaryData)> action_function;
     };
 
@@ -173,7 +167,7 @@ namespace SampleFlow
     Action<InputType>::
     consume (InputType sample, AuxiliaryData aux_data)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       action_function (std::move (sample), std::move(aux_data));
     }
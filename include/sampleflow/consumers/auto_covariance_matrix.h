@@ -308,12 +308,6 @@ namespace SampleFlow
         value_type get() const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * Describes the maximal lag up to which we calculate auto-covariances.
          */
@@ -380,7 +374,7 @@ namespace SampleFlow
     AutoCovarianceMatrix<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       // If this is the first sample we see, initialize all components
       // After the first sample, the autocovariance vector
@@ -489,7 +483,7 @@ namespace SampleFlow
     AutoCovarianceMatrix<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       value_type current_autocovariation(max_lag+1);
       for (auto &a : current_autocovariation)
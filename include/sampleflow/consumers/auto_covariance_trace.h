@@ -348,12 +348,6 @@ namespace SampleFlow
         value_type get() const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * Describes the maximal lag up to which we calculate auto-covariances.
          */
@@ -419,7 +413,7 @@ namespace SampleFlow
     AutoCovarianceTrace<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       // If this is the first sample we see, initialize all components
       // After the first sample, the autocovariance vector
@@ -523,7 +517,7 @@ namespace SampleFlow
     AutoCovarianceTrace<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       std::vector<scalar_type> current_autocovariation(max_lag+1,
                                                        scalar_type(0));
@@ -94,12 +94,6 @@ namespace SampleFlow
         std::vector<scalar_type> get() const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * The data type, where we save multiple set of previous samples.
          */
@@ -153,7 +147,7 @@ namespace SampleFlow
     AverageCosineBetweenSuccessiveSamples<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       // If this is the first sample we see, initialize all components
       // After the first sample, the average cosine vector.
@@ -221,7 +215,7 @@ namespace SampleFlow
     AverageCosineBetweenSuccessiveSamples<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       return current_avg_cosine;
     }
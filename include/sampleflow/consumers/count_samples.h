@@ -18,6 +18,7 @@
 
 #include <sampleflow/consumer.h>
 #include <sampleflow/types.h>
+#include <sampleflow/shards.h>
 #include <mutex>
 
 
@@ -33,7 +34,8 @@ namespace SampleFlow
      *
      * The implementation of this class is thread-safe, i.e., its
      * consume() member function can be called concurrently and from multiple
-     * threads.
+     * threads. See enable_sharding() for how to avoid contention for the
+     * lock of an object to which many threads send samples.
      *
      *
      * @tparam InputType The C++ type used for the samples $x_k$.
@@ -80,6 +82,18 @@ namespace SampleFlow
         void
         consume (InputType sample, AuxiliaryData aux_data) override;
 
+        /**
+         * Process a sample that an upstream producer has sent as a
+         * SharedSample object. This does the same as consume(), but
+         * without making a copy of the sample.
+         *
+         * @param[in] sample The sample to process, along with its
+         *   auxiliary data. Both are ignored.
+         */
+        virtual
+        void
+        consume_shared (const SharedSample<InputType> &sample) override;
+
         /**
          * A function that returns the number of samples received so far.
          *
@@ -88,17 +102,39 @@ namespace SampleFlow
         value_type
         get () const;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Merge the state of another CountSamples object into the current
+         * one. Afterwards, the current object reports the number of samples
+         * both objects have seen together.
+         *
+         * @param[in] other The object whose state is to be merged into the
+         *   current one. It is not changed.
          */
-        mutable std::mutex mutex;
+        void
+        merge (const CountSamples<InputType> &other);
 
+        /**
+         * Let each thread that sends samples to this object count them in
+         * a separate, per-thread shard. The counts of all shards are added
+         * up whenever get() is called. See MeanValue::enable_sharding() for
+         * a discussion of when this is useful, and of the argument.
+         *
+         * This function must be called before the first sample is
+         * processed, and can only be called once.
+         */
+        void
+        enable_sharding (const unsigned int n_shards = 0);
+
+      private:
         /**
          * The number of samples received so far.
          */
         types::sample_index n_samples;
+
+        /**
+         * The per-thread shards used if enable_sharding() has been called.
+         */
+        SampleFlow::internal::Shards<CountSamples<InputType>> shards;
     };
 
 
@@ -129,9 +165,36 @@ namespace SampleFlow
     CountSamples<InputType>::
     consume (InputType /*sample*/, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      CountSamples<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
 
-      ++n_samples;
+      ++target.n_samples;
+    }
+
+
+
+    template <typename InputType>
+    void
+    CountSamples<InputType>::
+    consume_shared (const SharedSample<InputType> &/*sample*/)
+    {
+      CountSamples<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      ++target.n_samples;
+    }
+
+
+
+    template <typename InputType>
+    void
+    CountSamples<InputType>::
+    merge (const CountSamples<InputType> &other)
+    {
+      const types::sample_index other_n_samples = other.get();
+
+      std::lock_guard<Mutex> lock(this->mutex);
+      n_samples += other_n_samples;
     }
 
 
@@ -141,9 +204,32 @@ namespace SampleFlow
     CountSamples<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      types::sample_index sum = 0;
+      for (const auto &shard : shards.all())
+        sum += shard->get();
+
+      std::lock_guard<Mutex> lock(this->mutex);
+
+      return sum + n_samples;
+    }
+
 
-      return n_samples;
+
+    template <typename InputType>
+    void
+    CountSamples<InputType>::
+    enable_sharding (const unsigned int n_shards)
+    {
+      assert (shards.enabled() == false);
+
+      // The shards use the same locking policy as the current object:
+      shards.initialize (n_shards,
+                         [this]()
+      {
+        CountSamples<InputType> *shard = new CountSamples<InputType>();
+        shard->set_locking_policy (this->mutex.get_locking_policy());
+        return shard;
+      });
     }
 
   }
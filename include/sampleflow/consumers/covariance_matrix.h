@@ -18,6 +18,7 @@
 
 #include <sampleflow/consumer.h>
 #include <sampleflow/types.h>
+#include <sampleflow/shards.h>
 #include <mutex>
 
 #include <eigen3/Eigen/Dense>
@@ -48,7 +49,8 @@ namespace SampleFlow
      *
      * The implementation of this class is thread-safe, i.e., its
      * consume() member function can be called concurrently and from multiple
-     * threads.
+     * threads. See enable_sharding() for how to avoid contention for the
+     * lock of an object to which many threads send samples.
      *
      *
      * @tparam InputType The C++ type used for the samples $x_k$. In
@@ -101,6 +103,30 @@ namespace SampleFlow
         consume (InputType     sample,
                  AuxiliaryData aux_data) override;
 
+        /**
+         * Process a whole block of samples. This does the same as calling
+         * consume() for each sample of the block, but only acquires the
+         * lock that protects the member variables of this class once.
+         *
+         * @param[in] samples The samples to process, along with their
+         *   auxiliary data (which is ignored).
+         */
+        virtual
+        void
+        consume_batch (const SampleBatch<InputType> &samples) override;
+
+        /**
+         * Process a sample that an upstream producer has sent as a
+         * SharedSample object. This does the same as consume(), but
+         * reads the sample in place rather than making a copy of it.
+         *
+         * @param[in] sample The sample to process, along with its
+         *   auxiliary data (which is ignored).
+         */
+        virtual
+        void
+        consume_shared (const SharedSample<InputType> &sample) override;
+
         /**
          * A function that returns the covariance matrix computed from the
          * samples seen so far. If no samples have been processed so far, then
@@ -111,13 +137,51 @@ namespace SampleFlow
         value_type
         get () const;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Merge the state of another CovarianceMatrix object into the
+         * current one. Afterwards, the current object represents the
+         * covariance matrix of all samples that either of the two objects
+         * has seen, as if all of these samples had been processed by the
+         * current object. This allows computing the covariance matrix of a
+         * large number of samples in parallel: Each thread, or each of
+         * several chains, feeds its own CovarianceMatrix object, and these
+         * objects are merged once sampling has finished.
+         *
+         * If the current object has seen $n_a$ samples with mean value
+         * $\bar x_a$ and covariance matrix $C_a$, and the other object
+         * $n_b$ samples with mean value $\bar x_b$ and covariance matrix
+         * $C_b$, then the merged covariance matrix is computed using the
+         * formula by Chan, Golub, and LeVeque (1979) (see
+         * https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Parallel_algorithm):
+         * @f{align*}{
+         *   C = \frac{1}{n_a+n_b-1}
+         *       \left( (n_a-1) C_a + (n_b-1) C_b
+         *               + \frac{n_a n_b}{n_a+n_b} \delta \delta^T \right),
+         *   \qquad
+         *   \delta = \bar x_b - \bar x_a.
+         * @f}
+         * The mean value is merged as described for MeanValue::merge().
+         *
+         * @param[in] other The object whose state is to be merged into the
+         *   current one. It is not changed.
          */
-        mutable std::mutex mutex;
+        void
+        merge (const CovarianceMatrix<InputType> &other);
 
+        /**
+         * Let each thread that sends samples to this object accumulate its
+         * share of the covariance matrix in a separate, per-thread shard.
+         * The shards are combined using merge() whenever get() is called.
+         * See MeanValue::enable_sharding() for a discussion of when this is
+         * useful, and of the argument.
+         *
+         * This function must be called before the first sample is
+         * processed, and can only be called once.
+         */
+        void
+        enable_sharding (const unsigned int n_shards = 0);
+
+      private:
         /**
          * The current value of $\bar x_k$ as described in the introduction
          * of this class.
@@ -134,6 +198,19 @@ namespace SampleFlow
          * The number of samples processed so far.
          */
         types::sample_index n_samples;
+
+        /**
+         * Update the current mean value and covariance matrix with the
+         * given sample. This function must be called while holding the
+         * lock on `mutex`.
+         */
+        void
+        update (const InputType &sample);
+
+        /**
+         * The per-thread shards used if enable_sharding() has been called.
+         */
+        SampleFlow::internal::Shards<CovarianceMatrix<InputType>> shards;
     };
 
 
@@ -164,8 +241,46 @@ namespace SampleFlow
     CovarianceMatrix<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      CovarianceMatrix<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      target.update (sample);
+    }
+
+
+
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    consume_batch (const SampleBatch<InputType> &samples)
+    {
+      CovarianceMatrix<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      for (const auto &sample : samples)
+        target.update (sample.first);
+    }
+
+
+
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    consume_shared (const SharedSample<InputType> &sample)
+    {
+      CovarianceMatrix<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      target.update (sample->first);
+    }
 
+
+
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    update (const InputType &sample)
+    {
       // If this is the first sample we see, initialize the matrix with
       // this sample. After the first sample, the covariance matrix
       // is the zero matrix since a single sample has a zero variance.
@@ -176,7 +291,7 @@ namespace SampleFlow
         {
           n_samples = 1;
           current_covariance_matrix.resize (Utilities::size(sample), Utilities::size(sample));
-          current_mean = std::move(sample);
+          current_mean = sample;
         }
       else
         {
@@ -204,16 +319,113 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    merge (const CovarianceMatrix<InputType> &other)
+    {
+      // If the other object is sharded, first merge its shards. See
+      // MeanValue::merge().
+      for (const auto &shard : other.shards.all())
+        merge (*shard);
+
+      // Then copy the state of the other object, so that we never hold
+      // the locks of both objects at the same time. See MeanValue::merge()
+      // for the reason.
+      InputType           other_mean;
+      value_type          other_covariance_matrix;
+      types::sample_index other_n_samples;
+      {
+        std::lock_guard<Mutex> lock(other.mutex);
+        other_mean              = other.current_mean;
+        other_covariance_matrix = other.current_covariance_matrix;
+        other_n_samples         = other.n_samples;
+      }
+
+      if (other_n_samples == 0)
+        return;
+
+      std::lock_guard<Mutex> lock(this->mutex);
+      if (n_samples == 0)
+        {
+          n_samples                 = other_n_samples;
+          current_mean              = std::move(other_mean);
+          current_covariance_matrix = std::move(other_covariance_matrix);
+          return;
+        }
+
+      const double n_a = n_samples;
+      const double n_b = other_n_samples;
+      const double n   = n_a + n_b;
+
+      InputType delta = other_mean;
+      delta -= current_mean;
+
+      // The covariance matrix of an object that has seen only one sample
+      // is zero, but the object does not actually store zeros in that
+      // case. So be careful to not use its elements:
+      const unsigned int size = Utilities::size(current_mean);
+      for (unsigned int i=0; i<size; ++i)
+        {
+          const auto delta_i = Utilities::get_nth_element(delta, i);
+          for (unsigned int j=0; j<size; ++j)
+            {
+              const auto delta_j = Utilities::conj(Utilities::get_nth_element(delta, j));
+
+              scalar_type sum_of_squares = (delta_i*delta_j) * (n_a * n_b / n);
+              if (n_samples > 1)
+                sum_of_squares += current_covariance_matrix(i,j) * (n_a - 1);
+              if (other_n_samples > 1)
+                sum_of_squares += other_covariance_matrix(i,j) * (n_b - 1);
+
+              current_covariance_matrix(i,j) = sum_of_squares / (n - 1);
+            }
+        }
+
+      delta /= (n / n_b);
+      current_mean += delta;
+
+      n_samples += other_n_samples;
+    }
+
+
+
     template <typename InputType>
     typename CovarianceMatrix<InputType>::value_type
     CovarianceMatrix<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      if (shards.enabled())
+        {
+          CovarianceMatrix<InputType> merged;
+          merged.merge (*this);
+          return merged.get();
+        }
+
+      std::lock_guard<Mutex> lock(this->mutex);
 
       return current_covariance_matrix;
     }
 
+
+
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    enable_sharding (const unsigned int n_shards)
+    {
+      assert (shards.enabled() == false);
+
+      // The shards use the same locking policy as the current object:
+      shards.initialize (n_shards,
+                         [this]()
+      {
+        CovarianceMatrix<InputType> *shard = new CovarianceMatrix<InputType>();
+        shard->set_locking_policy (this->mutex.get_locking_policy());
+        return shard;
+      });
+    }
+
   }
 }
 
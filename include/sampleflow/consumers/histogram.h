@@ -18,6 +18,7 @@
 
 #include <sampleflow/consumer.h>
 #include <sampleflow/types.h>
+#include <sampleflow/shards.h>
 
 #include <mutex>
 #include <type_traits>
@@ -51,7 +52,8 @@ namespace SampleFlow
      *
      * The implementation of this class is thread-safe, i.e., its
      * consume() member function can be called concurrently and from multiple
-     * threads.
+     * threads. See enable_sharding() for how to avoid contention for the
+     * lock of an object to which many threads send samples.
      *
      *
      * @tparam InputType The C++ type used for the samples $x_k$ processed
@@ -156,7 +158,10 @@ namespace SampleFlow
                    const std::function<double (const double)> &f);
 
         /**
-         * Copy constructor.
+         * Copy constructor. The new object has the same bins as `o`, and
+         * counts all samples `o` has seen, including those that are still
+         * held in the shards of `o` if it is sharded. The new object itself
+         * is not sharded, regardless of whether `o` is.
          */
         Histogram (const Histogram<InputType> &o);
 
@@ -187,6 +192,18 @@ namespace SampleFlow
         void
         consume (InputType sample, AuxiliaryData aux_data) override;
 
+        /**
+         * Process a whole block of samples. This does the same as calling
+         * consume() for each sample of the block, but only acquires the
+         * lock that protects the bins once.
+         *
+         * @param[in] samples The samples to process, along with their
+         *   auxiliary data (which is ignored).
+         */
+        virtual
+        void
+        consume_batch (const SampleBatch<InputType> &samples) override;
+
         /**
          * Return the histogram in the format discussed in the documentation
          * of the `value_type` type.
@@ -196,6 +213,33 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Merge the state of another Histogram object into the current one
+         * by adding the number of samples in each bin of the other object
+         * to the number of samples in the corresponding bin of the current
+         * object. Afterwards, the current object represents the histogram
+         * of all samples that either of the two objects has seen. The two
+         * objects must use the same bins.
+         *
+         * @param[in] other The object whose state is to be merged into the
+         *   current one. It is not changed.
+         */
+        void
+        merge (const Histogram<InputType> &other);
+
+        /**
+         * Let each thread that sends samples to this object count them in
+         * a separate, per-thread copy of the bins. The bins of all shards
+         * are added up whenever get() is called. See
+         * MeanValue::enable_sharding() for a discussion of when this is
+         * useful, and of the argument.
+         *
+         * This function must be called before the first sample is
+         * processed, and can only be called once.
+         */
+        void
+        enable_sharding (const unsigned int n_shards = 0);
+
         /**
          * Write the histogram into a file in such a way that it can
          * be visualized using the Gnuplot program. Internally, this function
@@ -222,12 +266,6 @@ namespace SampleFlow
         write_gnuplot (std::ostream &&output_stream) const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * A variable that describes the left end points of each of the
          * intervals that make up each bin. The vector contains one additional
@@ -251,6 +289,19 @@ namespace SampleFlow
          * abort.
          */
         unsigned int bin_number (const double value) const;
+
+        /**
+         * For a given sample, return the number of the bin it needs to be
+         * counted in, or `bins.size()` if the sample lies outside the range
+         * covered by the histogram and should simply be discarded. This
+         * function is used by both consume() and consume_batch().
+         */
+        unsigned int sample_bin (const InputType sample) const;
+
+        /**
+         * The per-thread shards used if enable_sharding() has been called.
+         */
+        SampleFlow::internal::Shards<Histogram<InputType>> shards;
     };
 
 
@@ -321,8 +372,12 @@ namespace SampleFlow
                                        |
                                        static_cast<int>(ParallelMode::asynchronous))),
       interval_points(o.interval_points),
-      bins (o.bins)
-    {}
+      bins (o.bins.size(), 0)
+    {
+      // Add the samples counted by the other object (and by its shards,
+      // if any) to the empty bins of the current one:
+      merge (o);
+    }
 
 
 
@@ -340,17 +395,35 @@ namespace SampleFlow
     Histogram<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      // If a sample lies outside the bounds, just discard it:
-      if (sample<interval_points.front() || sample>=interval_points.back())
-        return;
+      // If a sample lies outside the bounds, just discard it. Otherwise
+      // we need to update the appropriate histogram bin:
+      const unsigned int bin = sample_bin(sample);
+
+      if (bin < bins.size())
+        {
+          Histogram<InputType> &target = (shards.enabled() ? shards.local() : *this);
+          std::lock_guard<Mutex> lock(target.mutex);
+          ++target.bins[bin];
+        }
+    }
+
+
 
-      // Otherwise we need to update the appropriate histogram bin:
-      const unsigned int bin = bin_number(sample);
+    template <typename InputType>
+    void
+    Histogram<InputType>::
+    consume_batch (const SampleBatch<InputType> &samples)
+    {
+      // Do the same as in consume(), but only acquire the lock once for
+      // the whole block:
+      Histogram<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
 
-      if (bin >= 0  &&  bin < bins.size())
+      for (const auto &sample : samples)
         {
-          std::lock_guard<std::mutex> lock(mutex);
-          ++bins[bin];
+          const unsigned int bin = sample_bin(sample.first);
+          if (bin < bins.size())
+            ++target.bins[bin];
         }
     }
 
@@ -373,11 +446,19 @@ namespace SampleFlow
         }
 
       // Now fill the bin sizes under a lock as they are subject to
-      // change from other threads:
-      std::lock_guard<std::mutex> lock(mutex);
+      // change from other threads. If the object is sharded, add up the
+      // bins of all shards, each under that shard's lock:
+      for (const auto &shard : shards.all())
+        {
+          std::lock_guard<Mutex> lock(shard->mutex);
+          for (unsigned int bin=0; bin<bins.size(); ++bin)
+            std::get<2>(return_value[bin]) += shard->bins[bin];
+        }
+
+      std::lock_guard<Mutex> lock(this->mutex);
       for (unsigned int bin=0; bin<bins.size(); ++bin)
         {
-          std::get<2>(return_value[bin]) = bins[bin];
+          std::get<2>(return_value[bin]) += bins[bin];
         }
 
       return return_value;
@@ -385,6 +466,57 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    void
+    Histogram<InputType>::
+    merge (const Histogram<InputType> &other)
+    {
+      // The bins do not change after construction, so they can be
+      // compared without holding a lock:
+      assert (interval_points == other.interval_points);
+
+      // If the other object is sharded, first merge its shards:
+      for (const auto &shard : other.shards.all())
+        merge (*shard);
+
+      // Then copy the other object's bin counts, so that we never hold
+      // the locks of both objects at the same time. See
+      // MeanValue::merge() for the reason.
+      std::vector<types::sample_index> other_bins;
+      {
+        std::lock_guard<Mutex> lock(other.mutex);
+        other_bins = other.bins;
+      }
+
+      std::lock_guard<Mutex> lock(this->mutex);
+      for (unsigned int bin=0; bin<bins.size(); ++bin)
+        bins[bin] += other_bins[bin];
+    }
+
+
+
+    template <typename InputType>
+    void
+    Histogram<InputType>::
+    enable_sharding (const unsigned int n_shards)
+    {
+      assert (shards.enabled() == false);
+
+      // Each shard has the same bins as the current object, but starts
+      // out with no samples in them. They also use the same locking
+      // policy:
+      shards.initialize (n_shards,
+                         [this]()
+      {
+        Histogram<InputType> *shard = new Histogram<InputType>(*this);
+        std::fill (shard->bins.begin(), shard->bins.end(), 0);
+        shard->set_locking_policy (this->mutex.get_locking_policy());
+        return shard;
+      });
+    }
+
+
+
     template <typename InputType>
     void
     Histogram<InputType>::
@@ -427,6 +559,19 @@ namespace SampleFlow
       else
         return (p-interval_points.begin()-1);
     }
+
+
+
+    template <typename InputType>
+    unsigned int
+    Histogram<InputType>::
+    sample_bin (const InputType sample) const
+    {
+      if (sample<interval_points.front() || sample>=interval_points.back())
+        return bins.size();
+      else
+        return bin_number(sample);
+    }
   }
 }
 
@@ -80,12 +80,6 @@ namespace SampleFlow
         get () const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * The value of the last sample seen by consume().
          */
@@ -108,7 +102,7 @@ namespace SampleFlow
     LastSample<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       last_sample = std::move (sample);
     }
@@ -120,7 +114,7 @@ namespace SampleFlow
     LastSample<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       return last_sample;
     }
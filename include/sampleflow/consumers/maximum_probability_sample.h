@@ -105,13 +105,19 @@ namespace SampleFlow
         value_type
         get () const;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Merge the state of another MaximumProbabilitySample object into
+         * the current one. Afterwards, the current object stores whichever
+         * of the two samples the objects have stored has the higher log
+         * likelihood.
+         *
+         * @param[in] other The object whose state is to be merged into the
+         *   current one. It is not changed.
          */
-        mutable std::mutex mutex;
+        void
+        merge (const MaximumProbabilitySample<InputType> &other);
 
+      private:
         /**
          * The currently most likely sample.
          */
@@ -162,11 +168,11 @@ namespace SampleFlow
     {
       // Let's see first if the sample provided has the log likelihood
       // attribute we would like to evaluate
-      if (aux_data.find ("relative log likelihood") != aux_data.end())
+      if (const double *p = aux_data.get_if<double>(AuxiliaryDataKeys::relative_log_likelihood))
         {
-          const double log_likelihood = boost::any_cast<double>(aux_data["relative log likelihood"]);
+          const double log_likelihood = *p;
 
-          std::lock_guard<std::mutex> lock(mutex);
+          std::lock_guard<Mutex> lock(this->mutex);
 
           // Check if we have seen any sample at all so far
           if (current_highest_log_likelihood == std::numeric_limits<double>::lowest())
@@ -190,12 +196,48 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    void
+    MaximumProbabilitySample<InputType>::
+    merge (const MaximumProbabilitySample<InputType> &other)
+    {
+      // First copy the state of the other object, so that we never hold
+      // the locks of both objects at the same time. See
+      // MeanValue::merge() for the reason.
+      InputType     other_sample;
+      AuxiliaryData other_data;
+      double        other_log_likelihood;
+      {
+        std::lock_guard<Mutex> lock(other.mutex);
+        other_sample         = other.current_most_likely_sample;
+        other_data           = other.current_most_likely_sample_data;
+        other_log_likelihood = other.current_highest_log_likelihood;
+      }
+
+      // If the other object has not seen any samples, there is nothing
+      // to do. Otherwise, proceed as in consume():
+      if (other_log_likelihood == std::numeric_limits<double>::lowest())
+        return;
+
+      std::lock_guard<Mutex> lock(this->mutex);
+      if ((current_highest_log_likelihood == std::numeric_limits<double>::lowest())
+          ||
+          (other_log_likelihood > current_highest_log_likelihood))
+        {
+          current_most_likely_sample = std::move (other_sample);
+          current_most_likely_sample_data = std::move (other_data);
+          current_highest_log_likelihood = other_log_likelihood;
+        }
+    }
+
+
+
     template <typename InputType>
     typename MaximumProbabilitySample<InputType>::value_type
     MaximumProbabilitySample<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       return {current_most_likely_sample, current_most_likely_sample_data};
     }
@@ -18,6 +18,7 @@
 
 #include <sampleflow/consumer.h>
 #include <sampleflow/types.h>
+#include <sampleflow/shards.h>
 #include <mutex>
 
 
@@ -53,7 +54,9 @@ namespace SampleFlow
      *
      * The implementation of this class is thread-safe, i.e., its
      * consume() member function can be called concurrently and from multiple
-     * threads.
+     * threads. If many threads send samples to the same object, they
+     * compete for the lock that protects the object's state; in that case,
+     * consider calling enable_sharding().
      *
      *
      * @tparam InputType The C++ type used for the samples $x_k$. In
@@ -121,6 +124,30 @@ namespace SampleFlow
         consume (InputType     sample,
                  AuxiliaryData aux_data) override;
 
+        /**
+         * Process a whole block of samples. This does the same as calling
+         * consume() for each sample of the block, but only acquires the
+         * lock that protects the member variables of this class once.
+         *
+         * @param[in] samples The samples to process, along with their
+         *   auxiliary data (which is ignored).
+         */
+        virtual
+        void
+        consume_batch (const SampleBatch<InputType> &samples) override;
+
+        /**
+         * Process a sample that an upstream producer has sent as a
+         * SharedSample object. This does the same as consume(), but
+         * does not make a copy of the auxiliary data.
+         *
+         * @param[in] sample The sample to process, along with its
+         *   auxiliary data (which is ignored).
+         */
+        virtual
+        void
+        consume_shared (const SharedSample<InputType> &sample) override;
+
         /**
          * A function that returns the mean value computed from the samples
          * seen so far. If no samples have been processed so far, then a
@@ -131,13 +158,73 @@ namespace SampleFlow
         value_type
         get () const;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Merge the state of another MeanValue object into the current one.
+         * Afterwards, the current object represents the mean value of all
+         * samples that either of the two objects has seen, as if all of
+         * these samples had been processed by the current object. This
+         * allows computing the mean value of a large number of samples in
+         * parallel without sharing one object (and its lock) between
+         * threads: Each thread, or each of several chains, feeds its own
+         * MeanValue object, and these objects are merged once sampling has
+         * finished.
+         *
+         * If the current object has seen $n_a$ samples with mean value
+         * $\bar x_a$, and the other object $n_b$ samples with mean value
+         * $\bar x_b$, then the merged mean value is computed as
+         * @f{align*}{
+         *   \bar x = \bar x_a + \frac{n_b}{n_a+n_b} (\bar x_b - \bar x_a),
+         * @f}
+         * which is the update formula in the introduction of this class
+         * generalized to adding $n_b$ samples at once (see
+         * https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Parallel_algorithm).
+         * This formula requires that `InputType` allows division by a
+         * floating point scalar.
+         *
+         * @param[in] other The object whose state is to be merged into the
+         *   current one. It is not changed.
          */
-        mutable std::mutex mutex;
+        void
+        merge (const MeanValue<InputType> &other);
 
+        /**
+         * Let each thread that sends samples to this object accumulate its
+         * share of the mean value in a separate, per-thread "shard" (itself
+         * a MeanValue object), rather than in the current object. All
+         * threads that call consume() concurrently otherwise compete for
+         * the one lock of the current object, and the time spent waiting
+         * for it can dominate the (small) cost of updating the mean; with
+         * sharding, each thread only acquires the (uncontended) lock of its
+         * own shard. The shards are combined using merge() whenever get()
+         * is called, or when the current object is merged into another one.
+         *
+         * Since get() has to merge all shards, it becomes more expensive.
+         * Sharding is therefore only worth it if samples are sent by
+         * several threads, for example when the object is connected to a
+         * producer in ParallelMode::asynchronous mode, and get() is only
+         * called rarely.
+         *
+         * This function must be called before the first sample is
+         * processed, and can only be called once. The shards use the
+         * locking policy of the current object at the time this function
+         * is called, so call set_locking_policy() first if you want to
+         * change it.
+         *
+         * @param[in] n_shards The number of shards to use. Threads are
+         *   assigned to shards in the order in which they first send a
+         *   sample, and once every shard has a thread, in a round-robin
+         *   fashion. A thread that starts after another one has ended
+         *   may take over the shard of the ended thread. So only if more
+         *   threads than shards send samples to the current object at the
+         *   same time do some of them share a shard. The
+         *   default value of zero creates one shard for each thread of
+         *   ThreadPool::default_pool(), plus one for the thread that runs
+         *   the producer.
+         */
+        void
+        enable_sharding (const unsigned int n_shards = 0);
+
+      private:
         /**
          * The current value of $\bar x_k$ as described in the introduction
          * of this class.
@@ -148,6 +235,18 @@ namespace SampleFlow
          * The number of samples processed so far.
          */
         types::sample_index n_samples;
+
+        /**
+         * Update the current mean value with the given sample. This
+         * function must be called while holding the lock on `mutex`.
+         */
+        void
+        update (InputType sample);
+
+        /**
+         * The per-thread shards used if enable_sharding() has been called.
+         */
+        SampleFlow::internal::Shards<MeanValue<InputType>> shards;
     };
 
 
@@ -178,8 +277,46 @@ namespace SampleFlow
     MeanValue<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      MeanValue<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      target.update (std::move(sample));
+    }
+
+
+
+    template <typename InputType>
+    void
+    MeanValue<InputType>::
+    consume_batch (const SampleBatch<InputType> &samples)
+    {
+      MeanValue<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      for (const auto &sample : samples)
+        target.update (sample.first);
+    }
+
+
+
+    template <typename InputType>
+    void
+    MeanValue<InputType>::
+    consume_shared (const SharedSample<InputType> &sample)
+    {
+      MeanValue<InputType> &target = (shards.enabled() ? shards.local() : *this);
+      std::lock_guard<Mutex> lock(target.mutex);
+
+      target.update (sample->first);
+    }
 
+
+
+    template <typename InputType>
+    void
+    MeanValue<InputType>::
+    update (InputType sample)
+    {
       // If this is the first sample we see, initialize the current-mean with
       // this sample.
       if (n_samples == 0)
@@ -203,16 +340,90 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    void
+    MeanValue<InputType>::
+    merge (const MeanValue<InputType> &other)
+    {
+      // If the other object is sharded, its state is distributed among
+      // its shards (and possibly the object itself, if it had received
+      // samples before sharding was enabled). Merge all of these:
+      for (const auto &shard : other.shards.all())
+        merge (*shard);
+
+      // Then copy the state of the other object. Doing so separately
+      // from updating the current object means that we never hold the
+      // locks of both objects at the same time, and so cannot deadlock
+      // if two threads merge two objects into each other concurrently.
+      InputType           other_mean;
+      types::sample_index other_n_samples;
+      {
+        std::lock_guard<Mutex> lock(other.mutex);
+        other_mean      = other.current_mean;
+        other_n_samples = other.n_samples;
+      }
+
+      if (other_n_samples == 0)
+        return;
+
+      std::lock_guard<Mutex> lock(this->mutex);
+      if (n_samples == 0)
+        {
+          n_samples = other_n_samples;
+          current_mean = std::move(other_mean);
+        }
+      else
+        {
+          n_samples += other_n_samples;
+
+          InputType update = std::move(other_mean);
+          update -= current_mean;
+          update /= (1.0 * n_samples / other_n_samples);
+
+          current_mean += update;
+        }
+    }
+
+
+
     template <typename InputType>
     typename MeanValue<InputType>::value_type
     MeanValue<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      // If the object is sharded, combine the shards into a temporary
+      // object and return that object's mean value:
+      if (shards.enabled())
+        {
+          MeanValue<InputType> merged;
+          merged.merge (*this);
+          return merged.get();
+        }
+
+      std::lock_guard<Mutex> lock(this->mutex);
 
       return current_mean;
     }
 
+
+
+    template <typename InputType>
+    void
+    MeanValue<InputType>::
+    enable_sharding (const unsigned int n_shards)
+    {
+      assert (shards.enabled() == false);
+
+      // The shards use the same locking policy as the current object:
+      shards.initialize (n_shards,
+                         [this]()
+      {
+        MeanValue<InputType> *shard = new MeanValue<InputType>();
+        shard->set_locking_policy (this->mutex.get_locking_policy());
+        return shard;
+      });
+    }
+
   }
 }
 
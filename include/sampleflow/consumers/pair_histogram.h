@@ -18,6 +18,7 @@
 
 #include <sampleflow/consumer.h>
 #include <sampleflow/types.h>
+#include <sampleflow/shards.h>
 
 #include <eigen3/Eigen/Dense>
 
@@ -55,7 +56,8 @@ namespace SampleFlow
      *
      * The implementation of this class is thread-safe, i.e., its
      * consume() member function can be called concurrently and from multiple
-     * threads.
+     * threads. See enable_sharding() for how to avoid contention for the
+     * lock of an object to which many threads send samples.
      *
      *
      * @tparam InputType The C++ type used for the samples $x_k$ processed
@@ -191,7 +193,10 @@ namespace SampleFlow
                        const std::function<double (const double)> &f_y);
 
         /**
-         * Copy constructor.
+         * Copy constructor. The new object has the same bins as `o`, and
+         * counts all samples `o` has seen, including those that are still
+         * held in the shards of `o` if it is sharded. The new object itself
+         * is not sharded, regardless of whether `o` is.
          */
         PairHistogram (const PairHistogram<InputType> &o);
 
@@ -225,6 +230,33 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Merge the state of another PairHistogram object into the current
+         * one by adding the number of samples in each bin of the other
+         * object to the number of samples in the corresponding bin of the
+         * current object. Afterwards, the current object represents the
+         * histogram of all samples that either of the two objects has seen.
+         * The two objects must use the same bins.
+         *
+         * @param[in] other The object whose state is to be merged into the
+         *   current one. It is not changed.
+         */
+        void
+        merge (const PairHistogram<InputType> &other);
+
+        /**
+         * Let each thread that sends samples to this object count them in
+         * a separate, per-thread copy of the bins. The bins of all shards
+         * are added up whenever get() is called. See
+         * MeanValue::enable_sharding() for a discussion of when this is
+         * useful, and of the argument.
+         *
+         * This function must be called before the first sample is
+         * processed, and can only be called once.
+         */
+        void
+        enable_sharding (const unsigned int n_shards = 0);
+
         /**
          * Write the PairHistogram into a file in such a way that it can
          * be visualized using the Gnuplot program. Internally, this function
@@ -252,12 +284,6 @@ namespace SampleFlow
         write_gnuplot (std::ostream &&output_stream) const;
 
       private:
-        /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
-         */
-        mutable std::mutex mutex;
-
         /**
          * A variable that describes the left end points of each of the
          * intervals that make up each bin. The vector contains one additional
@@ -283,6 +309,11 @@ namespace SampleFlow
          */
         unsigned int x_bin_number (const double value) const;
         unsigned int y_bin_number (const double value) const;
+
+        /**
+         * The per-thread shards used if enable_sharding() has been called.
+         */
+        SampleFlow::internal::Shards<PairHistogram<InputType>> shards;
     };
 
 
@@ -301,7 +332,7 @@ namespace SampleFlow
                                        static_cast<int>(ParallelMode::asynchronous))),
       x_interval_points(n_x_bins+1),
       y_interval_points(n_y_bins+1),
-      bins (n_x_bins, n_y_bins)
+      bins (Eigen::Matrix<types::sample_index,Eigen::Dynamic,Eigen::Dynamic>::Zero(n_x_bins, n_y_bins))
     {
       // First treat the subdivision of the x-axis:
       {
@@ -346,7 +377,7 @@ namespace SampleFlow
                                        static_cast<int>(ParallelMode::asynchronous))),
       x_interval_points(n_x_bins+1),
       y_interval_points(n_y_bins+1),
-      bins (n_x_bins, n_y_bins)
+      bins (Eigen::Matrix<types::sample_index,Eigen::Dynamic,Eigen::Dynamic>::Zero(n_x_bins, n_y_bins))
     {
       // Treat the x-axis subdivision:
       {
@@ -398,8 +429,12 @@ namespace SampleFlow
                                        static_cast<int>(ParallelMode::asynchronous))),
       x_interval_points(o.x_interval_points),
       y_interval_points(o.y_interval_points),
-      bins (o.bins)
-    {}
+      bins (Eigen::Matrix<types::sample_index,Eigen::Dynamic,Eigen::Dynamic>::Zero(o.bins.rows(), o.bins.cols()))
+    {
+      // Add the samples counted by the other object (and by its shards,
+      // if any) to the empty bins of the current one:
+      merge (o);
+    }
 
 
 
@@ -433,9 +468,10 @@ namespace SampleFlow
           &&
           y_bin >= 0  &&  y_bin < bins.cols())
         {
-          std::lock_guard<std::mutex> lock(mutex);
+          PairHistogram<InputType> &target = (shards.enabled() ? shards.local() : *this);
+          std::lock_guard<Mutex> lock(target.mutex);
 
-          ++bins(x_bin,y_bin);
+          ++target.bins(x_bin,y_bin);
         }
     }
 
@@ -461,13 +497,24 @@ namespace SampleFlow
           }
 
       // Now fill the bin sizes under a lock as they are subject to
-      // change from other threads:
-      std::lock_guard<std::mutex> lock(mutex);
+      // change from other threads. If the object is sharded, add up the
+      // bins of all shards, each under that shard's lock:
+      Eigen::Matrix<types::sample_index,Eigen::Dynamic,Eigen::Dynamic> all_bins;
+      {
+        std::lock_guard<Mutex> lock(this->mutex);
+        all_bins = bins;
+      }
+      for (const auto &shard : shards.all())
+        {
+          std::lock_guard<Mutex> lock(shard->mutex);
+          all_bins += shard->bins;
+        }
+
       for (unsigned int x_bin=0; x_bin<bins.rows(); ++x_bin)
         for (unsigned int y_bin=0; y_bin<bins.cols(); ++y_bin)
           {
             const unsigned int bin = x_bin * bins.cols() + y_bin;
-            std::get<2>(return_value[bin]) = bins(x_bin,y_bin);
+            std::get<2>(return_value[bin]) = all_bins(x_bin,y_bin);
           }
 
       return return_value;
@@ -475,6 +522,57 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    void
+    PairHistogram<InputType>::
+    merge (const PairHistogram<InputType> &other)
+    {
+      // The bins do not change after construction, so they can be
+      // compared without holding a lock:
+      assert (x_interval_points == other.x_interval_points);
+      assert (y_interval_points == other.y_interval_points);
+
+      // If the other object is sharded, first merge its shards:
+      for (const auto &shard : other.shards.all())
+        merge (*shard);
+
+      // Then copy the other object's bin counts, so that we never hold
+      // the locks of both objects at the same time. See
+      // MeanValue::merge() for the reason.
+      Eigen::Matrix<types::sample_index,Eigen::Dynamic,Eigen::Dynamic> other_bins;
+      {
+        std::lock_guard<Mutex> lock(other.mutex);
+        other_bins = other.bins;
+      }
+
+      std::lock_guard<Mutex> lock(this->mutex);
+      bins += other_bins;
+    }
+
+
+
+    template <typename InputType>
+    void
+    PairHistogram<InputType>::
+    enable_sharding (const unsigned int n_shards)
+    {
+      assert (shards.enabled() == false);
+
+      // Each shard has the same bins as the current object, but starts
+      // out with no samples in them. They also use the same locking
+      // policy:
+      shards.initialize (n_shards,
+                         [this]()
+      {
+        PairHistogram<InputType> *shard = new PairHistogram<InputType>(*this);
+        shard->bins.setZero();
+        shard->set_locking_policy (this->mutex.get_locking_policy());
+        return shard;
+      });
+    }
+
+
+
     template <typename InputType>
     void
     PairHistogram<InputType>::
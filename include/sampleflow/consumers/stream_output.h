@@ -94,13 +94,19 @@ namespace SampleFlow
         void
         consume (InputType sample, AuxiliaryData aux_data) override;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Process a sample that an upstream producer has sent as a
+         * SharedSample object. This does the same as consume(), but
+         * writes the sample without making a copy of it.
+         *
+         * @param[in] sample The sample to process, along with its
+         *   auxiliary data (which is ignored).
          */
-        mutable std::mutex mutex;
+        virtual
+        void
+        consume_shared (const SharedSample<InputType> &sample) override;
 
+      private:
         /**
          * A reference to the stream to which output will be written for each
          * sample.
@@ -181,11 +187,24 @@ namespace SampleFlow
     StreamOutput<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       internal::StreamOutput::write (sample, output_stream);
       output_stream << '\n';
     }
+
+
+
+    template <typename InputType>
+    void
+    StreamOutput<InputType>::
+    consume_shared (const SharedSample<InputType> &sample)
+    {
+      std::lock_guard<Mutex> lock(this->mutex);
+
+      internal::StreamOutput::write (sample->first, output_stream);
+      output_stream << '\n';
+    }
   }
 }
 
@@ -111,6 +111,32 @@ namespace SampleFlow
       consume (InputType sample,
                AuxiliaryData aux_data) override final;
 
+      /**
+       * An implementation of the Consumer::consume_batch() function. In the
+       * current context, what this function does is to call the
+       * filter_batch() function with the block of samples, and then send
+       * the samples that function returns (if any) as one block to all
+       * consumers connected to this filter.
+       *
+       * @param[in] samples The samples, along with their auxiliary data.
+       */
+      virtual
+      void
+      consume_batch (const SampleBatch<InputType> &samples) override final;
+
+      /**
+       * An implementation of the Consumer::consume_shared() function. In the
+       * current context, what this function does is to call the
+       * filter_shared() function with the sample, and then send the
+       * SharedSample object that function returns (if any) to all consumers
+       * connected to this filter.
+       *
+       * @param[in] sample The sample, along with its auxiliary data.
+       */
+      virtual
+      void
+      consume_shared (const SharedSample<InputType> &sample) override final;
+
       /**
        * Ensure that all samples currently being worked on by this object
        * are finished up. In a parallel context, there may still be new samples
@@ -161,6 +187,43 @@ namespace SampleFlow
       boost::optional<std::pair<OutputType, AuxiliaryData> >
       filter (InputType sample,
               AuxiliaryData aux_data) = 0;
+
+      /**
+       * Process a whole block of samples. The default implementation calls
+       * filter() for each sample of the block, and collects all of the
+       * samples it returns. Derived classes can override this function
+       * if they can process a block more efficiently than one sample at
+       * a time.
+       *
+       * @param[in] samples The samples, along with their auxiliary data.
+       *
+       * @return The samples (along with their auxiliary data) that are
+       *   to be sent to all consumers connected to this filter, in the
+       *   order in which they are to be sent. The returned object may be
+       *   empty, or contain fewer (or more) samples than the input block.
+       */
+      virtual
+      SampleBatch<OutputType>
+      filter_batch (const SampleBatch<InputType> &samples);
+
+      /**
+       * Process a sample that an upstream producer has sent as a
+       * SharedSample object. The default implementation calls filter() with
+       * a copy of the sample and stores what that function returns (if
+       * anything) in a new SharedSample object. Filters that pass on
+       * some samples unchanged and swallow others (i.e., ones that *select*
+       * rather than *transform* samples) should override this function and
+       * simply return the object they were given for those samples they
+       * pass on, thereby avoiding the copy.
+       *
+       * @param[in] sample The sample, along with its auxiliary data.
+       *
+       * @return The sample to be sent to all consumers connected to this
+       *   filter, or a `nullptr` if the sample is swallowed.
+       */
+      virtual
+      SharedSample<OutputType>
+      filter_shared (const SharedSample<InputType> &sample);
   };
 
 
@@ -189,8 +252,71 @@ namespace SampleFlow
     // Then see whether the derived class actually produced anything,
     // and if so, send it downstream.
     if (maybe_sample)
-      this->issue_sample (std::move (maybe_sample->first),
-                          std::move (maybe_sample->second));
+      this->send_sample (std::move (maybe_sample->first),
+                         std::move (maybe_sample->second));
+  }
+
+
+
+  template <typename InputType, typename OutputType>
+  void
+  Filter<InputType,OutputType>::
+  consume_batch (const SampleBatch<InputType> &samples)
+  {
+    const SampleBatch<OutputType> output_samples = filter_batch (samples);
+
+    // Only bother downstream consumers if there is anything to send:
+    if (output_samples.size() > 0)
+      this->issue_sample_batch (output_samples);
+  }
+
+
+
+  template <typename InputType, typename OutputType>
+  SampleBatch<OutputType>
+  Filter<InputType,OutputType>::
+  filter_batch (const SampleBatch<InputType> &samples)
+  {
+    SampleBatch<OutputType> output_samples;
+    for (const auto &sample : samples)
+      {
+        boost::optional<std::pair<OutputType, AuxiliaryData> >
+        maybe_sample = filter (sample.first, sample.second);
+
+        if (maybe_sample)
+          output_samples.emplace_back (std::move (*maybe_sample));
+      }
+
+    return output_samples;
+  }
+
+
+
+  template <typename InputType, typename OutputType>
+  void
+  Filter<InputType,OutputType>::
+  consume_shared (const SharedSample<InputType> &sample)
+  {
+    const SharedSample<OutputType> output_sample = filter_shared (sample);
+
+    if (output_sample)
+      this->issue_shared_sample (output_sample);
+  }
+
+
+
+  template <typename InputType, typename OutputType>
+  SharedSample<OutputType>
+  Filter<InputType,OutputType>::
+  filter_shared (const SharedSample<InputType> &sample)
+  {
+    boost::optional<std::pair<OutputType, AuxiliaryData> >
+    maybe_sample = filter (sample->first, sample->second);
+
+    if (maybe_sample)
+      return std::make_shared<std::pair<OutputType, AuxiliaryData>> (std::move (*maybe_sample));
+    else
+      return nullptr;
   }
 
 
@@ -201,11 +327,19 @@ namespace SampleFlow
   flush()
   {
     // First flush all of the samples that are currently still queued
-    // up by the current Filter object
-    Consumer<InputType>::flush();
-
-    // Then also trigger a flush operation on all downstream Consumer
-    // objects connected to this Filter
+    // up by the current Filter object. Then also trigger a flush operation
+    // on all downstream Consumer objects connected to this Filter -- also
+    // if processing one of our own samples threw an exception that
+    // Consumer::flush() now passes on.
+    try
+      {
+        Consumer<InputType>::flush();
+      }
+    catch (...)
+      {
+        this->flush_consumers();
+        throw;
+      }
     this->flush_consumers();
   }
 
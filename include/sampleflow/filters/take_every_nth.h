@@ -90,13 +90,23 @@ namespace SampleFlow
         filter (InputType sample,
                 AuxiliaryData aux_data) override;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Process one sample that an upstream producer has sent as a
+         * SharedSample object. This does the same as filter(), but
+         * passes on the given object itself rather than a copy of the
+         * sample.
+         *
+         * @param[in] sample The sample to process, along with its
+         *   auxiliary data.
+         *
+         * @return The object given as argument if filter() would have
+         *   passed on the sample, and a `nullptr` otherwise.
          */
-        std::mutex mutex;
+        virtual
+        SharedSample<InputType>
+        filter_shared (const SharedSample<InputType> &sample) override;
 
+      private:
         /**
          * A counter counting how many samples we have seen so far.
          */
@@ -135,7 +145,7 @@ namespace SampleFlow
     filter (InputType sample,
             AuxiliaryData aux_data)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Mutex> lock(this->mutex);
 
       ++counter;
       if (counter % every_nth == 0)
@@ -149,6 +159,25 @@ namespace SampleFlow
           {};
     }
 
+
+
+    template <typename InputType>
+    SharedSample<InputType>
+    TakeEveryNth<InputType>::
+    filter_shared (const SharedSample<InputType> &sample)
+    {
+      std::lock_guard<Mutex> lock(this->mutex);
+
+      ++counter;
+      if (counter % every_nth == 0)
+        {
+          counter = 0;
+          return sample;
+        }
+      else
+        return nullptr;
+    }
+
   }
 }
 
@@ -0,0 +1,339 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_LOG_LIKELIHOOD_CACHE_H
+#define SAMPLEFLOW_LOG_LIKELIHOOD_CACHE_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+
+namespace SampleFlow
+{
+  /**
+   * A class that wraps a function that computes the log likelihood
+   * $\log\pi(x)$ of a sample $x$, and that remembers the values it has
+   * computed for the most recently used samples. If the log likelihood of
+   * one of these samples is requested again, then the stored value is
+   * returned instead of calling the wrapped function again.
+   *
+   * This is useful if evaluating the log likelihood is expensive, and if
+   * the sampler visits the same samples repeatedly. This is typically the
+   * case for discrete sample spaces such as the dice in the first example
+   * of the MetropolisHastings class, or for samples that live on a lattice.
+   *
+   * Objects of this class can be used in place of the `log_likelihood`
+   * argument of all producers that take a function of the form
+   * `double (const OutputType &)`. The producers take these arguments as
+   * `std::function` objects, which need to be able to copy the function
+   * object they store. Since the cache contains a mutex, it can not be
+   * copied, and so one needs to wrap the cache into `std::ref` (which
+   * also makes sure that the producer uses and updates the cache object
+   * one has created):
+   * @code
+   *   LogLikelihoodCache<unsigned int> cache (&log_likelihood, 1000);
+   *
+   *   Producers::MetropolisHastings<unsigned int> mh_sampler;
+   *   mh_sampler.sample (1, std::ref(cache), &perturb, n_samples);
+   *
+   *   std::cout << "Cache hit rate: " << cache.hit_rate() << std::endl;
+   * @endcode
+   * The same cache can be used for several calls to `sample()`, and for
+   * several producers, as long as they all sample the same distribution.
+   *
+   *
+   * ### Keys ###
+   *
+   * The cache finds the stored value for a sample by looking up a "key"
+   * in a hash table. In the simplest case, the sample itself is the key
+   * (i.e., `KeyType` equals `InputType`), and the template arguments `Hash`
+   * and `KeyEqual` describe how to compute a hash value for, and how to
+   * compare, samples. For other sample types -- for example,
+   * `std::valarray<double>`, for which `operator==` does not return a
+   * `bool` and for which there is no `std::hash` specialization -- one
+   * can provide a function that converts a sample into a key of a
+   * different type. This function can also "quantize" the sample, for
+   * example to map all samples within a small neighborhood of a lattice
+   * point to the same key. It is the responsibility of the user to
+   * ensure that samples with the same key have the same log likelihood
+   * (or at least that the error made by pretending that this is so is
+   * acceptable).
+   *
+   *
+   * ### Capacity ###
+   *
+   * The cache stores at most the number of values passed to the
+   * constructor. If it is full, then storing a new value evicts the
+   * least recently used one.
+   *
+   *
+   * ### Threading model ###
+   *
+   * The cache can be called concurrently from several threads (for
+   * example by the MultipleTryMetropolisHastings and
+   * PrefetchingMetropolisHastings producers), provided the wrapped
+   * function can. Lookups in the cache are serialized, but the wrapped
+   * function is called without holding a lock. As a consequence, if two
+   * threads ask for the log likelihood of the same sample at the same
+   * time, then the wrapped function may be called for it twice.
+   *
+   * @tparam InputType The type of the samples whose log likelihood is to
+   *   be computed.
+   * @tparam KeyType The type of the keys used to look up stored values.
+   * @tparam Hash A function object type that computes a hash value for
+   *   keys, as for `std::unordered_map`.
+   * @tparam KeyEqual A function object type that compares two keys for
+   *   equality, as for `std::unordered_map`.
+   */
+  template <typename InputType,
+            typename KeyType = InputType,
+            typename Hash = std::hash<KeyType>,
+            typename KeyEqual = std::equal_to<KeyType>>
+  class LogLikelihoodCache
+  {
+    public:
+      /**
+       * Constructor.
+       *
+       * @param[in] log_likelihood The function whose values are to be
+       *   cached.
+       * @param[in] capacity The maximal number of values stored.
+       * @param[in] key A function that computes the key of a sample. The
+       *   default only makes sense if `KeyType` equals `InputType`, in
+       *   which case it returns the sample itself.
+       * @param[in] hash The object used to compute hash values of keys.
+       * @param[in] key_equal The object used to compare keys.
+       */
+      LogLikelihoodCache (const std::function<double (const InputType &)> &log_likelihood,
+                          const std::size_t capacity,
+                          const std::function<KeyType (const InputType &)> &key
+                          = [](const InputType &x)
+      {
+        return x;
+      },
+      const Hash &hash = Hash(),
+      const KeyEqual &key_equal = KeyEqual());
+
+      /**
+       * Return the log likelihood of the given sample, either from the
+       * cache or by calling the wrapped function.
+       */
+      double
+      operator() (const InputType &x);
+
+      /**
+       * Return the number of calls to operator() that have been answered
+       * from the cache.
+       */
+      std::size_t
+      n_hits () const;
+
+      /**
+       * Return the number of calls to operator() that required calling
+       * the wrapped function.
+       */
+      std::size_t
+      n_misses () const;
+
+      /**
+       * Return the fraction of calls to operator() that have been answered
+       * from the cache, or zero if there have not been any calls yet.
+       */
+      double
+      hit_rate () const;
+
+      /**
+       * Return the number of values currently stored.
+       */
+      std::size_t
+      size () const;
+
+      /**
+       * Remove all stored values and reset the statistics.
+       */
+      void
+      clear ();
+
+    private:
+      /**
+       * The function whose values are cached, and the function that
+       * computes keys.
+       */
+      const std::function<double (const InputType &)> log_likelihood;
+      const std::function<KeyType (const InputType &)> key;
+
+      /**
+       * The maximal number of values stored.
+       */
+      const std::size_t capacity;
+
+      /**
+       * A mutex that guards all of the following member variables.
+       */
+      mutable std::mutex mutex;
+
+      /**
+       * The stored keys and values, ordered from the most recently used
+       * to the least recently used.
+       */
+      std::list<std::pair<KeyType,double>> entries;
+
+      /**
+       * A map from keys to their position in the `entries` list.
+       */
+      std::unordered_map<KeyType,
+          typename std::list<std::pair<KeyType,double>>::iterator,
+          Hash, KeyEqual> index;
+
+      /**
+       * Statistics about how calls to operator() have been answered.
+       */
+      std::size_t hits;
+      std::size_t misses;
+  };
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  LogLikelihoodCache (const std::function<double (const InputType &)> &log_likelihood,
+                      const std::size_t capacity,
+                      const std::function<KeyType (const InputType &)> &key,
+                      const Hash &hash,
+                      const KeyEqual &key_equal)
+    :
+    log_likelihood (log_likelihood),
+    key (key),
+    capacity (capacity),
+    index (0, hash, key_equal),
+    hits (0),
+    misses (0)
+  {
+    assert (capacity > 0);
+  }
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  double
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  operator() (const InputType &x)
+  {
+    KeyType k = key(x);
+
+    // First see whether we have the value already. If so, move it to
+    // the front of the list of recently used entries and return it.
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+
+      const auto p = index.find (k);
+      if (p != index.end())
+        {
+          entries.splice (entries.begin(), entries, p->second);
+          ++hits;
+          return p->second->second;
+        }
+      else
+        ++misses;
+    }
+
+    // If not, compute it without holding the lock, so that other threads
+    // can use the cache in the meantime.
+    const double value = log_likelihood (x);
+
+    // Then store it, unless another thread has done so while we
+    // computed it. Evict the least recently used entry if necessary.
+    std::lock_guard<std::mutex> lock (mutex);
+    if (index.find (k) == index.end())
+      {
+        if (entries.size() == capacity)
+          {
+            index.erase (entries.back().first);
+            entries.pop_back ();
+          }
+        entries.emplace_front (std::move(k), value);
+        index.emplace (entries.front().first, entries.begin());
+      }
+
+    return value;
+  }
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  std::size_t
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  n_hits () const
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    return hits;
+  }
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  std::size_t
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  n_misses () const
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    return misses;
+  }
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  double
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  hit_rate () const
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    return (hits + misses > 0 ?
+            1. * hits / (hits + misses) :
+            0.);
+  }
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  std::size_t
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  size () const
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    return entries.size();
+  }
+
+
+
+  template <typename InputType, typename KeyType, typename Hash, typename KeyEqual>
+  void
+  LogLikelihoodCache<InputType,KeyType,Hash,KeyEqual>::
+  clear ()
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    entries.clear ();
+    index.clear ();
+    hits   = 0;
+    misses = 0;
+  }
+}
+
+#endif
@@ -0,0 +1,256 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_MUTEX_H
+#define SAMPLEFLOW_MUTEX_H
+
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <thread>
+
+
+namespace SampleFlow
+{
+  /**
+   * An enumeration that designates how a Mutex object (and consequently
+   * a Consumer or Filter object) protects its state against concurrent
+   * access. This is set through the Consumer::set_locking_policy()
+   * function.
+   */
+  enum class LockingPolicy : int
+  {
+    /**
+     * Use a `std::mutex`. This is the default. Threads that cannot
+     * obtain the lock are put to sleep by the operating system until the
+     * lock becomes available.
+     */
+    mutex = 1,
+
+    /**
+     * Use a spinlock, i.e., a flag that is atomically set when the lock
+     * is obtained and cleared when it is released. Obtaining and
+     * releasing an uncontended spinlock is cheaper than for a
+     * `std::mutex`, but threads that cannot obtain the lock do not sleep
+     * and instead keep trying (yielding to other threads in between).
+     * This is a good choice if the lock is only held for very short
+     * times, as is the case for most consumers, and if there are not
+     * many more threads than processor cores.
+     */
+    spinlock = 2,
+
+    /**
+     * Do not lock at all. This is only safe if it is known that the
+     * object is never accessed from more than one thread at the same
+     * time -- for example, because all of the producers and filters
+     * upstream of a consumer run on the same thread and all filters and
+     * consumers involved use ParallelMode::synchronous. In that case,
+     * this policy removes the cost of locking altogether.
+     */
+    none = 3
+  };
+
+
+
+  /**
+   * A class that can be used like a `std::mutex` (i.e., it satisfies the
+   * requirements of the C++ concept "Lockable" and can consequently be
+   * used with `std::lock_guard` and `std::unique_lock`), but whose
+   * mechanism for locking can be selected at run time via the
+   * LockingPolicy `enum`. Consumer and Filter classes use objects of
+   * this type to protect their state.
+   *
+   *
+   * ### Threading model ###
+   *
+   * The lock(), try_lock(), and unlock() functions can of course be
+   * called from multiple threads concurrently. On the other hand,
+   * set_locking_policy() may only be called while no other thread is
+   * using the object, and in particular not while the object is locked.
+   */
+  class Mutex
+  {
+    public:
+      /**
+       * Constructor. Create an object that uses LockingPolicy::mutex.
+       */
+      Mutex ();
+
+      /**
+       * Copying a mutex does not make sense, so disallow it.
+       */
+      Mutex (const Mutex &) = delete;
+
+      /**
+       * Copying a mutex does not make sense, so disallow it.
+       */
+      Mutex &operator= (const Mutex &) = delete;
+
+      /**
+       * Select the mechanism used for locking.
+       */
+      void
+      set_locking_policy (const LockingPolicy locking_policy);
+
+      /**
+       * Return the mechanism used for locking.
+       */
+      LockingPolicy
+      get_locking_policy () const;
+
+      /**
+       * Obtain the lock, waiting for it to become available if necessary.
+       */
+      void
+      lock ();
+
+      /**
+       * Try to obtain the lock without waiting.
+       *
+       * @return Whether the lock was obtained.
+       */
+      bool
+      try_lock ();
+
+      /**
+       * Release the lock.
+       */
+      void
+      unlock ();
+
+    private:
+      /**
+       * The mechanism used for locking. This variable is only written to
+       * while no other thread uses the object, but it is read every time
+       * the object is locked; reading it atomically (with relaxed memory
+       * ordering, which is no more expensive than reading a plain
+       * variable) avoids a formal data race.
+       */
+      std::atomic<int> locking_policy;
+
+      /**
+       * The mutex used for LockingPolicy::mutex.
+       */
+      std::mutex mutex;
+
+      /**
+       * The flag used for LockingPolicy::spinlock.
+       */
+      std::atomic_flag spinlock_flag;
+  };
+
+
+
+  inline
+  Mutex::Mutex ()
+    :
+    locking_policy (static_cast<int>(LockingPolicy::mutex))
+  {
+    spinlock_flag.clear();
+  }
+
+
+
+  inline
+  void
+  Mutex::set_locking_policy (const LockingPolicy locking_policy)
+  {
+    this->locking_policy.store (static_cast<int>(locking_policy),
+                                std::memory_order_relaxed);
+  }
+
+
+
+  inline
+  LockingPolicy
+  Mutex::get_locking_policy () const
+  {
+    return static_cast<LockingPolicy>(locking_policy.load (std::memory_order_relaxed));
+  }
+
+
+
+  inline
+  void
+  Mutex::lock ()
+  {
+    switch (get_locking_policy())
+      {
+        case LockingPolicy::mutex:
+          mutex.lock();
+          break;
+
+        case LockingPolicy::spinlock:
+          while (spinlock_flag.test_and_set (std::memory_order_acquire))
+            std::this_thread::yield();
+          break;
+
+        case LockingPolicy::none:
+          break;
+
+        default:
+          assert (false);
+      }
+  }
+
+
+
+  inline
+  bool
+  Mutex::try_lock ()
+  {
+    switch (get_locking_policy())
+      {
+        case LockingPolicy::mutex:
+          return mutex.try_lock();
+
+        case LockingPolicy::spinlock:
+          return !spinlock_flag.test_and_set (std::memory_order_acquire);
+
+        case LockingPolicy::none:
+          return true;
+
+        default:
+          assert (false);
+          return false;
+      }
+  }
+
+
+
+  inline
+  void
+  Mutex::unlock ()
+  {
+    switch (get_locking_policy())
+      {
+        case LockingPolicy::mutex:
+          mutex.unlock();
+          break;
+
+        case LockingPolicy::spinlock:
+          spinlock_flag.clear (std::memory_order_release);
+          break;
+
+        case LockingPolicy::none:
+          break;
+
+        default:
+          assert (false);
+      }
+  }
+}
+
+#endif
@@ -50,13 +50,16 @@ namespace SampleFlow
     synchronous = 1,
 
     /**
-     * Process the sample asynchronously by creating a new task that the
-     * operating system can work on whenever it has available resources.
+     * Process the sample asynchronously by creating a new task that one
+     * of the threads of a ThreadPool can work on whenever it has available
+     * resources.
      * To make this possible, a Consumer or Filter object that uses this
-     * mode copies the sample, and then creates a std::task object that
+     * mode copies the sample, and then creates a task object that
      * encapsulates what needs to be done (namely, processing the sample
      * and, if this consumer is in fact a filter, sending the processed
-     * sample downstream to other consumers).
+     * sample downstream to other consumers). Which pool the task is
+     * submitted to can be selected using Consumer::set_thread_pool(); by
+     * default, it is the pool returned by ThreadPool::default_pool().
      *
      * Control flow then immediately returns to the place where the current
      * sample was sent from, with one caveat: when specifying
@@ -71,7 +74,10 @@ namespace SampleFlow
      * samples, we don't end up with an indefinite backlog of samples.
      *
      * The limit of currently pending tasks (the "queue size") can be
-     * set through an argument to Consumer::set_parallel_mode().
+     * set through an argument to Consumer::set_parallel_mode(). Whether
+     * the current thread really blocks when the limit is reached, or
+     * whether instead a sample is dropped, is determined by the
+     * QueueOverflowPolicy that can also be passed to that function.
      *
      * @note When a filter or consumer object uses this parallel mode,
      *   then it can be thought of copying every incoming sample into
@@ -102,6 +108,44 @@ namespace SampleFlow
      */
     asynchronous = 2
   };
+
+
+
+  /**
+   * An enumeration that designates what a Consumer (or Filter) object
+   * running in ParallelMode::asynchronous should do with a newly incoming
+   * sample if the maximal number of samples whose processing has been
+   * deferred, but not yet finished, has been reached. This is set through
+   * the Consumer::set_parallel_mode() function.
+   */
+  enum class QueueOverflowPolicy : int
+  {
+    /**
+     * Block the thread on which the sample was sent (typically the thread
+     * running the Producer) until processing of one of the previous
+     * samples has finished. This throttles the producer to the rate at
+     * which the consumer can process samples, and no sample is lost.
+     */
+    block = 1,
+
+    /**
+     * Discard the oldest sample that has been queued for processing but
+     * whose processing has not yet started, and queue the new sample in
+     * its place. This is useful for consumers that only need to see
+     * a recent subset of samples (for example, to monitor the progress
+     * of a sampler), and for which the producer should never be
+     * slowed down. If all queued samples are already being
+     * processed, there is nothing that could be discarded, and the
+     * current thread blocks as for QueueOverflowPolicy::block.
+     */
+    drop_oldest = 2,
+
+    /**
+     * Discard the newly incoming sample. The producer is never slowed
+     * down, but the consumer will only see a subset of samples.
+     */
+    drop_newest = 3
+  };
 }
 
 #endif
@@ -0,0 +1,783 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PIPELINE_H
+#define SAMPLEFLOW_PIPELINE_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/consumer.h>
+#include <sampleflow/filter.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/types.h>
+
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace SampleFlow
+{
+  namespace internal
+  {
+    /**
+     * Functions that are only declared, and whose only purpose is to
+     * allow determining the template arguments of the Consumer or Filter
+     * base class of a given type via `decltype`.
+     */
+    template <typename InputType>
+    InputType consumer_input_type (const Consumer<InputType> *);
+
+    template <typename InputType>
+    std::true_type is_consumer_helper (const Consumer<InputType> *);
+
+    std::false_type is_consumer_helper (...);
+
+    template <typename InputType, typename OutputType>
+    std::true_type is_filter_helper (const Filter<InputType,OutputType> *);
+
+    std::false_type is_filter_helper (...);
+
+    template <typename InputType, typename OutputType>
+    OutputType filter_output_type (const Filter<InputType,OutputType> *);
+
+
+    /**
+     * A type trait that indicates whether `T` is derived from some
+     * Consumer class.
+     */
+    template <typename T>
+    struct IsConsumer
+      : decltype(is_consumer_helper (std::declval<T *>()))
+    {};
+
+
+    /**
+     * A type trait that indicates whether `T` is derived from some
+     * Filter class.
+     */
+    template <typename T>
+    struct IsFilter
+      : decltype(is_filter_helper (std::declval<T *>()))
+    {};
+
+
+    /**
+     * The types of samples a Filter class `FilterType` takes and returns.
+     */
+    template <typename FilterType>
+    using FilterInputType = decltype(consumer_input_type (std::declval<FilterType *>()));
+
+    template <typename FilterType>
+    using FilterOutputType = decltype(filter_output_type (std::declval<FilterType *>()));
+
+
+
+    /**
+     * The end of a static pipeline that hands every sample to one
+     * consumer. The consumer's consume() function is called with a
+     * qualified name, i.e., without going through the virtual function
+     * table, so that the compiler can inline it.
+     */
+    template <typename ConsumerType>
+    class ConsumerSink
+    {
+      public:
+        explicit
+        ConsumerSink (ConsumerType &consumer)
+          :
+          consumer (&consumer)
+        {}
+
+        template <typename SampleType>
+        void
+        process (SampleType sample,
+                 AuxiliaryData aux_data)
+        {
+          consumer->ConsumerType::consume (std::move(sample), std::move(aux_data));
+        }
+
+        void
+        flush ()
+        {
+          consumer->flush ();
+        }
+
+      private:
+        ConsumerType *consumer;
+    };
+
+
+
+    /**
+     * One step of a static pipeline: A filter whose filter() function is
+     * called with every sample, followed by the rest of the pipeline
+     * (further filters, and finally a sink) to which every sample is
+     * handed that the filter returns. As for ConsumerSink, the filter's
+     * filter() function is called without going through the virtual
+     * function table.
+     *
+     * The specialization of this class for an empty list of filters
+     * represents the end of the pipeline and simply hands samples to
+     * the sink.
+     */
+    template <typename SinkType, typename... FilterTypes>
+    class StaticChain;
+
+
+    template <typename SinkType>
+    class StaticChain<SinkType>
+    {
+      public:
+        template <std::size_t index, typename StageTuple>
+        StaticChain (std::integral_constant<std::size_t,index>,
+                     const StageTuple &,
+                     const SinkType &sink)
+          :
+          sink (sink)
+        {}
+
+        template <typename SampleType>
+        void
+        process (SampleType sample,
+                 AuxiliaryData aux_data)
+        {
+          sink.process (std::move(sample), std::move(aux_data));
+        }
+
+        void
+        flush ()
+        {
+          sink.flush ();
+        }
+
+      private:
+        SinkType sink;
+    };
+
+
+    template <typename SinkType, typename FilterType, typename... FilterTypes>
+    class StaticChain<SinkType, FilterType, FilterTypes...>
+    {
+      public:
+        /**
+         * Constructor. Take the filter with the given index out of the
+         * tuple of filters that make up the pipeline, and build the rest
+         * of the pipeline from the following ones.
+         */
+        template <std::size_t index, typename StageTuple>
+        StaticChain (std::integral_constant<std::size_t,index>,
+                     const StageTuple &stages,
+                     const SinkType &sink)
+          :
+          filter (std::get<index>(stages)),
+          rest (std::integral_constant<std::size_t,index+1>(), stages, sink)
+        {}
+
+        void
+        process (FilterInputType<FilterType> sample,
+                 AuxiliaryData aux_data)
+        {
+          auto maybe_sample = filter->FilterType::filter (std::move(sample),
+                                                          std::move(aux_data));
+          if (maybe_sample)
+            rest.process (std::move(maybe_sample->first),
+                          std::move(maybe_sample->second));
+        }
+
+        void
+        flush ()
+        {
+          rest.flush ();
+        }
+
+      private:
+        std::shared_ptr<FilterType>              filter;
+        StaticChain<SinkType, FilterTypes...>    rest;
+    };
+
+
+
+    /**
+     * An object that describes a filter that is to be created once it is
+     * known which type of samples it will be given. This is what functions
+     * such as discard_first_n() return: At the time they are called, the
+     * type of samples is not yet known, but it is when the object is
+     * appended to a pipeline via `operator|`.
+     */
+    template <template <typename> class FilterTemplate, typename ArgumentType>
+    struct FilterStageFactory
+    {
+      ArgumentType argument;
+    };
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  class Tee;
+
+  template <typename ProducerOutputType, typename ChainType>
+  class Pipeline;
+
+
+
+  /**
+   * An object that describes the first part of a static pipeline: A
+   * producer, followed by zero or more filters. Objects of this type are
+   * created by the pipeline() function and by appending filters to such
+   * an object using `operator|`. Once a consumer (or several consumers,
+   * via tee()) is appended, the result is a Pipeline object that is
+   * connected to the producer.
+   *
+   * @tparam ProducerOutputType The type of samples the producer creates.
+   * @tparam CurrentType The type of samples at the current end of the
+   *   pipeline, i.e., the type of samples the last filter returns, or
+   *   `ProducerOutputType` if there are no filters yet.
+   * @tparam FilterTypes The types of the filters in the pipeline.
+   */
+  template <typename ProducerOutputType, typename CurrentType, typename... FilterTypes>
+  class PipelineBuilder
+  {
+    public:
+      /**
+       * Constructor.
+       */
+      PipelineBuilder (Producer<ProducerOutputType> &producer,
+                       const std::tuple<std::shared_ptr<FilterTypes>...> &stages)
+        :
+        producer (&producer),
+        stages (stages)
+      {}
+
+      /**
+       * The producer at the head of the pipeline.
+       */
+      Producer<ProducerOutputType> *producer;
+
+      /**
+       * The filters in the pipeline, in the order in which samples
+       * pass through them.
+       */
+      std::tuple<std::shared_ptr<FilterTypes>...> stages;
+  };
+
+
+
+  /**
+   * A *static pipeline* connects a producer, a sequence of filters, and
+   * one or more consumers in such a way that every sample the producer
+   * creates is passed through the filters and to the consumers by a chain
+   * of calls that are all known at compile time. This is in contrast to
+   * connecting each of these objects to its upstream object via
+   * Consumer::connect_to_producer(), in which case every step from one
+   * object to the next goes through a Producer's signal, the
+   * `std::function` objects connected to it, and then the virtual
+   * Consumer::consume() or Filter::filter() functions. For cheap filters
+   * and consumers, these indirections can cost more than the actual work.
+   * A static pipeline instead calls the `filter()` and `consume()`
+   * functions of the objects it is composed of with their qualified
+   * names, which allows the compiler to inline the entire chain into one
+   * function. Only the connection between the producer and this
+   * function still goes through the producer's signal; this last
+   * indirection is cheapest if the producer uses
+   * DispatchBackend::flat_list (see Producer::set_dispatch_backend()).
+   *
+   * Objects of this class are created by starting from a producer, and
+   * appending filters and, finally, consumers using `operator|`:
+   * @code
+   *   SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+   *   SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+   *   SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+   *
+   *   const auto pipeline = SampleFlow::pipeline (mh_sampler)
+   *                         | SampleFlow::discard_first_n (1000)
+   *                         | SampleFlow::take_every_nth (10)
+   *                         | SampleFlow::tee (mean_value, covariance_matrix);
+   *
+   *   mh_sampler.sample (...);
+   * @endcode
+   * Filters can be appended either in the form of the objects returned
+   * by functions such as discard_first_n() or take_every_nth(), in which
+   * case the pipeline creates and owns the filter objects, or as
+   * references to existing filter objects. The consumers at the end of
+   * the pipeline are always references to existing objects, and these
+   * objects (as well as the producer and any filter objects the
+   * pipeline does not own) need to live at least as long as the pipeline
+   * is connected to the producer. The connection is severed when the
+   * Pipeline object is destroyed, or when disconnect() is called.
+   *
+   * The filters and consumers that are part of a static pipeline are not
+   * otherwise connected to anything: The filters only pass samples on to
+   * the next element of the pipeline, not to any consumers that may have
+   * been connected to them, and the consumers receive samples from the
+   * pipeline regardless of whether they are connected to other producers.
+   * If a filter or consumer should *also* receive samples from elsewhere,
+   * it can of course be connected to other producers as usual.
+   *
+   *
+   * ### Threading model ###
+   *
+   * All filters and consumers of a static pipeline are executed
+   * synchronously, on the thread on which the producer sends the
+   * sample, regardless of the parallel mode these objects are set to.
+   * Because filters and consumers are written in such a way that their
+   * filter() and consume() functions can be called concurrently, a
+   * producer may still send samples to a pipeline from several threads
+   * at once.
+   *
+   *
+   * @tparam ProducerOutputType The type of samples the producer creates.
+   * @tparam ChainType A type that describes the filters and consumers
+   *   the pipeline is composed of. This is an internal implementation
+   *   detail; use `auto` for Pipeline objects.
+   */
+  template <typename ProducerOutputType, typename ChainType>
+  class Pipeline
+  {
+    public:
+      /**
+       * Constructor. Create the chain of filters and consumers and
+       * connect it to the given producer.
+       */
+      Pipeline (Producer<ProducerOutputType> &producer,
+                const std::shared_ptr<ChainType> &chain);
+
+      /**
+       * Move constructor.
+       */
+      Pipeline (Pipeline &&other) = default;
+
+      /**
+       * Copying a pipeline does not make sense, so disallow it.
+       */
+      Pipeline (const Pipeline &) = delete;
+
+      /**
+       * Copying a pipeline does not make sense, so disallow it.
+       */
+      Pipeline &operator= (const Pipeline &) = delete;
+
+      /**
+       * Destructor. Disconnect from the producer.
+       */
+      ~Pipeline ();
+
+      /**
+       * Sever the connection to the producer. After this function has
+       * been called, the producer's samples are no longer sent to the
+       * filters and consumers of this pipeline.
+       */
+      void
+      disconnect ();
+
+    private:
+      /**
+       * The filters and consumers the pipeline is composed of. The
+       * functions connected to the producer also hold a copy of this
+       * pointer, and so the chain stays at the same place in memory
+       * even if the Pipeline object is moved.
+       */
+      std::shared_ptr<ChainType> chain;
+
+      /**
+       * The connections to the producer's signals.
+       */
+      std::tuple<Connection,Connection,Connection,Connection> connections;
+  };
+
+
+
+  template <typename ProducerOutputType, typename ChainType>
+  Pipeline<ProducerOutputType,ChainType>::
+  Pipeline (Producer<ProducerOutputType> &producer,
+            const std::shared_ptr<ChainType> &chain)
+    :
+    chain (chain)
+  {
+    // Build functions that hand individual samples, blocks of samples,
+    // and shared samples to the chain. These are the only places where
+    // samples go through a std::function object; from here on, all
+    // calls are known at compile time.
+    const std::shared_ptr<ChainType> chain_ptr = chain;
+    connections =
+      producer.connect_to_signals (
+        [chain_ptr](ProducerOutputType sample, AuxiliaryData aux_data)
+    {
+      chain_ptr->process (std::move(sample), std::move(aux_data));
+    },
+    [chain_ptr](const SampleBatch<ProducerOutputType> &samples)
+    {
+      for (const auto &sample : samples)
+        chain_ptr->process (sample.first, sample.second);
+    },
+    [chain_ptr](const SharedSample<ProducerOutputType> &sample)
+    {
+      chain_ptr->process (sample->first, sample->second);
+    },
+    [chain_ptr]()
+    {
+      chain_ptr->flush();
+    });
+  }
+
+
+
+  template <typename ProducerOutputType, typename ChainType>
+  Pipeline<ProducerOutputType,ChainType>::
+  ~Pipeline ()
+  {
+    disconnect ();
+  }
+
+
+
+  template <typename ProducerOutputType, typename ChainType>
+  void
+  Pipeline<ProducerOutputType,ChainType>::
+  disconnect ()
+  {
+    // If this object has been moved from, there is nothing to do
+    // (and we must not sever the connections the object has been
+    // moved to).
+    if (chain)
+      {
+        std::get<0>(connections).disconnect();
+        std::get<1>(connections).disconnect();
+        std::get<2>(connections).disconnect();
+        std::get<3>(connections).disconnect();
+
+        chain.reset();
+      }
+  }
+
+
+
+  /**
+   * A class that represents the end of a static pipeline that hands
+   * every sample to several consumers. Objects of this type are created
+   * by the tee() function. Every consumer other than the last one is
+   * given a copy of the sample; the last one gets the sample itself.
+   */
+  template <typename... ConsumerTypes>
+  class Tee
+  {
+    public:
+      /**
+       * Constructor.
+       */
+      explicit
+      Tee (ConsumerTypes &... consumers);
+
+      /**
+       * Hand the given sample to all consumers.
+       */
+      template <typename SampleType>
+      void
+      process (SampleType sample,
+               AuxiliaryData aux_data);
+
+      /**
+       * Call the flush() function of all consumers.
+       */
+      void
+      flush ();
+
+    private:
+      /**
+       * Pointers to the consumers.
+       */
+      std::tuple<ConsumerTypes *...> consumers;
+
+      /**
+       * Hand the sample to the consumer with the given index and all
+       * following ones. The second argument indicates whether the
+       * consumer with the given index is the last one.
+       */
+      template <std::size_t index, typename SampleType>
+      void
+      process (std::integral_constant<std::size_t,index>,
+               std::false_type,
+               SampleType &sample,
+               AuxiliaryData &aux_data);
+
+      template <std::size_t index, typename SampleType>
+      void
+      process (std::integral_constant<std::size_t,index>,
+               std::true_type,
+               SampleType &sample,
+               AuxiliaryData &aux_data);
+
+      /**
+       * Call flush() on the consumer with the given index and all
+       * following ones.
+       */
+      template <std::size_t index>
+      void
+      flush (std::integral_constant<std::size_t,index>);
+
+      void
+      flush (std::integral_constant<std::size_t,sizeof...(ConsumerTypes)>);
+  };
+
+
+
+  template <typename... ConsumerTypes>
+  Tee<ConsumerTypes...>::
+  Tee (ConsumerTypes &... consumers)
+    :
+    consumers (&consumers...)
+  {
+    static_assert (sizeof...(ConsumerTypes) > 0,
+                   "A Tee object needs at least one consumer.");
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  template <typename SampleType>
+  void
+  Tee<ConsumerTypes...>::
+  process (SampleType sample,
+           AuxiliaryData aux_data)
+  {
+    process (std::integral_constant<std::size_t,0>(),
+             std::integral_constant<bool,(sizeof...(ConsumerTypes) == 1)>(),
+             sample, aux_data);
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  template <std::size_t index, typename SampleType>
+  void
+  Tee<ConsumerTypes...>::
+  process (std::integral_constant<std::size_t,index>,
+           std::false_type,
+           SampleType &sample,
+           AuxiliaryData &aux_data)
+  {
+    using ConsumerType
+      = typename std::tuple_element<index, std::tuple<ConsumerTypes...>>::type;
+    std::get<index>(consumers)->ConsumerType::consume (sample, aux_data);
+
+    process (std::integral_constant<std::size_t,index+1>(),
+             std::integral_constant<bool,(index+2 == sizeof...(ConsumerTypes))>(),
+             sample, aux_data);
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  template <std::size_t index, typename SampleType>
+  void
+  Tee<ConsumerTypes...>::
+  process (std::integral_constant<std::size_t,index>,
+           std::true_type,
+           SampleType &sample,
+           AuxiliaryData &aux_data)
+  {
+    using ConsumerType
+      = typename std::tuple_element<index, std::tuple<ConsumerTypes...>>::type;
+    std::get<index>(consumers)->ConsumerType::consume (std::move(sample),
+                                                       std::move(aux_data));
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  void
+  Tee<ConsumerTypes...>::
+  flush ()
+  {
+    flush (std::integral_constant<std::size_t,0>());
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  template <std::size_t index>
+  void
+  Tee<ConsumerTypes...>::
+  flush (std::integral_constant<std::size_t,index>)
+  {
+    std::get<index>(consumers)->flush();
+    flush (std::integral_constant<std::size_t,index+1>());
+  }
+
+
+
+  template <typename... ConsumerTypes>
+  void
+  Tee<ConsumerTypes...>::
+  flush (std::integral_constant<std::size_t,sizeof...(ConsumerTypes)>)
+  {}
+
+
+
+  /**
+   * Start a static pipeline with the given producer. See the Pipeline
+   * class for how the returned object is used.
+   */
+  template <typename ProducerOutputType>
+  PipelineBuilder<ProducerOutputType, ProducerOutputType>
+  pipeline (Producer<ProducerOutputType> &producer)
+  {
+    return {producer, std::tuple<>()};
+  }
+
+
+
+  /**
+   * Return an object that, when appended to a static pipeline, creates
+   * a Filters::DiscardFirstN object with the given argument. See the
+   * Pipeline class for more information.
+   */
+  inline
+  internal::FilterStageFactory<Filters::DiscardFirstN, types::sample_index>
+  discard_first_n (const types::sample_index n)
+  {
+    return {n};
+  }
+
+
+
+  /**
+   * Return an object that, when appended to a static pipeline, creates
+   * a Filters::TakeEveryNth object with the given argument. See the
+   * Pipeline class for more information.
+   */
+  inline
+  internal::FilterStageFactory<Filters::TakeEveryNth, types::sample_index>
+  take_every_nth (const types::sample_index n)
+  {
+    return {n};
+  }
+
+
+
+  /**
+   * Return an object that, when appended to a static pipeline, hands
+   * every sample to all of the given consumers. See the Pipeline class
+   * for more information.
+   */
+  template <typename... ConsumerTypes>
+  Tee<ConsumerTypes...>
+  tee (ConsumerTypes &... consumers)
+  {
+    return Tee<ConsumerTypes...> (consumers...);
+  }
+
+
+
+  /**
+   * Append a filter that is created from the given factory object (as
+   * returned by discard_first_n(), for example) to a static pipeline.
+   */
+  template <typename ProducerOutputType, typename CurrentType, typename... FilterTypes,
+            template <typename> class FilterTemplate, typename ArgumentType>
+  PipelineBuilder<ProducerOutputType,
+                  internal::FilterOutputType<FilterTemplate<CurrentType>>,
+                  FilterTypes..., FilterTemplate<CurrentType>>
+                  operator| (const PipelineBuilder<ProducerOutputType, CurrentType, FilterTypes...> &builder,
+                             const internal::FilterStageFactory<FilterTemplate,ArgumentType> &factory)
+  {
+    return {*builder.producer,
+            std::tuple_cat (builder.stages,
+                            std::make_tuple (std::make_shared<FilterTemplate<CurrentType>> (factory.argument)))
+           };
+  }
+
+
+
+  /**
+   * Append an existing filter object to a static pipeline. The filter
+   * object needs to live at least as long as the resulting pipeline.
+   */
+  template <typename ProducerOutputType, typename CurrentType, typename... FilterTypes,
+            typename FilterType>
+  typename std::enable_if<internal::IsFilter<FilterType>::value,
+           PipelineBuilder<ProducerOutputType,
+           internal::FilterOutputType<FilterType>,
+           FilterTypes..., FilterType>>::type
+           operator| (const PipelineBuilder<ProducerOutputType, CurrentType, FilterTypes...> &builder,
+                      FilterType &filter)
+  {
+    static_assert (std::is_same<internal::FilterInputType<FilterType>,
+                   CurrentType>::value,
+                   "The filter's input type must match the type of samples "
+                   "at the end of the pipeline.");
+
+    // Create a std::shared_ptr object that refers to the filter, but
+    // does not own it.
+    const std::shared_ptr<FilterType> filter_ptr (&filter, [](FilterType *) {});
+    return {*builder.producer,
+            std::tuple_cat (builder.stages, std::make_tuple (filter_ptr))
+           };
+  }
+
+
+
+  /**
+   * Finish a static pipeline by appending a Tee object (as returned by the
+   * tee() function), and connect it to the producer.
+   */
+  template <typename ProducerOutputType, typename CurrentType, typename... FilterTypes,
+            typename... ConsumerTypes>
+  Pipeline<ProducerOutputType,
+           internal::StaticChain<Tee<ConsumerTypes...>, FilterTypes...>>
+           operator| (const PipelineBuilder<ProducerOutputType, CurrentType, FilterTypes...> &builder,
+                      const Tee<ConsumerTypes...> &sink)
+  {
+    using ChainType = internal::StaticChain<Tee<ConsumerTypes...>, FilterTypes...>;
+    return {*builder.producer,
+            std::make_shared<ChainType> (std::integral_constant<std::size_t,0>(),
+                                         builder.stages, sink)
+           };
+  }
+
+
+
+  /**
+   * Finish a static pipeline by appending a single consumer, and connect
+   * it to the producer. The consumer needs to live at least as long as
+   * the resulting pipeline.
+   */
+  template <typename ProducerOutputType, typename CurrentType, typename... FilterTypes,
+            typename ConsumerType>
+  typename std::enable_if<internal::IsConsumer<ConsumerType>::value &&
+           !internal::IsFilter<ConsumerType>::value,
+           Pipeline<ProducerOutputType,
+           internal::StaticChain<internal::ConsumerSink<ConsumerType>, FilterTypes...>>>::type
+           operator| (const PipelineBuilder<ProducerOutputType, CurrentType, FilterTypes...> &builder,
+                      ConsumerType &consumer)
+  {
+    static_assert (std::is_same<decltype(internal::consumer_input_type (&consumer)),
+                   CurrentType>::value,
+                   "The consumer's input type must match the type of samples "
+                   "at the end of the pipeline.");
+
+    using ChainType = internal::StaticChain<internal::ConsumerSink<ConsumerType>, FilterTypes...>;
+    return {*builder.producer,
+            std::make_shared<ChainType> (std::integral_constant<std::size_t,0>(),
+                                         builder.stages,
+                                         internal::ConsumerSink<ConsumerType> (consumer))
+           };
+  }
+}
+
+#endif
@@ -17,12 +17,39 @@
 #define SAMPLEFLOW_PRODUCER_H
 
 #include <sampleflow/auxiliary_data.h>
-#include <boost/signals2.hpp>
+#include <sampleflow/signal.h>
 #include <functional>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 
 namespace SampleFlow
 {
+  /**
+   * A type that describes a contiguous block of samples, along with the
+   * auxiliary data for each of them, that a Producer sends downstream in
+   * one go rather than one sample at a time. See the discussion of
+   * batches in the documentation of the Producer class.
+   */
+  template <typename SampleType>
+  using SampleBatch = std::vector<std::pair<SampleType,AuxiliaryData>>;
+
+
+
+  /**
+   * A type that describes a sample, along with its auxiliary data, that is
+   * stored in a reference-counted, immutable buffer. A Producer can send
+   * such an object to all of its consumers instead of sending each of them
+   * a separate copy of the sample. See the discussion of shared samples in
+   * the documentation of the Producer class.
+   */
+  template <typename SampleType>
+  using SharedSample = std::shared_ptr<const std::pair<SampleType,AuxiliaryData>>;
+
+
+
   /**
    * This is the base class for classes that *produce* samples. Principally,
    * it provides a way for Consumer objects to attach themselves to a signal
@@ -43,6 +70,54 @@ namespace SampleFlow
    * sample (and any auxiliary data that may be available along with the
    * sample) to all consumers that have connected to the sample.
    *
+   *
+   * ### Batches of samples ###
+   *
+   * Sending every sample through a signal individually has a cost that,
+   * for cheap consumers, can easily exceed the cost of processing the
+   * sample itself. Producers can therefore also send a whole block of
+   * samples at once by triggering the `issue_sample_batch` member
+   * variable with a SampleBatch object. Consumers that connect to a
+   * producer via Consumer::connect_to_producer() receive such blocks
+   * through their Consumer::consume_batch() function and can then, for
+   * example, amortize the cost of locking across all samples of the block.
+   * Slots connected via the two-argument version of connect_to_signals()
+   * are simply called once for each sample of a block, so they do not
+   * need to know about batches at all.
+   *
+   *
+   * ### Shared samples ###
+   *
+   * The `issue_sample` signal passes samples by value, and consequently
+   * every connected consumer receives its own copy of the sample and its
+   * auxiliary data. For large samples (say, vectors with thousands of
+   * entries) and several consumers, making these copies may be more
+   * expensive than anything the consumers then do with them. Producers can
+   * therefore be asked, by calling set_sample_sharing(), to instead store
+   * each sample once in a SharedSample object and to send this object to
+   * all consumers via the `issue_shared_sample` signal. Consumers receive
+   * these objects through their Consumer::consume_shared() function, and
+   * those that only need to read the sample can then process it without
+   * ever copying it. Filters that only select samples, but do not change
+   * them (such as Filters::TakeEveryNth), pass the same object on to their
+   * own consumers. Slots connected via the two- or three-argument versions
+   * of connect_to_signals() are simply called with a copy of the sample.
+   *
+   * Derived classes support this by sending individual samples via
+   * the send_sample() function, rather than by triggering `issue_sample`
+   * directly.
+   *
+   *
+   * ### Dispatch mechanisms ###
+   *
+   * The signals of this class are objects of type Signal, which can use
+   * different mechanisms to call the connected functions. By default,
+   * they use `boost::signals2`, but a flat, lock-free list of functions
+   * is often substantially faster if samples are cheap to process and
+   * consumers are only rarely connected and disconnected. The mechanism
+   * can be selected for each producer individually by calling
+   * set_dispatch_backend(); see the DispatchBackend `enum` for details.
+   *
    * @tparam OutputType The C++ type used to describe samples. For example,
    *   if one samples from a continuous, one-dimensional distribution, then
    *   an appropriate type may be `double`. If one samples from the two
@@ -52,6 +127,33 @@ namespace SampleFlow
   class Producer
   {
     public:
+      /**
+       * Constructor. By default, samples are sent to downstream consumers
+       * by value; see set_sample_sharing() for the alternative.
+       */
+      Producer ();
+
+      /**
+       * Select the mechanism by which the signals of this object call the
+       * functions connected to them, see the DispatchBackend `enum`.
+       *
+       * @note This function needs to be called *before* any consumer or
+       *   filter is connected to the current object.
+       */
+      void
+      set_dispatch_backend (const DispatchBackend backend);
+
+      /**
+       * Select whether samples should be sent to downstream consumers as
+       * SharedSample objects, rather than by value. See the discussion of
+       * shared samples in the documentation of this class.
+       *
+       * @note This function needs to be called *before* this producer
+       *   starts producing samples.
+       */
+      void
+      set_sample_sharing (const bool share_samples);
+
       /**
        * Connect the function passed as argument to the signal that is
        * triggered whenever a new sample is produced. All function
@@ -85,8 +187,48 @@ namespace SampleFlow
        *   is triggered, the function previously attached is no longer
        *   called.
        */
-      std::pair<boost::signals2::connection,boost::signals2::connection>
+      std::pair<Connection,Connection>
+      connect_to_signals (const std::function<void (OutputType, AuxiliaryData)> &signal_slot,
+                          const std::function<void ()> &flush_slot);
+
+      /**
+       * Like the previous function, but in addition to a function that is
+       * called for each individual sample, also connect a function that
+       * is called whenever this producer sends a whole block of samples.
+       * If a producer sends a block, then only `batch_slot`, but not
+       * `signal_slot`, is called. If a producer sends a SharedSample
+       * object, then `signal_slot` is called with a copy of the sample.
+       *
+       * @param[in] signal_slot The function to be called whenever an
+       *   individual new sample is produced.
+       * @param[in] batch_slot The function to be called whenever a block
+       *   of new samples is produced.
+       * @param[in] flush_slot The function to be called whenever this
+       *   producer is done producing samples for the moment. See the
+       *   previous function for a description.
+       *
+       * @return The connections made for `signal_slot`, `batch_slot`, and
+       *   `flush_slot`, in this order.
+       */
+      std::tuple<Connection,Connection,Connection>
+      connect_to_signals (const std::function<void (OutputType, AuxiliaryData)> &signal_slot,
+                          const std::function<void (const SampleBatch<OutputType> &)> &batch_slot,
+                          const std::function<void ()> &flush_slot);
+
+      /**
+       * Like the previous function, but also connect a function that is
+       * called whenever this producer sends a sample as a SharedSample
+       * object. In that case, only `shared_slot`, but not `signal_slot`,
+       * is called. This is the function Consumer::connect_to_producer()
+       * uses.
+       *
+       * @return The connections made for `signal_slot`, `batch_slot`,
+       *   `shared_slot`, and `flush_slot`, in this order.
+       */
+      std::tuple<Connection,Connection,Connection,Connection>
       connect_to_signals (const std::function<void (OutputType, AuxiliaryData)> &signal_slot,
+                          const std::function<void (const SampleBatch<OutputType> &)> &batch_slot,
+                          const std::function<void (const SharedSample<OutputType> &)> &shared_slot,
                           const std::function<void ()> &flush_slot);
 
     protected:
@@ -96,7 +238,24 @@ namespace SampleFlow
        * classes should call this signal whenever a new sample has
        * been produced.
        */
-      boost::signals2::signal<void (OutputType, AuxiliaryData)> issue_sample;
+      Signal<OutputType, AuxiliaryData> issue_sample;
+
+      /**
+       * The signal that is used to notify downstream objects of the
+       * availability of a whole block of new samples. Implementations of
+       * derived classes can call this signal, instead of calling
+       * `issue_sample` for each sample individually, if they produce
+       * several samples before any of them needs to be seen downstream.
+       */
+      Signal<const SampleBatch<OutputType> &> issue_sample_batch;
+
+      /**
+       * The signal that is used to send a sample, stored in a SharedSample
+       * object, to all downstream objects at once. Derived classes
+       * typically do not trigger this signal directly, but call
+       * send_sample().
+       */
+      Signal<const SharedSample<OutputType> &> issue_shared_sample;
 
       /**
        * The signal that is used to notify downstream objects of the
@@ -132,7 +291,7 @@ namespace SampleFlow
        *   // Loop over all elements of the given range and issue a sample for
        *   // each of them.
        *   for (auto sample : range)
-       *     this->issue_sample (sample, {});
+       *     this->send_sample (sample, {});
        * }
        * @endcode
        * This code, taken from the Producers::Range class, sets up the
@@ -144,24 +303,153 @@ namespace SampleFlow
        * (which, because it isn't caught here, automatically leads to the
        * current function exiting as well).
        */
-      boost::signals2::signal<void ()> flush_consumers;
+      Signal<> flush_consumers;
+
+      /**
+       * Send one sample downstream. Depending on what was passed to
+       * set_sample_sharing(), this function either triggers the
+       * `issue_sample` signal, or it moves the sample and its auxiliary
+       * data into a SharedSample object and triggers the
+       * `issue_shared_sample` signal with it. In either case, the
+       * arguments are not copied any further by this function.
+       */
+      void
+      send_sample (OutputType    sample,
+                   AuxiliaryData aux_data);
+
+    private:
+      /**
+       * Whether send_sample() should send samples as SharedSample objects.
+       */
+      bool share_samples;
   };
 
 
 
   template <typename OutputType>
-  std::pair<boost::signals2::connection,boost::signals2::connection>
+  Producer<OutputType>::
+  Producer ()
+    :
+    share_samples (false)
+  {}
+
+
+
+  template <typename OutputType>
+  void
+  Producer<OutputType>::
+  set_dispatch_backend (const DispatchBackend backend)
+  {
+    issue_sample.set_backend (backend);
+    issue_sample_batch.set_backend (backend);
+    issue_shared_sample.set_backend (backend);
+    flush_consumers.set_backend (backend);
+  }
+
+
+
+  template <typename OutputType>
+  void
+  Producer<OutputType>::
+  set_sample_sharing (const bool share_samples)
+  {
+    this->share_samples = share_samples;
+  }
+
+
+
+  template <typename OutputType>
+  void
+  Producer<OutputType>::
+  send_sample (OutputType    sample,
+               AuxiliaryData aux_data)
+  {
+    if (share_samples)
+      issue_shared_sample (std::make_shared<std::pair<OutputType,AuxiliaryData>>
+                           (std::move(sample), std::move(aux_data)));
+    else
+      issue_sample (std::move(sample), std::move(aux_data));
+  }
+
+
+
+  template <typename OutputType>
+  std::pair<Connection,Connection>
   Producer<OutputType>::
   connect_to_signals (const std::function<void (OutputType, AuxiliaryData)> &new_sample_slot,
                       const std::function<void ()> &flush_slot)
   {
-    // Connect with the signal and return the connection object.
-    return { issue_sample.connect (new_sample_slot),
+    // The caller does not know about blocks of samples or shared samples,
+    // so in addition to connecting the slot to the signal for individual
+    // samples, we also need to connect something to the batch signal that
+    // unpacks blocks and calls the slot for each sample individually, and
+    // something to the shared-sample signal that calls the slot with a
+    // copy of the sample. The caller will only ever see one connection
+    // object for these connections, so combine them into one.
+    const Connection sample_connection
+      = issue_sample.connect (new_sample_slot);
+    const Connection batch_connection
+      = issue_sample_batch.connect ([new_sample_slot](const SampleBatch<OutputType> &samples)
+    {
+      for (const auto &sample : samples)
+        new_sample_slot (sample.first, sample.second);
+    });
+    const Connection shared_connection
+      = issue_shared_sample.connect ([new_sample_slot](const SharedSample<OutputType> &sample)
+    {
+      new_sample_slot (sample->first, sample->second);
+    });
+
+    // Then also connect the flush slot and return the connection objects.
+    return { Connection (Connection (sample_connection, batch_connection),
+                         shared_connection),
              flush_consumers.connect (flush_slot)
            };
   }
 
 
+
+  template <typename OutputType>
+  std::tuple<Connection,Connection,Connection>
+  Producer<OutputType>::
+  connect_to_signals (const std::function<void (OutputType, AuxiliaryData)> &new_sample_slot,
+                      const std::function<void (const SampleBatch<OutputType> &)> &batch_slot,
+                      const std::function<void ()> &flush_slot)
+  {
+    // As in the previous function, the caller does not know about shared
+    // samples, so connect something that calls the slot for individual
+    // samples with a copy of the sample.
+    const Connection sample_connection
+      = issue_sample.connect (new_sample_slot);
+    const Connection shared_connection
+      = issue_shared_sample.connect ([new_sample_slot](const SharedSample<OutputType> &sample)
+    {
+      new_sample_slot (sample->first, sample->second);
+    });
+
+    return std::make_tuple (Connection (sample_connection, shared_connection),
+                            issue_sample_batch.connect (batch_slot),
+                            flush_consumers.connect (flush_slot));
+  }
+
+
+
+  template <typename OutputType>
+  std::tuple<Connection,Connection,Connection,Connection>
+  Producer<OutputType>::
+  connect_to_signals (const std::function<void (OutputType, AuxiliaryData)> &new_sample_slot,
+                      const std::function<void (const SampleBatch<OutputType> &)> &batch_slot,
+                      const std::function<void (const SharedSample<OutputType> &)> &shared_slot,
+                      const std::function<void ()> &flush_slot)
+  {
+    // Connect with the signals and return the connection objects.
+    return std::make_tuple (issue_sample.connect (new_sample_slot),
+                            issue_sample_batch.connect (batch_slot),
+                            issue_shared_sample.connect (shared_slot),
+                            flush_consumers.connect (flush_slot));
+  }
+
+
   /**
    * A namespace for the implementation of producers, i.e., classes
    * derived from the Producer class.
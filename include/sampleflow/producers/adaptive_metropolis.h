@@ -0,0 +1,411 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_ADAPTIVE_METROPOLIS_H
+#define SAMPLEFLOW_PRODUCERS_ADAPTIVE_METROPOLIS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/element_access.h>
+#include <sampleflow/types.h>
+
+#include <eigen3/Eigen/Dense>
+
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the Adaptive Metropolis algorithm of
+     * @cite HST01. This is a Metropolis-Hastings algorithm for samples
+     * $x\in{\mathbb R}^d$ whose proposal distribution is a Gaussian
+     * centered at the current sample, with a covariance matrix that is
+     * adapted to the covariance of the samples produced so far:
+     * Trial samples are drawn as
+     * $\tilde x = x + s_d L z$ where $z$ is a vector of independent
+     * standard normal random variables, $s_d=2.4/\sqrt{d}$ is the scaling
+     * factor recommended in @cite GRG95, and $LL^T=C$ is the Cholesky
+     * decomposition of an estimate $C$ of the covariance matrix of the
+     * target distribution.
+     *
+     * This is the same algorithm as the one shown in the second example
+     * in the documentation of the MetropolisHastings class. That example,
+     * however, obtains $C$ from a Consumers::CovarianceMatrix object and
+     * computes its Cholesky decomposition from scratch in every step, at a
+     * cost of ${\cal O}(d^3)$ operations per sample. This class instead
+     * keeps the Cholesky factor of the (unnormalized) scatter matrix
+     * $S=\sum_k (x_k-\bar x)(x_k-\bar x)^T$ of the samples, and updates
+     * it whenever a sample is added to (or removed from) the estimate.
+     * Each such change is a rank-one update (or downdate) of $S$, which
+     * can be applied to its Cholesky factor in ${\cal O}(d^2)$ operations,
+     * and $C=S/(n-1)$. The cost of producing a sample is therefore
+     * ${\cal O}(d^2)$ plus the cost of evaluating the log likelihood.
+     *
+     * The adaptation is controlled by the following parameters, all of
+     * which count samples produced by this object, across all calls to
+     * sample():
+     * - For the first `adaptation_start` samples, trial samples are drawn
+     *   using the initial covariance matrix $C_0$ passed to the
+     *   constructor (again scaled by $s_d^2$).
+     * - All samples up to and including sample `adaptation_end` are
+     *   used to update the covariance estimate. After that, the estimate
+     *   is "frozen", and the chain becomes a regular Metropolis-Hastings
+     *   chain with a fixed proposal distribution. Freezing the estimate at
+     *   the end of the burn-in phase is a common way to make sure that
+     *   the samples produced afterwards come from a Markov chain in the
+     *   usual sense.
+     * - If `window_size` is nonzero, then the estimate only uses the last
+     *   `window_size` samples. This allows the proposal distribution to
+     *   "forget" samples from the early burn-in phase, at the cost of one
+     *   additional rank-one downdate per sample and of storing the samples
+     *   in the window.
+     *
+     * To make sure that $S$ is always positive definite (and consequently
+     * has a Cholesky decomposition), the scatter matrix starts as $C_0$
+     * rather than as the zero matrix, as if it contained one additional
+     * "prior" sample. If all samples are used, its contribution to the
+     * estimate $C$ decays like $1/n$, and is in practice negligible after
+     * the first few hundred samples. If `window_size` is nonzero, on the
+     * other hand, the number of samples in the estimate stops growing at
+     * `window_size`, and $C$ permanently contains the term
+     * $C_0/(\text{window\_size}-1)$. This bias is small if the window is
+     * large, but it does not go away.
+     *
+     * The AuxiliaryData object associated with each sample stores the same
+     * entries as for the MetropolisHastings class.
+     *
+     * @tparam OutputType The type of the samples. This needs to be a
+     *   vector type with real-valued elements, such as `Eigen::VectorXd`
+     *   or `std::valarray<double>`, for which the functions
+     *   Utilities::size() and Utilities::get_nth_element() can be used.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class AdaptiveMetropolis : public Producer<OutputType>
+    {
+      public:
+        /**
+         * The type used to store covariance matrices.
+         */
+        using matrix_type = Eigen::MatrixXd;
+
+        /**
+         * Constructor.
+         *
+         * @param[in] initial_covariance The covariance matrix $C_0$ used
+         *   until adaptation starts. It needs to be symmetric and positive
+         *   definite, and its size determines the dimension $d$ of the
+         *   samples.
+         * @param[in] adaptation_start The number of samples after which the
+         *   estimated covariance matrix is used instead of $C_0$. This needs
+         *   to be at least two.
+         * @param[in] adaptation_end The number of samples after which the
+         *   covariance estimate is no longer updated. The default is to
+         *   never stop adapting.
+         * @param[in] window_size The number of most recent samples that are
+         *   used for the covariance estimate, or zero if all samples are to
+         *   be used.
+         */
+        AdaptiveMetropolis (const matrix_type &initial_covariance,
+                            const types::sample_index adaptation_start,
+                            const types::sample_index adaptation_end
+                            = std::numeric_limits<types::sample_index>::max(),
+                            const types::sample_index window_size = 0);
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects. The arguments have the same meaning as for
+         * MetropolisHastings::sample(), but there is no `perturb` argument
+         * since this class generates trial samples itself.
+         *
+         * Calling this function several times continues the adaptation
+         * where the previous call left off, i.e., the covariance estimate
+         * and the sample counts described in the documentation of this class
+         * are kept between calls.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const types::sample_index n_samples,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+        /**
+         * Return the current estimate $C$ of the covariance matrix of the
+         * samples, i.e., of the covariance used (after scaling by $s_d^2$)
+         * for the proposal distribution once adaptation has started. Before
+         * the second sample has been produced, this is $C_0$.
+         */
+        matrix_type
+        covariance_estimate () const;
+
+      private:
+        /**
+         * The initial covariance matrix, and its Cholesky factor.
+         */
+        const matrix_type initial_covariance;
+        const matrix_type initial_covariance_factor;
+
+        /**
+         * The parameters of the adaptation as described in the class
+         * documentation.
+         */
+        const types::sample_index adaptation_start;
+        const types::sample_index adaptation_end;
+        const types::sample_index window_size;
+
+        /**
+         * The number of samples produced so far.
+         */
+        types::sample_index n_samples_produced;
+
+        /**
+         * The number of samples that currently make up the covariance
+         * estimate, their mean, and the Cholesky decomposition of their
+         * scatter matrix plus $C_0$.
+         */
+        types::sample_index n_samples_in_estimate;
+        Eigen::VectorXd mean;
+        Eigen::LLT<matrix_type> scatter_matrix_decomposition;
+
+        /**
+         * If `window_size` is nonzero, the samples currently in the
+         * estimate.
+         */
+        std::deque<Eigen::VectorXd> window;
+
+        /**
+         * Add a sample to the covariance estimate, and remove the oldest
+         * one if the window is full.
+         */
+        void
+        update_estimate (const Eigen::VectorXd &x);
+
+        /**
+         * Compute the scatter matrix and its decomposition from scratch
+         * from the samples stored in the window. This is used if a
+         * rank-one downdate fails due to round-off.
+         */
+        void
+        recompute_estimate ();
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    AdaptiveMetropolis<OutputType,RandomNumberGenerator>::
+    AdaptiveMetropolis (const matrix_type &initial_covariance,
+                        const types::sample_index adaptation_start,
+                        const types::sample_index adaptation_end,
+                        const types::sample_index window_size)
+      :
+      initial_covariance (initial_covariance),
+      initial_covariance_factor (initial_covariance.llt().matrixL()),
+      adaptation_start (adaptation_start),
+      adaptation_end (adaptation_end),
+      window_size (window_size),
+      n_samples_produced (0),
+      n_samples_in_estimate (0),
+      mean (Eigen::VectorXd::Zero(initial_covariance.rows())),
+      scatter_matrix_decomposition (initial_covariance)
+    {
+      assert (initial_covariance.rows() == initial_covariance.cols());
+      assert (scatter_matrix_decomposition.info() == Eigen::Success);
+      assert (adaptation_start >= 2);
+      assert ((window_size == 0) || (window_size >= 2));
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    typename AdaptiveMetropolis<OutputType,RandomNumberGenerator>::matrix_type
+    AdaptiveMetropolis<OutputType,RandomNumberGenerator>::
+    covariance_estimate () const
+    {
+      if (n_samples_in_estimate < 2)
+        return initial_covariance;
+      else
+        return scatter_matrix_decomposition.reconstructedMatrix() / (n_samples_in_estimate-1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    AdaptiveMetropolis<OutputType,RandomNumberGenerator>::
+    update_estimate (const Eigen::VectorXd &x)
+    {
+      // Add the sample: If the mean of n samples is m, then adding x
+      // changes the scatter matrix by n/(n+1) (x-m)(x-m)^T.
+      {
+        const Eigen::VectorXd delta = x - mean;
+        const double n = n_samples_in_estimate;
+        mean += delta / (n+1);
+        scatter_matrix_decomposition.rankUpdate (delta, n/(n+1));
+        ++n_samples_in_estimate;
+      }
+
+      if (window_size == 0)
+        return;
+
+      window.push_back (x);
+      if (window.size() <= window_size)
+        return;
+
+      // Remove the oldest sample y: If the mean of n samples (including y)
+      // is m, then removing y changes the scatter matrix by
+      // -n/(n-1) (y-m)(y-m)^T. This downdate may fail if round-off has
+      // made the matrix indefinite, in which case we start over from the
+      // samples in the window.
+      const Eigen::VectorXd delta = window.front() - mean;
+      window.pop_front ();
+      const double n = n_samples_in_estimate;
+      mean -= delta / (n-1);
+      scatter_matrix_decomposition.rankUpdate (delta, -n/(n-1));
+      --n_samples_in_estimate;
+
+      if (scatter_matrix_decomposition.info() != Eigen::Success)
+        recompute_estimate ();
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    AdaptiveMetropolis<OutputType,RandomNumberGenerator>::
+    recompute_estimate ()
+    {
+      mean.setZero ();
+      for (const auto &x : window)
+        mean += x;
+      mean /= window.size();
+
+      matrix_type scatter_matrix = initial_covariance;
+      for (const auto &x : window)
+        scatter_matrix += (x - mean) * (x - mean).transpose();
+
+      scatter_matrix_decomposition.compute (scatter_matrix);
+      n_samples_in_estimate = window.size();
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    AdaptiveMetropolis<OutputType,RandomNumberGenerator>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const types::sample_index n_samples,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      const unsigned int dim = initial_covariance.rows();
+      assert (Utilities::size(starting_point) == dim);
+
+      RandomNumberGenerator rng;
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+      std::normal_distribution<double> normal_distribution(0,1);
+
+      const double scaling = 2.4/std::sqrt(1.*dim);
+
+      OutputType current_sample         = starting_point;
+      double     current_log_likelihood = log_likelihood (current_sample);
+
+      Eigen::VectorXd x (dim);
+      Eigen::VectorXd z (dim);
+      Eigen::VectorXd step (dim);
+
+      for (types::sample_index i=0; i<n_samples; ++i)
+        {
+          // Draw a trial sample, using either the initial or the estimated
+          // covariance matrix. For the latter, the Cholesky factor of the
+          // covariance matrix is that of the scatter matrix divided by
+          // sqrt(n-1).
+          for (unsigned int k=0; k<dim; ++k)
+            z(k) = normal_distribution(rng);
+
+          if ((n_samples_produced < adaptation_start) || (n_samples_in_estimate < 2))
+            step.noalias() = scaling * (initial_covariance_factor * z);
+          else
+            {
+              step.noalias() = scatter_matrix_decomposition.matrixL() * z;
+              step *= scaling / std::sqrt(n_samples_in_estimate-1.);
+            }
+
+          OutputType trial_sample = current_sample;
+          for (unsigned int k=0; k<dim; ++k)
+            Utilities::get_nth_element (trial_sample, k) += step(k);
+
+          const double trial_log_likelihood = log_likelihood (trial_sample);
+
+          // Accept or reject the trial sample in the same way as
+          // MetropolisHastings::sample() does. The proposal distribution
+          // is symmetric, so the ratio of proposal probabilities is one.
+          bool repeated_sample;
+          if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihood,
+                                             1., rng, uniform_distribution))
+            {
+              current_sample         = std::move(trial_sample);
+              current_log_likelihood = trial_log_likelihood;
+
+              repeated_sample = false;
+            }
+          else
+            repeated_sample = true;
+
+          // Update the covariance estimate with the new sample, unless
+          // adaptation has ended:
+          ++n_samples_produced;
+          if (n_samples_produced <= adaptation_end)
+            {
+              for (unsigned int k=0; k<dim; ++k)
+                x(k) = Utilities::get_nth_element (current_sample, k);
+              update_estimate (x);
+            }
+
+          this->send_sample (current_sample,
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+            {AuxiliaryDataKeys::sample_is_repeated, repeated_sample}
+          });
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,352 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_AFFINE_INVARIANT_ENSEMBLE_H
+#define SAMPLEFLOW_PRODUCERS_AFFINE_INVARIANT_ENSEMBLE_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/random.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/element_access.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the affine-invariant ensemble sampler of
+     * @cite GoodmanWeare10 with the "stretch move", in the parallel
+     * variant popularized by the `emcee` package @cite ForemanMackeyEtAl13.
+     *
+     * The sampler evolves an ensemble of $K$ "walkers" $x_1,\ldots,x_K$
+     * in ${\mathbb R}^d$. To update walker $x_k$, it selects a walker $x_j$
+     * from a "complementary" set of walkers, draws a number $z$ from the
+     * distribution $g(z)\propto 1/\sqrt{z}$ on $[1/a,a]$, and proposes the
+     * trial sample $\tilde x = x_j + z(x_k-x_j)$ on the line through the two
+     * walkers. This trial sample is accepted with probability
+     * $\min\left\{1, z^{d-1}\frac{\pi(\tilde x)}{\pi(x_k)}\right\}$. The
+     * algorithm has only one parameter, $a>1$, for which the default value
+     * $a=2$ works well in practice. In particular, there is no proposal
+     * distribution that would need to be tuned: Because trial samples are
+     * constructed from differences of walkers, the ensemble automatically
+     * adapts to the scale and correlations of the distribution, and the
+     * algorithm performs equally well for all distributions that are
+     * affine transformations of each other -- for example, for all
+     * Gaussians, however elongated. This is in contrast to the
+     * DifferentialEvaluationMetropolisHastings class, which also evolves an
+     * ensemble of chains, but which requires `perturb` and `crossover`
+     * functions.
+     *
+     * The walkers are split into two halves, and each generation first
+     * updates all walkers of the first half, using the walkers of the
+     * second half as the complementary set, and then the other way around.
+     * Since the updates of the walkers of one half only depend on the
+     * walkers of the other half, they are independent of each other, and
+     * the sample() function performs them concurrently on a ThreadPool.
+     *
+     * After each generation, the current samples of all walkers are sent
+     * to consumers, in the order of walkers. The AuxiliaryData object
+     * associated with each sample stores the same two entries as for the
+     * MetropolisHastings class, plus
+     * - An entry with name "chain index" (i.e., key
+     *   AuxiliaryDataKeys::chain_index) of type `unsigned int` that stores
+     *   the index of the walker, i.e., the index of its starting point in
+     *   the array passed to sample().
+     *
+     *
+     * ### Threading model ###
+     *
+     * The `log_likelihood` function passed to sample() is called
+     * concurrently from the thread that calls sample() and the threads of
+     * the ThreadPool selected via set_thread_pool(), and must be safe to
+     * call concurrently. Each walker has its own random number generator,
+     * and so the samples produced do not depend on the number of threads.
+     * Samples are only sent to consumers from the thread that calls
+     * sample().
+     *
+     * @tparam OutputType The type of the samples. This needs to be a
+     *   vector type with real-valued elements, such as `Eigen::VectorXd`
+     *   or `std::valarray<double>`, for which the functions
+     *   Utilities::size() and Utilities::get_nth_element() can be used.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class AffineInvariantEnsemble : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] stretch_scale The parameter $a>1$ of the distribution
+         *   from which the stretch factor $z$ is drawn.
+         */
+        explicit
+        AffineInvariantEnsemble (const double stretch_scale = 2.);
+
+        /**
+         * Select the ThreadPool on which walkers are updated. If this
+         * function is not called, then the pool returned by
+         * ThreadPool::default_pool() is used.
+         *
+         * @param[in] thread_pool The pool to submit tasks to. The pool needs
+         *   to live at least as long as the current object.
+         */
+        void
+        set_thread_pool (ThreadPool &thread_pool);
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial samples of each walker, it performs the given number of
+         * generations and sends the samples of all walkers after each
+         * generation through the signal of the base class to Consumer
+         * objects.
+         *
+         * @param[in] starting_points The initial samples of the walkers. The
+         *   number of starting points determines the number of walkers,
+         *   which needs to be at least four. The algorithm is typically
+         *   run with at least $2d$ walkers, and the starting points need to
+         *   span ${\mathbb R}^d$ since walkers can never leave the affine
+         *   subspace spanned by the starting points.
+         * @param[in] log_likelihood A function object that, when called
+         *   with a sample $x$, returns $\log(\pi(x))$. See
+         *   MetropolisHastings::sample() for details.
+         * @param[in] n_samples_per_walker The number of generations, i.e.,
+         *   the number of samples each walker produces.
+         * @param[in] random_seed The random number generator of walker $k$
+         *   is seeded from this seed and the number $k$. See
+         *   MetropolisHastings::sample().
+         */
+        void
+        sample (const std::vector<OutputType> &starting_points,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const types::sample_index n_samples_per_walker,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+        /**
+         * Return, for each walker, the fraction of trial samples that have
+         * been accepted in all previous calls to sample(). Walker $k$ is
+         * the one that starts at the $k$th starting point; if the calls to
+         * sample() used different numbers of walkers, then the ratio for
+         * walker $k$ only counts the calls in which it existed.
+         */
+        std::vector<double>
+        get_acceptance_ratios () const;
+
+      private:
+        /**
+         * The parameter $a$ of the stretch move.
+         */
+        const double stretch_scale;
+
+        /**
+         * The pool on which walkers are updated. If this is a `nullptr` at
+         * the time sample() is called, then it is set to
+         * ThreadPool::default_pool().
+         */
+        ThreadPool *thread_pool;
+
+        /**
+         * The number of accepted trial samples and the number of steps of
+         * each walker, summed over all calls to sample().
+         */
+        std::vector<types::sample_index> n_accepted_samples;
+        std::vector<types::sample_index> n_steps;
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    AffineInvariantEnsemble<OutputType,RandomNumberGenerator>::
+    AffineInvariantEnsemble (const double stretch_scale)
+      :
+      stretch_scale (stretch_scale),
+      thread_pool (nullptr)
+    {
+      assert (stretch_scale > 1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    AffineInvariantEnsemble<OutputType,RandomNumberGenerator>::
+    set_thread_pool (ThreadPool &thread_pool)
+    {
+      this->thread_pool = &thread_pool;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::vector<double>
+    AffineInvariantEnsemble<OutputType,RandomNumberGenerator>::
+    get_acceptance_ratios () const
+    {
+      std::vector<double> ratios (n_accepted_samples.size(), 0.);
+      for (unsigned int k=0; k<n_accepted_samples.size(); ++k)
+        if (n_steps[k] > 0)
+          ratios[k] = 1. * n_accepted_samples[k] / n_steps[k];
+      return ratios;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    AffineInvariantEnsemble<OutputType,RandomNumberGenerator>::
+    sample (const std::vector<OutputType> &starting_points,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const types::sample_index n_samples_per_walker,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      const unsigned int n_walkers = starting_points.size();
+      assert (n_walkers >= 4);
+
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      if (thread_pool == nullptr)
+        thread_pool = &ThreadPool::default_pool();
+
+      const unsigned int dim = Utilities::size(starting_points[0]);
+
+      // Give each walker its own stream of random numbers, derived from
+      // the seed and the walker number:
+      std::vector<RandomNumberGenerator> rngs;
+      rngs.reserve (n_walkers);
+      for (unsigned int k=0; k<n_walkers; ++k)
+        rngs.emplace_back (Utilities::make_random_number_generator<RandomNumberGenerator> (random_seed, k));
+
+      std::vector<OutputType> current_samples = starting_points;
+      std::vector<double>     current_log_likelihoods (n_walkers);
+      // Use 'char' rather than 'bool' since walkers are updated
+      // concurrently, and different elements of a std::vector<bool> may
+      // share the same memory location:
+      std::vector<char>       repeated_samples (n_walkers);
+      thread_pool->parallel_for (n_walkers,
+                                 [&](const unsigned int k)
+      {
+        current_log_likelihoods[k] = log_likelihood (current_samples[k]);
+      });
+
+      if (n_accepted_samples.size() < n_walkers)
+        {
+          n_accepted_samples.resize (n_walkers, 0);
+          n_steps.resize (n_walkers, 0);
+        }
+
+      // The walkers [0,n_walkers/2) form the first half, the rest the
+      // second one.
+      const unsigned int half_begin[2] = {0, n_walkers/2};
+      const unsigned int half_end[2]   = {n_walkers/2, n_walkers};
+
+      SampleBatch<OutputType> samples;
+      samples.reserve (n_walkers);
+
+      for (types::sample_index generation=0; generation<n_samples_per_walker; ++generation)
+        {
+          for (unsigned int half=0; half<2; ++half)
+            {
+              const unsigned int other_begin = half_begin[1-half];
+              const unsigned int n_others    = half_end[1-half] - half_begin[1-half];
+
+              thread_pool->parallel_for (half_end[half] - half_begin[half],
+                                         [&](const unsigned int i)
+              {
+                const unsigned int k = half_begin[half] + i;
+                RandomNumberGenerator &rng = rngs[k];
+
+                // Choose a walker from the other half, and a stretch factor
+                // z distributed as 1/sqrt(z) on [1/a,a] by transforming a
+                // uniformly distributed number:
+                const unsigned int j
+                  = other_begin + std::uniform_int_distribution<unsigned int>(0, n_others-1)(rng);
+                const double w = (stretch_scale - 1) *
+                                 std::uniform_real_distribution<>(0,1)(rng) + 1;
+                const double z = w * w / stretch_scale;
+
+                OutputType trial_sample = current_samples[j];
+                for (unsigned int d=0; d<dim; ++d)
+                  Utilities::get_nth_element (trial_sample, d)
+                    += z * (Utilities::get_nth_element (current_samples[k], d) -
+                            Utilities::get_nth_element (current_samples[j], d));
+
+                const double trial_log_likelihood = log_likelihood (trial_sample);
+
+                // Accept or reject the trial sample. This is the
+                // Metropolis-Hastings criterion where the factor z^{d-1}
+                // takes the role of the inverse of the ratio of proposal
+                // probabilities, including the treatment of samples with
+                // zero probability. The random number that decides is
+                // drawn up front, so that each step uses the same number
+                // of random numbers regardless of the outcome.
+                const double proposal_distribution_ratio = std::pow(z, 1. - dim);
+                const double u = std::uniform_real_distribution<>(0,1)(rng);
+                const auto drawn_u = [u](RandomNumberGenerator &)
+                {
+                  return u;
+                };
+
+                if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihoods[k],
+                                                   proposal_distribution_ratio,
+                                                   rng, drawn_u))
+                  {
+                    current_samples[k]         = std::move(trial_sample);
+                    current_log_likelihoods[k] = trial_log_likelihood;
+                    ++n_accepted_samples[k];
+                    repeated_samples[k] = false;
+                  }
+                else
+                  repeated_samples[k] = true;
+                ++n_steps[k];
+              });
+            }
+
+          // Output the samples of all walkers:
+          samples.clear ();
+          for (unsigned int k=0; k<n_walkers; ++k)
+            samples.emplace_back (current_samples[k],
+                                  AuxiliaryData
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihoods[k]},
+            {AuxiliaryDataKeys::sample_is_repeated, static_cast<bool>(repeated_samples[k])},
+            {AuxiliaryDataKeys::chain_index, k}
+          });
+          this->issue_sample_batch (samples);
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,259 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_DELAYED_ACCEPTANCE_MH_H
+#define SAMPLEFLOW_PRODUCERS_DELAYED_ACCEPTANCE_MH_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the "delayed acceptance" Metropolis-Hastings
+     * algorithm of @cite ChristenFox05. This algorithm is useful if
+     * evaluating the log likelihood $\log\pi(x)$ is expensive, but a cheap
+     * approximation $\log\pi^\ast(x)$ (a "surrogate") is available -- for
+     * example, if $\pi(x)$ requires solving a partial differential equation
+     * and $\pi^\ast(x)$ solves the same equation on a coarse mesh. The
+     * algorithm screens each trial sample $\tilde x$ using the surrogate
+     * first, and only evaluates the expensive log likelihood for trial
+     * samples that pass this screening. Because most trial samples are
+     * rejected in typical applications of the Metropolis-Hastings
+     * algorithm, this saves most of the expensive evaluations if the
+     * surrogate is good.
+     *
+     * Specifically, a trial sample $\tilde x$ proposed from the current
+     * sample $x$ (as in the MetropolisHastings class) is accepted in two
+     * stages:
+     * - In the first stage, it is accepted with probability
+     *   $\alpha_1 = \min\left\{1, \frac{\pi^\ast(\tilde x)}{\pi^\ast(x)}
+     *   \frac{\pi_\text{proposal}(x|\tilde x)}{\pi_\text{proposal}(\tilde x|x)}
+     *   \right\}$, i.e., using the Metropolis-Hastings criterion for the
+     *   surrogate. If it is rejected, the current sample is repeated.
+     * - If it is accepted in the first stage, then the expensive log
+     *   likelihood is evaluated, and the trial sample is accepted with
+     *   probability
+     *   $\alpha_2 = \min\left\{1, \frac{\pi(\tilde x)}{\pi(x)}
+     *   \frac{\pi^\ast(x)}{\pi^\ast(\tilde x)} \right\}$. This factor
+     *   corrects for the error of the surrogate and ensures that the chain
+     *   samples $\pi$, not $\pi^\ast$.
+     * If the surrogate equals the log likelihood, then $\alpha_2=1$ and
+     * the algorithm is the Metropolis-Hastings algorithm (but with twice
+     * the number of evaluations). The better the surrogate, the closer
+     * $\alpha_2$ is to one and the more expensive evaluations are saved;
+     * on the other hand, the surrogate must not be zero where $\pi$ is
+     * nonzero, since the chain would then never visit these regions.
+     *
+     * The AuxiliaryData object associated with each sample stores the two
+     * entries described for the MetropolisHastings class, plus
+     * - An entry with name "rejected at stage" (i.e., key
+     *   AuxiliaryDataKeys::rejected_at_stage) of type `unsigned int`
+     *   that is zero if the trial sample has been accepted, and otherwise
+     *   the stage (1 or 2) at which it was rejected. The number of
+     *   samples for which this entry is one is the number of expensive
+     *   evaluations of the log likelihood that have been saved. (Except
+     *   for chains in regions where the surrogate is zero, see sample(),
+     *   in which trial samples can also be rejected at stage two without
+     *   evaluating the log likelihood.)
+     *
+     * The entry with key AuxiliaryDataKeys::relative_log_likelihood stores
+     * the (expensive) log likelihood $\log\pi(x_k)$ of each sample.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class DelayedAcceptanceMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects.
+         *
+         * @param[in] starting_point The initial sample $x_0$.
+         * @param[in] log_likelihood A function object that, when called
+         *   with a sample $x$, returns $\log(\pi(x))$. See
+         *   MetropolisHastings::sample() for details.
+         * @param[in] surrogate_log_likelihood A function object that, when
+         *   called with a sample $x$, returns $\log(\pi^\ast(x))$, an
+         *   approximation of $\log(\pi(x))$ that is cheap to evaluate. It
+         *   does not need to be normalized in the same way as
+         *   `log_likelihood`, i.e., it may differ from it by a constant.
+         * @param[in] perturb A function object that returns a trial sample
+         *   and the ratio of proposal probabilities, as described in
+         *   MetropolisHastings::sample().
+         * @param[in] n_samples The number of (new) samples to be produced
+         *   by this function.
+         * @param[in] random_seed The seed of the random number generator
+         *   used to accept or reject samples. See MetropolisHastings::sample().
+         *
+         * As in the MetropolisHastings class, log likelihoods equal to
+         * `-std::numeric_limits<double>::max()` or
+         * `-std::numeric_limits<double>::infinity()` indicate a zero
+         * probability. Trial samples for which either the surrogate or the
+         * log likelihood is zero are rejected, unless the corresponding
+         * value is also zero for the current sample; in the latter case,
+         * the stage in question only considers the ratio of proposal
+         * probabilities (in stage one) or accepts with probability
+         * $\min\{1,\pi^\ast(x)/\pi^\ast(y)\}$ (in stage two), so that
+         * the chain can perform a random walk until it reaches an area of
+         * nonzero probability. The factor $\pi^\ast(x)/\pi^\ast(y)$ used
+         * in stage two is treated as one if both surrogate values are
+         * zero. If only the surrogate value of the current sample $x$ is
+         * zero, then this factor is zero and the trial sample is rejected
+         * in stage two without evaluating its log likelihood -- except if
+         * the current sample also has zero probability, in which case the
+         * factor is again treated as one so that the chain can find its way
+         * into the support of $\pi$. As a consequence, the surrogate needs
+         * to be nonzero wherever $\pi$ is: A chain that reaches (or
+         * starts at) a sample with nonzero probability but zero surrogate
+         * probability never leaves it, as prescribed by the algorithm.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<double (const OutputType &)> &surrogate_log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const types::sample_index n_samples,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    DelayedAcceptanceMetropolisHastings<OutputType,RandomNumberGenerator>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const std::function<double (const OutputType &)> &surrogate_log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const types::sample_index n_samples,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      RandomNumberGenerator rng;
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      OutputType current_sample                   = starting_point;
+      double     current_log_likelihood           = log_likelihood (current_sample);
+      double     current_surrogate_log_likelihood = surrogate_log_likelihood (current_sample);
+
+      for (types::sample_index i=0; i<n_samples; ++i)
+        {
+          std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample);
+          OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+          const double proposal_distribution_ratio = trial_sample_and_ratio.second;
+
+          // Stage 1: Screen the trial sample using the surrogate. This is
+          // the same test as in MetropolisHastings::sample(), using the
+          // surrogate instead of the log likelihood.
+          const double trial_surrogate_log_likelihood = surrogate_log_likelihood (trial_sample);
+          unsigned int rejected_at_stage = 0;
+          if (!internal::accept_trial_sample (trial_surrogate_log_likelihood,
+                                              current_surrogate_log_likelihood,
+                                              proposal_distribution_ratio,
+                                              rng, uniform_distribution))
+            rejected_at_stage = 1;
+          else
+            {
+              // Stage 2: Evaluate the expensive log likelihood and correct
+              // for the error of the surrogate by the factor
+              // pi*(x)/pi*(y), i.e., by the inverse of the ratio of
+              // surrogate values. (Stage 1 only accepts a trial sample with
+              // a zero surrogate value if the current sample has one as
+              // well.) There are two special cases:
+              // - If both surrogate values are zero, their ratio is not
+              //   defined and we treat it as one.
+              // - If only the current surrogate value is zero, then the
+              //   factor is zero and the trial sample is rejected without
+              //   evaluating the log likelihood. The exception is if the
+              //   current sample also has zero probability: The chain is
+              //   then still looking for the support of the distribution,
+              //   and we treat the ratio as one as well.
+              const bool trial_surrogate_is_zero
+                = internal::is_zero_probability (trial_surrogate_log_likelihood);
+              const bool current_surrogate_is_zero
+                = internal::is_zero_probability (current_surrogate_log_likelihood);
+
+              double log_surrogate_ratio = 0.;
+              bool   surrogate_factor_is_zero = false;
+              if (trial_surrogate_is_zero && current_surrogate_is_zero)
+                log_surrogate_ratio = 0.;
+              else if (current_surrogate_is_zero)
+                {
+                  if (internal::is_zero_probability (current_log_likelihood))
+                    log_surrogate_ratio = 0.;
+                  else
+                    surrogate_factor_is_zero = true;
+                }
+              else
+                log_surrogate_ratio = trial_surrogate_log_likelihood - current_surrogate_log_likelihood;
+
+              if (surrogate_factor_is_zero)
+                rejected_at_stage = 2;
+              else
+                {
+                  const double trial_log_likelihood = log_likelihood (trial_sample);
+
+                  if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihood,
+                                                     std::exp(log_surrogate_ratio),
+                                                     rng, uniform_distribution))
+                    {
+                      current_sample                   = std::move(trial_sample);
+                      current_log_likelihood           = trial_log_likelihood;
+                      current_surrogate_log_likelihood = trial_surrogate_log_likelihood;
+                    }
+                  else
+                    rejected_at_stage = 2;
+                }
+            }
+
+          this->send_sample (current_sample,
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+            {AuxiliaryDataKeys::sample_is_repeated, (rejected_at_stage != 0)},
+            {AuxiliaryDataKeys::rejected_at_stage, rejected_at_stage}
+          });
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -21,8 +21,13 @@
 #include <sampleflow/scope_exit.h>
 #include <sampleflow/types.h>
 
+#include <algorithm>
+#include <cassert>
+#include <functional>
 #include <random>
 #include <cmath>
+#include <utility>
+#include <vector>
 
 namespace SampleFlow
 {
@@ -37,11 +42,88 @@ namespace SampleFlow
      * different perturb function that accepts both the current sample and a vector
      * of rejected samples as arguments. These rejected samples can be used for a more
      * sophisticated perturbation strategy.
+     *
+     * Like the MetropolisHastings class, this class provides a nested class
+     * Chain that produces the samples of a chain one at a time, on demand,
+     * rather than all at once through sample(). See the section on producing
+     * samples on demand in the documentation of the MetropolisHastings class.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
      */
-    template <typename OutputType>
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
     class DelayedRejectionMetropolisHastings : public Producer<OutputType>
     {
       public:
+        /**
+         * A class that represents the state of a delayed rejection chain
+         * and produces its samples one at a time. This is the analog of
+         * MetropolisHastings::Chain.
+         */
+        class Chain
+        {
+          public:
+            /**
+             * Constructor. The arguments have the same meaning as for
+             * DelayedRejectionMetropolisHastings::sample(). The
+             * `log_likelihood` and `perturb` function objects are copied and
+             * stored.
+             */
+            Chain (const OutputType &starting_point,
+                   const std::function<double (const OutputType &)> &log_likelihood,
+                   const std::function<std::pair<OutputType,double> (const OutputType &, const std::vector<OutputType> &)> &perturb,
+                   const unsigned int max_delays,
+                   const typename RandomNumberGenerator::result_type random_seed = {});
+
+            /**
+             * Perform one step of the chain (including all of its delay
+             * stages), and return the new sample along with its auxiliary
+             * data.
+             */
+            std::pair<OutputType,AuxiliaryData>
+            next ();
+
+            /**
+             * Perform the given number of steps of the chain, and return
+             * the new samples along with their auxiliary data.
+             */
+            SampleBatch<OutputType>
+            next (const types::sample_index n_samples);
+
+          private:
+            /**
+             * The functions and parameters that define the chain.
+             */
+            const std::function<double (const OutputType &)> log_likelihood;
+            const std::function<std::pair<OutputType,double> (const OutputType &, const std::vector<OutputType> &)> perturb;
+            const unsigned int max_delays;
+
+            /**
+             * The random number generator used to accept or reject samples,
+             * and the distribution used with it.
+             */
+            RandomNumberGenerator rng;
+            std::uniform_real_distribution<> uniform_distribution;
+
+            /**
+             * The current sample and its log likelihood.
+             */
+            OutputType current_sample;
+            double     current_log_likelihood;
+
+            /**
+             * The storage for the trial samples of the delay stages, their
+             * log likelihoods (where the first element is the log likelihood
+             * of the current sample), and the table of acceptance ratios
+             * used by compute_acceptance_ratio(). These are re-used for all
+             * samples.
+             */
+            std::vector<OutputType> rejected_samples;
+            std::vector<double>     log_likelihoods;
+            std::vector<double>     acceptance_ratio_table;
+        };
+
         /**
          * The principal function of this class. Starting from the given
          * initial sample $x_0$, it produces a sequence of samples $x_k$
@@ -117,68 +199,202 @@ namespace SampleFlow
                 const std::function<std::pair<OutputType,double> (const OutputType &, const std::vector<OutputType> &)> &perturb,
                 const unsigned int max_delays,
                 const types::sample_index n_samples,
-                const std::mt19937::result_type random_seed = {});
+                const typename RandomNumberGenerator::result_type random_seed = {});
       private:
         /**
-         * Recursively compute the acceptance ratio given the previous sample and
-         * a vector of proposed samples (all but one that have already been rejected).
+         * Compute the acceptance ratio of the trial sample of the current
+         * delay stage $n$. The acceptance ratio $\alpha(x; y_1,\ldots,y_n)$ of
+         * the trial sample $y_n$, given the last accepted sample $x$ and the
+         * previously rejected trial samples $y_1,\ldots,y_{n-1}$, is defined
+         * recursively in terms of the acceptance ratios of shorter sequences
+         * of samples. Evaluating this recursion directly requires a number
+         * of evaluations of $\alpha$ that grows exponentially with $n$, but
+         * all of these evaluations are of the form
+         * $\alpha(z_a; z_s,\ldots,z_e)$ where $z_0=x$, $z_i=y_i$ for
+         * $i\ge 1$, and $z_s,\ldots,z_e$ is a contiguous subsequence. Moreover,
+         * $\alpha$ only depends on the log likelihoods of the samples. This
+         * function therefore stores these values in a table indexed by
+         * $(a,s,e)$ and computes them bottom-up ("dynamic programming"): In
+         * delay stage $n$, it computes all entries with $\max(a,e)=n$ in
+         * the order of increasing length of the subsequence. All other
+         * entries the computation depends on have been computed in this or
+         * earlier delay stages. The cost of delay stage $n$ is therefore
+         * ${\cal O}(n^3)$ operations on numbers, and no samples are copied.
          *
-         * @param[in] x The previous accepted sample and its associated log likelihood.
-         * @param[in] y Vector of proposed samples and their corresponding log
-         *   likelihoods; all but the last element have already been rejected.
+         * @param[in] log_likelihoods The log likelihoods of $z_0,\ldots,z_n$.
+         * @param[in] table_size The size $N$ of the table in each of its three
+         *   indices. This needs to be larger than $n$.
+         * @param[in,out] table The table of acceptance ratios, of size $N^3$.
+         *   On input, it needs to contain all entries computed in the
+         *   previous delay stages (of the current sample); on output, it
+         *   also contains those of the current delay stage.
+         * @return The acceptance ratio $\alpha(z_0; z_1,\ldots,z_n)$.
          */
+        static
         double
-        alpha_fn (const std::pair<OutputType,double> &x,
-                  const std::vector<std::pair<OutputType,double>> &y);
+        compute_acceptance_ratio (const std::vector<double> &log_likelihoods,
+                                  const unsigned int table_size,
+                                  std::vector<double> &table);
     };
 
 
 
-    template <typename OutputType>
+    template <typename OutputType, typename RandomNumberGenerator>
     double
-    DelayedRejectionMetropolisHastings<OutputType>::
-    alpha_fn (const std::pair<OutputType,double> &x,
-              const std::vector<std::pair<OutputType,double>> &y)
+    DelayedRejectionMetropolisHastings<OutputType,RandomNumberGenerator>::
+    compute_acceptance_ratio (const std::vector<double> &log_likelihoods,
+                              const unsigned int table_size,
+                              std::vector<double> &table)
+    {
+      const unsigned int n = log_likelihoods.size() - 1;
+      assert (n >= 1);
+      assert (n < table_size);
+      assert (table.size() == table_size*table_size*table_size);
+
+      const auto alpha = [&](const unsigned int a,
+                             const unsigned int s,
+                             const unsigned int e) -> double &
+      {
+        return table[(a*table_size + s)*table_size + e];
+      };
+
+      for (unsigned int length=1; length<=n; ++length)
+        for (unsigned int s=1; s+length-1<=n; ++s)
+          {
+            const unsigned int e = s+length-1;
+            for (unsigned int a=0; a<=n; ++a)
+              {
+                // Only compute the entries that are new in this delay stage,
+                // and skip the ones that are never needed:
+                if ((std::max(a,e) != n) || ((a >= s) && (a <= e)))
+                  continue;
+
+                // Start with the ratio of likelihoods of z_e and z_a. In the
+                // case where no samples have been rejected yet, the acceptance
+                // ratio is calculated the same as regular MH; we assume that
+                // the proposal is symmetric, so the acceptance ratio is
+                // simply the likelihood ratio. Otherwise, multiply by the
+                // factors that account for the rejected samples z_s...z_{e-1}.
+                double ratio = std::exp(log_likelihoods[e] - log_likelihoods[a]);
+                for (unsigned int j=1; j<=e-s; ++j)
+                  ratio *= (1 - alpha(e, e-j, e-1)) /
+                           (1 - alpha(a, s, s+j-1));
+                alpha(a,s,e) = ratio;
+              }
+          }
+
+      return alpha(0,1,n);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    DelayedRejectionMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    Chain (const OutputType &starting_point,
+           const std::function<double (const OutputType &)> &log_likelihood,
+           const std::function<std::pair<OutputType,double> (const OutputType &, const std::vector<OutputType> &)> &perturb,
+           const unsigned int max_delays,
+           const typename RandomNumberGenerator::result_type random_seed)
+      :
+      log_likelihood (log_likelihood),
+      perturb (perturb),
+      max_delays (max_delays),
+      uniform_distribution (0,1),
+      current_sample (starting_point),
+      current_log_likelihood (log_likelihood (starting_point)),
+      acceptance_ratio_table ((max_delays+2)*(max_delays+2)*(max_delays+2))
+    {
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed(random_seed);
+
+      rejected_samples.reserve (max_delays);
+      log_likelihoods.reserve (max_delays+2);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::pair<OutputType,AuxiliaryData>
+    DelayedRejectionMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    next ()
     {
-      // Define the current delay stage as the number of rejected samples
-      // (number of proposed samples minus 1)
-      const unsigned int num_rejected_samples = y.size() - 1;
-      // Get the current proposed sample from the list of all proposed samples
-      const auto yi = y[num_rejected_samples];
-
-      // Get the likelihood ratio of the previous sample to the current proposed sample
-      const double likelihood_ratio = std::exp(yi.second - x.second);
-
-      // In the case where no samples have been rejected yet, the acceptance ratio is calculated
-      // the same as regular MH; we assume that the proposal is symmetric, so the acceptance
-      // ratio is simply the likelihood ratio
-      if (num_rejected_samples == 0)
-        return likelihood_ratio;
-
-      // Otherwise, recursively compute acceptance ratio
-      double alpha = likelihood_ratio;
-      for (int j = 1; j <= num_rejected_samples; ++j)
+      const unsigned int table_size = max_delays+2;
+
+      rejected_samples.clear ();
+      log_likelihoods.assign (1, current_log_likelihood);
+
+      // Initialize a bool to store whether a sample is accepted
+      bool accepted_sample = false;
+      // Delayed rejection loop
+      for (unsigned int delay_stage = 0; delay_stage <= max_delays; ++delay_stage)
         {
-          const std::vector<std::pair<OutputType,double>> num_yvec_rev(y.begin() + (num_rejected_samples - j),
-                                                                       y.begin() + num_rejected_samples);
-          const std::vector<std::pair<OutputType,double>> num_yvec(num_yvec_rev.rbegin(), num_yvec_rev.rend() + 1);
-          const std::vector<std::pair<OutputType,double>> den_yvec(y.begin(), y.begin() + j);
-          alpha *= (1 - alpha_fn(yi, num_yvec_rev)) /
-                   (1 - alpha_fn(x, den_yvec));
+          // Obtain a new sample by perturbation of the previous samples
+          // (the previously last accepted one, along with the rejected ones)
+          // and then evaluate its log likelihood.
+          //
+          // TODO: The current implementation discards the second part of the
+          // information returned by the 'perturb' function. This is based on
+          // the assumption that the proposal distributions used by 'perturb'
+          // are symmetric, and that the second number equals 1.0. We should
+          // generalize this.
+          std::pair<OutputType,double> trial_sample_and_ratio = perturb(current_sample,
+                                                                        rejected_samples);
+          OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+          const double trial_log_likelihood = log_likelihood(trial_sample);
+          log_likelihoods.push_back (trial_log_likelihood);
+
+          const double acceptance_ratio = compute_acceptance_ratio (log_likelihoods,
+                                                                    table_size,
+                                                                    acceptance_ratio_table);
+          if (acceptance_ratio > 1 || acceptance_ratio >= uniform_distribution(rng))
+            accepted_sample = true;
+          if (accepted_sample)
+            {
+              current_sample         = std::move(trial_sample);
+              current_log_likelihood = trial_log_likelihood;
+              break;
+            }
+          else if (delay_stage < max_delays)
+            rejected_samples.push_back (std::move(trial_sample));
         }
-      return alpha;
+
+      // Return the new sample (which may be equal to the old sample).
+      return
+      {
+        current_sample,
+        AuxiliaryData
+        {
+          {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+          {AuxiliaryDataKeys::sample_is_repeated, !accepted_sample}
+        }
+      };
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    SampleBatch<OutputType>
+    DelayedRejectionMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    next (const types::sample_index n_samples)
+    {
+      SampleBatch<OutputType> samples;
+      samples.reserve (n_samples);
+      for (types::sample_index i=0; i<n_samples; ++i)
+        samples.emplace_back (next());
+      return samples;
     }
 
 
-    template <typename OutputType>
+
+    template <typename OutputType, typename RandomNumberGenerator>
     void
-    DelayedRejectionMetropolisHastings<OutputType>::
+    DelayedRejectionMetropolisHastings<OutputType,RandomNumberGenerator>::
     sample (const OutputType &starting_point,
             const std::function<double (const OutputType &)> &log_likelihood,
             const std::function<std::pair<OutputType,double> (const OutputType &, const std::vector<OutputType> &)> &perturb,
             const unsigned int max_delays,
             const types::sample_index n_samples,
-            const std::mt19937::result_type random_seed)
+            const typename RandomNumberGenerator::result_type random_seed)
     {
       // Make sure the flush_consumers() function is called at any point
       // where we exit the current function.
@@ -187,65 +403,18 @@ namespace SampleFlow
         this->flush_consumers();
       });
 
-      std::mt19937 rng;
-      if (random_seed != std::mt19937::result_type {})
-        rng.seed(random_seed);
-
-      std::uniform_real_distribution<> uniform_distribution(0,1);
+      // Set up a chain that produces the samples, and that calls the
+      // caller's function objects rather than copies of them.
+      Chain chain (starting_point, std::cref(log_likelihood), std::cref(perturb),
+                   max_delays, random_seed);
 
-      OutputType current_sample         = starting_point;
-      double     current_log_likelihood = log_likelihood (current_sample);
-
-      // Loop over the desired number of samples
+      // Loop over the desired number of samples and output each of them
+      // (which may be equal to the previous one).
       for (types::sample_index i=0; i<n_samples; ++i)
         {
-          // Initialize a vector to store rejected samples, along with their
-          // log likelihoods
-          std::vector<std::pair<OutputType,double>> proposed_samples;
-          // Initialize a bool to store whether a sample is accepted
-          bool accepted_sample = false;
-          // Delayed rejection loop
-          for (unsigned int delay_stage = 0; delay_stage <= max_delays; ++delay_stage)
-            {
-              // Obtain a new sample by perturbation of the previous samples
-              // (the previously last accepted one, along with the rejected ones)
-              // and then evaluate its log likelihood.
-              //
-              // TODO: The current implementation discards the second part of the
-              // information returned by the 'perturb' function. This is based on
-              // the assumption that the proposal distributions used by 'perturb'
-              // are symmetric, and that the second number equals 1.0. We should
-              // generalize this.
-              std::vector<OutputType> proposed_samples_only (proposed_samples.size());
-              for (unsigned int i=0; i<proposed_samples.size(); ++i)
-                proposed_samples_only[i] = proposed_samples[i].first;
-              std::pair<OutputType,double> trial_sample_and_ratio = perturb(current_sample,
-                                                                            proposed_samples_only);
-              const OutputType trial_sample = std::move(trial_sample_and_ratio.first);
-              const double trial_log_likelihood = log_likelihood(trial_sample);
-              proposed_samples.push_back({trial_sample, trial_log_likelihood});
-
-              const double acceptance_ratio = alpha_fn({current_sample, current_log_likelihood},
-                                                       proposed_samples);
-              if (acceptance_ratio > 1 || acceptance_ratio >= uniform_distribution(rng))
-                accepted_sample = true;
-              if (accepted_sample)
-                {
-                  current_sample         = trial_sample;
-                  current_log_likelihood = trial_log_likelihood;
-                  break;
-                }
-            }
-
-          // Output the new sample (which may be equal to the old sample).
-          this->issue_sample (current_sample,
-          {
-            {"relative log likelihood", boost::any(current_log_likelihood)},
-            {"sample is repeated", boost::any(!accepted_sample)}
-          });
+          std::pair<OutputType,AuxiliaryData> sample = chain.next();
+          this->send_sample (std::move(sample.first), std::move(sample.second));
         }
-
-      this->flush_consumers();
     }
 
   }
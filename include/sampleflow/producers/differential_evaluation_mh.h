@@ -19,11 +19,17 @@
 
 #include <sampleflow/producer.h>
 #include <sampleflow/scope_exit.h>
+#include <sampleflow/thread_pool.h>
 #include <sampleflow/types.h>
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
 #include <random>
 #include <cmath>
+#include <utility>
+#include <vector>
 
 namespace SampleFlow
 {
@@ -38,11 +44,169 @@ namespace SampleFlow
      * This class provides the same functionality as Metropolis Hastings but does
      * so over $N$ chains simultaneously, which can improve the rate of convergence. The
      * number of chains $N$ is given as an argument to the sample() function.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The trial samples of all chains in one "generation" only depend on
+     * the samples of the previous generation, and their log likelihoods can
+     * therefore be evaluated concurrently. If a ThreadPool has been selected
+     * via set_thread_pool(), then sample() does so, and the `log_likelihood`
+     * function must then be safe to call concurrently. The `perturb` and
+     * `crossover` functions, as well as the random number generator used to
+     * select chains for crossover and to accept or reject trial samples,
+     * are only used on the thread that calls sample(), in the same order
+     * as without a thread pool. Consequently, the samples produced (and the
+     * order in which they are sent to consumers) do not depend on whether,
+     * and with how many threads, a thread pool is used.
+     *
+     *
+     * ### Producing samples on demand ###
+     *
+     * Like the MetropolisHastings class, this class provides a nested class
+     * Chain that produces samples one at a time, on demand, rather than all
+     * at once through sample(); see the section on producing samples on
+     * demand in the documentation of the MetropolisHastings class. Because
+     * the chains of one generation are advanced together, a Chain object
+     * computes a whole generation whenever it runs out of samples, and then
+     * returns the samples of that generation one at a time in the order of
+     * chains -- i.e., in the same order in which sample() sends them to
+     * consumers.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
      */
-    template <typename OutputType>
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
     class DifferentialEvaluationMetropolisHastings : public Producer<OutputType>
     {
       public:
+        /**
+         * A class that represents the state of a set of differential
+         * evaluation chains and produces their samples one at a time. This is
+         * the analog of MetropolisHastings::Chain.
+         */
+        class Chain
+        {
+          public:
+            /**
+             * Constructor. The arguments have the same meaning as for
+             * DifferentialEvaluationMetropolisHastings::sample(). The
+             * function objects are copied and stored.
+             */
+            Chain (const std::vector<OutputType> &starting_points,
+                   const std::function<double (const OutputType &)> &log_likelihood,
+                   const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                   const std::function<OutputType (const OutputType &, const OutputType &, const OutputType &)> &crossover,
+                   const unsigned int crossover_gap,
+                   const typename RandomNumberGenerator::result_type random_seed = {});
+
+            /**
+             * Select the ThreadPool on which the log likelihoods of the
+             * trial samples of each generation are evaluated. See
+             * DifferentialEvaluationMetropolisHastings::set_thread_pool().
+             */
+            void
+            set_thread_pool (ThreadPool &thread_pool);
+
+            /**
+             * Return the next sample along with its auxiliary data. If all
+             * samples of the current generation have already been returned,
+             * then this function first computes the next generation.
+             */
+            std::pair<OutputType,AuxiliaryData>
+            next ();
+
+            /**
+             * Return the given number of next samples along with their
+             * auxiliary data.
+             */
+            SampleBatch<OutputType>
+            next (const types::sample_index n_samples);
+
+          private:
+            /**
+             * Advance the first `n_active_chains` chains by one generation,
+             * and append the samples so produced to the given array.
+             */
+            void
+            compute_generation (const typename std::vector<OutputType>::size_type n_active_chains,
+                                SampleBatch<OutputType> &samples);
+
+            /**
+             * The functions and parameters that define the chains.
+             */
+            const std::function<double (const OutputType &)> log_likelihood;
+            const std::function<std::pair<OutputType,double> (const OutputType &)> perturb;
+            const std::function<OutputType (const OutputType &, const OutputType &, const OutputType &)> crossover;
+            const unsigned int crossover_gap;
+
+            /**
+             * The pool on which log likelihoods are evaluated, or `nullptr`.
+             */
+            ThreadPool *thread_pool;
+
+            /**
+             * The random number generator used to select chains for crossover
+             * and to accept or reject samples, and the distribution used to
+             * accept or reject samples.
+             */
+            RandomNumberGenerator rng;
+            std::uniform_real_distribution<> uniform_distribution;
+
+            /**
+             * The index of the next generation to be computed.
+             */
+            types::sample_index generation;
+
+            /**
+             * The current samples of all chains and their log likelihoods, as
+             * well as an array to store new values so that all crossovers
+             * can be performed with the previous set of samples. At the end
+             * of each generation, the two arrays of samples are swapped.
+             */
+            std::vector<OutputType> current_samples;
+            std::vector<double>     current_log_likelihoods;
+            std::vector<OutputType> next_samples;
+
+            /**
+             * For each chain, the trial sample, the proposal distribution
+             * ratio, its log likelihood, and the random number against which
+             * the acceptance ratio is compared.
+             */
+            std::vector<OutputType> trial_samples;
+            std::vector<double>     proposal_distribution_ratios;
+            std::vector<double>     trial_log_likelihoods;
+            std::vector<double>     acceptance_thresholds;
+
+            /**
+             * The samples of the most recently computed generation, and the
+             * index of the first one that has not been returned by next()
+             * yet.
+             */
+            SampleBatch<OutputType> generation_samples;
+            std::size_t             next_generation_sample;
+
+            friend class DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>;
+        };
+
+        /**
+         * Constructor.
+         */
+        DifferentialEvaluationMetropolisHastings ();
+
+        /**
+         * Select the ThreadPool on which the log likelihoods of the trial
+         * samples of each generation are evaluated. If this function is not
+         * called, then they are evaluated one after the other on the thread
+         * that calls sample().
+         *
+         * @param[in] thread_pool The pool to submit tasks to. The pool needs
+         *   to live at least as long as the current object.
+         */
+        void
+        set_thread_pool (ThreadPool &thread_pool);
+
         /**
          * The principal function of this class. Starting from the given
          * initial samples $x_{i, 0}$, it produces a multiple chains of
@@ -116,20 +280,221 @@ namespace SampleFlow
                 const std::function<OutputType (const OutputType &, const OutputType &, const OutputType &)> &crossover,
                 const unsigned int crossover_gap,
                 const types::sample_index n_samples,
-                const std::mt19937::result_type random_seed = {});
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+      private:
+        /**
+         * The pool on which log likelihoods are evaluated, or `nullptr` if
+         * they are to be evaluated on the thread that calls sample().
+         */
+        ThreadPool *thread_pool;
     };
 
 
-    template <typename OutputType>
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::
+    DifferentialEvaluationMetropolisHastings ()
+      :
+      thread_pool (nullptr)
+    {}
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
     void
-    DifferentialEvaluationMetropolisHastings<OutputType>::
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::
+    set_thread_pool (ThreadPool &thread_pool)
+    {
+      this->thread_pool = &thread_pool;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    Chain (const std::vector<OutputType> &starting_points,
+           const std::function<double (const OutputType &)> &log_likelihood,
+           const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+           const std::function<OutputType (const OutputType &, const OutputType &, const OutputType &)> &crossover,
+           const unsigned int crossover_gap,
+           const typename RandomNumberGenerator::result_type random_seed)
+      :
+      log_likelihood (log_likelihood),
+      perturb (perturb),
+      crossover (crossover),
+      crossover_gap (crossover_gap),
+      thread_pool (nullptr),
+      uniform_distribution (0,1),
+      generation (0),
+      current_samples (starting_points),
+      current_log_likelihoods (starting_points.size()),
+      next_samples (starting_points),
+      trial_samples (starting_points.size()),
+      proposal_distribution_ratios (starting_points.size()),
+      trial_log_likelihoods (starting_points.size()),
+      acceptance_thresholds (starting_points.size()),
+      next_generation_sample (0)
+    {
+      assert (starting_points.size() >= 3);
+
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    set_thread_pool (ThreadPool &thread_pool)
+    {
+      this->thread_pool = &thread_pool;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::pair<OutputType,AuxiliaryData>
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    next ()
+    {
+      if (next_generation_sample == generation_samples.size())
+        {
+          generation_samples.clear ();
+          compute_generation (current_samples.size(), generation_samples);
+          next_generation_sample = 0;
+        }
+
+      return std::move (generation_samples[next_generation_sample++]);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    SampleBatch<OutputType>
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    next (const types::sample_index n_samples)
+    {
+      SampleBatch<OutputType> samples;
+      samples.reserve (n_samples);
+      for (types::sample_index i=0; i<n_samples; ++i)
+        samples.emplace_back (next());
+      return samples;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    compute_generation (const typename std::vector<OutputType>::size_type n_active_chains,
+                        SampleBatch<OutputType> &samples)
+    {
+      const typename std::vector<OutputType>::size_type n_chains = current_samples.size();
+
+      // First generate the trial samples of all chains of this
+      // generation. All random numbers, including the ones used to
+      // accept or reject trial samples below, are drawn here, on the
+      // current thread and in the same order as if we went through
+      // the chains one after the other.
+      for (typename std::vector<OutputType>::size_type chain = 0; chain < n_active_chains; ++chain)
+        {
+          // Determine trial sample and likelihood ratio; either from
+          // crossover operation or regular perturbation
+          std::pair<OutputType, double> trial_sample_and_ratio;
+
+          // Perform crossover every crossover_gap iterations
+          if ((generation % crossover_gap) == 0 && generation > 0)
+            {
+              // Select two chains to combine
+              std::uniform_int_distribution<typename std::vector<OutputType>::size_type>
+              a_dist(0, n_chains - 2);
+
+              typename std::vector<OutputType>::size_type a = a_dist(rng);
+              if (a >= chain)
+                a += 1;
+              const OutputType &trial_a = current_samples[a];
+
+              std::uniform_int_distribution<typename std::vector<OutputType>::size_type>
+              b_dist(0, n_chains - 3);
+
+              typename std::vector<OutputType>::size_type b = b_dist(rng);
+              if (b >= std::max(a, chain))
+                b += 2;
+              else if (b >= std::min<typename std::vector<OutputType>::size_type>(a, chain))
+                b += 1;
+              const OutputType &trial_b = current_samples[b];
+
+              // Combine trial a and trial b
+              const OutputType crossover_result = crossover(current_samples[chain], trial_a, trial_b);
+              trial_sample_and_ratio = perturb(crossover_result);
+            }
+          else
+            trial_sample_and_ratio = perturb(current_samples[chain]);
+
+          trial_samples[chain] = std::move(trial_sample_and_ratio.first);
+          proposal_distribution_ratios[chain] = trial_sample_and_ratio.second;
+          acceptance_thresholds[chain] = uniform_distribution(rng);
+        }
+
+      // Then evaluate the log likelihoods of all trial samples, on the
+      // thread pool if one has been selected. The trial samples only
+      // depend on the previous generation, so these evaluations are
+      // independent of each other.
+      const auto evaluate = [&](const unsigned int chain)
+      {
+        trial_log_likelihoods[chain] = log_likelihood (trial_samples[chain]);
+      };
+      if (thread_pool != nullptr)
+        thread_pool->parallel_for (n_active_chains, evaluate);
+      else
+        for (unsigned int chain = 0; chain < n_active_chains; ++chain)
+          evaluate (chain);
+
+      // Finally accept or reject the trial samples, and output samples
+      // in the order of chains.
+      for (typename std::vector<OutputType>::size_type chain = 0; chain < n_active_chains; ++chain)
+        {
+          // Accept trial sample with probability equal to ratio of likelihoods;
+          // (always accept if > 1)
+          double acceptance_ratio = (std::exp(trial_log_likelihoods[chain] - current_log_likelihoods[chain]) /
+                                     proposal_distribution_ratios[chain]);
+          bool accepted_sample = false;
+          if (acceptance_ratio >= acceptance_thresholds[chain])
+            accepted_sample = true;
+          if (accepted_sample)
+            {
+              next_samples[chain] = std::move(trial_samples[chain]);
+              current_log_likelihoods[chain] = trial_log_likelihoods[chain];
+            }
+          else
+            next_samples[chain] = current_samples[chain];
+          // Output the new sample (which may be equal to the old sample).
+          samples.emplace_back (current_samples[chain],
+                                AuxiliaryData
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihoods[chain]},
+            {AuxiliaryDataKeys::sample_is_repeated, !accepted_sample}
+          });
+        }
+
+      std::swap (current_samples, next_samples);
+      ++generation;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    DifferentialEvaluationMetropolisHastings<OutputType,RandomNumberGenerator>::
     sample (const std::vector<OutputType> starting_points,
             const std::function<double (const OutputType &)> &log_likelihood,
             const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
             const std::function<OutputType (const OutputType &, const OutputType &, const OutputType &)> &crossover,
             const unsigned int crossover_gap,
             const types::sample_index n_samples,
-            const std::mt19937::result_type random_seed)
+            const typename RandomNumberGenerator::result_type random_seed)
     {
       const typename std::vector<OutputType>::size_type n_chains = starting_points.size();
       assert (n_chains >= 3);
@@ -140,93 +505,28 @@ namespace SampleFlow
         this->flush_consumers();
       });
 
-      std::mt19937 rng;
-      if (random_seed != std::mt19937::result_type {})
-        rng.seed (random_seed);
-
-      // Initialize distribution for comparing to acceptance ratio
-      std::uniform_real_distribution<> uniform_distribution(0,1);
-
-      std::vector<OutputType> current_samples = starting_points;
-      std::vector<double> current_log_likelihoods(n_chains);
-      // Include another array to store new values so that all crossovers
-      // can be performed with the previous set of samples
-      std::vector<OutputType> next_samples = starting_points;
+      // Set up the chains that produce the samples, and that call the
+      // caller's function objects rather than copies of them.
+      Chain chain (starting_points, std::cref(log_likelihood), std::cref(perturb),
+                   std::cref(crossover), crossover_gap, random_seed);
+      if (thread_pool != nullptr)
+        chain.set_thread_pool (*thread_pool);
 
-      // Loop over the desired number of samples, using an outer loop over
-      // "generations" and an inner loop over the individual chains. We
-      // exit from the inner loop when we have reached the desired number of
-      // samples.
-      for (types::sample_index generation=0; true; ++generation)
+      // Loop over the desired number of samples, one "generation" at a
+      // time. The last generation may be incomplete if the number of
+      // samples is not a multiple of the number of chains, in which case
+      // we only advance as many chains as necessary.
+      SampleBatch<OutputType> samples;
+      samples.reserve (n_chains);
+      for (types::sample_index generation=0; generation*n_chains < n_samples; ++generation)
         {
-          // Loop over the desired number of chains
-          for (typename std::vector<OutputType>::size_type chain = 0; chain < n_chains; ++chain)
-            {
-              // Return if we have already generated the desired number of
-              // samples. The ScopeExit object above also makes sure that
-              // we flush the downstream consumers.
-              if (generation * n_chains + chain >= n_samples)
-                return;
-
-              // Determine trial sample and likelihood ratio; either from
-              // crossover operation or regular perturbation
-              std::pair<OutputType, double> trial_sample_and_ratio;
-
-              // Perform crossover every crossover_gap iterations
-              if ((generation % crossover_gap) == 0 && generation > 0)
-                {
-                  // Select two chains to combine
-                  std::uniform_int_distribution<typename std::vector<OutputType>::size_type>
-                  a_dist(0, n_chains - 2);
-
-                  typename std::vector<OutputType>::size_type a = a_dist(rng);
-                  if (a >= chain)
-                    a += 1;
-                  const OutputType trial_a = current_samples[a];
-
-                  std::uniform_int_distribution<typename std::vector<OutputType>::size_type>
-                  b_dist(0, n_chains - 3);
-
-                  typename std::vector<OutputType>::size_type b = b_dist(rng);
-                  if (b >= std::max(a, chain))
-                    b += 2;
-                  else if (b >= std::min<typename std::vector<OutputType>::size_type>(a, chain))
-                    b += 1;
-                  const OutputType trial_b = current_samples[b];
-
-                  // Combine trial a and trial b
-                  const OutputType crossover_result = crossover(current_samples[chain], trial_a, trial_b);
-                  trial_sample_and_ratio = perturb(crossover_result);
-                }
-              else
-                trial_sample_and_ratio = perturb(current_samples[chain]);
-
-              OutputType trial_sample = std::move(trial_sample_and_ratio.first);
-              const double proposal_distribution_ratio = trial_sample_and_ratio.second;
-              const double trial_log_likelihood = log_likelihood (trial_sample);
-              // Accept trial sample with probability equal to ratio of likelihoods;
-              // (always accept if > 1)
-              double acceptance_ratio = (std::exp(trial_log_likelihood - current_log_likelihoods[chain]) /
-                                         proposal_distribution_ratio);
-              bool accepted_sample = false;
-              if (acceptance_ratio >= uniform_distribution(rng))
-                accepted_sample = true;
-              if (accepted_sample)
-                {
-                  next_samples[chain] = trial_sample;
-                  current_log_likelihoods[chain] = log_likelihood(trial_sample);
-                }
-              else
-                next_samples[chain] = current_samples[chain];
-              // Output the new sample (which may be equal to the old sample).
-              this->issue_sample (current_samples[chain],
-              {
-                {"relative log likelihood", boost::any(current_log_likelihoods[chain])},
-                {"sample is repeated", boost::any(!accepted_sample)}
-              });
-            }
+          const typename std::vector<OutputType>::size_type n_active_chains
+            = std::min<types::sample_index> (n_chains, n_samples - generation*n_chains);
 
-          current_samples = next_samples;
+          samples.clear ();
+          chain.compute_generation (n_active_chains, samples);
+          for (auto &sample : samples)
+            this->send_sample (std::move(sample.first), std::move(sample.second));
         }
     }
 
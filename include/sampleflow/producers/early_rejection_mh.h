@@ -0,0 +1,222 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_EARLY_REJECTION_MH_H
+#define SAMPLEFLOW_PRODUCERS_EARLY_REJECTION_MH_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the Metropolis-Hastings algorithm that allows
+     * the evaluation of the log likelihood of a trial sample to stop as
+     * soon as it is clear that the trial sample will be rejected.
+     *
+     * The Metropolis-Hastings algorithm accepts a trial sample $\tilde x$
+     * proposed from the current sample $x$ if
+     * $u \le \frac{\pi(\tilde x)}{\pi(x)}
+     *  \frac{\pi_\text{proposal}(x|\tilde x)}{\pi_\text{proposal}(\tilde x|x)}$
+     * where $u$ is a random number drawn uniformly from $[0,1]$. The
+     * MetropolisHastings class draws $u$ after evaluating $\pi(\tilde x)$,
+     * but nothing prevents us from drawing it *before*. In that case, the
+     * condition above can be written as
+     * @f{align*}{
+     *   \log\pi(\tilde x) \ge \ell_\text{min}
+     *   = \log\pi(x)
+     *     + \log\frac{\pi_\text{proposal}(\tilde x|x)}{\pi_\text{proposal}(x|\tilde x)}
+     *     + \log u,
+     * @f}
+     * and the threshold $\ell_\text{min}$ is known before the log
+     * likelihood of the trial sample is evaluated. This class passes
+     * $\ell_\text{min}$ to the function that evaluates the log likelihood.
+     * In many applications, the log likelihood is a sum of many terms that
+     * are all non-positive -- for example, if
+     * $\pi(x)=\prod_{j=1}^N p(y_j|x)$ is the product of the probabilities
+     * of $N$ independent measurements $y_j$ with $p(y_j|x)\le 1$. Then the
+     * partial sums of $\log\pi(\tilde x)=\sum_j \log p(y_j|\tilde x)$
+     * decrease monotonically, and the evaluation can stop as soon as a
+     * partial sum falls below $\ell_\text{min}$. Since most trial samples are
+     * rejected in a well-tuned sampler, this can reduce the average cost of
+     * evaluating the log likelihood; see @cite SolonenEtAl2012 for a
+     * discussion of this idea. How much is saved depends on how quickly the
+     * partial sums of rejected trial samples fall below the threshold: The
+     * savings are large if the log likelihood of a typical trial sample is
+     * much smaller than that of the current sample (for example during
+     * burn-in, or if the proposal distribution is wide), and small if the
+     * two differ only by a small fraction of the total sum.
+     *
+     * Since the acceptance or rejection of a trial sample only depends on
+     * whether its log likelihood is above or below $\ell_\text{min}$, the
+     * chain produced by this class does not depend on whether (or where)
+     * the log likelihood function stops its evaluation early. In
+     * particular, it is the same chain one gets with a log likelihood
+     * function that ignores the threshold altogether. Because the
+     * random numbers are drawn in a different order, it is a different
+     * (but statistically equivalent) chain than the one produced by the
+     * MetropolisHastings class for the same random seed.
+     *
+     * The AuxiliaryData object associated with each sample stores the same
+     * entries as for the MetropolisHastings class. The relative log
+     * likelihood stored for each sample is always a completely evaluated
+     * one, since only trial samples whose log likelihood is above the
+     * threshold are accepted.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class EarlyRejectionMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects.
+         *
+         * @param[in] starting_point The initial sample $x_0$.
+         * @param[in] log_likelihood A function object that, when called
+         *   with a sample $x$ and a threshold $\ell_\text{min}$, returns
+         *   either $\log(\pi(x))$, or -- if it can already tell that
+         *   $\log(\pi(x))<\ell_\text{min}$ before having completely
+         *   evaluated $\log(\pi(x))$ -- any value less than
+         *   $\ell_\text{min}$. In the latter case, the trial sample will be
+         *   rejected and the value returned is not used otherwise. The
+         *   threshold may be `-std::numeric_limits<double>::infinity()`
+         *   (for example when evaluating the log likelihood of the starting
+         *   point), in which case the function always needs to return the
+         *   complete log likelihood.
+         * @param[in] perturb A function object that returns a trial sample
+         *   and the ratio of proposal probabilities, as described in
+         *   MetropolisHastings::sample().
+         * @param[in] n_samples The number of (new) samples to be produced
+         *   by this function.
+         * @param[in] random_seed The seed of the random number generator
+         *   used to accept or reject samples. See MetropolisHastings::sample().
+         *
+         * Log likelihoods equal to `-std::numeric_limits<double>::max()` or
+         * `-std::numeric_limits<double>::infinity()` indicate a zero
+         * probability and are treated as in MetropolisHastings::sample().
+         * In particular, if the current sample has zero probability, then
+         * no trial sample can be rejected early and the threshold passed to
+         * the `log_likelihood` function is
+         * `-std::numeric_limits<double>::infinity()`.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &, const double)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const types::sample_index n_samples,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    EarlyRejectionMetropolisHastings<OutputType,RandomNumberGenerator>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &, const double)> &log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const types::sample_index n_samples,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      RandomNumberGenerator rng;
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      OutputType current_sample         = starting_point;
+      double     current_log_likelihood = log_likelihood (current_sample,
+                                                          -std::numeric_limits<double>::infinity());
+
+      for (types::sample_index i=0; i<n_samples; ++i)
+        {
+          std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample);
+          OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+          const double proposal_distribution_ratio = trial_sample_and_ratio.second;
+
+          // Draw the random number that decides about acceptance first, and
+          // convert it into a lower bound for the log likelihood of the
+          // trial sample. If the current sample has zero probability, then
+          // every trial sample with nonzero probability is accepted, and
+          // there is no bound.
+          const double u = uniform_distribution(rng);
+          const bool current_sample_has_zero_probability
+            = internal::is_zero_probability (current_log_likelihood);
+          const double log_likelihood_threshold
+            = (current_sample_has_zero_probability ?
+               -std::numeric_limits<double>::infinity() :
+               current_log_likelihood + std::log(proposal_distribution_ratio) + std::log(u));
+
+          const double trial_log_likelihood = log_likelihood (trial_sample,
+                                                              log_likelihood_threshold);
+
+          // Then decide about acceptance. Other than the order in which
+          // things happen, this is the same as in
+          // MetropolisHastings::sample(), using the random number drawn
+          // above:
+          const auto drawn_u = [u](RandomNumberGenerator &)
+          {
+            return u;
+          };
+
+          bool repeated_sample;
+          if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihood,
+                                             proposal_distribution_ratio,
+                                             rng, drawn_u))
+            {
+              current_sample         = std::move(trial_sample);
+              current_log_likelihood = trial_log_likelihood;
+
+              repeated_sample = false;
+            }
+          else
+            repeated_sample = true;
+
+          this->send_sample (current_sample,
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+            {AuxiliaryDataKeys::sample_is_repeated, repeated_sample}
+          });
+        }
+    }
+
+  }
+}
+
+
+#endif
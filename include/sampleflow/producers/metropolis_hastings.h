@@ -17,13 +17,20 @@
 #define SAMPLEFLOW_PRODUCERS_METROPOLIS_HASTINGS_H
 
 #include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/binary_io.h>
 #include <sampleflow/scope_exit.h>
 #include <sampleflow/types.h>
 
 #include <random>
 #include <functional>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <istream>
 #include <limits>
+#include <memory>
+#include <ostream>
 
 namespace SampleFlow
 {
@@ -54,9 +61,11 @@ namespace SampleFlow
      * Producer::connect_to_signal() or using Consumer::connect_to_producer())
      * one at a time. The AuxiliaryData object associated with each sample
      * $x_k$ stores two entries:
-     * - An entry with name "relative log likelihood" of type
+     * - An entry with name "relative log likelihood" (i.e., key
+     *   AuxiliaryDataKeys::relative_log_likelihood) of type
      *   `double` that stores $\log(\pi(x_k))$;
-     * - An entry with name "sample is repeated" that stores a `bool`
+     * - An entry with name "sample is repeated" (i.e., key
+     *   AuxiliaryDataKeys::sample_is_repeated) that stores a `bool`
      *   indicating whether the algorithm has chosen the current
      *   sample as an accepted trial sample (if `false`) or whether
      *   it is a repeated sample because the trial sample has been
@@ -486,11 +495,238 @@ namespace SampleFlow
      * draw samples from `std::complex` numbers, quaternions, graphs, or,
      * in essence, any other data type for which one can define the necessary
      * operations mentioned above.
+     *
+     *
+     * <h3>Sending samples in blocks</h3>
+     *
+     * By default, every sample is sent to downstream consumers as soon as it
+     * has been produced. If the constructor is given a batch size greater
+     * than one, then samples are instead collected into blocks of that
+     * size, and each block is sent downstream as a whole (see the discussion
+     * of batches in the documentation of the Producer class). This reduces
+     * the overhead of getting samples to consumers if the likelihood
+     * and perturbation functions are cheap to evaluate. On the other hand,
+     * consumers then only see samples with a delay, and so this should not
+     * be used if the `perturb` function queries consumers, as in the
+     * Adaptive Metropolis example above.
+     *
+     *
+     * <h3>Producing samples on demand</h3>
+     *
+     * The sample() function produces a given number of samples and sends
+     * them to consumers before it returns. Sometimes, one would rather like
+     * to ask for one sample at a time, for example to embed sampling into
+     * an event loop, to process samples in some other way than through
+     * consumers, or to advance several chains in turn on the same thread.
+     * For these cases, the class provides the nested class Chain, which
+     * stores the state of a chain and produces the next sample (along with
+     * the same auxiliary data as sample()) every time its Chain::next()
+     * function is called:
+     * @code
+     *   std::vector<MetropolisHastings<SampleType>::Chain> chains;
+     *   for (unsigned int c=0; c<n_chains; ++c)
+     *     chains.emplace_back (starting_points[c], &log_likelihood, &perturb,
+     *                          1+c);
+     *
+     *   while (...)
+     *     for (auto &chain : chains)
+     *       {
+     *         const std::pair<SampleType,AuxiliaryData> sample = chain.next();
+     *         ...process the sample...
+     *       }
+     * @endcode
+     * The sample() function itself uses a Chain object, and so a Chain
+     * object produces exactly the same sequence of samples as a call to
+     * sample() with the same arguments.
+     *
+     *
+     * <h3>Continuing and resuming chains</h3>
+     *
+     * Each call to sample() starts a new chain at the given starting point.
+     * If one wants to split a long chain into pieces -- for example to
+     * query consumers in between -- then one can instead continue the chain
+     * started by the last call to sample() via sample_more():
+     * @code
+     *   mh_sampler.sample (starting_point, &log_likelihood, &perturb, 10000);
+     *   while (...convergence criterion not satisfied...)
+     *     mh_sampler.sample_more (10000);
+     * @endcode
+     * The samples so produced are exactly the same as if they had all been
+     * produced by one call to sample().
+     *
+     * The state of the chain can also be written to a stream via
+     * save_state(), in a compact binary form. A program that has been
+     * terminated can then later restore it via load_state() and continue
+     * the chain where it left off:
+     * @code
+     *   // In the first run of the program:
+     *   mh_sampler.sample (starting_point, &log_likelihood, &perturb, 10000);
+     *   std::ofstream output ("chain.state", std::ios::binary);
+     *   mh_sampler.save_state (output);
+     *
+     *   // In the next run of the program:
+     *   std::ifstream input ("chain.state", std::ios::binary);
+     *   mh_sampler.load_state (input, &log_likelihood, &perturb);
+     *   mh_sampler.sample_more (10000);
+     * @endcode
+     * If the `perturb` function uses a random number generator of its own,
+     * then its state needs to be saved and restored separately (for
+     * example via Utilities::write_binary() and Utilities::read_binary())
+     * for the continued chain to be exactly the same as one that had not
+     * been interrupted. The default way of writing and reading samples
+     * only works for trivially copyable types such as `double` or
+     * `std::array<double,N>`; for other types, save_state() and load_state()
+     * take functions that write and read samples as additional arguments.
+     *
+     *
+     * <h3>Random number generators</h3>
+     *
+     * By default, this class (like all other producers) draws the random
+     * numbers it needs from a generator of type `std::mt19937`. The second
+     * template argument of the class allows selecting a different type of
+     * generator; it needs to satisfy the requirements the C++ standard
+     * places on "uniform random bit generators", and be constructible from
+     * and re-seedable with a seed of type `RandomNumberGenerator::result_type`.
+     * A good alternative is the "counter-based" generator Philox4x32, whose
+     * state is only a few dozen bytes (rather than the roughly 2.5 kB of
+     * `std::mt19937`), and which provides many non-overlapping streams of
+     * numbers for the same seed. Producers that use more than one generator
+     * -- for example the MultiChainMetropolisHastings,
+     * ParallelTempering, and AffineInvariantEnsemble classes, which use
+     * one per chain, replica, or walker -- obtain them via
+     * Utilities::make_random_number_generator(), which for Philox4x32
+     * assigns them distinct streams:
+     * @code
+     *   std::pair<SampleType,double> perturb (const SampleType &x,
+     *                                         Philox4x32 &rng);
+     *
+     *   MultiChainMetropolisHastings<SampleType,Philox4x32> sampler;
+     *   sampler.sample (starting_points, &log_likelihood, &perturb,
+     *                   n_samples_per_chain, seed);
+     * @endcode
      */
-    template <typename OutputType>
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
     class MetropolisHastings : public Producer<OutputType>
     {
       public:
+        /**
+         * A class that represents the state of a Metropolis-Hastings chain
+         * -- i.e., the current sample, its log likelihood, and the state of
+         * the random number generator -- and that produces the samples of
+         * the chain one at a time. See the section on producing samples on
+         * demand in the documentation of the MetropolisHastings class.
+         */
+        class Chain
+        {
+          public:
+            /**
+             * Constructor. The arguments have the same meaning as for
+             * MetropolisHastings::sample(). The `log_likelihood` and
+             * `perturb` function objects are copied and stored.
+             */
+            Chain (const OutputType &starting_point,
+                   const std::function<double (const OutputType &)> &log_likelihood,
+                   const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                   const typename RandomNumberGenerator::result_type random_seed = {});
+
+            /**
+             * Constructor. Restore the state of a chain that has previously
+             * been written by save(), and continue it with the given
+             * `log_likelihood` and `perturb` functions. These need to be the
+             * same functions (or equivalent ones) as those used by the chain
+             * whose state was saved.
+             *
+             * @param[in] input_stream The stream to read the state from.
+             * @param[in] log_likelihood See MetropolisHastings::sample().
+             * @param[in] perturb See MetropolisHastings::sample().
+             * @param[in] read_sample A function that reads a sample from the
+             *   stream in the form written by the `write_sample` argument of
+             *   save(). The default, Utilities::read_binary(), can be used if
+             *   `OutputType` is a trivially copyable type such as `double`
+             *   or `std::array<double,N>`.
+             */
+            Chain (std::istream &input_stream,
+                   const std::function<double (const OutputType &)> &log_likelihood,
+                   const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                   const std::function<OutputType (std::istream &)> &read_sample
+                   = &Utilities::read_binary<OutputType>);
+
+            /**
+             * Perform one step of the chain, and return the new sample
+             * along with its auxiliary data.
+             */
+            std::pair<OutputType,AuxiliaryData>
+            next ();
+
+            /**
+             * Perform the given number of steps of the chain, and return
+             * the new samples along with their auxiliary data.
+             */
+            SampleBatch<OutputType>
+            next (const types::sample_index n_samples);
+
+            /**
+             * Return the number of steps the chain has performed so far,
+             * including the steps performed before its state was saved if
+             * it has been restored via the corresponding constructor.
+             */
+            types::sample_index
+            n_steps () const;
+
+            /**
+             * Write the state of the chain -- i.e., the current sample, its
+             * log likelihood, the state of the random number generator, and
+             * the number of steps performed so far -- to the given stream in
+             * binary form. The chain can then later be continued by creating
+             * a Chain object from the stream. The `log_likelihood` and
+             * `perturb` functions are not part of the state.
+             *
+             * @param[in] output_stream The stream to write the state to.
+             * @param[in] write_sample A function that writes a sample to the
+             *   stream. The default, Utilities::write_binary(), can be used
+             *   if `OutputType` is a trivially copyable type.
+             */
+            void
+            save (std::ostream &output_stream,
+                  const std::function<void (std::ostream &, const OutputType &)> &write_sample
+                  = &Utilities::write_binary<OutputType>) const;
+
+          private:
+            /**
+             * The functions that define the chain.
+             */
+            const std::function<double (const OutputType &)> log_likelihood;
+            const std::function<std::pair<OutputType,double> (const OutputType &)> perturb;
+
+            /**
+             * The random number generator used to accept or reject samples,
+             * and the distribution used with it.
+             */
+            RandomNumberGenerator rng;
+            std::uniform_real_distribution<> uniform_distribution;
+
+            /**
+             * The current sample and its log likelihood.
+             */
+            OutputType current_sample;
+            double     current_log_likelihood;
+
+            /**
+             * The number of steps performed so far.
+             */
+            types::sample_index step_counter;
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param[in] batch_size The number of samples that are sent
+         *   downstream together as one block. The last block produced by
+         *   a call to sample() may contain fewer samples.
+         */
+        explicit
+        MetropolisHastings (const unsigned int batch_size = 1);
+
         /**
          * The principal function of this class. Starting from the given
          * initial sample $x_0$, it produces a sequence of samples $x_k$
@@ -565,18 +801,236 @@ namespace SampleFlow
                 const std::function<double (const OutputType &)> &log_likelihood,
                 const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
                 const types::sample_index n_samples,
-                const std::mt19937::result_type random_seed = {});
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+        /**
+         * Continue the chain started by the last call to sample() (or
+         * restored by load_state()) from where it stopped, and produce the
+         * given number of additional samples. In contrast to calling
+         * sample() again with the last sample as starting point, this
+         * neither evaluates the log likelihood of that sample again nor
+         * re-seeds the random number generator: Producing $N$ samples with
+         * one call to sample() yields exactly the same samples as producing
+         * them with a call to sample() followed by calls to sample_more().
+         *
+         * To make this possible, sample() stores copies of its
+         * `log_likelihood` and `perturb` arguments, which are then also used
+         * by this function.
+         */
+        void
+        sample_more (const types::sample_index n_samples);
+
+        /**
+         * Write the state of the chain started by the last call to sample()
+         * (or restored by load_state()) to the given stream in binary form.
+         * See Chain::save() for details.
+         */
+        void
+        save_state (std::ostream &output_stream,
+                    const std::function<void (std::ostream &, const OutputType &)> &write_sample
+                    = &Utilities::write_binary<OutputType>) const;
+
+        /**
+         * Restore the state of a chain that has previously been written by
+         * save_state(), for example by a program that has since been
+         * terminated. The chain can then be continued via sample_more().
+         * See the Chain constructor that reads from a stream for the
+         * meaning of the arguments.
+         */
+        void
+        load_state (std::istream &input_stream,
+                    const std::function<double (const OutputType &)> &log_likelihood,
+                    const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                    const std::function<OutputType (std::istream &)> &read_sample
+                    = &Utilities::read_binary<OutputType>);
+
+      private:
+        /**
+         * The number of samples sent downstream together as one block.
+         */
+        const unsigned int batch_size;
+
+        /**
+         * The chain that produces samples. It is created by sample() and
+         * load_state(), and continued by sample_more().
+         */
+        std::unique_ptr<Chain> chain;
+
+        /**
+         * Produce the given number of samples with the current chain and
+         * send them downstream.
+         */
+        void
+        produce_samples (const types::sample_index n_samples);
     };
 
 
-    template <typename OutputType>
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    MetropolisHastings<OutputType,RandomNumberGenerator>::
+    MetropolisHastings (const unsigned int batch_size)
+      :
+      batch_size (batch_size)
+    {
+      assert (batch_size >= 1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    MetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    Chain (const OutputType &starting_point,
+           const std::function<double (const OutputType &)> &log_likelihood,
+           const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+           const typename RandomNumberGenerator::result_type random_seed)
+      :
+      log_likelihood (log_likelihood),
+      perturb (perturb),
+      uniform_distribution (0,1),
+      current_sample (starting_point),
+      current_log_likelihood (log_likelihood (starting_point)),
+      step_counter (0)
+    {
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    MetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    Chain (std::istream &input_stream,
+           const std::function<double (const OutputType &)> &log_likelihood,
+           const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+           const std::function<OutputType (std::istream &)> &read_sample)
+      :
+      log_likelihood (log_likelihood),
+      perturb (perturb),
+      // Read things in the same order as save() writes them, which is
+      // also the order in which the member variables are initialized:
+      rng (Utilities::read_binary<RandomNumberGenerator> (input_stream)),
+      uniform_distribution (0,1),
+      current_sample (read_sample (input_stream)),
+      current_log_likelihood (Utilities::read_binary<double> (input_stream)),
+      step_counter (Utilities::read_binary<std::uint64_t> (input_stream))
+    {}
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::pair<OutputType,AuxiliaryData>
+    MetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    next ()
+    {
+      // Obtain a new sample by perturbation and evaluate the
+      // log likelihood for it
+      std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample);
+      OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+      const double proposal_distribution_ratio = trial_sample_and_ratio.second;
+
+      const double trial_log_likelihood = log_likelihood (trial_sample);
+
+      // Then see if we want to accept the sample. This happens if either
+      // the new sample has a higher likelihood (which happens if and
+      // only if the log likelihood of the new sample is larger than the
+      // log likelihood of the old sample), or if the ratio of likelihoods
+      // is larger than a randomly drawn number between zero and one. The
+      // ratio of likelihoods equals the exp of the difference of
+      // log likelihoods.
+      //
+      // If the sample is not accepted, then we simply stick with (i.e.,
+      // repeat) the previous sample.
+      //
+      // There are two special cases to consider. If the probability of the
+      // new sample is zero (i.e., the log likelihood is either -infinity or
+      // -numeric_limits<double>::max()), then we never want to accept the
+      // sample and there is no need to do any arithmetic on it. If, on
+      // the other hand, the sample has a zero probability *and* the
+      // previous probability was *also* zero, then we want to accept it
+      // (with probability min{1,1/r} for proposal distribution ratio r) so
+      // that we can do a random walk that hopefully at some point leads
+      // to an area of nonzero probabilities.
+      //
+      // All of this is implemented in internal::accept_trial_sample(),
+      // which the other Metropolis-Hastings-type producers also use.
+      bool repeated_sample;
+      if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihood,
+                                         proposal_distribution_ratio,
+                                         rng, uniform_distribution))
+        {
+          current_sample         = std::move(trial_sample);
+          current_log_likelihood = trial_log_likelihood;
+
+          repeated_sample = false;
+        }
+      else
+        repeated_sample = true;
+
+      ++step_counter;
+
+      // Return the new sample (which may be equal to the old sample)
+      return
+      {
+        current_sample,
+        AuxiliaryData
+        {
+          {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+          {AuxiliaryDataKeys::sample_is_repeated, repeated_sample}
+        }
+      };
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    SampleBatch<OutputType>
+    MetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    next (const types::sample_index n_samples)
+    {
+      SampleBatch<OutputType> samples;
+      samples.reserve (n_samples);
+      for (types::sample_index i=0; i<n_samples; ++i)
+        samples.emplace_back (next());
+      return samples;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    types::sample_index
+    MetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    n_steps () const
+    {
+      return step_counter;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
     void
-    MetropolisHastings<OutputType>::
+    MetropolisHastings<OutputType,RandomNumberGenerator>::Chain::
+    save (std::ostream &output_stream,
+          const std::function<void (std::ostream &, const OutputType &)> &write_sample) const
+    {
+      // The uniform distribution does not have any state that would need
+      // to be saved. Write everything else in the order in which the
+      // constructor that reads the state initializes member variables.
+      Utilities::write_binary (output_stream, rng);
+      write_sample (output_stream, current_sample);
+      Utilities::write_binary (output_stream, current_log_likelihood);
+      Utilities::write_binary (output_stream, static_cast<std::uint64_t>(step_counter));
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MetropolisHastings<OutputType,RandomNumberGenerator>::
     sample (const OutputType &starting_point,
             const std::function<double (const OutputType &)> &log_likelihood,
             const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
             const types::sample_index n_samples,
-            const std::mt19937::result_type random_seed)
+            const typename RandomNumberGenerator::result_type random_seed)
     {
       // Make sure the flush_consumers() function is called at any point
       // where we exit the current function.
@@ -585,81 +1039,95 @@ namespace SampleFlow
         this->flush_consumers();
       });
 
-      std::mt19937 rng;
-      if (random_seed != std::mt19937::result_type {})
-        rng.seed (random_seed);
+      // Set up a chain that produces the samples. The chain outlives this
+      // call (see sample_more()), so it must own copies of the function
+      // objects.
+      chain.reset (new Chain (starting_point, log_likelihood, perturb,
+                              random_seed));
 
-      std::uniform_real_distribution<> uniform_distribution(0,1);
+      produce_samples (n_samples);
+    }
 
-      OutputType current_sample         = starting_point;
-      double     current_log_likelihood = log_likelihood (current_sample);
 
-      // Loop over the desired number of samples
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MetropolisHastings<OutputType,RandomNumberGenerator>::
+    sample_more (const types::sample_index n_samples)
+    {
+      assert (chain != nullptr);
+
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      produce_samples (n_samples);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MetropolisHastings<OutputType,RandomNumberGenerator>::
+    save_state (std::ostream &output_stream,
+                const std::function<void (std::ostream &, const OutputType &)> &write_sample) const
+    {
+      assert (chain != nullptr);
+      chain->save (output_stream, write_sample);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MetropolisHastings<OutputType,RandomNumberGenerator>::
+    load_state (std::istream &input_stream,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const std::function<OutputType (std::istream &)> &read_sample)
+    {
+      chain.reset (new Chain (input_stream, log_likelihood, perturb, read_sample));
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MetropolisHastings<OutputType,RandomNumberGenerator>::
+    produce_samples (const types::sample_index n_samples)
+    {
+      // If we send samples downstream in blocks, this is where we collect
+      // them:
+      SampleBatch<OutputType> samples;
+      if (batch_size > 1)
+        samples.reserve (batch_size);
+
+      // Loop over the desired number of samples, and output each new sample
+      // or put it into the current block of samples and output that if it
+      // is full.
       for (types::sample_index i=0; i<n_samples; ++i)
         {
-          // Obtain a new sample by perturbation and evaluate the
-          // log likelihood for it
-          std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample);
-          OutputType trial_sample = std::move(trial_sample_and_ratio.first);
-          const double proposal_distribution_ratio = trial_sample_and_ratio.second;
-
-          const double trial_log_likelihood = log_likelihood (trial_sample);
-
-          // Then see if we want to accept the sample. This happens if either
-          // the new sample has a higher likelihood (which happens if and
-          // only if the log likelihood of the new sample is larger than the
-          // log likelihood of the old sample), or if the ratio of likelihoods
-          // is larger than a randomly drawn number between zero and one. The
-          // ratio of likelihoods equals the exp of the difference of
-          // log likelihoods.
-          //
-          // If the sample is not accepted, then we simply stick with (i.e.,
-          // repeat) the previous sample.
-          //
-          // There are two special cases to consider. If the probability of the
-          // new sample is zero (i.e., the log likelihood is either -infinity or
-          // -numeric_limits<double>::max()), then we never want to accept the
-          // sample and there is no need to do any arithmetic on it. If, on
-          // the other hand, the sample has a zero probability *and* the
-          // previous probability was *also* zero, then we always want to accept
-          // it so that we can do a random walk that hopefully at some point leads
-          // to an area of nonzero probabilities.
-          const bool trial_sample_has_zero_probability
-            = ((trial_log_likelihood == -std::numeric_limits<double>::max())
-               ||
-               (trial_log_likelihood == -std::numeric_limits<double>::infinity()));
-          const bool current_sample_has_zero_probability
-            = ((current_log_likelihood == -std::numeric_limits<double>::max())
-               ||
-               (current_log_likelihood == -std::numeric_limits<double>::infinity()));
-
-          bool repeated_sample;
-          if (!(trial_sample_has_zero_probability && !current_sample_has_zero_probability)
-              &&
-              ((trial_sample_has_zero_probability && current_sample_has_zero_probability
-                && (1. / proposal_distribution_ratio >= uniform_distribution(rng)))
-               ||
-               (trial_log_likelihood - std::log(proposal_distribution_ratio) > current_log_likelihood)
-               ||
-               (std::exp(trial_log_likelihood - current_log_likelihood) / proposal_distribution_ratio >= uniform_distribution(rng))))
+          std::pair<OutputType,AuxiliaryData> sample = chain->next();
+          if (batch_size == 1)
+            this->send_sample (std::move(sample.first), std::move(sample.second));
+          else
             {
-              current_sample         = trial_sample;
-              current_log_likelihood = trial_log_likelihood;
-
-              repeated_sample = false;
+              samples.emplace_back (std::move(sample));
+              if (samples.size() == batch_size)
+                {
+                  this->issue_sample_batch (samples);
+                  samples.clear ();
+                }
             }
-          else
-            repeated_sample = true;
-
-          // Output the new sample (which may be equal to the old sample).
-          this->issue_sample (current_sample,
-          {
-            {"relative log likelihood", boost::any(current_log_likelihood)},
-            {"sample is repeated", boost::any(repeated_sample)}
-          });
         }
 
-      this->flush_consumers();
+      // Send what is left of the last block. Consumers are flushed by the
+      // callers of this function when they return.
+      if (samples.size() > 0)
+        this->issue_sample_batch (samples);
     }
 
   }
@@ -0,0 +1,325 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_MULTI_CHAIN_MH_H
+#define SAMPLEFLOW_PRODUCERS_MULTI_CHAIN_MH_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/random.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * A producer that runs several independent Metropolis-Hastings chains
+     * at the same time, each on its own thread. Each chain works exactly
+     * as the one run by the MetropolisHastings class, and the documentation
+     * of that class discusses the algorithm and the arguments to the
+     * sample() function. If evaluating the log likelihood is expensive, then
+     * running $K$ chains on $K$ threads produces (almost) $K$ times as many
+     * samples in the same wall-clock time as a single chain, provided the
+     * machine has at least $K$ processor cores.
+     *
+     * The number of chains is the number of starting points passed to the
+     * sample() function, and each chain uses its own random number
+     * generator. The samples of all chains are sent to the same downstream
+     * consumers. To this end, all chains pass their samples through a
+     * common lock, so that a consumer only ever receives one sample (or
+     * block of samples) at a time, just as if all samples had been
+     * produced by a single MetropolisHastings object. Consumers therefore
+     * do not need to know that the samples come from several threads.
+     * They will, however, see the samples of the different chains
+     * interleaved in an unpredictable order. For consumers that accumulate
+     * statistics over all samples (mean values, covariance matrices,
+     * histograms, etc.) this does not matter; for consumers that care about
+     * the order of samples (for example, Consumers::AutoCovarianceMatrix),
+     * one will want to separate the chains again, using the chain index
+     * described below.
+     *
+     * The AuxiliaryData object associated with each sample stores the same
+     * two entries as for the MetropolisHastings class, plus
+     * - An entry with name "chain index" (i.e., key
+     *   AuxiliaryDataKeys::chain_index) of type `unsigned int` that stores
+     *   the number of the chain that produced the sample, i.e., the index
+     *   of its starting point in the array passed to sample().
+     *
+     *
+     * ### Threading model ###
+     *
+     * The `log_likelihood` and `perturb` functions passed to sample() are
+     * called concurrently from several threads, and must be written
+     * accordingly. In particular, the `perturb` function must not use a
+     * random number generator shared between calls, such as the `static`
+     * generators in the examples of the MetropolisHastings class. Instead,
+     * it receives the random number generator of the chain it is called for
+     * as its second argument.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class MultiChainMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] batch_size The number of samples of each chain that
+         *   are sent downstream together as one block. Since each chain
+         *   has to acquire the lock mentioned in the class documentation
+         *   only once per block, choosing a batch size greater than one
+         *   reduces the time chains spend waiting for each other. The last
+         *   block of each chain produced by a call to sample() may contain
+         *   fewer samples.
+         */
+        explicit
+        MultiChainMetropolisHastings (const unsigned int batch_size = 1);
+
+        /**
+         * The principal function of this class. Starting from each of the
+         * given initial samples $x_{i,0}$, it runs one chain $x_{i,k}$ on a
+         * separate thread and passes the samples of all chains through the
+         * signal of the base class to Consumer objects. The function returns
+         * once all chains have produced their samples. If the
+         * `log_likelihood` or `perturb` function throws an exception on one
+         * of the chains, then the other chains stop after their current
+         * step, and the exception is re-thrown once all chains have
+         * stopped.
+         *
+         * @param[in] starting_points The initial samples $x_{i,0}$ of each
+         *   chain $i$. The number of starting points determines how many
+         *   chains (and threads) this function runs.
+         * @param[in] log_likelihood A function object that, when called
+         *   with a sample $x$, returns $\log(\pi(x))$. See
+         *   MetropolisHastings::sample() for details.
+         * @param[in] perturb A function object that, when given a sample
+         *   $x$ and the random number generator of the chain $x$ belongs
+         *   to, returns a trial sample $\tilde x$ and the ratio
+         *   $\frac{\pi_\text{proposal}(\tilde x|x)}
+         *         {\pi_\text{proposal}(x|\tilde x)}$. See
+         *   MetropolisHastings::sample() for details.
+         * @param[in] n_samples_per_chain The number of (new) samples each
+         *   of the chains produces.
+         * @param[in] random_seed The random number generator of chain $i$
+         *   is seeded from this seed and the number $i$. Passing the same
+         *   seed every time this function is called results in the same
+         *   sequence of samples for each of the chains -- though not
+         *   necessarily in the same interleaving of samples from
+         *   different chains.
+         */
+        void
+        sample (const std::vector<OutputType> &starting_points,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+                const types::sample_index n_samples_per_chain,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+      private:
+        /**
+         * The number of samples sent downstream together as one block.
+         */
+        const unsigned int batch_size;
+
+        /**
+         * A mutex that the chains acquire before sending samples
+         * downstream.
+         */
+        std::mutex send_mutex;
+
+        /**
+         * Run one chain. This is the function executed by each of the
+         * threads started by sample(). The chain stops early once `stop`
+         * is set, which another chain does when it throws an exception.
+         */
+        void
+        run_chain (const unsigned int chain,
+                   const OutputType &starting_point,
+                   const std::function<double (const OutputType &)> &log_likelihood,
+                   const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+                   const types::sample_index n_samples,
+                   const typename RandomNumberGenerator::result_type random_seed,
+                   const std::atomic<bool> &stop);
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    MultiChainMetropolisHastings<OutputType,RandomNumberGenerator>::
+    MultiChainMetropolisHastings (const unsigned int batch_size)
+      :
+      batch_size (batch_size)
+    {
+      assert (batch_size >= 1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MultiChainMetropolisHastings<OutputType,RandomNumberGenerator>::
+    sample (const std::vector<OutputType> &starting_points,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+            const types::sample_index n_samples_per_chain,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      assert (starting_points.size() > 0);
+
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      // Start one thread per chain. Exceptions thrown on these threads
+      // are stored and re-thrown on the current thread once all chains
+      // have stopped; the first exception also asks all other chains to
+      // stop, rather than letting them run to completion.
+      const unsigned int n_chains = starting_points.size();
+      std::vector<std::exception_ptr> exceptions (n_chains);
+      std::atomic<bool> stop (false);
+      std::vector<std::thread> threads;
+      threads.reserve (n_chains);
+      for (unsigned int chain=0; chain<n_chains; ++chain)
+        threads.emplace_back ([&, chain]()
+      {
+        try
+          {
+            run_chain (chain, starting_points[chain],
+                       log_likelihood, perturb,
+                       n_samples_per_chain, random_seed, stop);
+          }
+        catch (...)
+          {
+            exceptions[chain] = std::current_exception();
+            stop = true;
+          }
+      });
+
+      for (auto &thread : threads)
+        thread.join();
+
+      for (const auto &exception : exceptions)
+        if (exception)
+          std::rethrow_exception (exception);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MultiChainMetropolisHastings<OutputType,RandomNumberGenerator>::
+    run_chain (const unsigned int chain,
+               const OutputType &starting_point,
+               const std::function<double (const OutputType &)> &log_likelihood,
+               const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+               const types::sample_index n_samples,
+               const typename RandomNumberGenerator::result_type random_seed,
+               const std::atomic<bool> &stop)
+    {
+      // Give each chain its own stream of random numbers, derived from
+      // the seed and the chain number:
+      RandomNumberGenerator rng
+        = Utilities::make_random_number_generator<RandomNumberGenerator> (random_seed, chain);
+
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      OutputType current_sample         = starting_point;
+      double     current_log_likelihood = log_likelihood (current_sample);
+
+      SampleBatch<OutputType> samples;
+      if (batch_size > 1)
+        samples.reserve (batch_size);
+
+      for (types::sample_index i=0; (i<n_samples) && !stop; ++i)
+        {
+          std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample, rng);
+          OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+          const double proposal_distribution_ratio = trial_sample_and_ratio.second;
+
+          const double trial_log_likelihood = log_likelihood (trial_sample);
+
+          // Accept or reject the trial sample in the same way as
+          // MetropolisHastings::sample() does, including the treatment
+          // of samples with zero probability:
+          bool repeated_sample;
+          if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihood,
+                                             proposal_distribution_ratio,
+                                             rng, uniform_distribution))
+            {
+              current_sample         = std::move(trial_sample);
+              current_log_likelihood = trial_log_likelihood;
+
+              repeated_sample = false;
+            }
+          else
+            repeated_sample = true;
+
+          // Output the new sample, or put it into the current block of
+          // samples and output that if it is full. In either case, only
+          // one chain at a time may send samples downstream.
+          AuxiliaryData aux_data
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+            {AuxiliaryDataKeys::sample_is_repeated, repeated_sample},
+            {AuxiliaryDataKeys::chain_index, chain}
+          };
+          if (batch_size == 1)
+            {
+              std::lock_guard<std::mutex> lock (send_mutex);
+              this->send_sample (current_sample, std::move(aux_data));
+            }
+          else
+            {
+              samples.emplace_back (current_sample, std::move(aux_data));
+              if (samples.size() == batch_size)
+                {
+                  std::lock_guard<std::mutex> lock (send_mutex);
+                  this->issue_sample_batch (samples);
+                  samples.clear ();
+                }
+            }
+        }
+
+      // Send what is left of the last block:
+      if (samples.size() > 0)
+        {
+          std::lock_guard<std::mutex> lock (send_mutex);
+          this->issue_sample_batch (samples);
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,412 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_MULTIPLE_TRY_MH_H
+#define SAMPLEFLOW_PRODUCERS_MULTIPLE_TRY_MH_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+#include <algorithm>
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the Multiple-Try Metropolis algorithm of
+     * Liu, Liang, and Wong (2000). In each step, this algorithm draws not
+     * just one, but $M$ trial samples $y_1,\ldots,y_M$ from the proposal
+     * distribution around the current sample $x$, selects one of them, $y$,
+     * with a probability proportional to a weight $w(y_j,x)$, and then
+     * accepts or rejects $y$ in a way that ensures that the resulting chain
+     * samples the target distribution $\pi$. With $M$ trial samples per
+     * step, the chain is more likely to find a good trial sample, and so
+     * has a higher acceptance rate and mixes better than the chain produced
+     * by the MetropolisHastings class -- at the cost of $2M-1$ evaluations
+     * of the log likelihood per step. This class evaluates these
+     * concurrently on a ThreadPool, so that on a machine with enough cores,
+     * a step takes about as much wall-clock time as two steps of the
+     * MetropolisHastings class.
+     *
+     * Specifically, one step of the algorithm consists of the following:
+     * - Draw $y_1,\ldots,y_M$ from the proposal distribution
+     *   $T(\cdot|x)$ (i.e., by calling the `perturb` function $M$ times
+     *   with the current sample $x$), and evaluate $\pi(y_j)$.
+     * - Select one of them, $y=y_j$, with probability proportional to
+     *   $w(y_j,x)$.
+     * - Draw $M-1$ reference points $x^\ast_1,\ldots,x^\ast_{M-1}$ from
+     *   $T(\cdot|y)$, evaluate $\pi(x^\ast_k)$, and set $x^\ast_M=x$.
+     * - Accept $y$ as the next sample with probability
+     *   $\min\left\{1,\frac{\sum_j w(y_j,x)}{\sum_k w(x^\ast_k,y)}\right\}$;
+     *   otherwise repeat $x$.
+     *
+     * For the weights, this class uses
+     * $w(y,x)=\pi(y)\,T(x|y)\,\lambda(x,y)$ with the symmetric function
+     * $\lambda(x,y)=\left(T(y|x)\,T(x|y)\right)^{-1/2}$, which results in
+     * $w(y,x)=\pi(y)\left(\frac{T(y|x)}{T(x|y)}\right)^{-1/2}$. This only
+     * requires the ratio of proposal probabilities that the `perturb`
+     * function already returns for the MetropolisHastings class, and so
+     * this class can use the same `perturb` functions. For symmetric
+     * proposal distributions, the weights are simply $w(y,x)=\pi(y)$. For
+     * $M=1$, the algorithm reduces to the Metropolis-Hastings algorithm
+     * and this class produces exactly the same chain as the
+     * MetropolisHastings class, including while the chain is in a region
+     * of zero probability.
+     *
+     * If all trial samples have zero probability, then this class does
+     * what the MetropolisHastings class does: It rejects the trial samples
+     * unless the current sample also has zero probability. In that case,
+     * it selects one of the trial samples with equal probability and
+     * accepts it with probability $\min\{1,1/r\}$, where $r$ is the
+     * ratio of proposal probabilities returned by the `perturb` function
+     * for this trial sample.
+     *
+     * Like for the MetropolisHastings class, the AuxiliaryData object
+     * associated with each sample stores the log likelihood of the sample
+     * (under the key AuxiliaryDataKeys::relative_log_likelihood) and
+     * whether it is a repeated sample (under the key
+     * AuxiliaryDataKeys::sample_is_repeated).
+     *
+     *
+     * ### Threading model ###
+     *
+     * The `log_likelihood` function passed to sample() is called
+     * concurrently from several threads, namely the thread that calls
+     * sample() and the threads of the ThreadPool selected via
+     * set_thread_pool(). It must therefore be safe to call it concurrently.
+     * The `perturb` function, on the other hand, is only ever called on the
+     * thread that called sample(), and so can use a random number
+     * generator stored in a `static` variable as in the examples in the
+     * documentation of the MetropolisHastings class.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class MultipleTryMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] n_trials The number $M$ of trial samples drawn in
+         *   each step.
+         */
+        explicit
+        MultipleTryMetropolisHastings (const unsigned int n_trials);
+
+        /**
+         * Select the ThreadPool on which the log likelihoods of trial
+         * samples and reference points are evaluated. If this function is
+         * not called, then the pool returned by ThreadPool::default_pool()
+         * is used. The thread that calls sample() also takes part in
+         * evaluating the log likelihoods.
+         *
+         * @param[in] thread_pool The pool to submit tasks to. The pool needs
+         *   to live at least as long as the current object.
+         */
+        void
+        set_thread_pool (ThreadPool &thread_pool);
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects. The arguments have the same meaning as for
+         * MetropolisHastings::sample(), except that the `log_likelihood`
+         * function must be safe to call concurrently (see the
+         * documentation of this class).
+         *
+         * If all trial samples of a step have a zero probability (i.e.,
+         * if `log_likelihood` returns `-std::numeric_limits<double>::max()`
+         * or `-std::numeric_limits<double>::infinity()` for all of them),
+         * then the step is rejected, unless the current sample also has a
+         * zero probability. In the latter case, one of the trial samples is
+         * chosen with equal probability and accepted, so that the chain
+         * performs a random walk until it reaches an area of nonzero
+         * probability.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const types::sample_index n_samples,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+      private:
+        /**
+         * The number $M$ of trial samples drawn in each step.
+         */
+        const unsigned int n_trials;
+
+        /**
+         * The pool on which log likelihoods are evaluated. If this is a
+         * `nullptr` at the time sample() is called, then it is set to
+         * ThreadPool::default_pool().
+         */
+        ThreadPool *thread_pool;
+
+        /**
+         * Evaluate the log likelihood of all of the given points, using the
+         * calling thread and the threads of `thread_pool`, and return the
+         * results.
+         */
+        std::vector<double>
+        evaluate_log_likelihoods (const std::vector<OutputType> &points,
+                                  const std::function<double (const OutputType &)> &log_likelihood);
+    };
+
+
+
+    namespace internal
+    {
+      /**
+       * Return $\log\sum_j e^{a_j}$ for the given values $a_j$, computed
+       * in a way that avoids overflow and underflow.
+       */
+      inline
+      double
+      log_sum_exp (const std::vector<double> &values)
+      {
+        const double max = *std::max_element (values.begin(), values.end());
+        if (max == -std::numeric_limits<double>::infinity())
+          return max;
+
+        double sum = 0;
+        for (const double value : values)
+          sum += std::exp (value - max);
+        return max + std::log (sum);
+      }
+
+
+
+      /**
+       * Return the logarithm $\log w = \ell + c$ of the weight of a
+       * sample with log likelihood $\ell$, where $c$ is the logarithm of
+       * the factor involving the proposal distribution. If $\ell$ denotes
+       * a zero probability (see SampleFlow::internal::is_zero_probability()),
+       * then return `-std::numeric_limits<double>::infinity()`, so that
+       * log_sum_exp() treats the weight as zero also if the user returned
+       * `-std::numeric_limits<double>::max()`.
+       */
+      inline
+      double
+      log_weight (const double log_likelihood,
+                  const double log_factor)
+      {
+        if (SampleFlow::internal::is_zero_probability (log_likelihood))
+          return -std::numeric_limits<double>::infinity();
+        else
+          return log_likelihood + log_factor;
+      }
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    MultipleTryMetropolisHastings<OutputType,RandomNumberGenerator>::
+    MultipleTryMetropolisHastings (const unsigned int n_trials)
+      :
+      n_trials (n_trials),
+      thread_pool (nullptr)
+    {
+      assert (n_trials >= 1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MultipleTryMetropolisHastings<OutputType,RandomNumberGenerator>::
+    set_thread_pool (ThreadPool &thread_pool)
+    {
+      this->thread_pool = &thread_pool;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::vector<double>
+    MultipleTryMetropolisHastings<OutputType,RandomNumberGenerator>::
+    evaluate_log_likelihoods (const std::vector<OutputType> &points,
+                              const std::function<double (const OutputType &)> &log_likelihood)
+    {
+      std::vector<double> results (points.size());
+      thread_pool->parallel_for (points.size(),
+                                 [&](const unsigned int i)
+      {
+        results[i] = log_likelihood (points[i]);
+      });
+
+      return results;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    MultipleTryMetropolisHastings<OutputType,RandomNumberGenerator>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const types::sample_index n_samples,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      if (thread_pool == nullptr)
+        thread_pool = &ThreadPool::default_pool();
+
+      RandomNumberGenerator rng;
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      OutputType current_sample         = starting_point;
+      double     current_log_likelihood = evaluate_log_likelihoods ({current_sample},
+                                                                    log_likelihood)[0];
+
+      std::vector<OutputType> trial_samples (n_trials);
+      std::vector<double>     proposal_ratios (n_trials);
+      std::vector<double>     log_proposal_ratios (n_trials);
+      std::vector<OutputType> reference_points (n_trials-1);
+      for (types::sample_index i=0; i<n_samples; ++i)
+        {
+          // Draw the trial samples and evaluate their weights. We work
+          // with the logarithms of the weights throughout.
+          for (unsigned int j=0; j<n_trials; ++j)
+            {
+              std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample);
+              trial_samples[j]       = std::move(trial_sample_and_ratio.first);
+              proposal_ratios[j]     = trial_sample_and_ratio.second;
+              log_proposal_ratios[j] = std::log (proposal_ratios[j]);
+            }
+          const std::vector<double> trial_log_likelihoods
+            = evaluate_log_likelihoods (trial_samples, log_likelihood);
+
+          std::vector<double> trial_log_weights (n_trials);
+          for (unsigned int j=0; j<n_trials; ++j)
+            trial_log_weights[j] = internal::log_weight (trial_log_likelihoods[j],
+                                                         -log_proposal_ratios[j]/2);
+          const double log_sum_of_trial_weights = internal::log_sum_exp (trial_log_weights);
+
+          // Deal with two special cases first. For M=1, the algorithm is
+          // the Metropolis-Hastings algorithm, and we use the same function
+          // as the MetropolisHastings class to accept or reject so that we
+          // get exactly the same chain. If all trial samples have zero
+          // probability, we do as the MetropolisHastings class does: The
+          // trial sample is rejected unless the current sample also has
+          // zero probability. In the latter case, select one of the trial
+          // samples with equal probability and accept it with the
+          // probability the MetropolisHastings class would use.
+          unsigned int selected = 0;
+          bool         accept;
+          if ((n_trials == 1)
+              ||
+              (log_sum_of_trial_weights == -std::numeric_limits<double>::infinity()))
+            {
+              if (SampleFlow::internal::is_zero_probability (current_log_likelihood) && (n_trials > 1))
+                selected = std::uniform_int_distribution<unsigned int>(0, n_trials-1)(rng);
+
+              accept = SampleFlow::internal::accept_trial_sample (trial_log_likelihoods[selected],
+                                                                  current_log_likelihood,
+                                                                  proposal_ratios[selected],
+                                                                  rng, uniform_distribution);
+            }
+          else
+            {
+              // Select one of the trial samples with a probability
+              // proportional to its weight:
+              double threshold = uniform_distribution(rng);
+              for (; selected<n_trials-1; ++selected)
+                {
+                  threshold -= std::exp (trial_log_weights[selected] - log_sum_of_trial_weights);
+                  if (threshold < 0)
+                    break;
+                }
+
+              // Then draw the reference points around the selected sample
+              // and compute their weights. The last reference point is the
+              // current sample, whose weight $w(x,y)$ contains the inverse
+              // of the proposal ratio of the selected sample:
+              const double selected_log_proposal_ratio = log_proposal_ratios[selected];
+              for (unsigned int k=0; k<n_trials-1; ++k)
+                {
+                  std::pair<OutputType,double> reference_point_and_ratio = perturb (trial_samples[selected]);
+                  reference_points[k] = std::move(reference_point_and_ratio.first);
+                  log_proposal_ratios[k] = std::log (reference_point_and_ratio.second);
+                }
+              const std::vector<double> reference_log_likelihoods
+                = evaluate_log_likelihoods (reference_points, log_likelihood);
+
+              std::vector<double> reference_log_weights (n_trials);
+              for (unsigned int k=0; k<n_trials-1; ++k)
+                reference_log_weights[k] = internal::log_weight (reference_log_likelihoods[k],
+                                                                 -log_proposal_ratios[k]/2);
+              reference_log_weights[n_trials-1]
+                = internal::log_weight (current_log_likelihood,
+                                        selected_log_proposal_ratio/2);
+
+              // Finally accept or reject. Like the MetropolisHastings class,
+              // only draw a random number if the acceptance probability is
+              // less than one.
+              const double log_acceptance_ratio
+                = log_sum_of_trial_weights - internal::log_sum_exp (reference_log_weights);
+              accept = ((log_acceptance_ratio > 0)
+                        ||
+                        (std::exp(log_acceptance_ratio) >= uniform_distribution(rng)));
+            }
+
+          bool repeated_sample;
+          if (accept)
+            {
+              current_sample         = std::move(trial_samples[selected]);
+              current_log_likelihood = trial_log_likelihoods[selected];
+
+              repeated_sample = false;
+            }
+          else
+            repeated_sample = true;
+
+          this->send_sample (current_sample,
+          {
+            {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+            {AuxiliaryDataKeys::sample_is_repeated, repeated_sample}
+          });
+        }
+    }
+
+  }
+}
+
+
+#endif
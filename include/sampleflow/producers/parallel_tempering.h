@@ -0,0 +1,458 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_PARALLEL_TEMPERING_H
+#define SAMPLEFLOW_PRODUCERS_PARALLEL_TEMPERING_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/random.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+#include <algorithm>
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of "parallel tempering", also called "replica
+     * exchange Monte Carlo" (see, for example, @cite EarlDeem05). This
+     * algorithm is useful for distributions $\pi(x)$ with several
+     * well-separated modes, between which a Metropolis-Hastings chain
+     * only moves very rarely (if at all) because it has to pass through
+     * regions of very low probability to get from one to the other.
+     *
+     * The algorithm runs $R$ Metropolis-Hastings chains ("replicas") at the
+     * same time, each sampling a "tempered" distribution
+     * $\pi_r(x) \propto \pi(x)^{1/T_r}$ with a temperature
+     * $1=T_0<T_1<\ldots<T_{R-1}$. The first of these, the "cold" chain,
+     * samples $\pi$ itself. The higher the temperature, the flatter the
+     * distribution $\pi_r$, and the more easily the chain moves between
+     * modes. Every few steps, the algorithm then proposes to exchange the
+     * current samples $x_r,x_{r+1}$ of neighboring replicas, and accepts
+     * the exchange with probability
+     * @f{align*}{
+     *   \min\left\{1, \exp\left(\left(\frac{1}{T_r}-\frac{1}{T_{r+1}}\right)
+     *                           \left(\log\pi(x_{r+1})-\log\pi(x_r)\right)\right)\right\}.
+     * @f}
+     * This preserves the joint distribution of all replicas, and
+     * consequently the cold chain still samples $\pi$, but samples that
+     * have crossed between modes at high temperature can now travel down
+     * the temperature ladder to the cold chain. If $x_r$ has zero
+     * probability, then the ratio above is infinite and the exchange is
+     * always accepted (unless $x_{r+1}$ has zero probability as well, in
+     * which case it is also accepted); if only $x_{r+1}$ has zero
+     * probability, the exchange is rejected. A cold chain that starts
+     * outside the support of $\pi$ is therefore moved into it as soon as
+     * one of the hotter chains has found it.
+     *
+     * Each replica uses the `log_likelihood` and `perturb` functions
+     * passed to sample() in the same way as the MetropolisHastings class,
+     * except that differences of log likelihoods are divided by the
+     * temperature of the replica when deciding whether to accept a trial
+     * sample. Since trial samples are typically rejected more often at
+     * low temperatures, it is useful to monitor the acceptance ratio of
+     * each replica (see get_acceptance_ratios()) as well as the rate at
+     * which exchanges between neighboring replicas are accepted (see
+     * get_swap_acceptance_ratios()) when choosing the temperatures: If the
+     * latter is small for a pair of replicas, then their temperatures are
+     * too far apart.
+     *
+     * By default, only the samples of the cold chain are sent to
+     * consumers. Alternatively, the samples of all replicas can be sent;
+     * consumers then need to use the temperature stored with each sample
+     * to tell them apart. In either case, the AuxiliaryData object
+     * associated with each sample stores the same two entries as for the
+     * MetropolisHastings class (where the log likelihood is the
+     * untempered one, $\log\pi(x)$), plus
+     * - An entry with name "chain index" (i.e., key
+     *   AuxiliaryDataKeys::chain_index) of type `unsigned int` that stores
+     *   the index $r$ of the replica that produced the sample.
+     * - An entry with name "temperature" (i.e., key
+     *   AuxiliaryDataKeys::temperature) of type `double` that stores the
+     *   temperature $T_r$ of that replica.
+     * "Repeated" samples are ones that equal the previous sample of the
+     * same replica because the replica has rejected its trial sample. The
+     * first sample a replica produces after its sample has been exchanged
+     * with a neighboring replica is not considered repeated, even if the
+     * replica has rejected its trial sample in that step, since it then
+     * differs from the replica's previous sample.
+     *
+     *
+     * ### Threading model ###
+     *
+     * Between exchanges, the replicas are independent of each other, and
+     * sample() advances them concurrently on the ThreadPool selected via
+     * set_thread_pool(). The `log_likelihood` and `perturb` functions are
+     * therefore called concurrently from several threads, and must be
+     * written accordingly. As for the MultiChainMetropolisHastings class,
+     * the `perturb` function receives the random number generator of the
+     * replica it is called for as its second argument. All samples are
+     * sent to consumers from the thread that calls sample(), after the
+     * exchange step; consumers therefore receive samples in blocks of
+     * (at most) as many steps as there are between exchanges. The samples
+     * produced do not depend on the number of threads used.
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class ParallelTempering : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] temperatures The temperatures $T_r$ of the replicas.
+         *   The first temperature needs to be one, and the temperatures need
+         *   to be increasing. The number of temperatures determines the
+         *   number of replicas.
+         * @param[in] swap_interval The number of steps each replica
+         *   performs between two attempts to exchange samples between
+         *   neighboring replicas.
+         * @param[in] output_all_replicas If `false`, only the samples of the
+         *   cold chain are sent to consumers; otherwise, the samples of
+         *   all replicas are sent.
+         */
+        ParallelTempering (const std::vector<double> &temperatures,
+                           const unsigned int swap_interval = 10,
+                           const bool output_all_replicas = false);
+
+        /**
+         * Select the ThreadPool on which the replicas are advanced. If this
+         * function is not called, then the pool returned by
+         * ThreadPool::default_pool() is used.
+         *
+         * @param[in] thread_pool The pool to submit tasks to. The pool needs
+         *   to live at least as long as the current object.
+         */
+        void
+        set_thread_pool (ThreadPool &thread_pool);
+
+        /**
+         * The principal function of this class. Starting all replicas from
+         * the given initial sample $x_0$, it lets each replica perform the
+         * given number of steps and sends the resulting samples through the
+         * signal of the base class to Consumer objects.
+         *
+         * @param[in] starting_point The initial sample $x_0$.
+         * @param[in] log_likelihood A function object that, when called
+         *   with a sample $x$, returns $\log(\pi(x))$. See
+         *   MetropolisHastings::sample() for details.
+         * @param[in] perturb A function object that, when given a sample
+         *   $x$ and the random number generator of the replica $x$ belongs
+         *   to, returns a trial sample $\tilde x$ and the ratio
+         *   $\frac{\pi_\text{proposal}(\tilde x|x)}
+         *         {\pi_\text{proposal}(x|\tilde x)}$. See
+         *   MetropolisHastings::sample() for details.
+         * @param[in] n_samples The number of steps each replica performs.
+         *   This is also the number of samples sent to consumers if only the
+         *   cold chain is output.
+         * @param[in] random_seed The random number generator of replica $r$
+         *   is seeded from this seed and the number $r$. See
+         *   MetropolisHastings::sample().
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+                const types::sample_index n_samples,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+        /**
+         * Return, for each replica, the fraction of trial samples that have
+         * been accepted in all previous calls to sample().
+         */
+        std::vector<double>
+        get_acceptance_ratios () const;
+
+        /**
+         * Return, for each pair $(r,r+1)$ of neighboring replicas, the
+         * fraction of proposed exchanges that have been accepted in all
+         * previous calls to sample().
+         */
+        std::vector<double>
+        get_swap_acceptance_ratios () const;
+
+      private:
+        /**
+         * The temperatures of the replicas.
+         */
+        const std::vector<double> temperatures;
+
+        /**
+         * The number of steps between exchanges.
+         */
+        const unsigned int swap_interval;
+
+        /**
+         * Whether all replicas, or only the cold chain, are output.
+         */
+        const bool output_all_replicas;
+
+        /**
+         * The pool on which replicas are advanced. If this is a `nullptr` at
+         * the time sample() is called, then it is set to
+         * ThreadPool::default_pool().
+         */
+        ThreadPool *thread_pool;
+
+        /**
+         * Statistics about accepted trial samples and exchanges.
+         */
+        std::vector<types::sample_index> n_accepted_samples;
+        std::vector<types::sample_index> n_steps;
+        std::vector<types::sample_index> n_accepted_swaps;
+        std::vector<types::sample_index> n_attempted_swaps;
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    ParallelTempering<OutputType,RandomNumberGenerator>::
+    ParallelTempering (const std::vector<double> &temperatures,
+                       const unsigned int swap_interval,
+                       const bool output_all_replicas)
+      :
+      temperatures (temperatures),
+      swap_interval (swap_interval),
+      output_all_replicas (output_all_replicas),
+      thread_pool (nullptr),
+      n_accepted_samples (temperatures.size(), 0),
+      n_steps (temperatures.size(), 0),
+      n_accepted_swaps (temperatures.size() > 0 ? temperatures.size()-1 : 0, 0),
+      n_attempted_swaps (temperatures.size() > 0 ? temperatures.size()-1 : 0, 0)
+    {
+      assert (temperatures.size() >= 1);
+      assert (temperatures[0] == 1.);
+      assert (std::is_sorted (temperatures.begin(), temperatures.end()));
+      assert (swap_interval >= 1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    ParallelTempering<OutputType,RandomNumberGenerator>::
+    set_thread_pool (ThreadPool &thread_pool)
+    {
+      this->thread_pool = &thread_pool;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::vector<double>
+    ParallelTempering<OutputType,RandomNumberGenerator>::
+    get_acceptance_ratios () const
+    {
+      std::vector<double> ratios (temperatures.size(), 0.);
+      for (unsigned int r=0; r<temperatures.size(); ++r)
+        if (n_steps[r] > 0)
+          ratios[r] = 1. * n_accepted_samples[r] / n_steps[r];
+      return ratios;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    std::vector<double>
+    ParallelTempering<OutputType,RandomNumberGenerator>::
+    get_swap_acceptance_ratios () const
+    {
+      std::vector<double> ratios (n_attempted_swaps.size(), 0.);
+      for (unsigned int r=0; r<n_attempted_swaps.size(); ++r)
+        if (n_attempted_swaps[r] > 0)
+          ratios[r] = 1. * n_accepted_swaps[r] / n_attempted_swaps[r];
+      return ratios;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    ParallelTempering<OutputType,RandomNumberGenerator>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+            const types::sample_index n_samples,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      if (thread_pool == nullptr)
+        thread_pool = &ThreadPool::default_pool();
+
+      const unsigned int n_replicas = temperatures.size();
+      const unsigned int n_output_replicas = (output_all_replicas ? n_replicas : 1);
+
+      // Give each replica its own stream of random numbers, derived from
+      // the seed and the replica number, and use yet another stream for
+      // the exchanges:
+      std::vector<RandomNumberGenerator> rngs;
+      rngs.reserve (n_replicas);
+      for (unsigned int r=0; r<n_replicas; ++r)
+        rngs.emplace_back (Utilities::make_random_number_generator<RandomNumberGenerator> (random_seed, r));
+      RandomNumberGenerator swap_rng
+        = Utilities::make_random_number_generator<RandomNumberGenerator> (random_seed, n_replicas);
+
+      std::uniform_real_distribution<> swap_distribution(0,1);
+
+      const double starting_log_likelihood = log_likelihood (starting_point);
+      std::vector<OutputType> current_samples (n_replicas, starting_point);
+      std::vector<double>     current_log_likelihoods (n_replicas, starting_log_likelihood);
+
+      // Whether the sample of each replica has been exchanged with a
+      // neighboring replica since the replica last produced a sample. (This
+      // is not a std::vector<bool> because the replicas write their
+      // elements concurrently.)
+      std::vector<char> exchanged_since_last_sample (n_replicas, false);
+
+      // The samples of each replica produced between two exchanges:
+      std::vector<SampleBatch<OutputType>> replica_samples (n_output_replicas);
+      SampleBatch<OutputType> samples;
+
+      for (types::sample_index i=0; i<n_samples; i+=swap_interval)
+        {
+          const unsigned int n_steps_this_round
+            = std::min<types::sample_index> (swap_interval, n_samples-i);
+
+          // Advance all replicas independently:
+          thread_pool->parallel_for (n_replicas,
+                                     [&](const unsigned int r)
+          {
+            std::uniform_real_distribution<> acceptance_distribution(0,1);
+            RandomNumberGenerator &rng = rngs[r];
+            const double temperature = temperatures[r];
+
+            if (r < n_output_replicas)
+              replica_samples[r].clear ();
+
+            for (unsigned int step=0; step<n_steps_this_round; ++step)
+              {
+                std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_samples[r], rng);
+                OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+                const double proposal_distribution_ratio = trial_sample_and_ratio.second;
+
+                const double trial_log_likelihood = log_likelihood (trial_sample);
+
+                // Accept or reject the trial sample in the same way as
+                // MetropolisHastings::sample() does, but using the
+                // tempered difference of log likelihoods. If the trial
+                // sample is rejected, the sample produced is only a
+                // repeated one if it has not been obtained by an exchange
+                // since the last sample of this replica:
+                bool repeated_sample;
+                if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihoods[r],
+                                                   proposal_distribution_ratio,
+                                                   rng, acceptance_distribution,
+                                                   temperature))
+                  {
+                    current_samples[r]         = std::move(trial_sample);
+                    current_log_likelihoods[r] = trial_log_likelihood;
+
+                    repeated_sample = false;
+                    ++n_accepted_samples[r];
+                  }
+                else
+                  repeated_sample = !exchanged_since_last_sample[r];
+                exchanged_since_last_sample[r] = false;
+                ++n_steps[r];
+
+                if (r < n_output_replicas)
+                  replica_samples[r].emplace_back (current_samples[r],
+                                                   AuxiliaryData
+                  {
+                    {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihoods[r]},
+                    {AuxiliaryDataKeys::sample_is_repeated, repeated_sample},
+                    {AuxiliaryDataKeys::chain_index, r},
+                    {AuxiliaryDataKeys::temperature, temperature}
+                  });
+              }
+          });
+
+          // Then send the samples downstream, ordered by step and within
+          // each step by replica:
+          if (n_output_replicas == 1)
+            this->issue_sample_batch (replica_samples[0]);
+          else
+            {
+              samples.clear ();
+              for (unsigned int step=0; step<n_steps_this_round; ++step)
+                for (unsigned int r=0; r<n_output_replicas; ++r)
+                  samples.emplace_back (std::move(replica_samples[r][step]));
+              this->issue_sample_batch (samples);
+            }
+
+          // Finally attempt to exchange the samples of neighboring
+          // replicas, starting with the hottest pair. If either sample has
+          // zero probability, then the ratio that decides about the
+          // exchange is either zero or infinite: If only the sample of the
+          // hotter replica has zero probability, the exchange is never
+          // accepted; if only the sample of the colder replica has, it is
+          // always accepted, which allows a cold chain that is stuck
+          // outside the support of the distribution to be rescued by a
+          // hotter one. If both have zero probability, the exchange is
+          // also accepted.
+          if (n_steps_this_round == swap_interval)
+            for (unsigned int r=n_replicas-1; r>0; --r)
+              {
+                const double ll_cold = current_log_likelihoods[r-1];
+                const double ll_hot  = current_log_likelihoods[r];
+                const double u = swap_distribution(swap_rng);
+
+                bool accept;
+                if (internal::is_zero_probability(ll_cold))
+                  accept = true;
+                else if (internal::is_zero_probability(ll_hot))
+                  accept = false;
+                else
+                  accept = (std::exp((1./temperatures[r-1] - 1./temperatures[r]) * (ll_hot - ll_cold))
+                            >= u);
+
+                ++n_attempted_swaps[r-1];
+                if (accept)
+                  {
+                    std::swap (current_samples[r-1], current_samples[r]);
+                    std::swap (current_log_likelihoods[r-1], current_log_likelihoods[r]);
+                    exchanged_since_last_sample[r-1] = true;
+                    exchanged_since_last_sample[r]   = true;
+                    ++n_accepted_swaps[r-1];
+                  }
+              }
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,319 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_PREFETCHING_MH_H
+#define SAMPLEFLOW_PRODUCERS_PREFETCHING_MH_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/acceptance.h>
+#include <sampleflow/random.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+#include <algorithm>
+#include <random>
+#include <functional>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the Metropolis-Hastings algorithm that uses
+     * "prefetching" (see Brockwell, 2006) to evaluate the log likelihoods of
+     * several future trial samples concurrently, but that produces exactly
+     * the same chain as the MetropolisHastings class. This is useful if
+     * evaluating the log likelihood is expensive and the machine has idle
+     * processor cores.
+     *
+     * The states a Metropolis-Hastings chain can be in after $d$ more steps
+     * form a binary tree: In each step, the trial sample is either accepted
+     * or rejected. Prefetching evaluates the log likelihoods of the trial
+     * samples at several nodes of this tree concurrently, before it is
+     * known which path through the tree the chain will take; the
+     * evaluations at nodes that are not on the path taken are wasted. For a
+     * well-tuned sampler, the acceptance ratio is around 0.234 (see the
+     * documentation of the MetropolisHastings class), and so by far the most
+     * likely path is a sequence of rejections. This class therefore
+     * evaluates the trial samples along this path: In each round, it draws
+     * $d$ trial samples from the current sample $x$ -- the ones the chain
+     * would see if all of them were rejected --, evaluates their log
+     * likelihoods concurrently, and then processes them one after the
+     * other. If one of them is accepted, then the remaining ones are
+     * discarded and the next round starts from the accepted sample. With an
+     * acceptance ratio $a$, a round therefore advances the chain by
+     * $\frac{1-(1-a)^d}{a}$ steps on average, for example by 2.8 steps for
+     * $a=0.234$ and $d=4$, or 3.4 steps for $d=8$, in the time it takes to
+     * evaluate the log likelihood once (if there are at least $d$ cores).
+     *
+     * To be able to discard trial samples and still produce the same
+     * chain as the MetropolisHastings class, the producer needs to be able
+     * to "rewind" the random number generator from which trial samples are
+     * drawn. Consequently, the `perturb` function passed to sample()
+     * receives the random number generator to use as its second argument,
+     * rather than using its own one. Specifically, the chain produced by
+     * @code
+     *   PrefetchingMetropolisHastings<SampleType> prefetching_sampler;
+     *   prefetching_sampler.sample (x0, log_likelihood, perturb,
+     *                               n_samples, seed);
+     * @endcode
+     * is identical to the one produced by
+     * @code
+     *   std::mt19937 proposal_rng
+     *     = PrefetchingMetropolisHastings<SampleType>::proposal_generator(seed);
+     *
+     *   MetropolisHastings<SampleType> mh_sampler;
+     *   mh_sampler.sample (x0, log_likelihood,
+     *                      [&](const SampleType &x)
+     *                      {
+     *                        return perturb (x, proposal_rng);
+     *                      },
+     *                      n_samples, seed);
+     * @endcode
+     * regardless of the prefetch depth $d$ and the number of threads used.
+     *
+     * The AuxiliaryData object associated with each sample stores the same
+     * entries as for the MetropolisHastings class.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The `log_likelihood` function passed to sample() is called
+     * concurrently from the thread that calls sample() and the threads of
+     * the ThreadPool selected via set_thread_pool(), and must be safe to
+     * call concurrently. The `perturb` function is only called on the
+     * thread that calls sample().
+     *
+     * @tparam RandomNumberGenerator The type of the random number generator
+     *   used by this class. See the section on random number generators in
+     *   the documentation of the MetropolisHastings class.
+     */
+    template <typename OutputType, typename RandomNumberGenerator = std::mt19937>
+    class PrefetchingMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] prefetch_depth The number $d$ of trial samples whose
+         *   log likelihoods are evaluated concurrently. The default value of
+         *   zero selects one more than the number of threads of the
+         *   ThreadPool used, since the thread that calls sample() also
+         *   evaluates log likelihoods. A depth of one results in the same
+         *   algorithm as in the MetropolisHastings class, without any
+         *   concurrency.
+         */
+        explicit
+        PrefetchingMetropolisHastings (const unsigned int prefetch_depth = 0);
+
+        /**
+         * Select the ThreadPool on which log likelihoods are evaluated. If
+         * this function is not called, then the pool returned by
+         * ThreadPool::default_pool() is used.
+         *
+         * @param[in] thread_pool The pool to submit tasks to. The pool needs
+         *   to live at least as long as the current object.
+         */
+        void
+        set_thread_pool (ThreadPool &thread_pool);
+
+        /**
+         * Return the random number generator that sample() passes to the
+         * `perturb` function when called with the given seed. See the
+         * documentation of this class for how this can be used to produce
+         * the same chain using the MetropolisHastings class.
+         */
+        static
+        RandomNumberGenerator
+        proposal_generator (const typename RandomNumberGenerator::result_type random_seed);
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects. The arguments have the same meaning as for
+         * MetropolisHastings::sample(), except that the `perturb` function
+         * has to draw the trial sample using the random number generator
+         * passed as its second argument, and that the `log_likelihood`
+         * function needs to be safe to call concurrently.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+                const types::sample_index n_samples,
+                const typename RandomNumberGenerator::result_type random_seed = {});
+
+      private:
+        /**
+         * The number of trial samples evaluated concurrently, or zero if
+         * this is to be determined from the number of threads of the pool.
+         */
+        const unsigned int prefetch_depth;
+
+        /**
+         * The pool on which log likelihoods are evaluated. If this is a
+         * `nullptr` at the time sample() is called, then it is set to
+         * ThreadPool::default_pool().
+         */
+        ThreadPool *thread_pool;
+    };
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    PrefetchingMetropolisHastings<OutputType,RandomNumberGenerator>::
+    PrefetchingMetropolisHastings (const unsigned int prefetch_depth)
+      :
+      prefetch_depth (prefetch_depth),
+      thread_pool (nullptr)
+    {}
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    PrefetchingMetropolisHastings<OutputType,RandomNumberGenerator>::
+    set_thread_pool (ThreadPool &thread_pool)
+    {
+      this->thread_pool = &thread_pool;
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    RandomNumberGenerator
+    PrefetchingMetropolisHastings<OutputType,RandomNumberGenerator>::
+    proposal_generator (const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Derive the seed of the generator for trial samples from the given
+      // seed, but make sure that it yields a different sequence than the
+      // generator used for accepting and rejecting samples.
+      return Utilities::make_random_number_generator<RandomNumberGenerator> (random_seed, 1);
+    }
+
+
+
+    template <typename OutputType, typename RandomNumberGenerator>
+    void
+    PrefetchingMetropolisHastings<OutputType,RandomNumberGenerator>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &, RandomNumberGenerator &)> &perturb,
+            const types::sample_index n_samples,
+            const typename RandomNumberGenerator::result_type random_seed)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      if (thread_pool == nullptr)
+        thread_pool = &ThreadPool::default_pool();
+      const unsigned int depth = (prefetch_depth > 0 ?
+                                  prefetch_depth :
+                                  thread_pool->n_threads() + 1);
+
+      // Set up the generator for accepting and rejecting samples in the
+      // same way as MetropolisHastings::sample() does, and the one for
+      // trial samples as documented:
+      RandomNumberGenerator rng;
+      if (random_seed != typename RandomNumberGenerator::result_type {})
+        rng.seed (random_seed);
+      RandomNumberGenerator proposal_rng = proposal_generator (random_seed);
+
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      OutputType current_sample         = starting_point;
+      double     current_log_likelihood = log_likelihood (current_sample);
+
+      // For each of the trial samples of a round, we need to store the
+      // sample itself, the proposal distribution ratio, its log likelihood,
+      // and the state of the proposal generator after drawing it (to which
+      // we rewind the generator if the sample is accepted).
+      std::vector<OutputType>   trial_samples (depth);
+      std::vector<double>       proposal_distribution_ratios (depth);
+      std::vector<double>       trial_log_likelihoods (depth);
+      std::vector<RandomNumberGenerator> proposal_rng_states (depth);
+
+      types::sample_index i = 0;
+      while (i < n_samples)
+        {
+          // Draw the trial samples along the path of rejections, and
+          // evaluate their log likelihoods concurrently:
+          const unsigned int n_trials = std::min<types::sample_index> (depth, n_samples-i);
+          for (unsigned int k=0; k<n_trials; ++k)
+            {
+              std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample, proposal_rng);
+              trial_samples[k]                = std::move(trial_sample_and_ratio.first);
+              proposal_distribution_ratios[k] = trial_sample_and_ratio.second;
+              proposal_rng_states[k]          = proposal_rng;
+            }
+
+          thread_pool->parallel_for (n_trials,
+                                     [&](const unsigned int k)
+          {
+            trial_log_likelihoods[k] = log_likelihood (trial_samples[k]);
+          });
+
+          // Then process them in order, until one is accepted. The
+          // following is exactly the same as in MetropolisHastings::sample().
+          for (unsigned int k=0; k<n_trials; ++k, ++i)
+            {
+              const double trial_log_likelihood        = trial_log_likelihoods[k];
+              const double proposal_distribution_ratio = proposal_distribution_ratios[k];
+
+              if (internal::accept_trial_sample (trial_log_likelihood, current_log_likelihood,
+                                                 proposal_distribution_ratio,
+                                                 rng, uniform_distribution))
+                {
+                  current_sample         = std::move(trial_samples[k]);
+                  current_log_likelihood = trial_log_likelihood;
+
+                  this->send_sample (current_sample,
+                  {
+                    {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+                    {AuxiliaryDataKeys::sample_is_repeated, false}
+                  });
+
+                  // The remaining trial samples were drawn from the wrong
+                  // sample. Discard them, and rewind the proposal generator
+                  // to where it was after drawing the accepted sample:
+                  proposal_rng = proposal_rng_states[k];
+                  ++i;
+                  break;
+                }
+              else
+                this->send_sample (current_sample,
+                {
+                  {AuxiliaryDataKeys::relative_log_likelihood, current_log_likelihood},
+                  {AuxiliaryDataKeys::sample_is_repeated, true}
+                });
+            }
+        }
+    }
+
+  }
+}
+
+
+#endif
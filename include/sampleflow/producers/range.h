@@ -19,6 +19,8 @@
 #include <sampleflow/producer.h>
 #include <sampleflow/scope_exit.h>
 
+#include <cassert>
+
 namespace SampleFlow
 {
   namespace Producers
@@ -53,6 +55,13 @@ namespace SampleFlow
      * also serve the source of samples of type `double`, letting the compiler
      * do the conversion.
      *
+     * By default, every sample is sent downstream individually. If the
+     * constructor is given a batch size greater than one, then samples are
+     * instead collected into blocks of that size and each block is sent
+     * downstream as a whole (see the discussion of batches in the
+     * documentation of the Producer class). This reduces the overhead of
+     * getting many samples to cheap consumers.
+     *
      * @tparam OutputType The type the samples sent downstream should have.
      *   This need not necessarily be the same type as the one of the objects
      *   provided to the sample() member function, but these objects must be
@@ -62,6 +71,16 @@ namespace SampleFlow
     class Range : public Producer<OutputType>
     {
       public:
+        /**
+         * Constructor.
+         *
+         * @param[in] batch_size The number of samples that are sent
+         *   downstream together as one block. The last block produced by
+         *   a call to sample() may contain fewer samples.
+         */
+        explicit
+        Range (const unsigned int batch_size = 1);
+
         /**
          * The principal function of this class. It produces samples
          * (that are then sent to consumers and filters connected to this
@@ -78,9 +97,27 @@ namespace SampleFlow
         template <typename RangeType>
         void
         sample (const RangeType &range);
+
+      private:
+        /**
+         * The number of samples sent downstream together as one block.
+         */
+        const unsigned int batch_size;
     };
 
 
+
+    template <typename OutputType>
+    Range<OutputType>::
+    Range (const unsigned int batch_size)
+      :
+      batch_size (batch_size)
+    {
+      assert (batch_size >= 1);
+    }
+
+
+
     template <typename OutputType>
     template <typename RangeType>
     void
@@ -96,8 +133,30 @@ namespace SampleFlow
 
       // Loop over all elements of the given range and issue a sample for
       // each of them.
-      for (auto sample : range)
-        this->issue_sample (sample, {});
+      if (batch_size == 1)
+        {
+          for (auto sample : range)
+            this->send_sample (sample, {});
+        }
+      else
+        {
+          // Otherwise collect the samples into blocks, and send each of
+          // these once it is full. At the end, send what's left over.
+          SampleBatch<OutputType> samples;
+          samples.reserve (batch_size);
+          for (auto sample : range)
+            {
+              samples.emplace_back (sample, AuxiliaryData());
+              if (samples.size() == batch_size)
+                {
+                  this->issue_sample_batch (samples);
+                  samples.clear ();
+                }
+            }
+
+          if (samples.size() > 0)
+            this->issue_sample_batch (samples);
+        }
     }
 
   }
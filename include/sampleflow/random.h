@@ -0,0 +1,392 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_RANDOM_H
+#define SAMPLEFLOW_RANDOM_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+
+
+namespace SampleFlow
+{
+  /**
+   * A "counter-based" random number generator, namely the Philox4x32-10
+   * generator of @cite SalmonEtAl11. It can be used wherever the C++
+   * standard library expects a "uniform random bit generator", for
+   * example with `std::uniform_real_distribution` or
+   * `std::normal_distribution`, and all producers accept it as their
+   * `RandomNumberGenerator` template argument.
+   *
+   * In contrast to generators such as `std::mt19937` that step a (large)
+   * internal state from one number to the next, the $i$th block of four
+   * 32-bit numbers returned by this generator is computed directly from
+   * the counter $i$ by a bijective function that is parameterized by a
+   * "key". As a consequence, the state of the generator consists of only
+   * a few integers: The key (here: the seed), the "stream" the
+   * generator works on (which makes up the upper half of the counter),
+   * and the position within the stream. One can jump to any position
+   * within a stream at no cost via set_offset() or discard(), and
+   * generators with the same seed but different stream indices produce
+   * non-overlapping sequences of numbers -- each stream has
+   * $2^{64}$ numbers. This makes it easy to give each of many
+   * chains or threads its own sequence of random numbers, in a way that
+   * depends only on the seed and the index of the chain, but not on which
+   * thread does the work. See make_random_number_generator() for how
+   * producers use this.
+   */
+  class Philox4x32
+  {
+    public:
+      /**
+       * The type of the numbers returned by operator().
+       */
+      using result_type = std::uint32_t;
+
+      /**
+       * Constructor.
+       *
+       * @param[in] seed The seed, i.e., the key of the generator.
+       * @param[in] stream The index of the stream of numbers to be
+       *   generated.
+       */
+      explicit
+      Philox4x32 (const result_type seed = 0,
+                  const std::uint64_t stream = 0);
+
+      /**
+       * Re-initialize the generator with the given seed and stream, and
+       * start at the beginning of the stream.
+       */
+      void
+      seed (const result_type seed,
+            const std::uint64_t stream = 0);
+
+      /**
+       * Return the next random number.
+       */
+      result_type
+      operator() ();
+
+      /**
+       * Skip the given number of random numbers.
+       */
+      void
+      discard (const unsigned long long n);
+
+      /**
+       * Return the index of the stream of numbers this generator produces.
+       */
+      std::uint64_t
+      stream () const;
+
+      /**
+       * Return the number of random numbers produced so far in the
+       * current stream (including the ones skipped via discard()), i.e.,
+       * the position of the next number within the stream.
+       */
+      std::uint64_t
+      offset () const;
+
+      /**
+       * Set the position of the next number to be produced within the
+       * current stream.
+       */
+      void
+      set_offset (const std::uint64_t offset);
+
+      /**
+       * The smallest and largest numbers operator() can return.
+       */
+      static constexpr result_type min ()
+      {
+        return 0;
+      }
+
+      static constexpr result_type max ()
+      {
+        return 0xffffffff;
+      }
+
+      /**
+       * Compare two generators. They are equal if they will produce the
+       * same sequence of numbers.
+       */
+      bool
+      operator== (const Philox4x32 &other) const;
+
+      bool
+      operator!= (const Philox4x32 &other) const;
+
+      /**
+       * Compute the block of four numbers the generator associates with the
+       * given counter and key. This function is the core of the algorithm
+       * and is mostly of interest for testing.
+       */
+      static
+      std::array<result_type,4>
+      compute_block (const std::array<result_type,4> &counter,
+                     const std::array<result_type,2> &key);
+
+    private:
+      /**
+       * The key of the generator, derived from the seed.
+       */
+      std::array<result_type,2> key;
+
+      /**
+       * The index of the stream, and the position of the next number
+       * within the stream.
+       */
+      std::uint64_t stream_index;
+      std::uint64_t position;
+
+      /**
+       * The most recently computed block of four numbers, i.e., the one
+       * that contains the number at `position` unless `position` is a
+       * multiple of four.
+       */
+      std::array<result_type,4> block;
+
+      /**
+       * Compute the block that contains the number at `position`.
+       */
+      void
+      compute_current_block ();
+  };
+
+
+
+  namespace Utilities
+  {
+    /**
+     * Create a random number generator of the given type for the stream
+     * with the given index, given a seed. Producers that need more than
+     * one generator -- for example, one for each of several chains or
+     * replicas -- call this function to obtain them, so that the numbers
+     * each chain sees depend only on the seed and the index of the
+     * chain, but not on which thread works on the chain.
+     *
+     * For general generator types, this function seeds the generator with
+     * a `std::seed_seq` object created from the seed and the stream index.
+     * This produces generators whose sequences of numbers are very
+     * unlikely to overlap in practice, but this is not guaranteed. For
+     * generators of type Philox4x32, it instead selects the stream with
+     * the given index, and the sequences of numbers are guaranteed to be
+     * distinct.
+     */
+    template <typename RandomNumberGenerator>
+    RandomNumberGenerator
+    make_random_number_generator (const typename RandomNumberGenerator::result_type seed,
+                                  const std::uint64_t stream);
+
+    template <>
+    Philox4x32
+    make_random_number_generator<Philox4x32> (const Philox4x32::result_type seed,
+                                              const std::uint64_t stream);
+  }
+
+
+
+  inline
+  Philox4x32::
+  Philox4x32 (const result_type seed,
+              const std::uint64_t stream)
+  {
+    this->seed (seed, stream);
+  }
+
+
+
+  inline
+  void
+  Philox4x32::
+  seed (const result_type seed,
+        const std::uint64_t stream)
+  {
+    key          = {{seed, 0}};
+    stream_index = stream;
+    position     = 0;
+    block        = {{0, 0, 0, 0}};
+  }
+
+
+
+  inline
+  Philox4x32::result_type
+  Philox4x32::
+  operator() ()
+  {
+    if (position % 4 == 0)
+      compute_current_block ();
+    return block[position++ % 4];
+  }
+
+
+
+  inline
+  void
+  Philox4x32::
+  discard (const unsigned long long n)
+  {
+    set_offset (position + n);
+  }
+
+
+
+  inline
+  std::uint64_t
+  Philox4x32::
+  stream () const
+  {
+    return stream_index;
+  }
+
+
+
+  inline
+  std::uint64_t
+  Philox4x32::
+  offset () const
+  {
+    return position;
+  }
+
+
+
+  inline
+  void
+  Philox4x32::
+  set_offset (const std::uint64_t offset)
+  {
+    position = offset;
+
+    // If the next number is in the middle of a block, then operator()
+    // expects that block to have been computed already:
+    if (position % 4 != 0)
+      compute_current_block ();
+  }
+
+
+
+  inline
+  bool
+  Philox4x32::
+  operator== (const Philox4x32 &other) const
+  {
+    return ((key == other.key)
+            &&
+            (stream_index == other.stream_index)
+            &&
+            (position == other.position));
+  }
+
+
+
+  inline
+  bool
+  Philox4x32::
+  operator!= (const Philox4x32 &other) const
+  {
+    return !(*this == other);
+  }
+
+
+
+  inline
+  std::array<Philox4x32::result_type,4>
+  Philox4x32::
+  compute_block (const std::array<result_type,4> &counter,
+                 const std::array<result_type,2> &key)
+  {
+    // The multipliers and the "Weyl sequence" constants by which the key
+    // is bumped in each round, as given in the paper:
+    const std::uint64_t multiplier_0 = 0xD2511F53;
+    const std::uint64_t multiplier_1 = 0xCD9E8D57;
+    const result_type   bump_0       = 0x9E3779B9;
+    const result_type   bump_1       = 0xBB67AE85;
+
+    std::array<result_type,4> x = counter;
+    std::array<result_type,2> k = key;
+    for (unsigned int round=0; round<10; ++round)
+      {
+        if (round > 0)
+          {
+            k[0] += bump_0;
+            k[1] += bump_1;
+          }
+
+        const std::uint64_t product_0 = multiplier_0 * x[0];
+        const std::uint64_t product_1 = multiplier_1 * x[2];
+
+        x = {{static_cast<result_type>(product_1 >> 32) ^ x[1] ^ k[0],
+              static_cast<result_type>(product_1),
+              static_cast<result_type>(product_0 >> 32) ^ x[3] ^ k[1],
+              static_cast<result_type>(product_0)
+             }
+            };
+      }
+
+    return x;
+  }
+
+
+
+  inline
+  void
+  Philox4x32::
+  compute_current_block ()
+  {
+    // The counter consists of the index of the block within the stream
+    // (lower half) and the index of the stream (upper half):
+    const std::uint64_t block_index = position / 4;
+    block = compute_block ({{static_cast<result_type>(block_index),
+                             static_cast<result_type>(block_index >> 32),
+                             static_cast<result_type>(stream_index),
+                             static_cast<result_type>(stream_index >> 32)
+                            }
+                           },
+                           key);
+  }
+
+
+
+  namespace Utilities
+  {
+    template <typename RandomNumberGenerator>
+    RandomNumberGenerator
+    make_random_number_generator (const typename RandomNumberGenerator::result_type seed,
+                                  const std::uint64_t stream)
+    {
+      std::seed_seq seed_sequence {seed,
+                                   static_cast<typename RandomNumberGenerator::result_type>(stream)};
+      return RandomNumberGenerator (seed_sequence);
+    }
+
+
+
+    template <>
+    inline
+    Philox4x32
+    make_random_number_generator<Philox4x32> (const Philox4x32::result_type seed,
+                                              const std::uint64_t stream)
+    {
+      return Philox4x32 (seed, stream);
+    }
+  }
+}
+
+#endif
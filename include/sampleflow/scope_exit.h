@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_SCOPE_EXIT_H
 
 
+#include <exception>
 #include <functional>
 
 namespace SampleFlow
@@ -69,8 +70,14 @@ namespace SampleFlow
 
         /**
          * Destructor. Execute the stored action.
+         *
+         * If the action throws an exception, then it is passed on to the
+         * caller -- unless the scope is left because another exception is
+         * already propagating. In that case, throwing a second exception
+         * would terminate the program, and the one thrown by the action is
+         * discarded instead.
          */
-        ~ScopeExit ();
+        ~ScopeExit () noexcept(false);
 
       private:
         /**
@@ -90,10 +97,26 @@ namespace SampleFlow
 
 
     inline
-    ScopeExit::~ScopeExit()
+    ScopeExit::~ScopeExit() noexcept(false)
     {
       // Actually trigger the stored function
-      exit_function();
+#if __cplusplus >= 201703L
+      const bool unwinding = (std::uncaught_exceptions() > 0);
+#else
+      const bool unwinding = std::uncaught_exception();
+#endif
+      if (unwinding)
+        {
+          try
+            {
+              exit_function();
+            }
+          catch (...)
+            {
+            }
+        }
+      else
+        exit_function();
     }
   }
 }
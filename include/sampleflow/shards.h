@@ -0,0 +1,264 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_SHARDS_H
+#define SAMPLEFLOW_SHARDS_H
+
+#include <sampleflow/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace internal
+  {
+    /**
+     * Return a number that identifies the calling thread among all threads
+     * that are currently running. A thread is always given the same number.
+     * When a thread ends, its number is given to the next thread that calls
+     * this function for the first time; as a consequence, the numbers in
+     * use are always small and can be used as indices into arrays, even in
+     * programs that create a large number of short-lived threads. In
+     * contrast, `std::thread::id` objects are neither small nor
+     * consecutive.
+     */
+    inline
+    unsigned int
+    this_thread_index ()
+    {
+      // Keep a list of the numbers of threads that have ended, and of
+      // how many numbers have been given out so far. Threads may end
+      // after static objects have been destroyed (for example the
+      // workers of ThreadPool::default_pool(), which is created before
+      // the first call of this function), so the list is never deleted:
+      struct State
+      {
+        std::mutex mutex;
+        std::vector<unsigned int> free_indices;
+        unsigned int n_indices = 0;
+      };
+      static State *const state = new State;
+
+      // Then give each thread a number when it first calls this function,
+      // and put the number back into the list when the thread ends:
+      struct ThreadIndex
+      {
+        ThreadIndex ()
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (state->free_indices.size() > 0)
+            {
+              index = state->free_indices.back();
+              state->free_indices.pop_back();
+            }
+          else
+            index = state->n_indices++;
+        }
+
+        ~ThreadIndex ()
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          state->free_indices.push_back (index);
+        }
+
+        unsigned int index;
+      };
+
+      static thread_local const ThreadIndex thread_index;
+      return thread_index.index;
+    }
+
+
+
+    /**
+     * A class that stores a set of objects of type `ShardType` (the
+     * "shards"), and hands out one of them to each thread that asks for
+     * one via local(). Consumers use this to let each of the threads that
+     * send samples to them accumulate their information in a separate
+     * object, rather than all threads competing for the lock of one
+     * object; the shards are then merged when the information is needed.
+     *
+     * Each object of this class assigns shards to threads in the order in
+     * which the threads first call local() on it: The first thread gets
+     * shard zero, the second one shard one, etc. Once all shards have been
+     * handed out, further threads are assigned to shards in a round-robin
+     * fashion, starting again with shard zero. The assignment is stored
+     * per number returned by this_thread_index(), and so a thread keeps
+     * its shard for the lifetime of the object, and a thread that is
+     * started after another one has ended may take over the shard of the
+     * thread that has ended. As a consequence, if no more threads ever run
+     * at the same time than there are shards, then each thread has its own
+     * shard -- also if a producer creates new threads each time it is asked
+     * for samples. Otherwise, some threads share a shard, and so users of
+     * this class still need to lock a shard when using it; but this lock is
+     * rarely contended.
+     *
+     * @tparam ShardType The type of the objects stored.
+     */
+    template <typename ShardType>
+    class Shards
+    {
+      public:
+        /**
+         * Constructor. The object stores no shards until initialize() is
+         * called.
+         */
+        Shards ();
+
+        /**
+         * Create the given number of shards, using the given function
+         * to create each of them.
+         *
+         * @param[in] n_shards The number of shards. If zero, then one shard
+         *   per thread of ThreadPool::default_pool() is created, plus one
+         *   for the thread on which samples are produced.
+         * @param[in] create_shard A function that returns a pointer to a
+         *   newly created shard. The current object takes over ownership
+         *   of the object pointed to.
+         */
+        template <typename Function>
+        void
+        initialize (const unsigned int n_shards,
+                    const Function &create_shard);
+
+        /**
+         * Return whether initialize() has been called.
+         */
+        bool
+        enabled () const;
+
+        /**
+         * Return the shard that belongs to the calling thread.
+         */
+        ShardType &
+        local () const;
+
+        /**
+         * Return all shards.
+         */
+        const std::vector<std::unique_ptr<ShardType>> &
+        all () const;
+
+      private:
+        /**
+         * The number of threads, identified by this_thread_index(), for
+         * which the current object stores which shard they have been
+         * assigned. Threads with larger numbers -- which only exist if
+         * more threads than this are running at the same time -- are
+         * assigned the shard given by their number modulo the number of
+         * shards.
+         */
+        static const unsigned int max_n_assigned_threads = 256;
+
+        /**
+         * The shards.
+         */
+        std::vector<std::unique_ptr<ShardType>> shards;
+
+        /**
+         * For each number returned by this_thread_index(), the index of
+         * the shard the thread with this number has been assigned, or -1
+         * if no such thread has called local() yet. Each element is only
+         * ever accessed by the thread that currently has the corresponding
+         * number.
+         */
+        std::unique_ptr<int[]> assigned_shards;
+
+        /**
+         * The number of threads that have so far been assigned a shard.
+         */
+        mutable std::atomic<unsigned int> n_assigned_threads;
+    };
+
+
+
+    template <typename ShardType>
+    Shards<ShardType>::
+    Shards ()
+      :
+      n_assigned_threads (0)
+    {}
+
+
+
+    template <typename ShardType>
+    template <typename Function>
+    void
+    Shards<ShardType>::
+    initialize (const unsigned int n_shards,
+                const Function &create_shard)
+    {
+      assert (shards.size() == 0);
+
+      const unsigned int n = (n_shards > 0 ?
+                              n_shards :
+                              ThreadPool::default_pool().n_threads() + 1);
+      for (unsigned int i=0; i<n; ++i)
+        shards.emplace_back (create_shard());
+
+      assigned_shards.reset (new int[max_n_assigned_threads]);
+      std::fill (assigned_shards.get(), assigned_shards.get() + max_n_assigned_threads,
+                 -1);
+    }
+
+
+
+    template <typename ShardType>
+    bool
+    Shards<ShardType>::
+    enabled () const
+    {
+      return (shards.size() > 0);
+    }
+
+
+
+    template <typename ShardType>
+    ShardType &
+    Shards<ShardType>::
+    local () const
+    {
+      const unsigned int thread_index = this_thread_index();
+      if (thread_index >= max_n_assigned_threads)
+        return *shards[thread_index % shards.size()];
+
+      // If this is the first call by a thread with this number, get the
+      // next shard in line:
+      int &shard = assigned_shards[thread_index];
+      if (shard == -1)
+        shard = n_assigned_threads++ % shards.size();
+
+      return *shards[shard];
+    }
+
+
+
+    template <typename ShardType>
+    const std::vector<std::unique_ptr<ShardType>> &
+    Shards<ShardType>::
+    all () const
+    {
+      return shards;
+    }
+  }
+}
+
+#endif
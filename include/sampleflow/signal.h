@@ -0,0 +1,678 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_SIGNAL_H
+#define SAMPLEFLOW_SIGNAL_H
+
+#include <boost/signals2.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  /**
+   * An enum that describes the mechanism a Signal object (and consequently
+   * a Producer object) uses to call the functions connected to it.
+   */
+  enum class DispatchBackend : int
+  {
+    /**
+     * Use a `boost::signals2::signal` object. This is the default. It is
+     * a general-purpose implementation that, every time the signal is
+     * triggered, takes a lock to obtain the current list of connected
+     * functions, and then takes another lock for each of these functions
+     * to check that it is still connected. For cheap consumers, this
+     * overhead can exceed the cost of processing a sample.
+     */
+    signals2 = 1,
+
+    /**
+     * Store the connected functions in a flat array that is never modified
+     * once it has been published. Triggering the signal then only requires
+     * reading a pointer to the current array and walking over it, without
+     * taking any locks. Connecting and disconnecting functions, on the other
+     * hand, creates a new array that replaces the current one (in a style
+     * that is often called "read-copy-update", or RCU); arrays that have
+     * been replaced are destroyed once no thread may still be walking over
+     * them. This mechanism is therefore well suited for the situation where
+     * functions are connected and disconnected rarely, but the signal is
+     * triggered for every one of a large number of samples.
+     */
+    flat_list = 2
+  };
+
+
+
+  namespace internal
+  {
+    /**
+     * An abstract base class for the objects that know how to sever
+     * one specific connection between a Signal and a function.
+     */
+    class ConnectionBody
+    {
+      public:
+        /**
+         * Destructor.
+         */
+        virtual ~ConnectionBody () = default;
+
+        /**
+         * Sever the connection.
+         */
+        virtual
+        void
+        disconnect () = 0;
+
+        /**
+         * Return whether the connection is still active.
+         */
+        virtual
+        bool
+        connected () const = 0;
+    };
+
+
+
+    /**
+     * An implementation of the ConnectionBody interface for connections
+     * made with a `boost::signals2::signal` object.
+     */
+    class Signals2ConnectionBody : public ConnectionBody
+    {
+      public:
+        /**
+         * Constructor.
+         */
+        explicit
+        Signals2ConnectionBody (const boost::signals2::connection &connection)
+          :
+          connection (connection)
+        {}
+
+        virtual
+        void
+        disconnect () override
+        {
+          connection.disconnect();
+        }
+
+        virtual
+        bool
+        connected () const override
+        {
+          return connection.connected();
+        }
+
+      private:
+        /**
+         * The connection object created by boost::signals2.
+         */
+        boost::signals2::connection connection;
+    };
+  }
+
+
+
+  /**
+   * A class that represents the connection between a Signal (for example,
+   * one of the signals of a Producer object) and a function that is called
+   * whenever the signal is triggered. Objects of this type are returned by
+   * Signal::connect() and Producer::connect_to_signals(). They can be
+   * copied freely; all copies refer to the same connection.
+   *
+   * Objects of this class can also represent a group of connections that
+   * are severed together; see the second constructor.
+   */
+  class Connection
+  {
+    public:
+      /**
+       * Default constructor. Create an object that does not represent
+       * any connection.
+       */
+      Connection () = default;
+
+      /**
+       * Create an object that represents the given `boost::signals2`
+       * connection.
+       */
+      Connection (const boost::signals2::connection &connection);
+
+      /**
+       * Create an object that represents the connection described by the
+       * given object.
+       */
+      explicit
+      Connection (const std::shared_ptr<internal::ConnectionBody> &body);
+
+      /**
+       * Create an object that represents both of the given connections:
+       * Calling disconnect() on the resulting object severs both.
+       */
+      Connection (const Connection &connection_1,
+                  const Connection &connection_2);
+
+      /**
+       * Sever the connection(s) represented by this object. After this
+       * function has returned, no new calls of the connected function(s)
+       * will be started, but calls that are currently executing on other
+       * threads may still be running.
+       */
+      void
+      disconnect () const;
+
+      /**
+       * Return whether any of the connections represented by this object
+       * is still active.
+       */
+      bool
+      connected () const;
+
+    private:
+      /**
+       * The objects that describe the connections this object represents.
+       */
+      std::vector<std::shared_ptr<internal::ConnectionBody>> bodies;
+  };
+
+
+
+  /**
+   * A class that represents a list of functions, all of which are called
+   * whenever the object is triggered via its `operator()`. This class
+   * provides the part of the interface of `boost::signals2::signal` that
+   * SampleFlow uses, but allows choosing between different mechanisms to
+   * store and call the connected functions; see the DispatchBackend
+   * `enum` for the available choices. The Producer class uses objects of
+   * this type to send samples to all connected consumers.
+   *
+   *
+   * ### Threading model ###
+   *
+   * All member functions of this class, with the exception of
+   * set_backend(), can be called concurrently and from multiple threads.
+   *
+   *
+   * @tparam Args The types of the arguments with which the connected
+   *   functions are called.
+   */
+  template <typename... Args>
+  class Signal
+  {
+    public:
+      /**
+       * Constructor. Create a signal that uses DispatchBackend::signals2.
+       */
+      Signal ();
+
+      /**
+       * Copying a signal does not make sense, so disallow it.
+       */
+      Signal (const Signal &) = delete;
+
+      /**
+       * Copying a signal does not make sense, so disallow it.
+       */
+      Signal &operator= (const Signal &) = delete;
+
+      /**
+       * Select the mechanism used to call the connected functions. This
+       * function can only be called while no functions are connected to
+       * the current object.
+       */
+      void
+      set_backend (const DispatchBackend backend);
+
+      /**
+       * Return the mechanism used to call the connected functions.
+       */
+      DispatchBackend
+      get_backend () const;
+
+      /**
+       * Connect the given function to the current signal.
+       *
+       * @return An object that describes the connection and that can
+       *   be used to sever it again.
+       */
+      Connection
+      connect (const std::function<void (Args...)> &slot);
+
+      /**
+       * Call all functions currently connected to this object with
+       * the given arguments, in the order in which they were connected.
+       */
+      void
+      operator() (Args... args) const;
+
+    private:
+      /**
+       * The structure used by DispatchBackend::flat_list to store a
+       * connected function.
+       */
+      struct Slot
+      {
+        explicit
+        Slot (const std::function<void (Args...)> &function)
+          :
+          function (function),
+          connected (true)
+        {}
+
+        /**
+         * The function to call.
+         */
+        const std::function<void (Args...)> function;
+
+        /**
+         * Whether the function is still connected. A function that has
+         * been disconnected may still be part of an array of slots that
+         * another thread is currently walking over; the flag makes sure
+         * that that thread does not start calling the function.
+         */
+        std::atomic<bool> connected;
+      };
+
+      /**
+       * The data structures used by DispatchBackend::flat_list. They are
+       * stored in a separate object that is referenced via a
+       * `std::shared_ptr` so that Connection objects can safely try to
+       * disconnect a function even after the Signal object has been
+       * destroyed.
+       */
+      class FlatList
+      {
+        public:
+          /**
+           * Constructor. Create an empty array of slots.
+           */
+          FlatList ();
+
+          /**
+           * Destructor. Delete the current and all replaced arrays of
+           * slots.
+           */
+          ~FlatList ();
+
+          /**
+           * Add a slot to the end of the list.
+           */
+          void
+          connect (const std::shared_ptr<Slot> &slot);
+
+          /**
+           * Remove a slot from the list.
+           */
+          void
+          disconnect (const std::shared_ptr<Slot> &slot);
+
+          /**
+           * Call all connected functions.
+           */
+          void
+          call (Args &... args) const;
+
+          /**
+           * Return whether there are any connected functions.
+           */
+          bool
+          empty () const;
+
+        private:
+          using SlotArray = std::vector<std::shared_ptr<Slot>>;
+
+          /**
+           * A pointer to the current array of slots. This array is never
+           * modified: connect() and disconnect() instead create a new
+           * array and make this pointer point to it.
+           */
+          std::atomic<const SlotArray *> current_slots;
+
+          /**
+           * Arrays that have been replaced by a newer one, but that may
+           * still be in use by threads currently executing call().
+           */
+          std::vector<const SlotArray *> replaced_slots;
+
+          /**
+           * The number of threads currently executing call(). If this
+           * number is zero at a time after an array has been replaced,
+           * then nobody can be using the replaced array any more.
+           */
+          mutable std::atomic<unsigned int> n_active_calls;
+
+          /**
+           * A mutex that serializes connect() and disconnect() operations.
+           */
+          std::mutex mutex;
+
+          /**
+           * Make `new_slots` the current array of slots, and delete
+           * replaced arrays if possible. This function must be called
+           * while holding the lock on `mutex`.
+           */
+          void
+          publish (const SlotArray *new_slots);
+      };
+
+      /**
+       * An implementation of the ConnectionBody interface for connections
+       * made with DispatchBackend::flat_list.
+       */
+      class FlatListConnectionBody : public internal::ConnectionBody
+      {
+        public:
+          FlatListConnectionBody (const std::shared_ptr<FlatList> &flat_list,
+                                  const std::shared_ptr<Slot> &slot);
+
+          virtual
+          void
+          disconnect () override;
+
+          virtual
+          bool
+          connected () const override;
+
+        private:
+          std::weak_ptr<FlatList> flat_list;
+          std::weak_ptr<Slot>     slot;
+      };
+
+      /**
+       * The mechanism used to call connected functions.
+       */
+      DispatchBackend backend;
+
+      /**
+       * The object used for DispatchBackend::signals2.
+       */
+      boost::signals2::signal<void (Args...)> signals2_signal;
+
+      /**
+       * The object used for DispatchBackend::flat_list.
+       */
+      std::shared_ptr<FlatList> flat_list;
+  };
+
+
+
+  inline
+  Connection::Connection (const boost::signals2::connection &connection)
+    :
+    bodies (1, std::make_shared<internal::Signals2ConnectionBody>(connection))
+  {}
+
+
+
+  inline
+  Connection::Connection (const std::shared_ptr<internal::ConnectionBody> &body)
+    :
+    bodies (1, body)
+  {}
+
+
+
+  inline
+  Connection::Connection (const Connection &connection_1,
+                          const Connection &connection_2)
+    :
+    bodies (connection_1.bodies)
+  {
+    bodies.insert (bodies.end(),
+                   connection_2.bodies.begin(), connection_2.bodies.end());
+  }
+
+
+
+  inline
+  void
+  Connection::disconnect () const
+  {
+    for (const auto &body : bodies)
+      body->disconnect();
+  }
+
+
+
+  inline
+  bool
+  Connection::connected () const
+  {
+    for (const auto &body : bodies)
+      if (body->connected())
+        return true;
+    return false;
+  }
+
+
+
+  template <typename... Args>
+  Signal<Args...>::Signal ()
+    :
+    backend (DispatchBackend::signals2),
+    flat_list (std::make_shared<FlatList>())
+  {}
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::set_backend (const DispatchBackend new_backend)
+  {
+    assert (signals2_signal.empty());
+    assert (flat_list->empty());
+
+    backend = new_backend;
+  }
+
+
+
+  template <typename... Args>
+  DispatchBackend
+  Signal<Args...>::get_backend () const
+  {
+    return backend;
+  }
+
+
+
+  template <typename... Args>
+  Connection
+  Signal<Args...>::connect (const std::function<void (Args...)> &slot)
+  {
+    switch (backend)
+      {
+        case DispatchBackend::signals2:
+          return signals2_signal.connect (slot);
+
+        case DispatchBackend::flat_list:
+        {
+          const auto new_slot = std::make_shared<Slot> (slot);
+          flat_list->connect (new_slot);
+          return Connection (std::make_shared<FlatListConnectionBody> (flat_list, new_slot));
+        }
+
+        default:
+          assert (false);
+          return {};
+      }
+  }
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::operator() (Args... args) const
+  {
+    if (backend == DispatchBackend::flat_list)
+      flat_list->call (args...);
+    else
+      signals2_signal (std::move(args)...);
+  }
+
+
+
+  template <typename... Args>
+  Signal<Args...>::FlatList::FlatList ()
+    :
+    current_slots (new SlotArray()),
+    n_active_calls (0)
+  {}
+
+
+
+  template <typename... Args>
+  Signal<Args...>::FlatList::~FlatList ()
+  {
+    delete current_slots.load();
+    for (const SlotArray *slots : replaced_slots)
+      delete slots;
+  }
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::FlatList::connect (const std::shared_ptr<Slot> &slot)
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+
+    SlotArray *new_slots = new SlotArray (*current_slots.load());
+    new_slots->push_back (slot);
+    publish (new_slots);
+  }
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::FlatList::disconnect (const std::shared_ptr<Slot> &slot)
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+
+    // First make sure that threads currently walking over the array
+    // do not start calling the function, then create a new array
+    // without the slot.
+    slot->connected = false;
+
+    SlotArray *new_slots = new SlotArray();
+    for (const auto &s : *current_slots.load())
+      if (s != slot)
+        new_slots->push_back (s);
+    publish (new_slots);
+  }
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::FlatList::publish (const SlotArray *new_slots)
+  {
+    replaced_slots.push_back (current_slots.exchange (new_slots));
+
+    // A thread executing call() first increments the counter of
+    // active calls, and only then reads the pointer to the current
+    // array. So if a thread had read the pointer to one of the arrays
+    // that have been replaced, it must already have incremented the
+    // counter, and if the counter is zero, all of these threads must
+    // have finished. (All of these operations are sequentially
+    // consistent atomic operations.) In that case, we can delete the
+    // replaced arrays; otherwise we defer this to the next connect()
+    // or disconnect() operation, or the destructor.
+    if (n_active_calls.load() == 0)
+      {
+        for (const SlotArray *slots : replaced_slots)
+          delete slots;
+        replaced_slots.clear();
+      }
+  }
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::FlatList::call (Args &... args) const
+  {
+    ++n_active_calls;
+    const SlotArray &slots = *current_slots.load();
+
+    try
+      {
+        for (const auto &slot : slots)
+          if (slot->connected.load())
+            slot->function (args...);
+      }
+    catch (...)
+      {
+        --n_active_calls;
+        throw;
+      }
+    --n_active_calls;
+  }
+
+
+
+  template <typename... Args>
+  bool
+  Signal<Args...>::FlatList::empty () const
+  {
+    return current_slots.load()->empty();
+  }
+
+
+
+  template <typename... Args>
+  Signal<Args...>::FlatListConnectionBody::
+  FlatListConnectionBody (const std::shared_ptr<FlatList> &flat_list,
+                          const std::shared_ptr<Slot> &slot)
+    :
+    flat_list (flat_list),
+    slot (slot)
+  {}
+
+
+
+  template <typename... Args>
+  void
+  Signal<Args...>::FlatListConnectionBody::disconnect ()
+  {
+    // Only do something if both the list and the slot still exist,
+    // and if the slot has not been disconnected before.
+    const std::shared_ptr<FlatList> list = flat_list.lock();
+    const std::shared_ptr<Slot>     s    = slot.lock();
+    if (list && s && s->connected.load())
+      list->disconnect (s);
+  }
+
+
+
+  template <typename... Args>
+  bool
+  Signal<Args...>::FlatListConnectionBody::connected () const
+  {
+    const std::shared_ptr<Slot> s = slot.lock();
+    return (s && s->connected.load());
+  }
+}
+
+#endif
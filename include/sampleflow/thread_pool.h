@@ -0,0 +1,430 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_THREAD_POOL_H
+#define SAMPLEFLOW_THREAD_POOL_H
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  /**
+   * A class that represents a fixed set of worker threads to which tasks
+   * can be submitted for execution at a later time. Consumer and Filter
+   * objects that run in ParallelMode::asynchronous use such a pool to
+   * process their samples (see Consumer::set_thread_pool()), rather than
+   * creating a new thread for every sample -- the latter would be what
+   * `std::async(std::launch::async, ...)` does on most systems, and the
+   * cost of creating and destroying a thread would then easily dominate
+   * the cost of processing cheap samples.
+   *
+   * The threads of a pool are created in the constructor and only
+   * terminated in the destructor. In between, they wait for tasks to be
+   * submitted via the submit() or enqueue() functions and execute them
+   * in the order in which they were submitted. There is a process-wide
+   * pool that can be obtained via the default_pool() function and that is
+   * used by all consumers that do not explicitly select a different pool.
+   * Creating separate pools is useful if one wants to limit the number of
+   * threads that work on a specific part of a pipeline.
+   *
+   *
+   * ### Threading model ###
+   *
+   * All member functions of this class can be called concurrently and
+   * from multiple threads, including from tasks that are currently
+   * executing on one of the threads of the pool.
+   */
+  class ThreadPool
+  {
+    public:
+      /**
+       * Constructor. Start the given number of worker threads.
+       *
+       * @param[in] n_threads The number of threads this pool should use
+       *   to execute tasks. If zero (which is also what
+       *   `std::thread::hardware_concurrency()` returns if it cannot
+       *   determine the number of processor cores), then one thread is
+       *   created.
+       */
+      explicit
+      ThreadPool (const unsigned int n_threads = std::thread::hardware_concurrency());
+
+      /**
+       * Destructor. Wait for all tasks that have already been submitted
+       * to finish, then terminate the worker threads.
+       */
+      ~ThreadPool ();
+
+      /**
+       * Copying a thread pool does not make sense, so disallow it.
+       */
+      ThreadPool (const ThreadPool &) = delete;
+
+      /**
+       * Copying a thread pool does not make sense, so disallow it.
+       */
+      ThreadPool &operator= (const ThreadPool &) = delete;
+
+      /**
+       * Queue the given task for execution on one of the worker threads of
+       * this pool.
+       *
+       * @param[in] task The function object to execute.
+       *
+       * @return A `std::future` object that becomes ready once the task has
+       *   finished executing. If the task throws an exception, then the
+       *   exception is stored in the future and re-thrown by
+       *   `std::future::get()`.
+       */
+      std::future<void>
+      submit (const std::function<void ()> &task);
+
+      /**
+       * Queue the given task for execution on one of the worker threads of
+       * this pool. This function is like submit(), but does not create a
+       * `std::future` object and is consequently cheaper. It is intended for
+       * callers that keep track of the completion of tasks themselves.
+       *
+       * @param[in] task The function object to execute. The function must
+       *   not throw an exception: Like for tasks run by `std::thread`, an
+       *   exception that escapes from the task leads to the program being
+       *   terminated.
+       */
+      void
+      enqueue (const std::function<void ()> &task);
+
+      /**
+       * Call `f(i)` for all $i=0,\ldots,n-1$, using the threads of this
+       * pool as well as the calling thread, and return once all of these
+       * calls have finished. The call `f(0)` is executed on the calling
+       * thread; all others are submitted to the pool. While waiting for
+       * them to finish, the calling thread helps executing tasks from the
+       * pool's queue (see run_pending_task()), so that this function can
+       * also be called from one of the pool's threads without the risk of
+       * deadlocks. Once the queue is empty, the calling thread blocks
+       * until the remaining calls have finished.
+       *
+       * If one of the calls throws an exception, then this function
+       * re-throws it once all calls have finished.
+       *
+       * @param[in] n The number of calls.
+       * @param[in] f The function to call. It must be safe to call it
+       *   concurrently with different arguments.
+       */
+      template <typename Function>
+      void
+      parallel_for (const unsigned int n,
+                    const Function &f);
+
+      /**
+       * Return the number of worker threads of this pool.
+       */
+      unsigned int
+      n_threads () const;
+
+      /**
+       * Return whether the calling thread is one of the worker threads of
+       * this pool.
+       */
+      bool
+      is_worker_thread () const;
+
+      /**
+       * Take one task that has been submitted but has not started
+       * executing yet off the queue, and execute it on the calling thread.
+       * This function is useful if a task running on one of the
+       * pool's threads needs to wait for other tasks to finish: If it simply
+       * blocked, and if all other threads of the pool were also blocked in
+       * the same way, then no thread would be available to execute the
+       * tasks that are being waited for. Instead of blocking, such
+       * a task should therefore help working through the queue.
+       *
+       * @return Whether a task was executed. If `false`, then there were no
+       *   queued tasks at the time this function was called.
+       */
+      bool
+      run_pending_task ();
+
+      /**
+       * Return a reference to a thread pool that is shared by the whole
+       * program and that has as many threads as there are processor cores
+       * in the machine. The pool is created the first time this function is
+       * called.
+       */
+      static
+      ThreadPool &
+      default_pool ();
+
+    private:
+      /**
+       * The worker threads.
+       */
+      std::vector<std::thread> worker_threads;
+
+      /**
+       * The queue of tasks that have been submitted but not yet started.
+       */
+      std::deque<std::function<void ()>> pending_tasks;
+
+      /**
+       * A mutex that guards access to the task queue and the
+       * `shutting_down` flag.
+       */
+      mutable std::mutex mutex;
+
+      /**
+       * A condition variable worker threads wait on while there are no
+       * tasks in the queue.
+       */
+      std::condition_variable task_available;
+
+      /**
+       * A flag that is set by the destructor to indicate that the worker
+       * threads should terminate once the queue has been emptied.
+       */
+      bool shutting_down;
+
+      /**
+       * The function executed by each of the worker threads.
+       */
+      void
+      worker_loop ();
+  };
+
+
+
+  inline
+  ThreadPool::ThreadPool (const unsigned int n_threads)
+    :
+    shutting_down (false)
+  {
+    const unsigned int n_worker_threads = std::max (n_threads, 1U);
+
+    worker_threads.reserve (n_worker_threads);
+    for (unsigned int i=0; i<n_worker_threads; ++i)
+      worker_threads.emplace_back ([this]()
+    {
+      this->worker_loop();
+    });
+  }
+
+
+
+  inline
+  ThreadPool::~ThreadPool ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      shutting_down = true;
+    }
+    task_available.notify_all();
+
+    for (auto &thread : worker_threads)
+      thread.join();
+  }
+
+
+
+  inline
+  std::future<void>
+  ThreadPool::submit (const std::function<void ()> &task)
+  {
+    // std::function objects need to be copyable, but std::packaged_task
+    // is not. So wrap the packaged task in a shared pointer, and queue
+    // a function object that just calls it.
+    const auto packaged_task = std::make_shared<std::packaged_task<void ()>> (task);
+    std::future<void> future = packaged_task->get_future();
+
+    enqueue ([packaged_task]()
+    {
+      (*packaged_task)();
+    });
+
+    return future;
+  }
+
+
+
+  inline
+  void
+  ThreadPool::enqueue (const std::function<void ()> &task)
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      assert (shutting_down == false);
+
+      pending_tasks.emplace_back (task);
+    }
+    task_available.notify_one();
+  }
+
+
+
+  template <typename Function>
+  void
+  ThreadPool::parallel_for (const unsigned int n,
+                            const Function &f)
+  {
+    std::vector<std::future<void>> futures;
+    futures.reserve (n);
+    for (unsigned int i=1; i<n; ++i)
+      futures.emplace_back (submit ([&f, i]()
+    {
+      f(i);
+    }));
+
+    // Execute the first call here. If it throws an exception, we still
+    // need to wait for the others since they reference 'f':
+    std::exception_ptr exception;
+    if (n > 0)
+      {
+        try
+          {
+            f(0);
+          }
+        catch (...)
+          {
+            exception = std::current_exception();
+          }
+      }
+
+    // Then wait for the other calls. As long as the pool has tasks
+    // queued, help working on them. Once the queue is empty, the call
+    // we are waiting for has been started by some other thread, and
+    // we can simply block until it finishes rather than spin and take
+    // processor time away from the threads doing the actual work.
+    for (auto &future : futures)
+      {
+        while (future.wait_for (std::chrono::seconds(0)) != std::future_status::ready)
+          if (run_pending_task() == false)
+            {
+              future.wait();
+              break;
+            }
+
+        try
+          {
+            future.get();
+          }
+        catch (...)
+          {
+            if (!exception)
+              exception = std::current_exception();
+          }
+      }
+
+    if (exception)
+      std::rethrow_exception (exception);
+  }
+
+
+
+  inline
+  unsigned int
+  ThreadPool::n_threads () const
+  {
+    return worker_threads.size();
+  }
+
+
+
+  inline
+  bool
+  ThreadPool::is_worker_thread () const
+  {
+    const std::thread::id this_thread = std::this_thread::get_id();
+    for (const auto &thread : worker_threads)
+      if (thread.get_id() == this_thread)
+        return true;
+    return false;
+  }
+
+
+
+  inline
+  bool
+  ThreadPool::run_pending_task ()
+  {
+    std::function<void ()> task;
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      if (pending_tasks.empty())
+        return false;
+
+      task = std::move (pending_tasks.front());
+      pending_tasks.pop_front();
+    }
+
+    task();
+    return true;
+  }
+
+
+
+  inline
+  ThreadPool &
+  ThreadPool::default_pool ()
+  {
+    // C++11 guarantees that function-local static variables are
+    // initialized exactly once, even if several threads call the
+    // function at the same time.
+    static ThreadPool pool;
+    return pool;
+  }
+
+
+
+  inline
+  void
+  ThreadPool::worker_loop ()
+  {
+    while (true)
+      {
+        std::function<void ()> task;
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          task_available.wait (lock,
+                               [this]()
+          {
+            return (shutting_down || !pending_tasks.empty());
+          });
+
+          // We only terminate once all tasks have been worked on, so
+          // that futures handed out by submit() all become ready.
+          if (pending_tasks.empty())
+            return;
+
+          task = std::move (pending_tasks.front());
+          pending_tasks.pop_front();
+        }
+
+        task();
+      }
+  }
+}
+
+#endif
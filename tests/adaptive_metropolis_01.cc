@@ -0,0 +1,122 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Like the adaptive_mh_01 test, but use the AdaptiveMetropolis
+// producer. Then check that freezing the adaptation and using a window
+// result in the covariance estimate one expects: After adaptation has
+// ended, the estimate needs to be the covariance of the samples up to that
+// point, and with a window, the covariance of the last samples of the
+// window (in both cases up to the contribution of the initial covariance
+// matrix).
+
+
+#include <iostream>
+#include <eigen3/Eigen/Dense>
+
+#include <sampleflow/producers/adaptive_metropolis.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = Eigen::Vector2d;
+
+
+double log_likelihood (const SampleType &x)
+{
+  const SampleType mu = {1,2};
+  const SampleType y = x-mu;
+  Eigen::Matrix2d C;
+  C << 1, 0.1,
+  0.1, 1;
+  return -0.5 * (y.transpose()*(C.inverse()*y))(0,0);
+}
+
+
+
+int main ()
+{
+  std::cout.precision(4);
+
+  const Eigen::MatrixXd initial_covariance = 0.01 * Eigen::MatrixXd::Identity(2,2);
+
+  // First the same setup as in the adaptive_mh_01 test:
+  {
+    SampleFlow::Producers::AdaptiveMetropolis<SampleType> am_sampler (initial_covariance, 1000);
+
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.connect_to_producer(am_sampler);
+
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+    covariance_matrix.connect_to_producer(am_sampler);
+
+    am_sampler.sample ({1,2}, &log_likelihood, 10000);
+
+    std::cout << "Mean value:\n" << mean_value.get() << std::endl;
+    std::cout << "Covariance matrix:\n" << covariance_matrix.get() << std::endl;
+    std::cout << "Covariance estimate:\n" << am_sampler.covariance_estimate() << std::endl;
+  }
+
+  // Then stop adapting after 5000 samples, and compare with the
+  // covariance of these samples:
+  {
+    SampleFlow::Producers::AdaptiveMetropolis<SampleType> am_sampler (initial_covariance, 1000, 5000);
+
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+    SampleFlow::Consumers::CountSamples<SampleType> counter;
+    SampleFlow::Consumers::Action<SampleType>
+    first_samples ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+    {
+      if (counter.get() <= 5000)
+        covariance_matrix.consume (x, aux_data);
+    });
+    counter.connect_to_producer(am_sampler);
+    first_samples.connect_to_producer(am_sampler);
+
+    am_sampler.sample ({1,2}, &log_likelihood, 10000);
+
+    std::cout << "Frozen estimate error: "
+              << (am_sampler.covariance_estimate() - covariance_matrix.get()).norm()
+              << std::endl;
+  }
+
+  // Finally use a window of 1000 samples, and produce the samples in two
+  // calls to sample(). Compare with the covariance of the last 1000
+  // samples.
+  {
+    SampleFlow::Producers::AdaptiveMetropolis<SampleType> am_sampler (initial_covariance, 1000,
+        std::numeric_limits<SampleFlow::types::sample_index>::max(),
+        1000);
+
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+    SampleFlow::Consumers::CountSamples<SampleType> counter;
+    SampleFlow::Consumers::Action<SampleType>
+    last_samples ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+    {
+      if (counter.get() > 9000)
+        covariance_matrix.consume (x, aux_data);
+    });
+    counter.connect_to_producer(am_sampler);
+    last_samples.connect_to_producer(am_sampler);
+
+    am_sampler.sample ({1,2}, &log_likelihood, 5000);
+    am_sampler.sample ({1,2}, &log_likelihood, 5000, 1);
+
+    std::cout << "Window estimate error: "
+              << (am_sampler.covariance_estimate() - covariance_matrix.get()).norm()
+              << std::endl;
+  }
+}
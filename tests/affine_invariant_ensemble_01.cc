@@ -0,0 +1,121 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the AffineInvariantEnsemble producer: Sample a strongly elongated
+// two-dimensional Gaussian, for which a Metropolis-Hastings sampler would
+// need a carefully tuned proposal distribution, and check its mean and
+// covariance matrix. Also check that every walker produces the same number
+// of samples, and that the samples do not depend on the number of threads
+// used.
+
+
+#include <iostream>
+#include <iomanip>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/producers/affine_invariant_ensemble.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+// A Gaussian with mean (1,2) and covariance matrix
+//   [ 100    9.9 ]
+//   [ 9.9    1   ],
+// i.e., with standard deviations 10 and 1 and correlation 0.99.
+double log_likelihood (const SampleType &x)
+{
+  const double y0 = (x[0]-1)/10;
+  const double y1 = (x[1]-2);
+  const double rho = 0.99;
+  return -(y0*y0 - 2*rho*y0*y1 + y1*y1) / (2*(1-rho*rho));
+}
+
+
+std::vector<SampleType>
+run (SampleFlow::ThreadPool &thread_pool,
+     const bool print)
+{
+  SampleFlow::Producers::AffineInvariantEnsemble<SampleType> ensemble_sampler;
+  ensemble_sampler.set_thread_pool (thread_pool);
+
+  std::vector<SampleType> samples;
+  std::vector<unsigned int> n_samples_per_walker (10, 0);
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+  {
+    samples.push_back (x);
+    ++n_samples_per_walker[aux_data.get<unsigned int>(SampleFlow::AuxiliaryDataKeys::chain_index)];
+  });
+  record.connect_to_producer (ensemble_sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (ensemble_sampler);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (ensemble_sampler);
+
+  // Start all walkers in a small ball around the origin:
+  std::vector<SampleType> starting_points;
+  for (unsigned int k=0; k<10; ++k)
+    starting_points.push_back (SampleType {0.01*k, 0.01*((3*k)%10)});
+
+  ensemble_sampler.sample (starting_points, &log_likelihood, 20000, 1);
+
+  if (print)
+    {
+      std::cout << std::fixed << std::setprecision(1);
+      std::cout << "Mean value: " << mean_value.get()[0] << ' ' << mean_value.get()[1] << std::endl;
+      std::cout << "Covariance matrix:" << std::endl
+                << "  " << covariance_matrix.get()(0,0) << ' ' << covariance_matrix.get()(0,1) << std::endl
+                << "  " << covariance_matrix.get()(1,0) << ' ' << covariance_matrix.get()(1,1) << std::endl;
+
+      std::cout << "Samples per walker:";
+      for (const unsigned int n : n_samples_per_walker)
+        std::cout << ' ' << n;
+      std::cout << std::endl;
+
+      double mean_acceptance_ratio = 0;
+      for (const double a : ensemble_sampler.get_acceptance_ratios())
+        mean_acceptance_ratio += a/10;
+      std::cout << "Acceptance ratio: " << mean_acceptance_ratio << std::endl;
+    }
+
+  return samples;
+}
+
+
+int main ()
+{
+  std::vector<SampleType> samples;
+  {
+    SampleFlow::ThreadPool thread_pool (1);
+    samples = run (thread_pool, true);
+  }
+  {
+    SampleFlow::ThreadPool thread_pool (3);
+    const std::vector<SampleType> other_samples = run (thread_pool, false);
+
+    bool same = (samples.size() == other_samples.size());
+    for (unsigned int i=0; same && i<samples.size(); ++i)
+      same = (samples[i][0] == other_samples[i][0]) && (samples[i][1] == other_samples[i][1]);
+    std::cout << "Same samples with 3 threads: " << same << std::endl;
+  }
+}
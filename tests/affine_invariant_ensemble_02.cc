@@ -0,0 +1,78 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that AffineInvariantEnsemble::get_acceptance_ratios() counts the
+// trial samples of all previous calls to sample(), as
+// ParallelTempering::get_acceptance_ratios() does: Call sample() twice,
+// the second time with more walkers, and compare the acceptance ratios
+// against the fraction of samples of each walker that are not flagged
+// as repeated.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/producers/affine_invariant_ensemble.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x[0]*x[0] + x[1]*x[1])/2;
+}
+
+
+int main ()
+{
+  SampleFlow::Producers::AffineInvariantEnsemble<SampleType> ensemble_sampler;
+
+  std::vector<unsigned int> n_samples (8, 0);
+  std::vector<unsigned int> n_accepted (8, 0);
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType, SampleFlow::AuxiliaryData aux_data)
+  {
+    const unsigned int k
+      = aux_data.get<unsigned int>(SampleFlow::AuxiliaryDataKeys::chain_index);
+    ++n_samples[k];
+    if (aux_data.get<bool>(SampleFlow::AuxiliaryDataKeys::sample_is_repeated) == false)
+      ++n_accepted[k];
+  });
+  record.connect_to_producer (ensemble_sampler);
+
+  std::vector<SampleType> starting_points;
+  for (unsigned int k=0; k<8; ++k)
+    starting_points.push_back (SampleType {0.1*k, 0.1*((3*k)%8)});
+
+  ensemble_sampler.sample (std::vector<SampleType>(starting_points.begin(),
+                                                   starting_points.begin()+6),
+                           &log_likelihood, 1000, 1);
+  ensemble_sampler.sample (starting_points, &log_likelihood, 500, 2);
+
+  const std::vector<double> ratios = ensemble_sampler.get_acceptance_ratios();
+  bool same = (ratios.size() == 8);
+  for (unsigned int k=0; k<ratios.size(); ++k)
+    if (ratios[k] != 1. * n_accepted[k] / n_samples[k])
+      same = false;
+
+  std::cout << "Samples of walkers 0 and 7: "
+            << n_samples[0] << ' ' << n_samples[7] << std::endl;
+  std::cout << "Acceptance ratios count all calls: "
+            << (same ? "yes" : "no") << std::endl;
+}
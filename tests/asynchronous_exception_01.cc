@@ -0,0 +1,83 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that an exception thrown by an asynchronous consumer on a thread
+// of the pool does not terminate the program, but is rethrown by flush()
+// and so reaches the caller of the producer's sample() function. All
+// other samples still have to be processed, and the consumer has to be
+// usable afterwards.
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/thread_pool.h>
+
+
+int main ()
+{
+  using SampleType = int;
+
+  SampleFlow::ThreadPool thread_pool (2);
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  std::atomic<unsigned int> n_processed_samples (0);
+  SampleFlow::Consumers::Action<SampleType>
+  consumer ([&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    if (x == 10)
+      throw std::runtime_error ("Sample 10 is not acceptable.");
+    ++n_processed_samples;
+  },
+  SampleFlow::ParallelMode::asynchronous);
+  consumer.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 4);
+  consumer.set_thread_pool (thread_pool);
+  consumer.connect_to_producer (range_producer);
+
+  std::vector<SampleType> samples (1000);
+  for (unsigned int i=0; i<samples.size(); ++i)
+    samples[i] = i;
+
+  try
+    {
+      range_producer.sample (samples);
+      std::cout << "No exception" << std::endl;
+    }
+  catch (const std::runtime_error &e)
+    {
+      std::cout << "Caught: " << e.what() << std::endl;
+    }
+  std::cout << "Processed samples: " << n_processed_samples << std::endl;
+
+  // The exception has been reported, so a second round of samples that
+  // does not contain the offending one must go through without one.
+  for (auto &x : samples)
+    x += 1000;
+  try
+    {
+      range_producer.sample (samples);
+      std::cout << "No exception" << std::endl;
+    }
+  catch (const std::runtime_error &e)
+    {
+      std::cout << "Caught: " << e.what() << std::endl;
+    }
+  std::cout << "Processed samples: " << n_processed_samples << std::endl;
+}
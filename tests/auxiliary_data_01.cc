@@ -0,0 +1,119 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AuxiliaryData class: Predefined keys and keys created from
+// strings, typed access to entries, replacing entries, and the interface
+// that mimics std::map<std::string,boost::any>.
+
+
+#include <iostream>
+#include <string>
+
+#include <sampleflow/auxiliary_data.h>
+
+
+int main ()
+{
+  using namespace SampleFlow;
+
+  // Keys created from strings are the same as the predefined ones if
+  // the strings match:
+  std::cout << "Predefined keys: "
+            << AuxiliaryDataKeys::relative_log_likelihood.name() << ", "
+            << AuxiliaryDataKeys::sample_is_repeated.name() << std::endl;
+  std::cout << "Same key: "
+            << (AuxiliaryDataKey("relative log likelihood") == AuxiliaryDataKeys::relative_log_likelihood)
+            << (AuxiliaryDataKey(std::string("my key")) == AuxiliaryDataKey("my key"))
+            << (AuxiliaryDataKey("my key") == AuxiliaryDataKeys::sample_is_repeated)
+            << std::endl;
+
+  // Typed access:
+  const AuxiliaryDataKey my_key ("my key");
+  AuxiliaryData aux_data
+  {
+    {AuxiliaryDataKeys::relative_log_likelihood, -1.5},
+    {AuxiliaryDataKeys::sample_is_repeated, true},
+    {my_key, std::string("some text")}
+  };
+  std::cout << "Size: " << aux_data.size() << std::endl;
+  std::cout << "Log likelihood: "
+            << aux_data.get<double>(AuxiliaryDataKeys::relative_log_likelihood) << std::endl;
+  std::cout << "Repeated: "
+            << aux_data.get<bool>(AuxiliaryDataKeys::sample_is_repeated) << std::endl;
+  std::cout << "Text: " << aux_data.get<std::string>(my_key) << std::endl;
+  std::cout << "Wrong type: "
+            << (aux_data.get_if<bool>(AuxiliaryDataKeys::relative_log_likelihood) == nullptr)
+            << std::endl;
+  try
+    {
+      aux_data.get<int>(my_key);
+    }
+  catch (const boost::bad_any_cast &)
+    {
+      std::cout << "Caught bad_any_cast" << std::endl;
+    }
+  try
+    {
+      aux_data.get<double>("not there");
+    }
+  catch (const std::out_of_range &)
+    {
+      std::cout << "Caught out_of_range" << std::endl;
+    }
+
+  // Replace an entry:
+  aux_data.set (AuxiliaryDataKeys::sample_is_repeated, false);
+  std::cout << "Size: " << aux_data.size()
+            << ", repeated: " << aux_data.get<bool>(AuxiliaryDataKeys::sample_is_repeated)
+            << std::endl;
+
+  // Now use the interface that looks like std::map<std::string,boost::any>.
+  // Scalar values wrapped in boost::any are stored like any other scalars.
+  AuxiliaryData legacy_aux_data
+  {
+    {"relative log likelihood", boost::any(2.5)},
+    {"sample is repeated", boost::any(false)},
+    {"counter", boost::any(42)}
+  };
+  std::cout << "Log likelihood: "
+            << *legacy_aux_data.get_if<double>(AuxiliaryDataKeys::relative_log_likelihood)
+            << std::endl;
+  std::cout << "Counter: " << boost::any_cast<int>(legacy_aux_data.at("counter"))
+            << ", found: " << (legacy_aux_data.find("counter") != legacy_aux_data.end())
+            << ", key: " << legacy_aux_data.find("counter")->first
+            << ", count: " << legacy_aux_data.count("counter")
+            << legacy_aux_data.count("something else")
+            << std::endl;
+  for (const auto &entry : legacy_aux_data)
+    {
+      std::cout << "   " << entry.first;
+      if (const bool *p = boost::any_cast<bool>(&entry.second))
+        std::cout << " -> " << (*p ? "true" : "false");
+      else if (const double *p = boost::any_cast<double>(&entry.second))
+        std::cout << " -> " << *p;
+      else if (const int *p = boost::any_cast<int>(&entry.second))
+        std::cout << " -> " << *p;
+      std::cout << std::endl;
+    }
+
+  // Copies are independent of the original:
+  AuxiliaryData copy = legacy_aux_data;
+  copy.set ("counter", 1.);
+  std::cout << "Original: " << boost::any_cast<int>(legacy_aux_data.at("counter"))
+            << ", copy: " << copy.get<double>("counter") << std::endl;
+
+  std::cout << "Empty: " << AuxiliaryData().empty() << std::endl;
+}
@@ -0,0 +1,88 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that samples sent in blocks by a Range producer arrive at all of
+// the downstream consumers and filters: consumers that override
+// consume_batch(), consumers that rely on the default implementation of
+// that function, filters (which pass the blocks on), and slots connected
+// via the two-argument version of Producer::connect_to_signals() that do
+// not know about blocks at all. The block size does not evenly divide the
+// number of samples, so the last block is shorter than the others.
+
+
+#include <iostream>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/histogram.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/stream_output.h>
+
+
+using SampleType = double;
+
+
+int main ()
+{
+  SampleFlow::Producers::Range<SampleType> range_producer (4);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::Histogram<SampleType> histogram (0.5, 10.5, 2);
+  histogram.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::CountSamples<SampleType> counter;
+  counter.connect_to_producer(range_producer);
+
+  SampleFlow::Filters::TakeEveryNth<SampleType> every_third (3);
+  every_third.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::StreamOutput<SampleType> stream_output(std::cout);
+  stream_output.connect_to_producer(every_third);
+
+  unsigned int n_samples_seen_by_slot = 0;
+  const auto connections
+    = range_producer.connect_to_signals ([&](SampleType, SampleFlow::AuxiliaryData)
+  {
+    ++n_samples_seen_by_slot;
+  },
+  []() {});
+
+  const std::vector<SampleType> samples = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+  range_producer.sample (samples);
+
+  std::cout << "Mean value: " << mean_value.get() << std::endl;
+  std::cout << "Covariance matrix: [[" << covariance_matrix.get()(0,0) << "]]" << std::endl;
+  std::cout << "Histogram: "
+            << std::get<2>(histogram.get()[0]) << ' '
+            << std::get<2>(histogram.get()[1]) << std::endl;
+  std::cout << "Number of samples: " << counter.get() << std::endl;
+  std::cout << "Samples seen by slot: " << n_samples_seen_by_slot << std::endl;
+
+  // After disconnecting the slot, it should not see any further
+  // samples, whether they are sent in blocks or not:
+  connections.first.disconnect();
+  connections.second.disconnect();
+  range_producer.sample (samples);
+  std::cout << "Samples seen by slot after disconnecting: " << n_samples_seen_by_slot << std::endl;
+  std::cout << "Number of samples: " << counter.get() << std::endl;
+}
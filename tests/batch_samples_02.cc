@@ -0,0 +1,106 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that a Metropolis-Hastings sampler that sends its samples in
+// blocks produces exactly the same chain as one that sends every sample
+// individually, and that consumers that override consume_batch() compute
+// the same results from it.
+
+
+#include <iostream>
+#include <cmath>
+#include <random>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/histogram.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x-1)*(x-1);
+}
+
+
+struct Results
+{
+  double mean;
+  double variance;
+  double acceptance_ratio;
+  SampleFlow::Consumers::Histogram<SampleType>::value_type histogram;
+};
+
+
+Results run (const unsigned int batch_size)
+{
+  SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler (batch_size);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer(mh_sampler);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer(mh_sampler);
+
+  SampleFlow::Consumers::Histogram<SampleType> histogram (-2, 4, 12);
+  histogram.connect_to_producer(mh_sampler);
+
+  SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+  acceptance_ratio.connect_to_producer(mh_sampler);
+
+  std::mt19937 rng;
+  mh_sampler.sample ({0},
+                     &log_likelihood,
+                     [&](const SampleType &x)
+  {
+    std::uniform_real_distribution<double> distribution(-0.5,0.5);
+    return std::make_pair (x + distribution(rng), 1.0);
+  },
+  1003);
+
+  return { mean_value.get(),
+           covariance_matrix.get()(0,0),
+           acceptance_ratio.get(),
+           histogram.get()
+         };
+}
+
+
+int main ()
+{
+  const Results individual = run (1);
+  const Results batched    = run (100);
+
+  std::cout << "Mean value: " << individual.mean << std::endl;
+  std::cout << "Variance: " << individual.variance << std::endl;
+  std::cout << "Acceptance ratio: " << individual.acceptance_ratio << std::endl;
+
+  std::cout << "Same results with blocks of samples: "
+            << (((individual.mean == batched.mean)
+                 &&
+                 (individual.variance == batched.variance)
+                 &&
+                 (individual.acceptance_ratio == batched.acceptance_ratio)
+                 &&
+                 (individual.histogram == batched.histogram))
+                ?
+                "yes" : "no")
+            << std::endl;
+}
@@ -0,0 +1,50 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the CountSamples consumer when run in asynchronous mode on a
+// thread pool other than the default one.
+
+#include <iostream>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+
+int main ()
+{
+  using SampleType = double;
+
+  SampleFlow::ThreadPool thread_pool (2);
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::CountSamples<SampleType> sample_count;
+  sample_count.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 16);
+  sample_count.set_thread_pool (thread_pool);
+  sample_count.connect_to_producer(range_producer);
+
+  std::vector<SampleType> samples (10000);
+  for (unsigned int i=0; i<samples.size(); ++i)
+    samples[i] = i;
+  range_producer.sample (samples);
+
+  // The producer flushes its consumers at the end of sample(), so all
+  // 10000 samples must have been counted at this point.
+  std::cout << sample_count.get() << std::endl;
+}
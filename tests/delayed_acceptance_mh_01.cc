@@ -0,0 +1,110 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the DelayedAcceptanceMetropolisHastings producer: Sample a
+// Gaussian using a surrogate that is a Gaussian with a different mean and
+// width, and check that the samples have the mean and variance of the
+// true distribution, not of the surrogate. Also check that the number of
+// evaluations of the expensive log likelihood equals the number of trial
+// samples that were not rejected in the first stage, and that if the
+// surrogate equals the log likelihood, no trial sample is rejected in the
+// second stage.
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <valarray>
+
+#include <sampleflow/producers/delayed_acceptance_mh.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+unsigned int n_expensive_evaluations = 0;
+
+double log_likelihood (const SampleType &x)
+{
+  ++n_expensive_evaluations;
+  return -(x[0]-1)*(x[0]-1);
+}
+
+
+double surrogate_log_likelihood (const SampleType &x)
+{
+  return -(x[0]-1.2)*(x[0]-1.2)/1.5;
+}
+
+
+// The same as log_likelihood(), but without counting evaluations.
+double exact_surrogate_log_likelihood (const SampleType &x)
+{
+  return -(x[0]-1)*(x[0]-1);
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0,2);
+  return {SampleType {x[0] + distribution(rng)}, 1.0};
+}
+
+
+void run (const std::function<double (const SampleType &)> &surrogate)
+{
+  n_expensive_evaluations = 0;
+
+  SampleFlow::Producers::DelayedAcceptanceMetropolisHastings<SampleType> da_sampler;
+
+  unsigned int n_rejected[3] = {0, 0, 0};
+  SampleFlow::Consumers::Action<SampleType>
+  count_stages ([&](SampleType, SampleFlow::AuxiliaryData aux_data)
+  {
+    ++n_rejected[aux_data.get<unsigned int>(SampleFlow::AuxiliaryDataKeys::rejected_at_stage)];
+  });
+  count_stages.connect_to_producer (da_sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (da_sampler);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (da_sampler);
+
+  const unsigned int n_samples = 100000;
+  da_sampler.sample ({0}, &log_likelihood, surrogate, &perturb, n_samples);
+
+  std::cout << std::setprecision(2)
+            << "Mean: " << mean_value.get()[0]
+            << ", variance: " << covariance_matrix.get()(0,0) << std::endl;
+  std::cout << "Accepted: " << n_rejected[0]
+            << ", rejected at stage 1: " << n_rejected[1]
+            << ", rejected at stage 2: " << n_rejected[2] << std::endl;
+  std::cout << "Expensive evaluations: " << n_expensive_evaluations
+            << " (expected " << 1 + n_samples - n_rejected[1] << ")"
+            << std::endl;
+}
+
+
+int main ()
+{
+  run (&surrogate_log_likelihood);
+  run (&exact_surrogate_log_likelihood);
+}
@@ -0,0 +1,125 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the DelayedAcceptanceMetropolisHastings producer for samples
+// whose surrogate has zero probability:
+// - If the chain starts where the surrogate is zero but the target
+//   distribution is not, then the correction factor pi*(x)/pi*(y) of
+//   stage two is zero for all trial samples in the support of the
+//   surrogate. These trial samples need to be rejected at stage two
+//   without evaluating the log likelihood, and the chain can not enter
+//   the support of the surrogate.
+// - If the chain starts where both the surrogate and the target
+//   distribution are zero, then it needs to random-walk its way into the
+//   support and stay there.
+
+
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <sampleflow/producers/delayed_acceptance_mh.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+unsigned int n_expensive_evaluations = 0;
+
+// A Gaussian, either on the whole real line or only on x>=0.
+double log_likelihood (const SampleType &x)
+{
+  ++n_expensive_evaluations;
+  return -x*x/2;
+}
+
+double half_log_likelihood (const SampleType &x)
+{
+  ++n_expensive_evaluations;
+  if (x < 0)
+    return -std::numeric_limits<double>::infinity();
+  else
+    return -x*x/2;
+}
+
+
+// A wider Gaussian on x>=0.
+double surrogate_log_likelihood (const SampleType &x)
+{
+  if (x < 0)
+    return -std::numeric_limits<double>::infinity();
+  else
+    return -x*x/4;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+void run (const std::function<double (const SampleType &)> &log_likelihood)
+{
+  n_expensive_evaluations = 0;
+
+  SampleFlow::Producers::DelayedAcceptanceMetropolisHastings<SampleType> da_sampler;
+
+  unsigned int n_rejected[3] = {0, 0, 0};
+  unsigned int n_in_support = 0;
+  unsigned int first_sample_in_support = 0;
+  bool         stays_in_support = true;
+  SampleFlow::Consumers::Action<SampleType>
+  count ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+  {
+    const unsigned int sample_index = n_rejected[0] + n_rejected[1] + n_rejected[2];
+    ++n_rejected[aux_data.get<unsigned int>(SampleFlow::AuxiliaryDataKeys::rejected_at_stage)];
+
+    if (x >= 0)
+      {
+        if (n_in_support == 0)
+          first_sample_in_support = sample_index;
+        ++n_in_support;
+      }
+    else if (n_in_support > 0)
+      stays_in_support = false;
+  });
+  count.connect_to_producer (da_sampler);
+
+  const unsigned int n_samples = 1000;
+  da_sampler.sample (-3, log_likelihood, &surrogate_log_likelihood, &perturb, n_samples);
+
+  std::cout << "Accepted: " << n_rejected[0]
+            << ", rejected at stage 1: " << n_rejected[1]
+            << ", rejected at stage 2: " << n_rejected[2] << std::endl;
+  std::cout << "Trial samples rejected at stage 2 without expensive evaluation: "
+            << (1 + n_samples - n_rejected[1]) - n_expensive_evaluations << std::endl;
+  std::cout << "Samples in the support of the surrogate: " << n_in_support;
+  if (n_in_support > 0)
+    std::cout << ", the first one is sample " << first_sample_in_support
+              << ", stays in the support: " << (stays_in_support ? "yes" : "no");
+  std::cout << std::endl;
+}
+
+
+int main ()
+{
+  run (&log_likelihood);
+  run (&half_log_likelihood);
+}
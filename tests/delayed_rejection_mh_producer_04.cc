@@ -0,0 +1,157 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the DelayedRejection Metropolis Hastings producer with
+// Eigen::VectorXd samples and many delay stages: Sample a narrow
+// two-dimensional Gaussian with a proposal distribution that is much too
+// wide, so that the chain frequently goes through all eight delay stages.
+// Compare the samples with the ones obtained by a straightforward
+// implementation of the chain that evaluates the recursive formula for
+// the acceptance ratio directly.
+
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include <sampleflow/producers/delayed_rejection_mh.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = Eigen::VectorXd;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -x.squaredNorm() / (2*0.1*0.1);
+}
+
+
+// Perturb by a Gaussian whose width shrinks with each delay stage. Keep
+// track of the deepest delay stage reached.
+std::mt19937 perturb_rng;
+unsigned int deepest_delay_stage = 0;
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      const std::vector<SampleType> &rejected_samples)
+{
+  deepest_delay_stage = std::max<unsigned int> (deepest_delay_stage,
+                                                rejected_samples.size());
+
+  std::normal_distribution<double> distribution(0, 2./(1+rejected_samples.size()));
+  SampleType x_tilde = x;
+  for (unsigned int d=0; d<x.size(); ++d)
+    x_tilde(d) += distribution(perturb_rng);
+  return {x_tilde, 1.0};
+}
+
+
+// The acceptance ratio alpha(x; y_1,...,y_k) of delayed rejection, given
+// the log likelihoods of the current sample x and of the trial samples
+// y_1...y_k, evaluated directly by the recursive formula of Tierney and
+// Mira.
+double alpha (const double x,
+              const std::vector<double> &y)
+{
+  const unsigned int k = y.size() - 1;
+  double ratio = std::exp(y[k] - x);
+  for (unsigned int j=1; j<=k; ++j)
+    ratio *= (1 - alpha (y[k], std::vector<double>(y.begin()+(k-j), y.begin()+k))) /
+             (1 - alpha (x, std::vector<double>(y.begin(), y.begin()+j)));
+  return ratio;
+}
+
+
+// A direct implementation of the delayed rejection chain using the
+// function above.
+std::vector<SampleType>
+reference_chain (const SampleType &starting_point,
+                 const unsigned int max_delays,
+                 const unsigned int n_samples,
+                 const std::mt19937::result_type random_seed)
+{
+  std::mt19937 rng (random_seed);
+  std::uniform_real_distribution<> uniform_distribution(0,1);
+
+  SampleType current_sample         = starting_point;
+  double     current_log_likelihood = log_likelihood (current_sample);
+
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<n_samples; ++i)
+    {
+      std::vector<SampleType> rejected_samples;
+      std::vector<double>     trial_log_likelihoods;
+      for (unsigned int delay_stage=0; delay_stage<=max_delays; ++delay_stage)
+        {
+          const SampleType trial_sample = perturb (current_sample, rejected_samples).first;
+          trial_log_likelihoods.push_back (log_likelihood (trial_sample));
+
+          const double acceptance_ratio = alpha (current_log_likelihood,
+                                                 trial_log_likelihoods);
+          if (acceptance_ratio > 1 || acceptance_ratio >= uniform_distribution(rng))
+            {
+              current_sample         = trial_sample;
+              current_log_likelihood = trial_log_likelihoods.back();
+              break;
+            }
+          rejected_samples.push_back (trial_sample);
+        }
+      samples.push_back (current_sample);
+    }
+  return samples;
+}
+
+
+int main ()
+{
+  const unsigned int max_delays = 8;
+  const unsigned int n_samples  = 2000;
+  const SampleType starting_point = SampleType::Constant (2, 0.5);
+
+  SampleFlow::Producers::DelayedRejectionMetropolisHastings<SampleType> drmh_sampler;
+
+  std::vector<SampleType> samples;
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    samples.push_back (x);
+  });
+  record.connect_to_producer (drmh_sampler);
+
+  perturb_rng.seed (1);
+  drmh_sampler.sample (starting_point, &log_likelihood, &perturb,
+                       max_delays, n_samples, 42);
+
+  std::cout << "Deepest delay stage reached: " << deepest_delay_stage << std::endl;
+
+  SampleType mean = SampleType::Zero (2);
+  for (const auto &x : samples)
+    mean += x;
+  mean /= samples.size();
+  std::cout << std::fixed << std::setprecision(2)
+            << "Mean value: " << mean(0) << ' ' << mean(1) << std::endl;
+
+  perturb_rng.seed (1);
+  const std::vector<SampleType> reference_samples
+    = reference_chain (starting_point, max_delays, n_samples, 42);
+  std::cout << "Same samples as direct evaluation: "
+            << (samples == reference_samples ? "yes" : "no") << std::endl;
+}
@@ -0,0 +1,104 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that the DEMC producer produces the same sequence of samples,
+// in the same order, whether or not it evaluates log likelihoods on a
+// thread pool, and for different numbers of threads. Use a number of
+// samples that is not a multiple of the number of chains.
+
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/differential_evaluation_mh.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x-1)*(x-1)/2;
+}
+
+
+std::mt19937 perturb_rng;
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  std::normal_distribution<double> distribution(0,1);
+  return {x + distribution(perturb_rng), 1.0};
+}
+
+
+SampleType crossover (const SampleType &current_sample,
+                      const SampleType &sample_a,
+                      const SampleType &sample_b)
+{
+  return current_sample + 1.68 * (sample_a - sample_b);
+}
+
+
+std::vector<SampleType>
+run (SampleFlow::ThreadPool *thread_pool)
+{
+  perturb_rng.seed (1);
+
+  SampleFlow::Producers::DifferentialEvaluationMetropolisHastings<SampleType> de_sampler;
+  if (thread_pool != nullptr)
+    de_sampler.set_thread_pool (*thread_pool);
+
+  std::vector<SampleType> samples;
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    samples.push_back (x);
+  });
+  record.connect_to_producer (de_sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (de_sampler);
+
+  de_sampler.sample ({-2, -1, 0, 1, 2, 3, 4, 5},
+                     &log_likelihood,
+                     &perturb,
+                     &crossover,
+                     5,
+                     10003,
+                     1);
+
+  std::cout << "Number of samples: " << samples.size()
+            << ", mean value: " << mean_value.get() << std::endl;
+  return samples;
+}
+
+
+int main ()
+{
+  const std::vector<SampleType> serial_samples = run (nullptr);
+
+  for (const unsigned int n_threads : {1, 2, 4})
+    {
+      SampleFlow::ThreadPool thread_pool (n_threads);
+      const bool same = (run (&thread_pool) == serial_samples);
+      std::cout << n_threads << " threads: "
+                << (same ? "same" : "different")
+                << std::endl;
+    }
+}
@@ -0,0 +1,92 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that producers and filters that use DispatchBackend::flat_list
+// deliver samples (individually and in blocks) to all connected
+// consumers, and that connecting and disconnecting consumers while
+// samples are being sent works as expected: A consumer connected from
+// within a slot sees all samples sent after the current one (or, if
+// samples are sent in blocks, all following blocks), and one that is
+// disconnected from within a slot sees none of them.
+
+
+#include <iostream>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/stream_output.h>
+
+
+using SampleType = double;
+
+
+int main ()
+{
+  for (const unsigned int batch_size : {1, 3})
+    {
+      std::cout << "Batch size " << batch_size << ':' << std::endl;
+
+      SampleFlow::Producers::Range<SampleType> range_producer (batch_size);
+      range_producer.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+
+      SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+      mean_value.connect_to_producer(range_producer);
+
+      SampleFlow::Filters::TakeEveryNth<SampleType> every_fourth (4);
+      every_fourth.set_dispatch_backend (SampleFlow::DispatchBackend::flat_list);
+      every_fourth.connect_to_producer(range_producer);
+
+      SampleFlow::Consumers::StreamOutput<SampleType> stream_output(std::cout);
+      stream_output.connect_to_producer(every_fourth);
+
+      // Connect a slot that, upon seeing the sample 5, connects a counter
+      // and disconnects a second slot.
+      SampleFlow::Consumers::CountSamples<SampleType> late_counter;
+      std::pair<SampleFlow::Connection,SampleFlow::Connection> connections;
+      unsigned int n_samples_seen_by_slot = 0;
+      const auto trigger_connections
+        = range_producer.connect_to_signals ([&](SampleType sample, SampleFlow::AuxiliaryData)
+      {
+        if (sample == 5)
+          {
+            late_counter.connect_to_producer (range_producer);
+            connections.first.disconnect();
+          }
+      },
+      []() {});
+      connections
+        = range_producer.connect_to_signals ([&](SampleType, SampleFlow::AuxiliaryData)
+      {
+        ++n_samples_seen_by_slot;
+      },
+      []() {});
+
+      const std::vector<SampleType> samples = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+      range_producer.sample (samples);
+
+      std::cout << "Mean value: " << mean_value.get() << std::endl;
+      std::cout << "Samples seen by the late counter: " << late_counter.get() << std::endl;
+      std::cout << "Samples seen by the disconnected slot: " << n_samples_seen_by_slot << std::endl;
+      std::cout << "Slot still connected: "
+                << (connections.first.connected() ? "yes" : "no") << std::endl;
+
+      trigger_connections.first.disconnect();
+      trigger_connections.second.disconnect();
+      connections.second.disconnect();
+    }
+}
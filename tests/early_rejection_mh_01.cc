@@ -0,0 +1,118 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the EarlyRejectionMetropolisHastings producer: Sample the
+// posterior distribution of the mean of a set of normally distributed
+// measurements, whose log likelihood is a sum of non-positive terms. Run
+// the sampler twice, once with a log likelihood function that ignores the
+// threshold, and once with one that stops summing as soon as the partial
+// sum falls below the threshold. Check that both runs produce the same
+// chain, that the chain has the correct mean, and output how many terms
+// of the sum were evaluated in each case.
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/producers/early_rejection_mh.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+std::vector<double> measurements;
+unsigned long n_terms_evaluated = 0;
+
+
+double log_likelihood (const SampleType &x,
+                       const double threshold,
+                       const bool stop_early)
+{
+  double sum = 0;
+  for (const double y : measurements)
+    {
+      ++n_terms_evaluated;
+      sum += -(y-x[0])*(y-x[0])/2;
+
+      if (stop_early && (sum < threshold))
+        break;
+    }
+  return sum;
+}
+
+
+std::mt19937 perturb_rng;
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  std::normal_distribution<double> distribution(0,0.2);
+  return {SampleType {x[0] + distribution(perturb_rng)}, 1.0};
+}
+
+
+std::vector<double> run (const bool stop_early)
+{
+  n_terms_evaluated = 0;
+  perturb_rng.seed (1);
+
+  SampleFlow::Producers::EarlyRejectionMetropolisHastings<SampleType> sampler;
+
+  std::vector<double> chain;
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    chain.push_back (x[0]);
+  });
+  record.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (sampler);
+
+  sampler.sample ({0.},
+                  [&](const SampleType &x, const double threshold)
+  {
+    return log_likelihood (x, threshold, stop_early);
+  },
+  &perturb,
+  20000);
+
+  std::cout << "Mean value: " << std::setprecision(3) << mean_value.get()[0] << std::endl;
+  std::cout << "Terms evaluated: " << n_terms_evaluated << std::endl;
+
+  return chain;
+}
+
+
+int main ()
+{
+  // Create 1000 measurements with mean 0.5 and standard deviation 1. The
+  // posterior mean is then close to 0.5, with a standard deviation of
+  // about 0.03.
+  std::mt19937 rng;
+  std::normal_distribution<double> distribution(0.5,1);
+  for (unsigned int j=0; j<1000; ++j)
+    measurements.push_back (distribution(rng));
+
+  const std::vector<double> full_chain  = run (false);
+  const std::vector<double> early_chain = run (true);
+
+  std::cout << "Chains are identical: " << (full_chain == early_chain) << std::endl;
+}
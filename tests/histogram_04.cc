@@ -0,0 +1,76 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that copying a sharded Histogram object yields a histogram that
+// counts all samples the original has seen, including those that are
+// still held in its shards, and that the copy counts new samples itself
+// rather than in the shards of the original.
+
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/histogram.h>
+
+
+int main ()
+{
+  using SampleType = double;
+
+  SampleFlow::Consumers::Histogram<SampleType> histogram(0, 4, 4);
+  histogram.enable_sharding (2);
+
+  // Let two threads send samples through their own producers, so that
+  // the samples end up in both shards:
+  std::vector<SampleFlow::Producers::Range<SampleType>> range_producers (2);
+  for (auto &range_producer : range_producers)
+    histogram.connect_to_producer (range_producer);
+
+  std::vector<std::thread> threads;
+  for (unsigned int t=0; t<2; ++t)
+    threads.emplace_back ([&range_producers, t]()
+  {
+    std::vector<SampleType> samples(100*(t+1));
+    for (unsigned int i=0; i<samples.size(); ++i)
+      samples[i] = 0.5 + (i+t) % 4;
+    range_producers[t].sample (samples);
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  SampleFlow::Consumers::Histogram<SampleType> copy (histogram);
+
+  // Send a few more samples to the copy:
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  copy.connect_to_producer (range_producer);
+  range_producer.sample (std::vector<SampleType> (10, 3.5));
+
+  std::cout << "Original:" << std::endl;
+  for (const auto v : histogram.get())
+    std::cout << std::get<0>(v) << ' '
+              << std::get<1>(v) << " -> "
+              << std::get<2>(v)
+              << std::endl;
+
+  std::cout << "Copy:" << std::endl;
+  for (const auto v : copy.get())
+    std::cout << std::get<0>(v) << ' '
+              << std::get<1>(v) << " -> "
+              << std::get<2>(v)
+              << std::endl;
+}
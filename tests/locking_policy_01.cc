@@ -0,0 +1,109 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the different locking policies: First, run the same chain of
+// filters and consumers with each of the policies and make sure that the
+// results are the same. Then check that the Mutex class actually
+// protects a counter that is incremented from several threads when
+// using LockingPolicy::mutex and LockingPolicy::spinlock.
+
+
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/last_sample.h>
+
+
+using SampleType = double;
+
+
+void run (const SampleFlow::LockingPolicy locking_policy)
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Filters::DiscardFirstN<SampleType> discard (10);
+  discard.set_locking_policy (locking_policy);
+  discard.connect_to_producer (range_producer);
+
+  SampleFlow::Filters::TakeEveryNth<SampleType> every_nth (3);
+  every_nth.set_locking_policy (locking_policy);
+  every_nth.connect_to_producer (discard);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.set_locking_policy (locking_policy);
+  mean_value.connect_to_producer (every_nth);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.set_locking_policy (locking_policy);
+  count_samples.connect_to_producer (every_nth);
+
+  SampleFlow::Consumers::LastSample<SampleType> last_sample;
+  last_sample.set_locking_policy (locking_policy);
+  last_sample.connect_to_producer (every_nth);
+
+  std::vector<SampleType> samples (100);
+  for (unsigned int i=0; i<samples.size(); ++i)
+    samples[i] = i;
+  range_producer.sample (samples);
+
+  std::cout << "mean=" << mean_value.get()
+            << ", count=" << count_samples.get()
+            << ", last=" << last_sample.get()
+            << std::endl;
+}
+
+
+
+void count_concurrently (const SampleFlow::LockingPolicy locking_policy)
+{
+  SampleFlow::Mutex mutex;
+  mutex.set_locking_policy (locking_policy);
+
+  unsigned long counter = 0;
+  std::vector<std::thread> threads;
+  for (unsigned int t=0; t<4; ++t)
+    threads.emplace_back ([&]()
+  {
+    for (unsigned int i=0; i<100000; ++i)
+      {
+        std::lock_guard<SampleFlow::Mutex> lock (mutex);
+        ++counter;
+      }
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  std::cout << "counter=" << counter << std::endl;
+}
+
+
+
+int main ()
+{
+  run (SampleFlow::LockingPolicy::mutex);
+  run (SampleFlow::LockingPolicy::spinlock);
+  run (SampleFlow::LockingPolicy::none);
+
+  count_concurrently (SampleFlow::LockingPolicy::mutex);
+  count_concurrently (SampleFlow::LockingPolicy::spinlock);
+}
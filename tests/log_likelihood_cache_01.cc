@@ -0,0 +1,146 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the LogLikelihoodCache class: Sample the loaded dice of the first
+// example in the documentation of the MetropolisHastings class, once
+// without and once with a cache, and check that the chains are the same
+// and that the log likelihood function is called only once per side of
+// the dice in the second case. Then check that the least recently used
+// entries are evicted if the cache is full, and use a cache whose keys
+// are quantized versions of std::valarray samples.
+
+
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/log_likelihood_cache.h>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/action.h>
+
+
+unsigned int n_evaluations = 0;
+
+double log_likelihood (const unsigned int &x)
+{
+  ++n_evaluations;
+  switch (x)
+    {
+      case 3:
+        return std::log(0.25);
+      case 4:
+        return std::log(0.05);
+      default:
+        return std::log(0.175);
+    }
+}
+
+
+std::mt19937 perturb_rng;
+
+std::pair<unsigned int,double> perturb (const unsigned int &)
+{
+  std::uniform_int_distribution<unsigned int> distribution(1,6);
+  return {distribution(perturb_rng), 1.0};
+}
+
+
+std::vector<unsigned int>
+run (const std::function<double (const unsigned int &)> &f)
+{
+  perturb_rng.seed (1);
+
+  SampleFlow::Producers::MetropolisHastings<unsigned int> mh_sampler;
+
+  std::vector<unsigned int> chain;
+  SampleFlow::Consumers::Action<unsigned int>
+  record ([&](unsigned int x, SampleFlow::AuxiliaryData)
+  {
+    chain.push_back (x);
+  });
+  record.connect_to_producer (mh_sampler);
+
+  mh_sampler.sample (1, f, &perturb, 10000);
+
+  return chain;
+}
+
+
+int main ()
+{
+  // Sample with and without the cache:
+  {
+    n_evaluations = 0;
+    const std::vector<unsigned int> chain = run (&log_likelihood);
+    std::cout << "Evaluations without cache: " << n_evaluations << std::endl;
+
+    n_evaluations = 0;
+    SampleFlow::LogLikelihoodCache<unsigned int> cache (&log_likelihood, 6);
+    const std::vector<unsigned int> cached_chain = run (std::ref(cache));
+    std::cout << "Evaluations with cache: " << n_evaluations << std::endl;
+    std::cout << "Hits: " << cache.n_hits()
+              << ", misses: " << cache.n_misses()
+              << ", hit rate: " << cache.hit_rate() << std::endl;
+    std::cout << "Chains are identical: " << (chain == cached_chain) << std::endl;
+  }
+
+  // Check eviction: With a capacity of 2, asking for 1, 2, 1, 3 evicts 2
+  // (the least recently used), so asking for 1 and then 2 again results
+  // in one hit and one miss.
+  {
+    n_evaluations = 0;
+    SampleFlow::LogLikelihoodCache<unsigned int> cache (&log_likelihood, 2);
+    for (const unsigned int x : {1u, 2u, 1u, 3u})
+      cache (x);
+    std::cout << "Size: " << cache.size() << std::endl;
+
+    const std::size_t hits = cache.n_hits();
+    cache (1);
+    std::cout << "1 found: " << (cache.n_hits() == hits+1) << std::endl;
+    cache (2);
+    std::cout << "2 found: " << (cache.n_hits() == hits+2) << std::endl;
+    std::cout << "Evaluations: " << n_evaluations << std::endl;
+
+    cache.clear ();
+    std::cout << "Size after clear: " << cache.size()
+              << ", hit rate: " << cache.hit_rate() << std::endl;
+  }
+
+  // Use a cache for std::valarray samples that rounds the (single)
+  // component of each sample to a multiple of 0.1, and uses the rounded
+  // value (as an integer) as key:
+  {
+    unsigned int n_valarray_evaluations = 0;
+    SampleFlow::LogLikelihoodCache<std::valarray<double>,long>
+    cache ([&](const std::valarray<double> &x)
+    {
+      ++n_valarray_evaluations;
+      return -x[0]*x[0];
+    },
+    100,
+    [](const std::valarray<double> &x)
+    {
+      return std::lround(x[0]*10);
+    });
+
+    for (const double x : {0.1, 0.11, 0.2, 0.09, 0.3, 0.21})
+      cache (std::valarray<double> {x});
+    std::cout << "Valarray evaluations: " << n_valarray_evaluations
+              << ", hits: " << cache.n_hits() << std::endl;
+  }
+}
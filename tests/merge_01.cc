@@ -0,0 +1,125 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the merge() functions of the accumulating consumers: Distribute
+// a set of samples unevenly among four objects of each consumer type
+// (one of which sees only one sample, and one of which sees none), merge
+// these into the first of these objects, and compare the result with
+// that of one object that has seen all samples.
+
+
+#include <iostream>
+#include <valarray>
+#include <random>
+
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/histogram.h>
+#include <sampleflow/consumers/pair_histogram.h>
+#include <sampleflow/consumers/maximum_probability_sample.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+int main ()
+{
+  std::mt19937 rng;
+  std::normal_distribution<> distribution (0.5, 0.25);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value[5];
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix[5];
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples[5];
+  SampleFlow::Consumers::PairHistogram<SampleType> pair_histogram[5]
+  {
+    {0, 1, 2, 0, 1, 2}, {0, 1, 2, 0, 1, 2}, {0, 1, 2, 0, 1, 2},
+    {0, 1, 2, 0, 1, 2}, {0, 1, 2, 0, 1, 2}
+  };
+  SampleFlow::Consumers::Histogram<double> histogram[5]
+  {
+    {0, 1, 4}, {0, 1, 4}, {0, 1, 4}, {0, 1, 4}, {0, 1, 4}
+  };
+  SampleFlow::Consumers::MaximumProbabilitySample<SampleType> map_point[5];
+
+  // Objects 0...3 get parts of the samples, object 4 all of them. Object 2
+  // gets exactly one sample, object 3 none.
+  for (unsigned int i=0; i<1000; ++i)
+    {
+      const SampleType sample = {distribution(rng), distribution(rng)};
+      const SampleFlow::AuxiliaryData aux_data
+      {
+        {SampleFlow::AuxiliaryDataKeys::relative_log_likelihood, -(sample*sample).sum()}
+      };
+
+      const unsigned int part = (i == 500 ? 2 : (i < 300 ? 0 : 1));
+      for (const unsigned int object : {part, 4u})
+        {
+          mean_value[object].consume (sample, aux_data);
+          covariance_matrix[object].consume (sample, aux_data);
+          count_samples[object].consume (sample, aux_data);
+          pair_histogram[object].consume (sample, aux_data);
+          histogram[object].consume (sample[0], aux_data);
+          map_point[object].consume (sample, aux_data);
+        }
+    }
+
+  // Merge objects 1...3 into object 0:
+  for (unsigned int object=1; object<4; ++object)
+    {
+      mean_value[0].merge (mean_value[object]);
+      covariance_matrix[0].merge (covariance_matrix[object]);
+      count_samples[0].merge (count_samples[object]);
+      pair_histogram[0].merge (pair_histogram[object]);
+      histogram[0].merge (histogram[object]);
+      map_point[0].merge (map_point[object]);
+    }
+
+  // Also check that merging into an object that has not seen any samples
+  // yields a copy of the other object:
+  mean_value[3].merge (mean_value[4]);
+  covariance_matrix[3].merge (covariance_matrix[4]);
+
+  for (const unsigned int object : {0, 4, 3})
+    {
+      std::cout << "Object " << object << ':' << std::endl;
+      std::cout << "  Mean value: "
+                << mean_value[object].get()[0] << ' '
+                << mean_value[object].get()[1] << std::endl;
+      std::cout << "  Covariance matrix: "
+                << covariance_matrix[object].get()(0,0) << ' '
+                << covariance_matrix[object].get()(0,1) << ' '
+                << covariance_matrix[object].get()(1,0) << ' '
+                << covariance_matrix[object].get()(1,1) << std::endl;
+
+      if (object == 3)
+        break;
+
+      std::cout << "  Number of samples: "
+                << count_samples[object].get() << std::endl;
+      std::cout << "  Histogram:";
+      for (const auto &bin : histogram[object].get())
+        std::cout << ' ' << std::get<2>(bin);
+      std::cout << std::endl;
+      std::cout << "  Pair histogram:";
+      for (const auto &bin : pair_histogram[object].get())
+        std::cout << ' ' << std::get<2>(bin);
+      std::cout << std::endl;
+      std::cout << "  MAP point: "
+                << map_point[object].get().first[0] << ' '
+                << map_point[object].get().first[1] << std::endl;
+    }
+}
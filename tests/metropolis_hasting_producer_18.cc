@@ -0,0 +1,162 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that continuing a chain with sample_more() yields the same
+// samples as producing them all with one call to sample(), without
+// evaluating the log likelihood of the last sample again, and that a
+// chain can be saved, restored by a different producer object, and
+// continued exactly where it left off. Also check that reading the state
+// of a random number generator from a corrupt or truncated stream leads
+// to an exception.
+
+
+#include <iostream>
+#include <sstream>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/action.h>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using SampleType = double;
+
+
+unsigned int n_evaluations = 0;
+
+double log_likelihood (const SampleType &x)
+{
+  ++n_evaluations;
+  return -x*x/2;
+}
+
+
+std::mt19937 perturb_rng;
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  std::uniform_real_distribution<double> distribution(-1,1);
+  return {x + distribution(perturb_rng), 1.};
+}
+
+
+int main ()
+{
+  std::vector<SampleType> samples;
+  const auto record = [&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    samples.push_back (x);
+  };
+
+  // First produce all samples with one call to sample()
+  std::vector<SampleType> reference_samples;
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::Action<SampleType> action (record);
+    action.connect_to_producer (mh_sampler);
+
+    perturb_rng.seed (1);
+    n_evaluations = 0;
+    samples.clear ();
+    mh_sampler.sample (0, &log_likelihood, &perturb, 1000, 42);
+    reference_samples = samples;
+
+    std::cout << "One call: " << samples.size() << " samples, "
+              << n_evaluations << " evaluations" << std::endl;
+  }
+
+  // Then do the same in pieces. Use blocks of samples to check that
+  // sample_more() also sends partial blocks at the end.
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler (7);
+    SampleFlow::Consumers::Action<SampleType> action (record);
+    action.connect_to_producer (mh_sampler);
+
+    perturb_rng.seed (1);
+    n_evaluations = 0;
+    samples.clear ();
+    mh_sampler.sample (0, &log_likelihood, &perturb, 300, 42);
+    mh_sampler.sample_more (200);
+    mh_sampler.sample_more (500);
+
+    std::cout << "Three calls: " << samples.size() << " samples, "
+              << n_evaluations << " evaluations, "
+              << (samples == reference_samples ? "same" : "different")
+              << std::endl;
+  }
+
+  // Finally save the state of a chain after 400 samples along with the
+  // state of the random number generator used in perturb(), and continue
+  // it with a different producer object after messing up that generator.
+  {
+    std::stringstream state;
+    {
+      SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+      SampleFlow::Consumers::Action<SampleType> action (record);
+      action.connect_to_producer (mh_sampler);
+
+      perturb_rng.seed (1);
+      samples.clear ();
+      mh_sampler.sample (0, &log_likelihood, &perturb, 400, 42);
+      mh_sampler.save_state (state);
+      SampleFlow::Utilities::write_binary (state, perturb_rng);
+    }
+
+    perturb_rng.seed (2);
+
+    {
+      SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+      SampleFlow::Consumers::Action<SampleType> action (record);
+      action.connect_to_producer (mh_sampler);
+
+      n_evaluations = 0;
+      mh_sampler.load_state (state, &log_likelihood, &perturb);
+      perturb_rng = SampleFlow::Utilities::read_binary<std::mt19937> (state);
+      mh_sampler.sample_more (600);
+
+      std::cout << "Restored chain: " << samples.size() << " samples, "
+                << n_evaluations << " evaluations, "
+                << (samples == reference_samples ? "same" : "different")
+                << std::endl;
+    }
+  }
+
+  // A stream that claims that the state of the generator consists of far
+  // more numbers than it actually does, and a stream that ends in the
+  // middle of the state:
+  {
+    std::stringstream corrupt_state;
+    SampleFlow::Utilities::write_binary (corrupt_state, std::uint32_t(0xffffffff));
+
+    std::stringstream full_state;
+    SampleFlow::Utilities::write_binary (full_state, std::mt19937());
+    std::stringstream truncated_state (full_state.str().substr(0, full_state.str().size()/2));
+
+    for (std::stringstream *state : {&corrupt_state, &truncated_state})
+      {
+        try
+          {
+            SampleFlow::Utilities::read_binary<std::mt19937> (*state);
+            std::cout << "Invalid state: no exception" << std::endl;
+          }
+        catch (const std::runtime_error &)
+          {
+            std::cout << "Invalid state: exception" << std::endl;
+          }
+      }
+  }
+}
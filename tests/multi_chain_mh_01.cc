@@ -0,0 +1,101 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the MultiChainMetropolisHastings producer: Run four chains with
+// different starting points on a Gaussian distribution, and check that
+// each chain produces the requested number of samples and that the
+// samples are correctly tagged with their chain index. Because the
+// samples of different chains arrive in an unpredictable order, we
+// accumulate the mean value of each chain separately; these are
+// reproducible. Also check that all samples together have the correct
+// mean value, and that sending samples in blocks yields the same results.
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/multi_chain_mh.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x-1)*(x-1);
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::uniform_real_distribution<double> distribution(-0.5,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+void run (const unsigned int batch_size)
+{
+  const unsigned int n_chains = 4;
+
+  SampleFlow::Producers::MultiChainMetropolisHastings<SampleType> mh_sampler (batch_size);
+
+  // Samples arrive one at a time, so the Action consumer does not need
+  // to protect these arrays:
+  std::vector<double> sums (n_chains, 0.);
+  std::vector<unsigned int> counts (n_chains, 0);
+  SampleFlow::Consumers::Action<SampleType>
+  per_chain ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+  {
+    const unsigned int chain
+      = aux_data.get<unsigned int>(SampleFlow::AuxiliaryDataKeys::chain_index);
+    sums[chain] += sample;
+    ++counts[chain];
+  });
+  per_chain.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (mh_sampler);
+
+  mh_sampler.sample ({-10, 0, 2, 10},
+                     &log_likelihood,
+                     &perturb,
+                     10000);
+
+  std::cout << "Batch size " << batch_size << ':' << std::endl;
+  for (unsigned int chain=0; chain<n_chains; ++chain)
+    std::cout << "  Chain " << chain << ": "
+              << counts[chain] << " samples, mean "
+              << std::setprecision(8) << sums[chain]/counts[chain]
+              << std::endl;
+  std::cout << "  Total: " << count_samples.get() << " samples, mean "
+            << std::setprecision(3) << mean_value.get() << std::endl;
+}
+
+
+int main ()
+{
+  run (1);
+  run (7);
+}
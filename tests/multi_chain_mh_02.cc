@@ -0,0 +1,97 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Like the _01 test, but use the Philox4x32 generator. Each chain then
+// works on its own stream of random numbers, and the samples of each chain
+// are reproducible regardless of how the threads running the chains are
+// scheduled. Check this by running the sampler twice and comparing the
+// samples of each chain.
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/multi_chain_mh.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/random.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x-1)*(x-1);
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      SampleFlow::Philox4x32 &rng)
+{
+  std::uniform_real_distribution<double> distribution(-0.5,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+std::vector<std::vector<SampleType>>
+run ()
+{
+  const unsigned int n_chains = 4;
+
+  SampleFlow::Producers::MultiChainMetropolisHastings<SampleType,SampleFlow::Philox4x32> mh_sampler;
+
+  // Samples arrive one at a time, so the Action consumer does not need
+  // to protect this array:
+  std::vector<std::vector<SampleType>> samples (n_chains);
+  SampleFlow::Consumers::Action<SampleType>
+  per_chain ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+  {
+    const unsigned int chain
+      = aux_data.get<unsigned int>(SampleFlow::AuxiliaryDataKeys::chain_index);
+    samples[chain].push_back (sample);
+  });
+  per_chain.connect_to_producer (mh_sampler);
+
+  mh_sampler.sample ({-10, 0, 2, 10},
+                     &log_likelihood,
+                     &perturb,
+                     10000,
+                     42);
+  return samples;
+}
+
+
+int main ()
+{
+  const std::vector<std::vector<SampleType>> samples = run ();
+
+  for (unsigned int chain=0; chain<samples.size(); ++chain)
+    {
+      double sum = 0;
+      for (const auto x : samples[chain])
+        sum += x;
+      std::cout << "Chain " << chain << ": "
+                << samples[chain].size() << " samples, mean "
+                << std::setprecision(8) << sum/samples[chain].size()
+                << std::endl;
+    }
+
+  std::cout << "Second run: "
+            << (run() == samples ? "same" : "different")
+            << std::endl;
+}
@@ -0,0 +1,80 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that if the log likelihood function throws an exception on one
+// chain of MultiChainMetropolisHastings, the exception is passed on to the
+// caller and the other chains stop early rather than producing all of
+// their (here slow) samples.
+
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include <sampleflow/producers/multi_chain_mh.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+using SampleType = double;
+
+
+// The first chain starts at a point where the log likelihood throws. For
+// the other chains, each evaluation takes a millisecond.
+double log_likelihood (const SampleType &x)
+{
+  if (x < -100)
+    throw std::runtime_error ("Invalid sample");
+
+  std::this_thread::sleep_for (std::chrono::milliseconds(1));
+  return -x*x;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::uniform_real_distribution<double> distribution(-0.5,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  const unsigned int n_samples_per_chain = 100000;
+
+  SampleFlow::Producers::MultiChainMetropolisHastings<SampleType> mh_sampler;
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (mh_sampler);
+
+  try
+    {
+      mh_sampler.sample ({-1000, 0, 1},
+                         &log_likelihood,
+                         &perturb,
+                         n_samples_per_chain);
+    }
+  catch (const std::exception &e)
+    {
+      std::cout << "Caught exception: " << e.what() << std::endl;
+    }
+
+  std::cout << "Other chains stopped early: "
+            << (count_samples.get() < 2*n_samples_per_chain ? "yes" : "no")
+            << std::endl;
+}
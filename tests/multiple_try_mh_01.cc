@@ -0,0 +1,113 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the MultipleTryMetropolisHastings producer: With one trial per
+// step, it has to produce exactly the same chain as the
+// MetropolisHastings producer. With more trials, check that the chain
+// samples a Gaussian distribution with the correct mean and variance,
+// and that the acceptance ratio increases with the number of trials.
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/multiple_try_mh.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -((x-1.)*(x-1.)).sum();
+}
+
+
+std::mt19937 rng;
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  std::normal_distribution<double> distribution(0,1);
+  SampleType y = x;
+  for (auto &y_i : y)
+    y_i += distribution(rng);
+  return {y, 1.0};
+}
+
+
+int main ()
+{
+  // First compare against the MetropolisHastings producer:
+  {
+    std::vector<double> samples[2];
+
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::Action<SampleType>
+    mh_action ([&](SampleType sample, SampleFlow::AuxiliaryData)
+    {
+      samples[0].push_back (sample[0]);
+    });
+    mh_action.connect_to_producer (mh_sampler);
+
+    SampleFlow::Producers::MultipleTryMetropolisHastings<SampleType> mtm_sampler (1);
+    SampleFlow::Consumers::Action<SampleType>
+    mtm_action ([&](SampleType sample, SampleFlow::AuxiliaryData)
+    {
+      samples[1].push_back (sample[0]);
+    });
+    mtm_action.connect_to_producer (mtm_sampler);
+
+    rng.seed (1);
+    mh_sampler.sample ({0, 0}, &log_likelihood, &perturb, 1000, 42);
+    rng.seed (1);
+    mtm_sampler.sample ({0, 0}, &log_likelihood, &perturb, 1000, 42);
+
+    std::cout << "Same chain with one trial: "
+              << (samples[0] == samples[1]) << std::endl;
+  }
+
+  // Then run with several numbers of trials:
+  for (const unsigned int n_trials : {1, 4, 8})
+    {
+      SampleFlow::Producers::MultipleTryMetropolisHastings<SampleType> mtm_sampler (n_trials);
+
+      SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+      mean_value.connect_to_producer (mtm_sampler);
+
+      SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+      covariance_matrix.connect_to_producer (mtm_sampler);
+
+      SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+      acceptance_ratio.connect_to_producer (mtm_sampler);
+
+      rng.seed (1);
+      mtm_sampler.sample ({0, 0}, &log_likelihood, &perturb, 20000, 42);
+
+      std::cout << "Trials: " << n_trials << std::endl
+                << std::setprecision(2)
+                << "  mean: " << mean_value.get()[0] << ' ' << mean_value.get()[1] << std::endl
+                << "  variance: " << covariance_matrix.get()(0,0) << ' ' << covariance_matrix.get()(1,1) << std::endl
+                << "  acceptance ratio: " << acceptance_ratio.get() << std::endl;
+    }
+}
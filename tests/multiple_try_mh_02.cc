@@ -0,0 +1,124 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the MultipleTryMetropolisHastings producer with one trial per
+// step against the MetropolisHastings producer for a chain that starts
+// outside the support of the distribution (a half-Gaussian on x>=0),
+// using a proposal distribution that is not symmetric. Both producers
+// need to produce exactly the same chain, including the auxiliary data,
+// also while the chain random-walks through the region of zero
+// probability. The log likelihood marks zero probability by
+// -std::numeric_limits<double>::max(), which both producers need to
+// report unchanged as the relative log likelihood of samples outside the
+// support.
+
+
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/multiple_try_mh.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  if (x < 0)
+    return -std::numeric_limits<double>::max();
+  else
+    return -x*x/2;
+}
+
+
+std::mt19937 rng;
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  std::normal_distribution<double> distribution(0,1);
+  const SampleType y = x + distribution(rng);
+  return {y, (y > x ? 0.5 : 2.0)};
+}
+
+
+struct Record
+{
+  std::vector<SampleType> samples;
+  std::vector<bool>       repeated;
+  std::vector<double>     log_likelihoods;
+
+  void add (const SampleType sample,
+            const SampleFlow::AuxiliaryData &aux_data)
+  {
+    samples.push_back (sample);
+    repeated.push_back (aux_data.get<bool>(SampleFlow::AuxiliaryDataKeys::sample_is_repeated));
+    log_likelihoods.push_back (aux_data.get<double>(SampleFlow::AuxiliaryDataKeys::relative_log_likelihood));
+  }
+};
+
+
+int main ()
+{
+  Record records[2];
+
+  SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+  SampleFlow::Consumers::Action<SampleType>
+  mh_action ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+  {
+    records[0].add (sample, aux_data);
+  });
+  mh_action.connect_to_producer (mh_sampler);
+
+  SampleFlow::Producers::MultipleTryMetropolisHastings<SampleType> mtm_sampler (1);
+  SampleFlow::Consumers::Action<SampleType>
+  mtm_action ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+  {
+    records[1].add (sample, aux_data);
+  });
+  mtm_action.connect_to_producer (mtm_sampler);
+
+  rng.seed (1);
+  mh_sampler.sample (-10, &log_likelihood, &perturb, 1000, 42);
+  rng.seed (1);
+  mtm_sampler.sample (-10, &log_likelihood, &perturb, 1000, 42);
+
+  unsigned int first_sample_in_support = 0;
+  while ((first_sample_in_support < records[0].samples.size())
+         &&
+         (records[0].samples[first_sample_in_support] < 0))
+    ++first_sample_in_support;
+
+  unsigned int n_rejected_in_zero_region = 0;
+  for (unsigned int i=0; i<first_sample_in_support; ++i)
+    if (records[0].repeated[i])
+      ++n_rejected_in_zero_region;
+
+  std::cout << "First sample in the support: "
+            << first_sample_in_support << std::endl;
+  std::cout << "Rejected samples before that: "
+            << n_rejected_in_zero_region << std::endl;
+  std::cout << "Same chain with one trial: "
+            << ((records[0].samples == records[1].samples)
+                &&
+                (records[0].repeated == records[1].repeated)
+                &&
+                (records[0].log_likelihoods == records[1].log_likelihoods) ? "yes" : "no")
+            << std::endl;
+}
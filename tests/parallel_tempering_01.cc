@@ -0,0 +1,158 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the ParallelTempering producer on a distribution with two
+// well-separated modes at -5 and +5 with equal weights. A
+// Metropolis-Hastings chain with the same proposal distribution never
+// leaves the mode it starts in, whereas the cold chain of parallel
+// tempering should spend about half of its samples in each mode. Also
+// check that the samples do not depend on the number of threads used,
+// and that outputting all replicas results in samples for all
+// temperatures.
+
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/parallel_tempering.h>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return std::log(std::exp(-(x-5)*(x-5)/(2*0.25)) +
+                  std::exp(-(x+5)*(x+5)/(2*0.25)));
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::normal_distribution<double> distribution(0,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+const std::vector<double> temperatures = {1, 3, 10, 30, 100};
+
+
+std::vector<SampleType>
+run (SampleFlow::ThreadPool &thread_pool)
+{
+  SampleFlow::Producers::ParallelTempering<SampleType> pt_sampler (temperatures, 5);
+  pt_sampler.set_thread_pool (thread_pool);
+
+  std::vector<SampleType> samples;
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    samples.push_back (x);
+  });
+  record.connect_to_producer (pt_sampler);
+
+  pt_sampler.sample (-5, &log_likelihood, &perturb, 100000, 1);
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Acceptance ratios:";
+  for (const double a : pt_sampler.get_acceptance_ratios())
+    std::cout << ' ' << a;
+  std::cout << std::endl;
+  std::cout << "Swap acceptance ratios:";
+  for (const double a : pt_sampler.get_swap_acceptance_ratios())
+    std::cout << ' ' << a;
+  std::cout << std::endl;
+
+  return samples;
+}
+
+
+double fraction_positive (const std::vector<SampleType> &samples)
+{
+  unsigned int n_positive = 0;
+  for (const SampleType x : samples)
+    if (x > 0)
+      ++n_positive;
+  return 1. * n_positive / samples.size();
+}
+
+
+int main ()
+{
+  // First a regular MH chain:
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+
+    std::vector<SampleType> samples;
+    SampleFlow::Consumers::Action<SampleType>
+    record ([&](SampleType x, SampleFlow::AuxiliaryData)
+    {
+      samples.push_back (x);
+    });
+    record.connect_to_producer (mh_sampler);
+
+    std::mt19937 rng;
+    mh_sampler.sample (-5, &log_likelihood,
+                       [&](const SampleType &x)
+    {
+      return perturb (x, rng);
+    },
+    100000);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "MH: fraction of samples in the positive mode: "
+              << fraction_positive(samples) << std::endl;
+  }
+
+  // Then parallel tempering, on pools of different sizes:
+  std::vector<SampleType> samples;
+  {
+    SampleFlow::ThreadPool thread_pool (1);
+    samples = run (thread_pool);
+    std::cout << "PT: " << samples.size() << " samples, fraction of samples in the positive mode: "
+              << std::setprecision(1) << fraction_positive(samples) << std::endl;
+  }
+  {
+    SampleFlow::ThreadPool thread_pool (3);
+    const bool same = (run (thread_pool) == samples);
+    std::cout << "Same samples with 3 threads: " << same << std::endl;
+  }
+
+  // Finally output all replicas, and count the samples per temperature:
+  {
+    SampleFlow::Producers::ParallelTempering<SampleType> pt_sampler (temperatures, 7, true);
+
+    std::map<double,unsigned int> n_samples_per_temperature;
+    SampleFlow::Consumers::Action<SampleType>
+    count ([&](SampleType, SampleFlow::AuxiliaryData aux_data)
+    {
+      ++n_samples_per_temperature[aux_data.get<double>(SampleFlow::AuxiliaryDataKeys::temperature)];
+    });
+    count.connect_to_producer (pt_sampler);
+
+    pt_sampler.sample (-5, &log_likelihood, &perturb, 1000, 1);
+
+    for (const auto &p : n_samples_per_temperature)
+      std::cout << "T=" << std::setprecision(0) << p.first << ": " << p.second << " samples" << std::endl;
+  }
+}
@@ -0,0 +1,114 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the exchange step of the ParallelTempering producer for samples
+// with zero probability: Start all replicas outside the support of a
+// distribution (a half-Gaussian on x>=0). All replicas then random-walk
+// until they reach the support. As soon as one of the hotter replicas has
+// done so, the next exchange step has to move its sample down to the cold
+// replica, since the exchange ratio is infinite if the colder sample has
+// zero probability and the hotter one does not. (With the seed used here,
+// the random walk of the cold replica on its own would only reach the
+// support after more than 200 steps.)
+
+
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/parallel_tempering.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  if (x < 0)
+    return -std::numeric_limits<double>::infinity();
+  else
+    return -x*x/2;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::normal_distribution<double> distribution(0,0.5);
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  const std::vector<double> temperatures = {1, 3, 10, 30, 100};
+  const unsigned int n_replicas = temperatures.size();
+  const unsigned int swap_interval = 5;
+  const unsigned int n_steps = 1000;
+
+  SampleFlow::Producers::ParallelTempering<SampleType> pt_sampler (temperatures,
+      swap_interval,
+      true);
+
+  // Record for each step and each replica whether its sample is in the
+  // support. Samples arrive ordered by step and, within each step, by
+  // replica.
+  std::vector<std::vector<bool>> in_support (n_replicas);
+  unsigned int n_samples_received = 0;
+  SampleFlow::Consumers::Action<SampleType>
+  record ([&](SampleType x, SampleFlow::AuxiliaryData)
+  {
+    in_support[n_samples_received % n_replicas].push_back (x >= 0);
+    ++n_samples_received;
+  });
+  record.connect_to_producer (pt_sampler);
+
+  pt_sampler.sample (-3, &log_likelihood, &perturb, n_steps, 3);
+
+  const auto first_step_in_support = [&](const unsigned int r)
+  {
+    for (unsigned int step=0; step<in_support[r].size(); ++step)
+      if (in_support[r][step])
+        return step;
+    return n_steps;
+  };
+
+  unsigned int first_step_any = n_steps;
+  for (unsigned int r=0; r<n_replicas; ++r)
+    first_step_any = std::min (first_step_any, first_step_in_support(r));
+  const unsigned int first_step_cold = first_step_in_support(0);
+
+  // The first exchange after the step in which the first replica reached
+  // the support happens at the end of that round of steps:
+  const unsigned int next_exchange = (first_step_any / swap_interval + 1) * swap_interval;
+
+  std::cout << "First step with any replica in the support: "
+            << first_step_any << std::endl;
+  std::cout << "First step with the cold replica in the support: "
+            << first_step_cold << std::endl;
+  std::cout << "Cold replica reached the support by the next exchange: "
+            << (first_step_cold <= next_exchange ? "yes" : "no") << std::endl;
+
+  bool stays_in_support = true;
+  for (unsigned int step=first_step_cold; step<n_steps; ++step)
+    if (!in_support[0][step])
+      stays_in_support = false;
+  std::cout << "Cold replica stays in the support: "
+            << (stays_in_support ? "yes" : "no") << std::endl;
+}
@@ -0,0 +1,94 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the "sample is repeated" flag of the ParallelTempering producer:
+// For each replica, a sample has to be flagged as repeated if and only if
+// it equals the previous sample of the same replica. In particular, the
+// first sample after an exchange differs from the previous one even if
+// the replica rejects its trial sample in that step, and must then not
+// be flagged as repeated.
+
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/parallel_tempering.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -x*x/2;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::normal_distribution<double> distribution(0,2);
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  const std::vector<double> temperatures = {1, 2, 4, 8};
+  const unsigned int n_replicas = temperatures.size();
+
+  SampleFlow::Producers::ParallelTempering<SampleType> pt_sampler (temperatures,
+      3,
+      true);
+
+  std::vector<SampleType> previous_samples (n_replicas, 1.);
+  unsigned int n_samples_received = 0;
+  unsigned int n_repeated = 0;
+  unsigned int n_equal_to_previous = 0;
+  unsigned int n_mismatches = 0;
+  SampleFlow::Consumers::Action<SampleType>
+  check ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+  {
+    const unsigned int r = n_samples_received % n_replicas;
+    const bool repeated = aux_data.get<bool>(SampleFlow::AuxiliaryDataKeys::sample_is_repeated);
+    const bool equal_to_previous = (x == previous_samples[r]);
+
+    if (repeated)
+      ++n_repeated;
+    if (equal_to_previous)
+      ++n_equal_to_previous;
+    if (repeated != equal_to_previous)
+      ++n_mismatches;
+
+    previous_samples[r] = x;
+    ++n_samples_received;
+  });
+  check.connect_to_producer (pt_sampler);
+
+  pt_sampler.sample (1., &log_likelihood, &perturb, 3000, 1);
+
+  bool some_exchanges_accepted = false;
+  for (const double ratio : pt_sampler.get_swap_acceptance_ratios())
+    if (ratio > 0)
+      some_exchanges_accepted = true;
+
+  std::cout << "Exchanges accepted: " << (some_exchanges_accepted ? "yes" : "no") << std::endl;
+  std::cout << "Samples flagged as repeated: " << n_repeated << std::endl;
+  std::cout << "Samples equal to the previous one: " << n_equal_to_previous << std::endl;
+  std::cout << "Mismatches: " << n_mismatches << std::endl;
+}
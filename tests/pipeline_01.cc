@@ -0,0 +1,122 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that a static pipeline (see pipeline.h) computes the same as
+// the equivalent graph of producer, filters, and consumers connected
+// via connect_to_producer(). Also check that a pipeline can use filter
+// objects it does not own, that it can end in a single consumer, and
+// that it no longer receives samples once it has been destroyed.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/pipeline.h>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -x*x/2;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<> distribution(-1,1);
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  // First use the usual way of connecting objects:
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+
+    SampleFlow::Filters::DiscardFirstN<SampleType> discard (1000);
+    discard.connect_to_producer (mh_sampler);
+
+    SampleFlow::Filters::TakeEveryNth<SampleType> every_nth (10);
+    every_nth.connect_to_producer (discard);
+
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.connect_to_producer (every_nth);
+
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+    covariance_matrix.connect_to_producer (every_nth);
+
+    mh_sampler.sample (0., &log_likelihood, &perturb, 20000);
+
+    std::cout << "Connected graph: mean=" << mean_value.get()
+              << ", variance=" << covariance_matrix.get()(0,0) << std::endl;
+  }
+
+  // Then the same with a static pipeline. The sampler uses the same
+  // (default) random seed, but the perturb() function needs to start
+  // from a fresh random number generator, too.
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+
+    const auto pipeline = SampleFlow::pipeline (mh_sampler)
+                          | SampleFlow::discard_first_n (1000)
+                          | SampleFlow::take_every_nth (10)
+                          | SampleFlow::tee (mean_value, covariance_matrix);
+
+    mh_sampler.sample (0., &log_likelihood,
+                       [](const SampleType &x)
+    {
+      static std::mt19937 rng;
+      std::uniform_real_distribution<> distribution(-1,1);
+      return std::pair<SampleType,double> (x + distribution(rng), 1.0);
+    },
+    20000);
+
+    std::cout << "Static pipeline: mean=" << mean_value.get()
+              << ", variance=" << covariance_matrix.get()(0,0) << std::endl;
+  }
+
+  // Finally use a filter object that the pipeline does not own, end in
+  // a single consumer, and check that destroying the pipeline disconnects
+  // it from the producer:
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Filters::TakeEveryNth<SampleType> every_nth (3);
+    SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+
+    {
+      const auto pipeline = SampleFlow::pipeline (mh_sampler)
+                            | every_nth
+                            | count_samples;
+      mh_sampler.sample (0., &log_likelihood, &perturb, 300);
+    }
+    mh_sampler.sample (0., &log_likelihood, &perturb, 300);
+
+    std::cout << "Samples counted: " << count_samples.get() << std::endl;
+  }
+}
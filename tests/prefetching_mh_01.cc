@@ -0,0 +1,137 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the PrefetchingMetropolisHastings producer: For several prefetch
+// depths and thread pool sizes, it has to produce exactly the same chain
+// (including the auxiliary data) as the MetropolisHastings producer
+// using the documented proposal generator. Use a distribution with a
+// region of zero probability, so that the special treatment of such
+// samples is also tested.
+
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <limits>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/prefetching_mh.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  if (x < -1)
+    return -std::numeric_limits<double>::infinity();
+  else
+    return -(x-1)*(x-1);
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x,
+                                      std::mt19937 &rng)
+{
+  std::normal_distribution<double> distribution(0,1);
+  return {x + distribution(rng), 1.0};
+}
+
+
+struct Record
+{
+  std::vector<SampleType> samples;
+  std::vector<double>     log_likelihoods;
+  std::vector<bool>       repeated;
+
+  void add (const SampleType sample,
+            const SampleFlow::AuxiliaryData &aux_data)
+  {
+    samples.push_back (sample);
+    log_likelihoods.push_back (aux_data.get<double>(SampleFlow::AuxiliaryDataKeys::relative_log_likelihood));
+    repeated.push_back (aux_data.get<bool>(SampleFlow::AuxiliaryDataKeys::sample_is_repeated));
+  }
+
+  bool operator== (const Record &other) const
+  {
+    return ((samples == other.samples)
+            && (log_likelihoods == other.log_likelihoods)
+            && (repeated == other.repeated));
+  }
+};
+
+
+int main ()
+{
+  const SampleFlow::types::sample_index n_samples = 5000;
+  const std::mt19937::result_type seed = 17;
+
+  // First produce the reference chain, starting in the area of zero
+  // probability:
+  Record reference;
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::Action<SampleType>
+    action ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+    {
+      reference.add (sample, aux_data);
+    });
+    action.connect_to_producer (mh_sampler);
+
+    std::mt19937 proposal_rng
+      = SampleFlow::Producers::PrefetchingMetropolisHastings<SampleType>::proposal_generator (seed);
+    mh_sampler.sample (-3,
+                       &log_likelihood,
+                       [&](const SampleType &x)
+    {
+      return perturb (x, proposal_rng);
+    },
+    n_samples, seed);
+  }
+
+  unsigned int n_accepted = 0;
+  for (const bool repeated : reference.repeated)
+    if (!repeated)
+      ++n_accepted;
+  std::cout << "Reference chain: " << reference.samples.size() << " samples, "
+            << n_accepted << " accepted" << std::endl;
+
+  // Then compare with the prefetching producer:
+  SampleFlow::ThreadPool thread_pool (3);
+  for (const unsigned int depth : {1, 2, 5, 16})
+    for (const bool use_default_pool : {true, false})
+      {
+        Record record;
+
+        SampleFlow::Producers::PrefetchingMetropolisHastings<SampleType> prefetching_sampler (depth);
+        if (use_default_pool == false)
+          prefetching_sampler.set_thread_pool (thread_pool);
+
+        SampleFlow::Consumers::Action<SampleType>
+        action ([&](SampleType sample, SampleFlow::AuxiliaryData aux_data)
+        {
+          record.add (sample, aux_data);
+        });
+        action.connect_to_producer (prefetching_sampler);
+
+        prefetching_sampler.sample (-3, &log_likelihood, &perturb, n_samples, seed);
+
+        std::cout << "Depth " << depth
+                  << (use_default_pool ? ", default pool" : ", own pool")
+                  << ": same chain = " << (record == reference) << std::endl;
+      }
+}
@@ -0,0 +1,244 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that the Chain classes of the MH, DR, and DEMC producers produce
+// the same samples (and auxiliary data) as the corresponding sample()
+// functions, whether one asks for samples one at a time or in groups, and
+// that several chains can be advanced in turn without affecting each
+// other.
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/delayed_rejection_mh.h>
+#include <sampleflow/producers/differential_evaluation_mh.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x-1)*(x-1)/2;
+}
+
+
+std::mt19937 perturb_rng;
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  std::normal_distribution<double> distribution(0,1);
+  return {x + distribution(perturb_rng), 1.0};
+}
+
+
+std::pair<SampleType,double> dr_perturb (const SampleType &x,
+                                         const std::vector<SampleType> &rejected_samples)
+{
+  std::normal_distribution<double> distribution(0,1./(1+rejected_samples.size()));
+  return {x + distribution(perturb_rng), 1.0};
+}
+
+
+SampleType crossover (const SampleType &current_sample,
+                      const SampleType &sample_a,
+                      const SampleType &sample_b)
+{
+  return current_sample + 1.68 * (sample_a - sample_b);
+}
+
+
+// A function object with its own random number generator, so that several
+// chains can be advanced in turn without sharing state.
+struct Perturb
+{
+  Perturb (const unsigned int seed)
+    : rng (seed)
+  {}
+
+  std::pair<SampleType,double> operator() (const SampleType &x)
+  {
+    std::normal_distribution<double> distribution(0,1);
+    return {x + distribution(rng), 1.0};
+  }
+
+  std::mt19937 rng;
+};
+
+
+
+// Compare a sequence of samples produced by sample() with one produced by
+// a Chain object
+bool same (const SampleFlow::SampleBatch<SampleType> &a,
+           const SampleFlow::SampleBatch<SampleType> &b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (unsigned int i=0; i<a.size(); ++i)
+    if ((a[i].first != b[i].first)
+        ||
+        (a[i].second.get<double>(SampleFlow::AuxiliaryDataKeys::relative_log_likelihood)
+         != b[i].second.get<double>(SampleFlow::AuxiliaryDataKeys::relative_log_likelihood))
+        ||
+        (a[i].second.get<bool>(SampleFlow::AuxiliaryDataKeys::sample_is_repeated)
+         != b[i].second.get<bool>(SampleFlow::AuxiliaryDataKeys::sample_is_repeated)))
+      return false;
+  return true;
+}
+
+
+
+// Ask a Chain object for samples one at a time and in groups of
+// different sizes
+template <typename ChainType>
+SampleFlow::SampleBatch<SampleType>
+pull (ChainType &chain, const unsigned int n_samples)
+{
+  SampleFlow::SampleBatch<SampleType> samples;
+  unsigned int group_size = 0;
+  while (samples.size() < n_samples)
+    {
+      group_size = std::min<unsigned int> ((group_size+1) % 5, n_samples - samples.size());
+      if (group_size == 0)
+        samples.emplace_back (chain.next());
+      else
+        for (auto &sample : chain.next(group_size))
+          samples.emplace_back (std::move(sample));
+    }
+  return samples;
+}
+
+
+
+int main ()
+{
+  const unsigned int n_samples = 1003;
+
+  // Metropolis-Hastings
+  {
+    SampleFlow::SampleBatch<SampleType> pushed_samples;
+    SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+    SampleFlow::Consumers::Action<SampleType>
+    action ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+    {
+      pushed_samples.emplace_back (x, std::move(aux_data));
+    });
+    action.connect_to_producer (mh_sampler);
+
+    perturb_rng.seed (1);
+    mh_sampler.sample (0, &log_likelihood, &perturb, n_samples, 42);
+
+    perturb_rng.seed (1);
+    SampleFlow::Producers::MetropolisHastings<SampleType>::Chain
+    chain (0, &log_likelihood, &perturb, 42);
+    const SampleFlow::SampleBatch<SampleType> pulled_samples = pull (chain, n_samples);
+
+    std::cout << "MH: "
+              << (same (pushed_samples, pulled_samples) ? "same" : "different")
+              << std::endl;
+  }
+
+  // Delayed rejection
+  {
+    SampleFlow::SampleBatch<SampleType> pushed_samples;
+    SampleFlow::Producers::DelayedRejectionMetropolisHastings<SampleType> dr_sampler;
+    SampleFlow::Consumers::Action<SampleType>
+    action ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+    {
+      pushed_samples.emplace_back (x, std::move(aux_data));
+    });
+    action.connect_to_producer (dr_sampler);
+
+    perturb_rng.seed (1);
+    dr_sampler.sample (0, &log_likelihood, &dr_perturb, 3, n_samples, 42);
+
+    perturb_rng.seed (1);
+    SampleFlow::Producers::DelayedRejectionMetropolisHastings<SampleType>::Chain
+    chain (0, &log_likelihood, &dr_perturb, 3, 42);
+    const SampleFlow::SampleBatch<SampleType> pulled_samples = pull (chain, n_samples);
+
+    std::cout << "DR: "
+              << (same (pushed_samples, pulled_samples) ? "same" : "different")
+              << std::endl;
+  }
+
+  // Differential evaluation. Use a number of samples that is a multiple of
+  // the number of chains, since sample() only advances as many chains as
+  // necessary in the last generation.
+  {
+    const std::vector<SampleType> starting_points = {-2, -1, 0, 1, 2, 3, 4, 5};
+
+    SampleFlow::SampleBatch<SampleType> pushed_samples;
+    SampleFlow::Producers::DifferentialEvaluationMetropolisHastings<SampleType> de_sampler;
+    SampleFlow::Consumers::Action<SampleType>
+    action ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+    {
+      pushed_samples.emplace_back (x, std::move(aux_data));
+    });
+    action.connect_to_producer (de_sampler);
+
+    perturb_rng.seed (1);
+    de_sampler.sample (starting_points, &log_likelihood, &perturb, &crossover,
+                       5, 1000, 42);
+
+    perturb_rng.seed (1);
+    SampleFlow::Producers::DifferentialEvaluationMetropolisHastings<SampleType>::Chain
+    chain (starting_points, &log_likelihood, &perturb, &crossover, 5, 42);
+    const SampleFlow::SampleBatch<SampleType> pulled_samples = pull (chain, 1000);
+
+    std::cout << "DEMC: "
+              << (same (pushed_samples, pulled_samples) ? "same" : "different")
+              << std::endl;
+  }
+
+  // Several MH chains advanced in turn, compared with running each of them
+  // through sample() on its own
+  {
+    const unsigned int n_chains = 3;
+
+    std::vector<SampleFlow::Producers::MetropolisHastings<SampleType>::Chain> chains;
+    for (unsigned int c=0; c<n_chains; ++c)
+      chains.emplace_back (c, &log_likelihood, Perturb(c+1), 100+c);
+
+    std::vector<SampleFlow::SampleBatch<SampleType>> pulled_samples (n_chains);
+    for (unsigned int i=0; i<n_samples; ++i)
+      for (unsigned int c=0; c<n_chains; ++c)
+        pulled_samples[c].emplace_back (chains[c].next());
+
+    for (unsigned int c=0; c<n_chains; ++c)
+      {
+        SampleFlow::SampleBatch<SampleType> pushed_samples;
+        SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+        SampleFlow::Consumers::Action<SampleType>
+        action ([&](SampleType x, SampleFlow::AuxiliaryData aux_data)
+        {
+          pushed_samples.emplace_back (x, std::move(aux_data));
+        });
+        action.connect_to_producer (mh_sampler);
+
+        mh_sampler.sample (c, &log_likelihood, Perturb(c+1), n_samples, 100+c);
+
+        std::cout << "Interleaved chain " << c << ": "
+                  << (same (pushed_samples, pulled_samples[c]) ? "same" : "different")
+                  << std::endl;
+      }
+  }
+}
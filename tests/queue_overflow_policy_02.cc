@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check QueueOverflowPolicy::drop_oldest: With a queue of size 3 and the
+// first sample already being processed, an asynchronous consumer that
+// cannot keep up must process the first sample plus the last two, and
+// discard all others.
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/thread_pool.h>
+
+
+int main ()
+{
+  using SampleType = int;
+
+  // Use a single thread so that queued samples are processed in order.
+  SampleFlow::ThreadPool thread_pool (1);
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  // The asynchronous consumer does not start processing samples until
+  // the 'gate' has been opened. It records all samples it processes.
+  std::atomic<bool> gate_open (false);
+  std::atomic<bool> processing_started (false);
+  std::mutex processed_samples_mutex;
+  std::vector<SampleType> processed_samples;
+  SampleFlow::Consumers::Action<SampleType>
+  slow_consumer ([&](SampleType sample, SampleFlow::AuxiliaryData)
+  {
+    processing_started = true;
+    while (gate_open == false)
+      std::this_thread::yield();
+
+    std::lock_guard<std::mutex> lock (processed_samples_mutex);
+    processed_samples.push_back (sample);
+  },
+  SampleFlow::ParallelMode::asynchronous);
+  slow_consumer.set_parallel_mode (SampleFlow::ParallelMode::asynchronous,
+                                   3,
+                                   SampleFlow::QueueOverflowPolicy::drop_oldest);
+  slow_consumer.set_thread_pool (thread_pool);
+  slow_consumer.connect_to_producer (range_producer);
+
+  // A second, synchronous consumer is called after the first one for
+  // each sample. It first makes sure that the asynchronous consumer has
+  // started working on the first sample, and opens the gate once the
+  // last sample has been sent.
+  SampleFlow::Consumers::Action<SampleType>
+  gate_keeper ([&](SampleType sample, SampleFlow::AuxiliaryData)
+  {
+    if (sample == 1)
+      while (processing_started == false)
+        std::this_thread::yield();
+    if (sample == 10)
+      gate_open = true;
+  });
+  gate_keeper.connect_to_producer (range_producer);
+
+  range_producer.sample (std::vector<SampleType> {1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+
+  std::cout << "Processed samples:";
+  for (const auto sample : processed_samples)
+    std::cout << ' ' << sample;
+  std::cout << std::endl;
+  std::cout << "Dropped samples: " << slow_consumer.n_dropped_samples() << std::endl;
+}
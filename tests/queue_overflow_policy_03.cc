@@ -0,0 +1,76 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check QueueOverflowPolicy::block: An asynchronous consumer that is
+// slower than its producer must throttle the producer so that never
+// more than 'queue_size' samples are waiting or being processed, and
+// it must not lose any samples.
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/thread_pool.h>
+
+
+int main ()
+{
+  using SampleType = int;
+  const unsigned int queue_size = 4;
+
+  SampleFlow::ThreadPool thread_pool (2);
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  std::atomic<unsigned int> n_processed_samples (0);
+  SampleFlow::Consumers::Action<SampleType>
+  slow_consumer ([&](SampleType, SampleFlow::AuxiliaryData)
+  {
+    std::this_thread::sleep_for (std::chrono::microseconds(100));
+    ++n_processed_samples;
+  },
+  SampleFlow::ParallelMode::asynchronous);
+  slow_consumer.set_parallel_mode (SampleFlow::ParallelMode::asynchronous,
+                                   queue_size,
+                                   SampleFlow::QueueOverflowPolicy::block);
+  slow_consumer.set_thread_pool (thread_pool);
+  slow_consumer.connect_to_producer (range_producer);
+
+  // Record the largest difference between the number of samples sent
+  // and the number of samples processed so far.
+  unsigned int n_sent_samples = 0;
+  unsigned int max_backlog = 0;
+  SampleFlow::Consumers::Action<SampleType>
+  observer ([&](SampleType, SampleFlow::AuxiliaryData)
+  {
+    ++n_sent_samples;
+    max_backlog = std::max (max_backlog, n_sent_samples - n_processed_samples);
+  });
+  observer.connect_to_producer (range_producer);
+
+  std::vector<SampleType> samples (1000);
+  range_producer.sample (samples);
+
+  std::cout << "Processed samples: " << n_processed_samples << std::endl;
+  std::cout << "Dropped samples: " << slow_consumer.n_dropped_samples() << std::endl;
+  std::cout << "Backlog bounded by queue size: "
+            << (max_backlog <= queue_size ? "yes" : "no") << std::endl;
+}
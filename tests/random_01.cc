@@ -0,0 +1,117 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Test the Philox4x32 random number generator: Compare against the
+// known-answer test vectors of the reference implementation, check that
+// jumping to a position in a stream yields the same numbers as getting
+// there one number at a time, that different streams yield different
+// numbers, and that the generator can be used with the distributions of
+// the C++ standard library.
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include <sampleflow/random.h>
+
+
+void print_block (const std::array<std::uint32_t,4> &counter,
+                  const std::array<std::uint32_t,2> &key)
+{
+  const std::array<std::uint32_t,4> block
+    = SampleFlow::Philox4x32::compute_block (counter, key);
+  for (const auto x : block)
+    std::cout << std::hex << std::setw(8) << std::setfill('0') << x << ' ';
+  std::cout << std::dec << std::endl;
+}
+
+
+int main ()
+{
+  // Known-answer tests
+  print_block ({{0, 0, 0, 0}}, {{0, 0}});
+  print_block ({{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {{0xffffffff, 0xffffffff}});
+  print_block ({{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}},
+  {{0xa4093822, 0x299f31d0}});
+
+  // Draw a sequence of numbers one at a time, and then get the same
+  // numbers by jumping around in the stream
+  SampleFlow::Philox4x32 rng (42, 3);
+  std::vector<std::uint32_t> numbers;
+  for (unsigned int i=0; i<20; ++i)
+    numbers.push_back (rng());
+  std::cout << "Offset after 20 numbers: " << rng.offset() << std::endl;
+
+  bool same = true;
+  for (const unsigned int offset : {13, 0, 7, 19, 4, 5})
+    {
+      SampleFlow::Philox4x32 other_rng (42, 3);
+      other_rng.set_offset (offset);
+      same = same && (other_rng() == numbers[offset]);
+    }
+  {
+    SampleFlow::Philox4x32 other_rng (42, 3);
+    other_rng.discard (6);
+    other_rng.discard (3);
+    same = same && (other_rng() == numbers[9]);
+  }
+  std::cout << "Jumping around: " << (same ? "same" : "different") << std::endl;
+
+  // A different stream, or a different seed, yields different numbers
+  {
+    SampleFlow::Philox4x32 other_stream (42, 4);
+    SampleFlow::Philox4x32 other_seed (43, 3);
+    unsigned int n_equal_stream = 0, n_equal_seed = 0;
+    for (unsigned int i=0; i<20; ++i)
+      {
+        n_equal_stream += (other_stream() == numbers[i] ? 1 : 0);
+        n_equal_seed   += (other_seed() == numbers[i] ? 1 : 0);
+      }
+    std::cout << "Equal numbers in other stream: " << n_equal_stream
+              << ", with other seed: " << n_equal_seed << std::endl;
+  }
+
+  // Comparison of generators
+  {
+    SampleFlow::Philox4x32 a (1, 2), b (1, 2);
+    std::cout << "Equal: " << (a == b);
+    a();
+    std::cout << ", after drawing from one: " << (a == b);
+    b();
+    std::cout << ", after drawing from both: " << (a == b) << std::endl;
+  }
+
+  // Use the generator with a standard distribution and compute mean and
+  // variance of uniformly distributed numbers
+  {
+    SampleFlow::Philox4x32 rng (1);
+    std::uniform_real_distribution<double> distribution (0,1);
+    const unsigned int n = 100000;
+    double sum = 0, sum_of_squares = 0;
+    for (unsigned int i=0; i<n; ++i)
+      {
+        const double x = distribution(rng);
+        sum += x;
+        sum_of_squares += x*x;
+      }
+    std::cout << "Mean: " << std::setprecision(3) << sum/n
+              << ", variance: " << (sum_of_squares/n - sum/n*sum/n)
+              << std::endl;
+  }
+}
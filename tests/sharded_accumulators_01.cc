@@ -0,0 +1,139 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the enable_sharding() functions of the accumulating consumers:
+// Let four threads send samples concurrently to consumers that use
+// sharding (with the default number of shards, and with fewer shards
+// than threads) and to consumers that do not, and compare the results.
+// Also check that a sharded object can be merged into one that is not.
+
+
+#include <iostream>
+#include <valarray>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/histogram.h>
+#include <sampleflow/consumers/pair_histogram.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+struct Consumers
+{
+  Consumers ()
+    :
+    pair_histogram (0, 1, 2, 0, 1, 2),
+    histogram (0, 1, 4)
+  {}
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  SampleFlow::Consumers::PairHistogram<SampleType> pair_histogram;
+  SampleFlow::Consumers::Histogram<double> histogram;
+};
+
+
+
+void output (const Consumers &consumers)
+{
+  std::cout << "  Mean value: "
+            << consumers.mean_value.get()[0] << ' '
+            << consumers.mean_value.get()[1] << std::endl;
+  std::cout << "  Covariance matrix: "
+            << consumers.covariance_matrix.get()(0,0) << ' '
+            << consumers.covariance_matrix.get()(0,1) << ' '
+            << consumers.covariance_matrix.get()(1,0) << ' '
+            << consumers.covariance_matrix.get()(1,1) << std::endl;
+  std::cout << "  Number of samples: "
+            << consumers.count_samples.get() << std::endl;
+  std::cout << "  Histogram:";
+  for (const auto &bin : consumers.histogram.get())
+    std::cout << ' ' << std::get<2>(bin);
+  std::cout << std::endl;
+  std::cout << "  Pair histogram:";
+  for (const auto &bin : consumers.pair_histogram.get())
+    std::cout << ' ' << std::get<2>(bin);
+  std::cout << std::endl;
+}
+
+
+
+int main ()
+{
+  Consumers consumers[3];
+
+  // Object 0 does not use sharding, object 1 uses the default number of
+  // shards, and object 2 uses fewer shards than there are threads:
+  consumers[1].mean_value.enable_sharding ();
+  consumers[1].covariance_matrix.enable_sharding ();
+  consumers[1].count_samples.enable_sharding ();
+  consumers[1].pair_histogram.enable_sharding ();
+  consumers[1].histogram.enable_sharding ();
+
+  consumers[2].mean_value.enable_sharding (2);
+  consumers[2].covariance_matrix.enable_sharding (2);
+  consumers[2].count_samples.enable_sharding (2);
+  consumers[2].pair_histogram.enable_sharding (2);
+  consumers[2].histogram.enable_sharding (2);
+
+  // Let each thread send a deterministic sequence of samples:
+  const unsigned int n_threads = 4;
+  const unsigned int n_samples_per_thread = 10000;
+  std::vector<std::thread> threads;
+  for (unsigned int t=0; t<n_threads; ++t)
+    threads.emplace_back ([&consumers,t]()
+  {
+    for (unsigned int i=0; i<n_samples_per_thread; ++i)
+      {
+        const unsigned int k = t*n_samples_per_thread + i;
+        const SampleType sample = {(k % 97) / 97., (k % 89) / 89. * (k % 2)};
+
+        for (auto &c : consumers)
+          {
+            c.mean_value.consume (sample, {});
+            c.covariance_matrix.consume (sample, {});
+            c.count_samples.consume (sample, {});
+            c.pair_histogram.consume (sample, {});
+            c.histogram.consume (sample[0], {});
+          }
+      }
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  for (const unsigned int object : {0, 1, 2})
+    {
+      std::cout << "Object " << object << ':' << std::endl;
+      output (consumers[object]);
+    }
+
+  // Merge the sharded object 1 into a new, unsharded object:
+  Consumers merged;
+  merged.mean_value.merge (consumers[1].mean_value);
+  merged.covariance_matrix.merge (consumers[1].covariance_matrix);
+  merged.count_samples.merge (consumers[1].count_samples);
+  merged.pair_histogram.merge (consumers[1].pair_histogram);
+  merged.histogram.merge (consumers[1].histogram);
+
+  std::cout << "Merged:" << std::endl;
+  output (merged);
+}
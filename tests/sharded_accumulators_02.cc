@@ -0,0 +1,113 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check how internal::Shards assigns shards to threads: Each object hands
+// out its shards to threads in the order in which they first ask for
+// one, regardless of how many other threads have existed before or have
+// used other objects. In particular, as long as no more threads use an
+// object at the same time than it has shards, each thread has its own
+// shard -- even if the threads are created anew for each round of work,
+// as some producers do.
+
+
+#include <atomic>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/shards.h>
+
+
+using Shards = SampleFlow::internal::Shards<int>;
+
+
+int *create_shard ()
+{
+  return new int (0);
+}
+
+
+// Let the given number of new threads ask the given object for their
+// shards, and return the set of distinct shards they got. None of the
+// threads ends before all of them have their shard, so that they all run
+// at the same time.
+std::set<const int *>
+shards_of_new_threads (const Shards &shards,
+                       const unsigned int n_threads)
+{
+  std::vector<const int *> local_shards (n_threads);
+  std::atomic<unsigned int> n_threads_done (0);
+  std::vector<std::thread> threads;
+  for (unsigned int t=0; t<n_threads; ++t)
+    threads.emplace_back ([&, t]()
+  {
+    local_shards[t] = &shards.local();
+    ++n_threads_done;
+    while (n_threads_done < n_threads)
+      std::this_thread::yield();
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  return std::set<const int *> (local_shards.begin(), local_shards.end());
+}
+
+
+int main ()
+{
+  // Let the main thread take the first shard of an object with two
+  // shards. Then let a few threads use a different object, and finally
+  // let one more thread use the first object: It has to get the second
+  // shard, not the one the main thread has.
+  {
+    Shards shards;
+    shards.initialize (2, &create_shard);
+    const int *main_thread_shard = &shards.local();
+
+    Shards other_shards;
+    other_shards.initialize (2, &create_shard);
+    shards_of_new_threads (other_shards, 3);
+
+    const std::set<const int *> new_thread_shard = shards_of_new_threads (shards, 1);
+    std::cout << "Main thread and new thread share a shard: "
+              << (new_thread_shard.count(main_thread_shard) > 0 ? "yes" : "no")
+              << std::endl;
+    std::cout << "Main thread keeps its shard: "
+              << (&shards.local() == main_thread_shard ? "yes" : "no")
+              << std::endl;
+  }
+
+  // Use an object with four shards in several rounds, each with four new
+  // threads. In each round, the threads need to have distinct shards.
+  {
+    Shards shards;
+    shards.initialize (4, &create_shard);
+    for (unsigned int round=0; round<3; ++round)
+      std::cout << "Round " << round << ": "
+                << shards_of_new_threads (shards, 4).size()
+                << " distinct shards" << std::endl;
+  }
+
+  // With more threads than shards, the threads share the shards evenly.
+  {
+    Shards shards;
+    shards.initialize (3, &create_shard);
+    std::cout << "Six threads, three shards: "
+              << shards_of_new_threads (shards, 6).size()
+              << " distinct shards" << std::endl;
+  }
+}
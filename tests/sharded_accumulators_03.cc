@@ -0,0 +1,53 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Use sharded consumers both on the main thread and on the workers of
+// the default thread pool, and then let the program end. The workers
+// end only when the default thread pool is destroyed at program exit,
+// and then give back the numbers internal::this_thread_index() assigned
+// them -- which must not use objects that have already been destroyed.
+
+
+#include <iostream>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+int main ()
+{
+  using SampleType = double;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::MeanValue<SampleType> async_mean_value;
+  async_mean_value.set_parallel_mode (SampleFlow::ParallelMode::asynchronous);
+  async_mean_value.enable_sharding ();
+  async_mean_value.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::MeanValue<SampleType> sync_mean_value;
+  sync_mean_value.enable_sharding ();
+  sync_mean_value.connect_to_producer (range_producer);
+
+  std::vector<SampleType> samples (1000);
+  for (unsigned int i=0; i<samples.size(); ++i)
+    samples[i] = i;
+  range_producer.sample (samples);
+
+  std::cout << async_mean_value.get() << ' '
+            << sync_mean_value.get() << std::endl;
+}
@@ -0,0 +1,137 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that a producer that shares its samples delivers them to all
+// consumers (including those downstream of selection filters) without
+// making copies for each consumer: The number of copies of each sample
+// must not depend on the number of consumers. Also check that a slot
+// connected via connect_to_signals(), which does not know about shared
+// samples, still sees all of them.
+
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+// A sample type that counts how often objects of this type are copied.
+struct CountedSample
+{
+  CountedSample (const double value = 0)
+    : value (value)
+  {}
+
+  CountedSample (const CountedSample &other)
+    : value (other.value)
+  {
+    ++n_copies;
+  }
+
+  CountedSample (CountedSample &&other) = default;
+
+  CountedSample &operator= (const CountedSample &other)
+  {
+    value = other.value;
+    ++n_copies;
+    return *this;
+  }
+
+  CountedSample &operator= (CountedSample &&other) = default;
+
+  double value;
+
+  static unsigned int n_copies;
+};
+
+unsigned int CountedSample::n_copies = 0;
+
+
+using SampleType = CountedSample;
+
+
+// Send 12 samples to the given number of consumers, and return how often
+// samples were copied in the process.
+unsigned int n_copies (const bool share_samples,
+                       const unsigned int n_consumers)
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  range_producer.set_sample_sharing (share_samples);
+
+  SampleFlow::Filters::DiscardFirstN<SampleType> discard_first_n (2);
+  discard_first_n.connect_to_producer (range_producer);
+
+  SampleFlow::Filters::TakeEveryNth<SampleType> every_fifth (5);
+  every_fifth.connect_to_producer (discard_first_n);
+
+  std::vector<std::unique_ptr<SampleFlow::Consumers::CountSamples<SampleType>>> counters;
+  std::vector<std::unique_ptr<SampleFlow::Consumers::CountSamples<SampleType>>> filtered_counters;
+  for (unsigned int i=0; i<n_consumers; ++i)
+    {
+      counters.emplace_back (new SampleFlow::Consumers::CountSamples<SampleType>());
+      counters.back()->connect_to_producer (range_producer);
+
+      filtered_counters.emplace_back (new SampleFlow::Consumers::CountSamples<SampleType>());
+      filtered_counters.back()->connect_to_producer (every_fifth);
+    }
+
+  const std::vector<SampleType> samples (12, SampleType(1.));
+
+  CountedSample::n_copies = 0;
+  range_producer.sample (samples);
+  const unsigned int copies = CountedSample::n_copies;
+
+  std::cout << "  " << n_consumers << " consumer(s): "
+            << counters.back()->get() << " samples, "
+            << filtered_counters.back()->get() << " filtered samples"
+            << std::endl;
+
+  return copies;
+}
+
+
+int main ()
+{
+  std::cout << "Shared samples:" << std::endl;
+  const unsigned int shared_1 = n_copies (true, 1);
+  const unsigned int shared_4 = n_copies (true, 4);
+  std::cout << "Copies per sample: " << shared_1/12. << ' ' << shared_4/12. << std::endl;
+
+  std::cout << "Samples sent by value:" << std::endl;
+  const unsigned int by_value_1 = n_copies (false, 1);
+  const unsigned int by_value_4 = n_copies (false, 4);
+  std::cout << "More copies with more consumers: "
+            << (by_value_4 > by_value_1 ? "yes" : "no") << std::endl;
+
+  // Now connect a slot that knows nothing about shared samples:
+  SampleFlow::Producers::Range<double> range_producer;
+  range_producer.set_sample_sharing (true);
+  double sum = 0;
+  const auto connections
+    = range_producer.connect_to_signals ([&](double sample, SampleFlow::AuxiliaryData)
+  {
+    sum += sample;
+  },
+  []() {});
+  range_producer.sample (std::vector<double> {1, 2, 3, 4});
+  connections.first.disconnect();
+  connections.second.disconnect();
+  std::cout << "Sum seen by slot: " << sum << std::endl;
+}
@@ -0,0 +1,120 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2020 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the lock-free protocol by which a consumer in
+// ParallelMode::synchronous keeps track of the samples it is currently
+// processing: Let several threads send samples to the same consumer (via
+// separate producers, which also flush the consumer at the end of each
+// of their sample() calls), and let yet another thread call
+// disconnect_and_flush() while they do so. This function has to return,
+// no sample may still be in the middle of being processed at that time,
+// and no sample may be processed afterwards, even though the threads
+// keep sending samples.
+
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+
+
+using SampleType = int;
+
+
+int main ()
+{
+  const unsigned int n_rounds  = 20;
+  const unsigned int n_senders = 4;
+
+  const std::vector<SampleType> samples (100, 1);
+
+  bool all_consistent = true;
+  for (unsigned int round=0; round<n_rounds; ++round)
+    {
+      std::vector<std::unique_ptr<SampleFlow::Producers::Range<SampleType>>> producers;
+      for (unsigned int t=0; t<n_senders; ++t)
+        producers.emplace_back (new SampleFlow::Producers::Range<SampleType>());
+
+      std::atomic<unsigned int> n_in_progress (0);
+      std::atomic<unsigned int> n_processed (0);
+      SampleFlow::Consumers::Action<SampleType>
+      consumer ([&](SampleType, SampleFlow::AuxiliaryData)
+      {
+        ++n_in_progress;
+        if (++n_processed % 64 == 0)
+          std::this_thread::yield();
+        --n_in_progress;
+      });
+      for (auto &producer : producers)
+        consumer.connect_to_producer (*producer);
+
+      // Start the threads that send samples until told to stop:
+      std::atomic<bool> stop (false);
+      std::atomic<unsigned int> n_sent (0);
+      std::vector<std::thread> senders;
+      for (unsigned int t=0; t<n_senders; ++t)
+        senders.emplace_back ([&, t]()
+      {
+        while (stop.load() == false)
+          {
+            producers[t]->sample (samples);
+            n_sent += samples.size();
+          }
+      });
+
+      // Wait until samples are flowing, then disconnect from yet another
+      // thread:
+      while (n_processed.load() < 1000)
+        std::this_thread::yield();
+
+      unsigned int n_in_progress_after_flush = 0;
+      unsigned int n_processed_after_flush = 0;
+      std::thread disconnecter ([&]()
+      {
+        consumer.disconnect_and_flush();
+        n_in_progress_after_flush = n_in_progress.load();
+        n_processed_after_flush = n_processed.load();
+      });
+      disconnecter.join();
+
+      // Let the senders continue for a bit before stopping them:
+      std::this_thread::sleep_for (std::chrono::milliseconds(10));
+      stop = true;
+      for (auto &sender : senders)
+        sender.join();
+
+      if ((n_in_progress_after_flush != 0)
+          ||
+          (n_processed.load() != n_processed_after_flush)
+          ||
+          (n_processed_after_flush > n_sent.load()))
+        {
+          std::cout << "Round " << round << ": "
+                    << n_in_progress_after_flush << " samples in progress after flush, "
+                    << n_processed.load() - n_processed_after_flush << " processed afterwards"
+                    << std::endl;
+          all_consistent = false;
+        }
+    }
+
+  std::cout << "disconnect_and_flush() returned in all rounds" << std::endl;
+  std::cout << "Sample counts consistent: " << (all_consistent ? "yes" : "no") << std::endl;
+}
@@ -0,0 +1,46 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that the ThreadPool class executes all tasks submitted to it,
+// and that the futures it returns become ready once a task has run.
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+
+#include <sampleflow/thread_pool.h>
+
+
+int main ()
+{
+  SampleFlow::ThreadPool thread_pool (3);
+  std::cout << "Number of threads: " << thread_pool.n_threads() << std::endl;
+
+  std::atomic<unsigned int> sum (0);
+
+  std::vector<std::future<void>> futures;
+  for (unsigned int i=1; i<=100; ++i)
+    futures.emplace_back (thread_pool.submit ([i,&sum]()
+  {
+    sum += i;
+  }));
+
+  for (auto &future : futures)
+    future.wait();
+
+  // The sum of the numbers 1...100 is 5050.
+  std::cout << "Sum: " << sum << std::endl;
+}